@@ -25,6 +25,8 @@
 #include "deprecated/gdkpixbuf.h"
 #include "filetransferportalprivate.h"
 #include "gdktextureprivate.h"
+#include "gdktexturedownloaderprivate.h"
+#include "gdkgltexture.h"
 #include "gdkrgba.h"
 #include "loaders/gdkpngprivate.h"
 #include "loaders/gdktiffprivate.h"
@@ -691,11 +693,18 @@ serialize_texture_in_thread (GTask        *task,
   GInputStream *input;
   gssize spliced;
 
-  value = gdk_content_serializer_get_value (serializer);
-  texture = g_value_get_object (value);
+  /* GL textures have been downloaded already, see texture_serializer() */
+  texture = task_data;
+  if (texture == NULL)
+    {
+      value = gdk_content_serializer_get_value (serializer);
+      texture = g_value_get_object (value);
+    }
 
   if (strcmp (gdk_content_serializer_get_mime_type (serializer), "image/png") == 0)
-    bytes = gdk_save_png (texture);
+    /* This is for clipboards and DND, so it's worth trading
+     * size for speed */
+    bytes = gdk_save_png_with_compression (texture, GDK_PNG_COMPRESSION_FAST);
   else if (strcmp (gdk_content_serializer_get_mime_type (serializer), "image/tiff") == 0)
     bytes = gdk_save_tiff (texture);
   else if (strcmp (gdk_content_serializer_get_mime_type (serializer), "image/jpeg") == 0)
@@ -720,15 +729,67 @@ serialize_texture_in_thread (GTask        *task,
     g_task_return_error (task, error);
 }
 
+static void
+texture_serializer_downloaded (GObject      *source,
+                               GAsyncResult *result,
+                               gpointer      data)
+{
+  GTask *task = data;
+  GdkTexture *texture, *downloaded;
+  GBytes *bytes;
+  gsize stride;
+  GError *error = NULL;
+
+  bytes = gdk_texture_downloader_download_bytes_finish (result, &stride, &error);
+  if (bytes == NULL)
+    {
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      return;
+    }
+
+  texture = g_value_get_object (gdk_content_serializer_get_value (g_task_get_source_object (task)));
+  downloaded = gdk_memory_texture_new (gdk_texture_get_width (texture),
+                                       gdk_texture_get_height (texture),
+                                       gdk_texture_get_format (texture),
+                                       bytes,
+                                       stride);
+  g_bytes_unref (bytes);
+
+  g_task_set_task_data (task, downloaded, g_object_unref);
+  g_task_run_in_thread (task, serialize_texture_in_thread);
+  g_object_unref (task);
+}
+
 static void
 texture_serializer (GdkContentSerializer *serializer)
 {
+  GdkTexture *texture;
   GTask *task;
 
   task = g_task_new (serializer,
                      gdk_content_serializer_get_cancellable (serializer),
                      texture_serializer_finish,
                      NULL);
+
+  texture = g_value_get_object (gdk_content_serializer_get_value (serializer));
+  if (GDK_IS_GL_TEXTURE (texture))
+    {
+      GdkTextureDownloader downloader;
+
+      /* Reading back from the thread would block the main thread
+       * on the GPU, so read back asynchronously first */
+      gdk_texture_downloader_init (&downloader, texture);
+      gdk_texture_downloader_set_format (&downloader, gdk_texture_get_format (texture));
+      gdk_texture_downloader_download_bytes_async (&downloader,
+                                                   NULL,
+                                                   gdk_content_serializer_get_cancellable (serializer),
+                                                   texture_serializer_downloaded,
+                                                   task);
+      gdk_texture_downloader_finish (&downloader);
+      return;
+    }
+
   g_task_run_in_thread (task, serialize_texture_in_thread);
   g_object_unref (task);
 }
@@ -38,6 +38,7 @@
 #include "gdkeventsprivate.h"
 #include "gdkframeclockidleprivate.h"
 #include "gdkglcontextprivate.h"
+#include "gdkglprogramcacheprivate.h"
 #include "gdkmonitorprivate.h"
 #include "gdkrectangle.h"
 #include "gdkvulkancontextprivate.h"
@@ -443,6 +444,7 @@ gdk_display_dispose (GObject *object)
     }
 #endif
 
+  g_clear_pointer (&display->gl_program_cache, gdk_gl_program_cache_free);
   g_clear_object (&priv->gl_context);
 #ifdef HAVE_EGL
   g_clear_pointer (&priv->egl_display, eglTerminate);
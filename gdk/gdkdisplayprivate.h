@@ -124,6 +124,8 @@ struct _GdkDisplay
   guint vulkan_refcount;
 #endif /* GDK_RENDERING_VULKAN */
 
+  struct _GdkGLProgramCache *gl_program_cache;
+
   /* egl info */
   guint have_egl_buffer_age : 1;
   guint have_egl_no_config_context : 1;
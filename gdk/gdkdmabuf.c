@@ -24,6 +24,8 @@
 #include "gdkdmabuffourccprivate.h"
 #include "gdkdmabuftextureprivate.h"
 #include "gdkmemoryformatprivate.h"
+#include "gdkmemorysimdprivate.h"
+#include "gdkparalleltaskprivate.h"
 
 #ifdef HAVE_DMABUF
 #include <sys/mman.h>
@@ -133,47 +135,169 @@ download_memcpy_3_1 (guchar          *dst_data,
     }
 }
 
-typedef struct _YUVCoefficients YUVCoefficients;
+/* multiplied by 65536, in the order that yuv_to_rgb_888 wants them:
+ * v_to_r, u_to_g, v_to_g, u_to_b */
+//static const int itu601_narrow[4] = { 104597, -25675, -53279, 132201 };
+static const int itu601_wide[4] = { 74711, -25864, -38050, 133176 };
 
-struct _YUVCoefficients
+/* Images with fewer pixels than this are converted in the calling
+ * thread, it's not worth the overhead of using threads for them. */
+#define PARALLEL_YUV_MIN_PIXELS (256 * 256)
+
+/* The minimum number of pixels converted by one task */
+#define PARALLEL_YUV_MIN_TASK_PIXELS (32 * 1024)
+
+typedef struct _YUVComponent YUVComponent;
+typedef struct _YUVDownload YUVDownload;
+
+/* Where to find the samples of the Y, U or V component:
+ * Pixel (x, y) uses the byte at
+ *   data + (y / y_sub) * stride + offset + (x / x_sub) * step
+ */
+struct _YUVComponent
 {
-  int v_to_r;
-  int u_to_g;
-  int v_to_g;
-  int u_to_b;
+  const guchar *data;
+  gsize stride;
+  gsize offset;
+  gsize step;
+  gsize x_sub;
+  gsize y_sub;
 };
 
-/* multiplied by 65536 */
-//static const YUVCoefficients itu601_narrow = { 104597, -25675, -53279, 132201 };
-static const YUVCoefficients itu601_wide = { 74711, -25864, -38050, 133176 };
-
-static inline void
-get_uv_values (const YUVCoefficients *coeffs,
-               guint8                 u,
-               guint8                 v,
-               int                   *out_r,
-               int                   *out_g,
-               int                   *out_b)
+struct _YUVDownload
+{
+  guchar *dst_data;
+  gsize dst_stride;
+  gsize width;
+  gsize height;
+  YUVComponent components[3];
+  gsize rows_per_task;
+};
+
+/* Returns the samples for row y, one per pixel. If they can be
+ * used as they are, no copy is made. */
+static const guchar *
+yuv_component_get_row (const YUVComponent *c,
+                       gsize               y,
+                       gsize               width,
+                       guchar             *buffer)
+{
+  const guchar *row;
+  gsize x, i;
+
+  row = c->data + (y / c->y_sub) * c->stride + c->offset;
+
+  if (c->x_sub == 1 && c->step == 1)
+    return row;
+
+  /* Handle the common subsamplings with fixed loops, those are a
+   * lot faster than the generic one. */
+  switch (c->x_sub)
+    {
+    case 1:
+      for (x = 0; x < width; x++)
+        buffer[x] = row[x * c->step];
+      return buffer;
+
+    case 2:
+      for (x = 0; x + 2 <= width; x += 2)
+        {
+          guchar value = row[x / 2 * c->step];
+
+          buffer[x] = value;
+          buffer[x + 1] = value;
+        }
+      break;
+
+    case 4:
+      for (x = 0; x + 4 <= width; x += 4)
+        {
+          guchar value = row[x / 4 * c->step];
+
+          buffer[x] = value;
+          buffer[x + 1] = value;
+          buffer[x + 2] = value;
+          buffer[x + 3] = value;
+        }
+      break;
+
+    default:
+      x = 0;
+      break;
+    }
+
+  for (; x < width; x += c->x_sub)
+    {
+      guchar value = row[(x / c->x_sub) * c->step];
+
+      for (i = 0; i < c->x_sub && x + i < width; i++)
+        buffer[x + i] = value;
+    }
+
+  return buffer;
+}
+
+static void
+download_yuv_rows (const YUVDownload *yuv,
+                   gsize              y_start,
+                   gsize              y_end)
+{
+  void (* yuv_to_rgb) (guchar *, const guchar *, const guchar *, const guchar *, gsize, const int[4]);
+  const GdkMemorySimdFuncs *simd;
+  guchar *buffer;
+  gsize y;
+
+  simd = gdk_memory_simd_get_funcs ();
+  if (simd && simd->yuv_to_rgb_888)
+    yuv_to_rgb = simd->yuv_to_rgb_888;
+  else
+    yuv_to_rgb = gdk_memory_simd_yuv_to_rgb_888_c;
+
+  buffer = g_malloc (3 * yuv->width);
+
+  for (y = y_start; y < y_end; y++)
+    {
+      yuv_to_rgb (yuv->dst_data + y * yuv->dst_stride,
+                  yuv_component_get_row (&yuv->components[0], y, yuv->width, buffer),
+                  yuv_component_get_row (&yuv->components[1], y, yuv->width, buffer + yuv->width),
+                  yuv_component_get_row (&yuv->components[2], y, yuv->width, buffer + 2 * yuv->width),
+                  yuv->width,
+                  itu601_wide);
+    }
+
+  g_free (buffer);
+}
+
+static void
+download_yuv_task (guint    task_index,
+                   gpointer user_data)
 {
-  int u2 = (int) u - 127;
-  int v2 = (int) v - 127;
-  *out_r = coeffs->v_to_r * v2;
-  *out_g = coeffs->u_to_g * u2 + coeffs->v_to_g * v2;
-  *out_b = coeffs->u_to_b * u2;
+  const YUVDownload *yuv = user_data;
+  gsize y = task_index * yuv->rows_per_task;
+
+  download_yuv_rows (yuv, y, MIN (y + yuv->rows_per_task, yuv->height));
 }
 
-static inline void
-set_rgb_values (guint8 rgb[3],
-                guint8 y,
-                int    r,
-                int    g,
-                int    b)
+static void
+download_yuv (YUVDownload *yuv)
 {
-  int y2 = y * 65536;
+  gsize n_tasks;
 
-  rgb[0] = CLAMP ((y2 + r) >> 16, 0, 255);
-  rgb[1] = CLAMP ((y2 + g) >> 16, 0, 255);
-  rgb[2] = CLAMP ((y2 + b) >> 16, 0, 255);
+  n_tasks = MIN (gdk_parallel_task_get_n_threads () * 4,
+                 yuv->width * yuv->height / PARALLEL_YUV_MIN_TASK_PIXELS);
+  n_tasks = MIN (n_tasks, yuv->height);
+
+  if (n_tasks < 2 || yuv->width * yuv->height < PARALLEL_YUV_MIN_PIXELS)
+    {
+      download_yuv_rows (yuv, 0, yuv->height);
+      return;
+    }
+
+  yuv->rows_per_task = (yuv->height + n_tasks - 1) / n_tasks;
+
+  gdk_parallel_task_run (download_yuv_task,
+                         yuv,
+                         (yuv->height + yuv->rows_per_task - 1) / yuv->rows_per_task);
 }
 
 static void
@@ -187,7 +311,7 @@ download_nv12 (guchar          *dst_data,
                gsize            sizes[GDK_DMABUF_MAX_PLANES])
 {
   const guchar *y_data, *uv_data;
-  gsize x, y, y_stride, uv_stride;
+  gsize y_stride, uv_stride;
   gsize U, V, X_SUB, Y_SUB;
 
   switch (dmabuf->fourcc)
@@ -222,23 +346,17 @@ download_nv12 (guchar          *dst_data,
   uv_data = src_data[1] + dmabuf->planes[1].offset;
   g_return_if_fail (sizes[1] >= dmabuf->planes[1].offset + (height + Y_SUB - 1) / Y_SUB * uv_stride);
 
-  for (y = 0; y < height; y += Y_SUB)
-    {
-      for (x = 0; x < width; x += X_SUB)
-        {
-          int r, g, b;
-          gsize xs, ys;
-
-          get_uv_values (&itu601_wide, uv_data[x / X_SUB * 2 + U], uv_data[x / X_SUB * 2 + V], &r, &g, &b);
-
-          for (ys = 0; ys < Y_SUB && y + ys < height; ys++)
-            for (xs = 0; xs < X_SUB && x + xs < width; xs++)
-              set_rgb_values (&dst_data[3 * (x + xs) + dst_stride * ys], y_data[x + xs + y_stride * ys], r, g, b);
-        }
-      dst_data += Y_SUB * dst_stride;
-      y_data += Y_SUB * y_stride;
-      uv_data += uv_stride;
-    }
+  download_yuv (&(YUVDownload) {
+                  .dst_data = dst_data,
+                  .dst_stride = dst_stride,
+                  .width = width,
+                  .height = height,
+                  .components = {
+                    { y_data, y_stride, 0, 1, 1, 1 },
+                    { uv_data, uv_stride, U, 2, X_SUB, Y_SUB },
+                    { uv_data, uv_stride, V, 2, X_SUB, Y_SUB },
+                  },
+                });
 }
 
 static void
@@ -252,7 +370,7 @@ download_yuv_3 (guchar          *dst_data,
                 gsize            sizes[GDK_DMABUF_MAX_PLANES])
 {
   const guchar *y_data, *u_data, *v_data;
-  gsize x, y, y_stride, u_stride, v_stride;
+  gsize y_stride, u_stride, v_stride;
   gsize U, V, X_SUB, Y_SUB;
 
   switch (dmabuf->fourcc)
@@ -302,24 +420,17 @@ download_yuv_3 (guchar          *dst_data,
   v_data = src_data[V] + dmabuf->planes[V].offset;
   g_return_if_fail (sizes[V] >= dmabuf->planes[V].offset + (height + Y_SUB - 1) / Y_SUB * v_stride);
 
-  for (y = 0; y < height; y += Y_SUB)
-    {
-      for (x = 0; x < width; x += X_SUB)
-        {
-          int r, g, b;
-          gsize xs, ys;
-
-          get_uv_values (&itu601_wide, u_data[x / X_SUB], v_data[x / X_SUB], &r, &g, &b);
-
-          for (ys = 0; ys < Y_SUB && y + ys < height; ys++)
-            for (xs = 0; xs < X_SUB && x + xs < width; xs++)
-              set_rgb_values (&dst_data[3 * (x + xs) + dst_stride * ys], y_data[x + xs + y_stride * ys], r, g, b);
-        }
-      dst_data += Y_SUB * dst_stride;
-      y_data += Y_SUB * y_stride;
-      u_data += u_stride;
-      v_data += v_stride;
-    }
+  download_yuv (&(YUVDownload) {
+                  .dst_data = dst_data,
+                  .dst_stride = dst_stride,
+                  .width = width,
+                  .height = height,
+                  .components = {
+                    { y_data, y_stride, 0, 1, 1, 1 },
+                    { u_data, u_stride, 0, 1, X_SUB, Y_SUB },
+                    { v_data, v_stride, 0, 1, X_SUB, Y_SUB },
+                  },
+                });
 }
 
 static void
@@ -333,22 +444,23 @@ download_yuyv (guchar          *dst_data,
                gsize            sizes[GDK_DMABUF_MAX_PLANES])
 {
   const guchar *src_data;
-  gsize x, y, src_stride;
-  gsize Y1, Y2, U, V;
+  gsize src_stride;
+  gsize Y1, U, V;
 
+  /* The 2nd Y is always 2 bytes after the first */
   switch (dmabuf->fourcc)
     {
     case DRM_FORMAT_YUYV:
-      Y1 = 0; U = 1; Y2 = 2; V = 3;
+      Y1 = 0; U = 1; V = 3;
       break;
     case DRM_FORMAT_YVYU:
-      Y1 = 0; V = 1; Y2 = 2; U = 3;
+      Y1 = 0; V = 1; U = 3;
       break;
     case DRM_FORMAT_UYVY:
-      U = 0; Y1 = 1; V = 2; Y2 = 3;
+      U = 0; Y1 = 1; V = 2;
       break;
     case DRM_FORMAT_VYUY:
-      V = 0; Y1 = 1; U = 2; Y2 = 3;
+      V = 0; Y1 = 1; U = 2;
       break;
     default:
       g_assert_not_reached ();
@@ -359,20 +471,17 @@ download_yuyv (guchar          *dst_data,
   src_data = src_datas[0] + dmabuf->planes[0].offset;
   g_return_if_fail (sizes[0] >= dmabuf->planes[0].offset + height * src_stride);
 
-  for (y = 0; y < height; y ++)
-    {
-      for (x = 0; x < width; x += 2)
-        {
-          int r, g, b;
-
-          get_uv_values (&itu601_wide, src_data[2 * x + U], src_data[2 * x + V], &r, &g, &b);
-          set_rgb_values (&dst_data[3 * x], src_data[2 * x + Y1], r, g, b);
-          if (x + 1 < width)
-            set_rgb_values (&dst_data[3 * (x + 1)], src_data[2 * x + Y2], r, g, b);
-        }
-      dst_data += dst_stride;
-      src_data += src_stride;
-    }
+  download_yuv (&(YUVDownload) {
+                  .dst_data = dst_data,
+                  .dst_stride = dst_stride,
+                  .width = width,
+                  .height = height,
+                  .components = {
+                    { src_data, src_stride, Y1, 2, 1, 1 },
+                    { src_data, src_stride, U, 4, 2, 1 },
+                    { src_data, src_stride, V, 4, 2, 1 },
+                  },
+                });
 }
 
 #define VULKAN_SWIZZLE(_R, _G, _B, _A) { VK_COMPONENT_SWIZZLE_ ## _R, VK_COMPONENT_SWIZZLE_ ## _G, VK_COMPONENT_SWIZZLE_ ## _B, VK_COMPONENT_SWIZZLE_ ## _A }
@@ -1980,6 +2089,44 @@ gdk_dmabuf_get_mmap_formats (void)
   return formats;
 }
 
+/*<private>
+ * gdk_dmabuf_download_data:
+ * @dmabuf: the dmabuf
+ * @src_data: the mapped memory of the planes of @dmabuf
+ * @sizes: the sizes of the mappings
+ * @format: the memory format for @dmabuf's fourcc, as returned by
+ *   gdk_dmabuf_get_memory_format()
+ * @width: the width of the image
+ * @height: the height of the image
+ * @data: the memory to download to
+ * @stride: the stride of @data
+ *
+ * Converts the contents of the planes of a dmabuf that have already
+ * been mapped into memory. The planes' offsets are applied to
+ * @src_data.
+ *
+ * This is the part of the mmap download that doesn't need the kernel,
+ * so it can be tested and benchmarked with plain memory.
+ */
+void
+gdk_dmabuf_download_data (const GdkDmabuf *dmabuf,
+                          const guchar    *src_data[GDK_DMABUF_MAX_PLANES],
+                          gsize            sizes[GDK_DMABUF_MAX_PLANES],
+                          GdkMemoryFormat  format,
+                          gsize            width,
+                          gsize            height,
+                          guchar          *data,
+                          gsize            stride)
+{
+  const GdkDrmFormatInfo *info;
+
+  info = get_drm_format_info (dmabuf->fourcc);
+
+  g_return_if_fail (info && info->download);
+
+  info->download (data, stride, format, width, height, dmabuf, src_data, sizes);
+}
+
 static void
 gdk_dmabuf_do_download_mmap (GdkTexture *texture,
                              guchar     *data,
@@ -2037,14 +2184,14 @@ gdk_dmabuf_do_download_mmap (GdkTexture *texture,
       needs_unmap[i] = TRUE;
     }
 
-    info->download (data,
-                    stride,
-                    gdk_texture_get_format (texture),
-                    gdk_texture_get_width (texture),
-                    gdk_texture_get_height (texture),
-                    dmabuf,
-                    src_data,
-                    sizes);
+  gdk_dmabuf_download_data (dmabuf,
+                            src_data,
+                            sizes,
+                            gdk_texture_get_format (texture),
+                            gdk_texture_get_width (texture),
+                            gdk_texture_get_height (texture),
+                            data,
+                            stride);
 
 out:
   for (i = 0; i < dmabuf->n_planes; i++)
@@ -29,6 +29,14 @@ void                        gdk_dmabuf_download_mmap            (GdkTexture
                                                                  GdkMemoryFormat                 format,
                                                                  guchar                         *data,
                                                                  gsize                           stride);
+void                        gdk_dmabuf_download_data            (const GdkDmabuf                *dmabuf,
+                                                                 const guchar                   *src_data[GDK_DMABUF_MAX_PLANES],
+                                                                 gsize                           sizes[GDK_DMABUF_MAX_PLANES],
+                                                                 GdkMemoryFormat                 format,
+                                                                 gsize                           width,
+                                                                 gsize                           height,
+                                                                 guchar                         *data,
+                                                                 gsize                           stride);
 
 
 int                         gdk_dmabuf_ioctl                    (int                             fd,
@@ -110,6 +110,7 @@ static const GdkDebugKey gdk_gl_feature_keys[] = {
   { "sync", GDK_GL_FEATURE_SYNC, "GL_ARB_sync" },
   { "base-instance", GDK_GL_FEATURE_BASE_INSTANCE, "GL_ARB_base_instance" },
   { "buffer-storage", GDK_GL_FEATURE_BUFFER_STORAGE, "GL_EXT_buffer_storage" },
+  { "program-binary", GDK_GL_FEATURE_PROGRAM_BINARY, "GL_ARB_get_program_binary" },
 };
 
 typedef struct _GdkGLContextPrivate GdkGLContextPrivate;
@@ -1709,6 +1710,17 @@ gdk_gl_context_check_features (GdkGLContext *context)
       epoxy_has_gl_extension ("GL_ARB_buffer_storage"))
     features |= GDK_GL_FEATURE_BUFFER_STORAGE;
 
+  if (gdk_gl_context_check_version (context, "4.1", "3.0") ||
+      epoxy_has_gl_extension ("GL_ARB_get_program_binary"))
+    {
+      GLint n_formats = 0;
+
+      /* Drivers may support the API without any formats */
+      glGetIntegerv (GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+      if (n_formats > 0)
+        features |= GDK_GL_FEATURE_PROGRAM_BINARY;
+    }
+
   return features;
 }
 
@@ -0,0 +1,483 @@
+/* GDK - The GIMP Drawing Kit
+ *
+ * gdkglprogramcache.c: On-disk cache for linked GL programs
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdkglprogramcacheprivate.h"
+
+#include "gdkdebugprivate.h"
+#include "gdkdisplayprivate.h"
+#include "gdkglcontextprivate.h"
+#include "gdkversionmacros.h"
+
+#include <string.h>
+
+/* The cache is like the Vulkan pipeline cache: One file per driver in
+ * the user's cache dir, keyed by the GL vendor, renderer and version
+ * strings and the GTK version.
+ * Programs are looked up by a checksum of all their sources, which
+ * the renderers compute.
+ *
+ * The file format is
+ *
+ *   magic     "GdkGLPB\0"
+ *   version   guint32
+ *   n_entries guint32
+ *   entries   n_entries times:
+ *     key_size   guint32
+ *     format     guint32
+ *     data_size  guint32
+ *     key        key_size bytes, not nul-terminated
+ *     data       data_size bytes
+ *
+ * in native byte order, as the file is only valid on this machine anyway.
+ */
+
+#define CACHE_MAGIC "GdkGLPB"
+#define CACHE_VERSION 1
+/* Don't let the cache grow without bounds */
+#define CACHE_MAX_SIZE (32 * 1024 * 1024)
+
+struct _GdkGLProgramCache
+{
+  GFile *file;
+  char *etag;
+  /* checksum => GBytes with the format followed by the binary */
+  GHashTable *programs;
+  gsize size;
+  guint save_source;
+};
+
+typedef struct
+{
+  guint32 key_size;
+  guint32 format;
+  guint32 data_size;
+} EntryHeader;
+
+static char *
+gdk_gl_program_cache_get_dirname (void)
+{
+  return g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "gl-program-cache", NULL);
+}
+
+static GFile *
+gdk_gl_program_cache_get_file (void)
+{
+  GChecksum *checksum;
+  char *dirname, *basename, *path;
+  GFile *result;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guchar *) glGetString (GL_VENDOR), -1);
+  g_checksum_update (checksum, (const guchar *) "\n", 1);
+  g_checksum_update (checksum, (const guchar *) glGetString (GL_RENDERER), -1);
+  g_checksum_update (checksum, (const guchar *) "\n", 1);
+  g_checksum_update (checksum, (const guchar *) glGetString (GL_VERSION), -1);
+
+  dirname = gdk_gl_program_cache_get_dirname ();
+  basename = g_strdup_printf ("%.32s.%u.%u.%u",
+                              g_checksum_get_string (checksum),
+                              GDK_MAJOR_VERSION,
+                              GDK_MINOR_VERSION,
+                              GDK_MICRO_VERSION);
+  path = g_build_filename (dirname, basename, NULL);
+  result = g_file_new_for_path (path);
+
+  g_free (path);
+  g_free (basename);
+  g_free (dirname);
+  g_checksum_free (checksum);
+
+  return result;
+}
+
+static void
+gdk_gl_program_cache_add (GdkGLProgramCache *self,
+                          const char        *key,
+                          gsize              key_size,
+                          GBytes            *data)
+{
+  char *checksum = g_strndup (key, key_size);
+
+  if (g_hash_table_contains (self->programs, checksum) ||
+      self->size + g_bytes_get_size (data) > CACHE_MAX_SIZE)
+    {
+      g_free (checksum);
+      return;
+    }
+
+  self->size += g_bytes_get_size (data);
+  g_hash_table_insert (self->programs, checksum, g_bytes_ref (data));
+}
+
+/* Adds all programs from the file we don't have yet, so we don't
+ * throw away what other processes added.
+ */
+static gboolean
+gdk_gl_program_cache_load (GdkGLProgramCache *self)
+{
+  GError *error = NULL;
+  GBytes *bytes;
+  const guchar *data;
+  char *contents, *etag;
+  gsize size, pos;
+  guint32 version, n_entries, i;
+
+  if (!g_file_load_contents (self->file, NULL, &contents, &size, &etag, &error))
+    {
+      GDK_DEBUG (OPENGL, "failed to load GL program cache file '%s': %s",
+                 g_file_peek_path (self->file), error->message);
+      g_clear_error (&error);
+      return FALSE;
+    }
+
+  g_free (self->etag);
+  self->etag = etag;
+
+  bytes = g_bytes_new_take (contents, size);
+  data = g_bytes_get_data (bytes, NULL);
+
+  if (size < sizeof (CACHE_MAGIC) + 2 * sizeof (guint32) ||
+      memcmp (data, CACHE_MAGIC, sizeof (CACHE_MAGIC)) != 0)
+    goto invalid;
+
+  pos = sizeof (CACHE_MAGIC);
+  memcpy (&version, data + pos, sizeof (guint32));
+  memcpy (&n_entries, data + pos + sizeof (guint32), sizeof (guint32));
+  pos += 2 * sizeof (guint32);
+  if (version != CACHE_VERSION)
+    goto invalid;
+
+  for (i = 0; i < n_entries; i++)
+    {
+      EntryHeader header;
+      GBytes *program;
+      guchar *blob;
+
+      if (size - pos < sizeof (EntryHeader))
+        goto invalid;
+
+      memcpy (&header, data + pos, sizeof (EntryHeader));
+      pos += sizeof (EntryHeader);
+
+      if (header.key_size == 0 ||
+          size - pos < header.key_size ||
+          size - pos - header.key_size < header.data_size)
+        goto invalid;
+
+      /* We keep the format in front of the binary */
+      blob = g_malloc (sizeof (guint32) + header.data_size);
+      memcpy (blob, &header.format, sizeof (guint32));
+      memcpy (blob + sizeof (guint32), data + pos + header.key_size, header.data_size);
+      program = g_bytes_new_take (blob, sizeof (guint32) + header.data_size);
+
+      gdk_gl_program_cache_add (self, (const char *) data + pos, header.key_size, program);
+      g_bytes_unref (program);
+
+      pos += header.key_size + header.data_size;
+    }
+
+  GDK_DEBUG (OPENGL, "loaded %u programs from GL program cache '%s'",
+             n_entries, g_file_peek_path (self->file));
+
+  g_bytes_unref (bytes);
+  return TRUE;
+
+invalid:
+  GDK_DEBUG (OPENGL, "GL program cache file '%s' is invalid, ignoring it",
+             g_file_peek_path (self->file));
+  g_bytes_unref (bytes);
+  return FALSE;
+}
+
+static GBytes *
+gdk_gl_program_cache_serialize (GdkGLProgramCache *self)
+{
+  GHashTableIter iter;
+  GByteArray *array;
+  gpointer key, value;
+  guint32 n;
+
+  array = g_byte_array_new ();
+  g_byte_array_append (array, (const guchar *) CACHE_MAGIC, sizeof (CACHE_MAGIC));
+  n = CACHE_VERSION;
+  g_byte_array_append (array, (const guchar *) &n, sizeof (guint32));
+  n = g_hash_table_size (self->programs);
+  g_byte_array_append (array, (const guchar *) &n, sizeof (guint32));
+
+  g_hash_table_iter_init (&iter, self->programs);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      const guchar *data;
+      EntryHeader header;
+      gsize size;
+
+      data = g_bytes_get_data (value, &size);
+      header.key_size = strlen (key);
+      memcpy (&header.format, data, sizeof (guint32));
+      header.data_size = size - sizeof (guint32);
+
+      g_byte_array_append (array, (const guchar *) &header, sizeof (EntryHeader));
+      g_byte_array_append (array, key, header.key_size);
+      g_byte_array_append (array, data + sizeof (guint32), header.data_size);
+    }
+
+  return g_byte_array_free_to_bytes (array);
+}
+
+static gboolean
+gdk_gl_program_cache_save (GdkGLProgramCache *self)
+{
+  GError *error = NULL;
+  GBytes *bytes;
+  char *path, *etag;
+  guint tries;
+
+  path = gdk_gl_program_cache_get_dirname ();
+  if (g_mkdir_with_parents (path, 0755) != 0)
+    {
+      g_warning_once ("Failed to create GL program cache directory");
+      g_free (path);
+      return FALSE;
+    }
+  g_free (path);
+
+  /* If somebody else saved the cache in between, merge their
+   * programs and try again, but don't fight forever.
+   */
+  for (tries = 0; tries < 3; tries++)
+    {
+      GDK_DEBUG (OPENGL, "Saving GL program cache to %s", g_file_peek_path (self->file));
+
+      bytes = gdk_gl_program_cache_serialize (self);
+
+      if (g_file_replace_contents (self->file,
+                                   g_bytes_get_data (bytes, NULL),
+                                   g_bytes_get_size (bytes),
+                                   self->etag,
+                                   FALSE,
+                                   0,
+                                   &etag,
+                                   NULL,
+                                   &error))
+        {
+          g_bytes_unref (bytes);
+          g_free (self->etag);
+          self->etag = etag;
+          return TRUE;
+        }
+
+      g_bytes_unref (bytes);
+
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WRONG_ETAG))
+        break;
+
+      GDK_DEBUG (OPENGL, "GL program cache file modified, merging into current");
+      g_clear_error (&error);
+      if (!gdk_gl_program_cache_load (self))
+        g_clear_pointer (&self->etag, g_free);
+    }
+
+  if (error)
+    {
+      g_warning ("Failed to save GL program cache: %s", error->message);
+      g_clear_error (&error);
+    }
+
+  return FALSE;
+}
+
+static gboolean
+gdk_gl_program_cache_save_cb (gpointer data)
+{
+  GdkGLProgramCache *self = data;
+
+  gdk_gl_program_cache_save (self);
+
+  self->save_source = 0;
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gdk_gl_program_cache_updated (GdkGLProgramCache *self)
+{
+  g_clear_handle_id (&self->save_source, g_source_remove);
+  self->save_source = g_timeout_add_seconds_full (G_PRIORITY_DEFAULT_IDLE - 10,
+                                                  10, /* random choice that is not now */
+                                                  gdk_gl_program_cache_save_cb,
+                                                  self,
+                                                  NULL);
+}
+
+static GdkGLProgramCache *
+gdk_gl_program_cache_new (void)
+{
+  GdkGLProgramCache *self;
+
+  self = g_new0 (GdkGLProgramCache, 1);
+  self->file = gdk_gl_program_cache_get_file ();
+  self->programs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_bytes_unref);
+
+  gdk_gl_program_cache_load (self);
+
+  return self;
+}
+
+/*<private>
+ * gdk_gl_program_cache_free:
+ * @cache: the cache
+ *
+ * Writes any pending changes to disk and frees the cache.
+ */
+void
+gdk_gl_program_cache_free (GdkGLProgramCache *cache)
+{
+  if (cache->save_source)
+    {
+      g_clear_handle_id (&cache->save_source, g_source_remove);
+      gdk_gl_program_cache_save (cache);
+    }
+
+  g_hash_table_unref (cache->programs);
+  g_free (cache->etag);
+  g_object_unref (cache->file);
+  g_free (cache);
+}
+
+static GdkGLProgramCache *
+gdk_gl_context_get_program_cache (GdkGLContext *self)
+{
+  GdkDisplay *display;
+
+  if (!gdk_gl_context_has_feature (self, GDK_GL_FEATURE_PROGRAM_BINARY))
+    return NULL;
+
+  display = gdk_gl_context_get_display (self);
+  if (display == NULL)
+    return NULL;
+
+  if (display->gl_program_cache == NULL)
+    display->gl_program_cache = gdk_gl_program_cache_new ();
+
+  return display->gl_program_cache;
+}
+
+/*<private>
+ * gdk_gl_context_load_program_binary:
+ * @self: the current GL context
+ * @checksum: a checksum identifying the program
+ * @program_id: a new program object
+ *
+ * Tries to set up @program_id from the on-disk program cache.
+ *
+ * If this fails, the caller needs to compile and link the program
+ * as usual and should then call gdk_gl_context_store_program_binary().
+ * This function prepares @program_id for that.
+ *
+ * Returns: %TRUE if @program_id was successfully loaded and linked
+ */
+gboolean
+gdk_gl_context_load_program_binary (GdkGLContext *self,
+                                    const char   *checksum,
+                                    GLuint        program_id)
+{
+  GdkGLProgramCache *cache;
+  GBytes *bytes;
+  const guchar *data;
+  guint32 format;
+  gsize size;
+  GLint status;
+
+  cache = gdk_gl_context_get_program_cache (self);
+  if (cache == NULL)
+    return FALSE;
+
+  bytes = g_hash_table_lookup (cache->programs, checksum);
+  if (bytes == NULL)
+    {
+      glProgramParameteri (program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+      return FALSE;
+    }
+
+  data = g_bytes_get_data (bytes, &size);
+  memcpy (&format, data, sizeof (guint32));
+
+  glProgramBinary (program_id, format, data + sizeof (guint32), size - sizeof (guint32));
+  glGetProgramiv (program_id, GL_LINK_STATUS, &status);
+  if (status == GL_TRUE)
+    return TRUE;
+
+  /* The driver changed in a way we didn't notice, get rid of it */
+  GDK_DEBUG (OPENGL, "Failed to load program %s from GL program cache", checksum);
+  cache->size -= size;
+  g_hash_table_remove (cache->programs, checksum);
+  gdk_gl_program_cache_updated (cache);
+
+  glProgramParameteri (program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  return FALSE;
+}
+
+/*<private>
+ * gdk_gl_context_store_program_binary:
+ * @self: the current GL context
+ * @checksum: a checksum identifying the program
+ * @program_id: a successfully linked program
+ *
+ * Adds @program_id to the on-disk program cache, so that future
+ * calls to gdk_gl_context_load_program_binary() can find it.
+ *
+ * The cache is written to disk a while later.
+ */
+void
+gdk_gl_context_store_program_binary (GdkGLContext *self,
+                                     const char   *checksum,
+                                     GLuint        program_id)
+{
+  GdkGLProgramCache *cache;
+  GLint length;
+  GLenum format;
+  guchar *data;
+  GBytes *bytes;
+  guint32 format32;
+
+  cache = gdk_gl_context_get_program_cache (self);
+  if (cache == NULL || g_hash_table_contains (cache->programs, checksum))
+    return;
+
+  glGetProgramiv (program_id, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return;
+
+  data = g_malloc (sizeof (guint32) + length);
+  glGetProgramBinary (program_id, length, &length, &format, data + sizeof (guint32));
+  if (length <= 0)
+    {
+      g_free (data);
+      return;
+    }
+
+  format32 = format;
+  memcpy (data, &format32, sizeof (guint32));
+  bytes = g_bytes_new_take (data, sizeof (guint32) + length);
+
+  gdk_gl_program_cache_add (cache, checksum, strlen (checksum), bytes);
+  gdk_gl_program_cache_updated (cache);
+
+  g_bytes_unref (bytes);
+}
@@ -0,0 +1,38 @@
+/* GDK - The GIMP Drawing Kit
+ *
+ * gdkglprogramcacheprivate.h: On-disk cache for linked GL programs
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "gdkglcontext.h"
+
+#include <epoxy/gl.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GdkGLProgramCache GdkGLProgramCache;
+
+void                    gdk_gl_program_cache_free               (GdkGLProgramCache      *cache);
+
+gboolean                gdk_gl_context_load_program_binary      (GdkGLContext           *self,
+                                                                 const char             *checksum,
+                                                                 GLuint                  program_id);
+void                    gdk_gl_context_store_program_binary     (GdkGLContext           *self,
+                                                                 const char             *checksum,
+                                                                 GLuint                  program_id);
+
+G_END_DECLS
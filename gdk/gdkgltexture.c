@@ -178,6 +178,144 @@ gdk_gl_texture_find_format (GdkGLContext    *context,
   return FALSE;
 }
 
+/* Reads with the format GL prefers, and guesses one if
+ * it can't tell. Needs the texture attached to the bound
+ * framebuffer. */
+static void
+gdk_gl_texture_find_read_format (GdkGLTexture    *self,
+                                 GdkGLContext    *context,
+                                 GdkMemoryFormat *out_format,
+                                 GLenum          *out_gl_format,
+                                 GLenum          *out_gl_type)
+{
+  GdkMemoryFormat format = gdk_texture_get_format (GDK_TEXTURE (self));
+  GLint gl_internal_format;
+  GLint gl_swizzle[4];
+
+  if (gdk_gl_context_check_version (context, "4.3", "3.1"))
+    {
+      GLint read_format, read_type;
+      glGetFramebufferParameteriv (GL_FRAMEBUFFER, GL_IMPLEMENTATION_COLOR_READ_FORMAT, &read_format);
+      glGetFramebufferParameteriv (GL_FRAMEBUFFER, GL_IMPLEMENTATION_COLOR_READ_TYPE, &read_type);
+      if (gdk_gl_texture_find_format (context, gdk_memory_format_alpha (format), read_format, read_type, out_format))
+        {
+          *out_gl_format = read_format;
+          *out_gl_type = read_type;
+          return;
+        }
+    }
+
+  *out_format = gdk_memory_depth_get_format (gdk_memory_format_get_depth (format));
+  if (gdk_memory_format_alpha (format) == GDK_MEMORY_ALPHA_STRAIGHT)
+    *out_format = gdk_memory_format_get_straight (*out_format);
+
+  gdk_memory_format_gl_format (*out_format,
+                               gdk_gl_context_get_use_es (context),
+                               &gl_internal_format,
+                               out_gl_format, out_gl_type, gl_swizzle);
+}
+
+static gboolean
+gdk_gl_texture_needs_fix_up (GdkMemoryFormat format,
+                             GLenum          gl_read_format,
+                             GLenum          gl_read_type)
+{
+  if (gl_read_format != GL_RGBA)
+    return FALSE;
+
+  if (gl_read_type == GL_UNSIGNED_BYTE)
+    return format == GDK_MEMORY_G8A8 ||
+           format == GDK_MEMORY_G8A8_PREMULTIPLIED ||
+           format == GDK_MEMORY_G8 ||
+           format == GDK_MEMORY_A8;
+
+  if (gl_read_type == GL_UNSIGNED_SHORT)
+    return format == GDK_MEMORY_G16A16 ||
+           format == GDK_MEMORY_G16A16_PREMULTIPLIED ||
+           format == GDK_MEMORY_G16 ||
+           format == GDK_MEMORY_A16;
+
+  return FALSE;
+}
+
+/* Fix up gles inadequacies */
+static void
+gdk_gl_texture_fix_up_pixels (GdkMemoryFormat  format,
+                              GLenum           gl_read_format,
+                              GLenum           gl_read_type,
+                              guchar          *pixels,
+                              gsize            stride,
+                              gsize            width,
+                              gsize            height)
+{
+  gsize actual_bpp = gl_read_type == GL_UNSIGNED_SHORT ? 8 : 4;
+
+  if (!gdk_gl_texture_needs_fix_up (format, gl_read_format, gl_read_type))
+    return;
+
+  if (gl_read_type == GL_UNSIGNED_BYTE)
+    {
+      for (unsigned int y = 0; y < height; y++)
+        {
+          for (unsigned int x = 0; x < width; x++)
+            {
+              guchar *data = &pixels[y * stride + x * actual_bpp];
+              if (format == GDK_MEMORY_G8A8 ||
+                  format == GDK_MEMORY_G8A8_PREMULTIPLIED)
+                {
+                  data[3] = data[1];
+                  data[1] = data[0];
+                  data[2] = data[0];
+                }
+              else if (format == GDK_MEMORY_G8)
+                {
+                  data[1] = data[0];
+                  data[2] = data[0];
+                  data[3] = 0xff;
+                }
+              else if (format == GDK_MEMORY_A8)
+                {
+                  data[3] = data[0];
+                  data[0] = 0;
+                  data[1] = 0;
+                  data[2] = 0;
+                }
+            }
+        }
+    }
+
+  else
+    {
+      for (unsigned int y = 0; y < height; y++)
+        {
+          for (unsigned int x = 0; x < width; x++)
+            {
+              guint16 *data = (guint16 *) &pixels[y * stride + x * actual_bpp];
+              if (format == GDK_MEMORY_G16A16 ||
+                  format == GDK_MEMORY_G16A16_PREMULTIPLIED)
+                {
+                  data[3] = data[1];
+                  data[1] = data[0];
+                  data[2] = data[0];
+                }
+              else if (format == GDK_MEMORY_G16)
+                {
+                  data[1] = data[0];
+                  data[2] = data[0];
+                  data[3] = 0xffff;
+                }
+              else if (format == GDK_MEMORY_A16)
+                {
+                  data[3] = data[0];
+                  data[0] = 0;
+                  data[1] = 0;
+                  data[2] = 0;
+                }
+            }
+        }
+    }
+}
+
 static inline void
 gdk_gl_texture_do_download (GdkGLTexture *self,
                             GdkGLContext *context,
@@ -244,39 +382,7 @@ gdk_gl_texture_do_download (GdkGLTexture *self,
       glGenFramebuffers (1, &fbo);
       glBindFramebuffer (GL_FRAMEBUFFER, fbo);
       glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, self->id, 0);
-      if (gdk_gl_context_check_version (context, "4.3", "3.1"))
-        {
-          GLint read_format, read_type;
-          glGetFramebufferParameteriv (GL_FRAMEBUFFER, GL_IMPLEMENTATION_COLOR_READ_FORMAT, &read_format);
-          glGetFramebufferParameteriv (GL_FRAMEBUFFER, GL_IMPLEMENTATION_COLOR_READ_TYPE, &read_type);
-          if (gdk_gl_texture_find_format (context, gdk_memory_format_alpha (format), read_format, read_type, &actual_format))
-            {
-              gl_read_format = read_format;
-              gl_read_type = read_type;
-            }
-          else
-            {
-              actual_format = gdk_memory_depth_get_format (gdk_memory_format_get_depth (format));
-              if (gdk_memory_format_alpha (format) == GDK_MEMORY_ALPHA_STRAIGHT)
-                actual_format = gdk_memory_format_get_straight (actual_format);
-
-              gdk_memory_format_gl_format (actual_format,
-                                           gdk_gl_context_get_use_es (context),
-                                           &gl_internal_format,
-                                           &gl_read_format, &gl_read_type, gl_swizzle);
-            }
-        }
-      else
-        {
-          actual_format = gdk_memory_depth_get_format (gdk_memory_format_get_depth (format));
-          if (gdk_memory_format_alpha (format) == GDK_MEMORY_ALPHA_STRAIGHT)
-            actual_format = gdk_memory_format_get_straight (actual_format);
-
-          gdk_memory_format_gl_format (actual_format,
-                                       gdk_gl_context_get_use_es (context),
-                                       &gl_internal_format,
-                                       &gl_read_format, &gl_read_type, gl_swizzle);
-        }
+      gdk_gl_texture_find_read_format (self, context, &actual_format, &gl_read_format, &gl_read_type);
 
       if (download->format == actual_format &&
           (download->stride == expected_stride))
@@ -300,79 +406,13 @@ gdk_gl_texture_do_download (GdkGLTexture *self,
                         gl_read_type,
                         pixels);
 
-          /* Fix up gles inadequacies */
-
-          if (gl_read_format == GL_RGBA &&
-              gl_read_type == GL_UNSIGNED_BYTE &&
-              (format == GDK_MEMORY_G8A8 ||
-               format == GDK_MEMORY_G8A8_PREMULTIPLIED ||
-               format == GDK_MEMORY_G8 ||
-               format == GDK_MEMORY_A8))
-            {
-              for (unsigned int y = 0; y < texture->height; y++)
-                {
-                  for (unsigned int x = 0; x < texture->width; x++)
-                    {
-                      guchar *data = &pixels[y * stride + x * actual_bpp];
-                      if (format == GDK_MEMORY_G8A8 ||
-                          format == GDK_MEMORY_G8A8_PREMULTIPLIED)
-                        {
-                          data[3] = data[1];
-                          data[1] = data[0];
-                          data[2] = data[0];
-                        }
-                      else if (format == GDK_MEMORY_G8)
-                        {
-                          data[1] = data[0];
-                          data[2] = data[0];
-                          data[3] = 0xff;
-                        }
-                      else if (format == GDK_MEMORY_A8)
-                        {
-                          data[3] = data[0];
-                          data[0] = 0;
-                          data[1] = 0;
-                          data[2] = 0;
-                        }
-                    }
-                }
-            }
-
-          if (gl_read_format == GL_RGBA &&
-              gl_read_type == GL_UNSIGNED_SHORT &&
-              (format == GDK_MEMORY_G16A16 ||
-               format == GDK_MEMORY_G16A16_PREMULTIPLIED ||
-               format == GDK_MEMORY_G16 ||
-               format == GDK_MEMORY_A16))
-            {
-              for (unsigned int y = 0; y < texture->height; y++)
-                {
-                  for (unsigned int x = 0; x < texture->width; x++)
-                    {
-                      guint16 *data = (guint16 *) &pixels[y * stride + x * actual_bpp];
-                      if (format == GDK_MEMORY_G16A16 ||
-                          format == GDK_MEMORY_G16A16_PREMULTIPLIED)
-                        {
-                          data[3] = data[1];
-                          data[1] = data[0];
-                          data[2] = data[0];
-                        }
-                      else if (format == GDK_MEMORY_G16)
-                        {
-                          data[1] = data[0];
-                          data[2] = data[0];
-                          data[3] = 0xffff;
-                        }
-                      else if (format == GDK_MEMORY_A16)
-                        {
-                          data[3] = data[0];
-                          data[0] = 0;
-                          data[1] = 0;
-                          data[2] = 0;
-                        }
-                    }
-                }
-            }
+          gdk_gl_texture_fix_up_pixels (format,
+                                        gl_read_format,
+                                        gl_read_type,
+                                        pixels,
+                                        stride,
+                                        texture->width,
+                                        texture->height);
 
           gdk_memory_convert (download->data,
                               download->stride,
@@ -412,6 +452,321 @@ gdk_gl_texture_download (GdkTexture      *texture,
   gdk_gl_texture_run (self, gdk_gl_texture_do_download, &download);
 }
 
+typedef struct _AsyncDownload AsyncDownload;
+
+struct _AsyncDownload
+{
+  Download download;
+  GdkGLContext *context;
+  GdkMemoryFormat read_format;
+  GLenum gl_read_format;
+  GLenum gl_read_type;
+  gsize read_stride;
+  GLuint buffer;
+  GLsync sync;
+  const guchar *pixels;
+};
+
+static void
+async_download_free (gpointer data)
+{
+  AsyncDownload *async = data;
+
+  /* GL resources are released on the main thread before the task returns */
+  g_assert (async->buffer == 0);
+
+  g_clear_object (&async->context);
+  g_free (async);
+}
+
+/* Must be called with async->context current */
+static void
+async_download_release_gl (AsyncDownload *async)
+{
+  if (async->sync)
+    {
+      glDeleteSync (async->sync);
+      async->sync = NULL;
+    }
+
+  if (async->buffer)
+    {
+      if (async->pixels)
+        {
+          glBindBuffer (GL_PIXEL_PACK_BUFFER, async->buffer);
+          glUnmapBuffer (GL_PIXEL_PACK_BUFFER);
+          glBindBuffer (GL_PIXEL_PACK_BUFFER, 0);
+          async->pixels = NULL;
+        }
+      glDeleteBuffers (1, &async->buffer);
+      async->buffer = 0;
+    }
+}
+
+static void
+gdk_gl_texture_download_in_thread (GTask        *task,
+                                   gpointer      source_object,
+                                   gpointer      task_data,
+                                   GCancellable *cancellable)
+{
+  GdkTexture *texture = source_object;
+  AsyncDownload *async = task_data;
+
+  gdk_texture_do_download (texture, async->download.format, async->download.data, async->download.stride);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static gboolean
+gdk_gl_texture_download_done (gpointer data)
+{
+  GTask *task = data;
+  AsyncDownload *async = g_task_get_task_data (task);
+  GdkGLContext *previous;
+
+  previous = gdk_gl_context_get_current ();
+  gdk_gl_context_make_current (async->context);
+
+  async_download_release_gl (async);
+
+  if (previous)
+    gdk_gl_context_make_current (previous);
+  else
+    gdk_gl_context_clear_current ();
+
+  g_task_return_boolean (task, TRUE);
+  g_object_unref (task);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gdk_gl_texture_download_convert (GTask        *task,
+                                 gpointer      source_object,
+                                 gpointer      task_data,
+                                 GCancellable *cancellable)
+{
+  GdkTexture *texture = source_object;
+  AsyncDownload *async = task_data;
+  const guchar *pixels = async->pixels;
+  guchar *copy = NULL;
+
+  if (gdk_gl_texture_needs_fix_up (gdk_texture_get_format (texture),
+                                   async->gl_read_format,
+                                   async->gl_read_type))
+    {
+      copy = g_memdup2 (pixels, async->read_stride * texture->height);
+      gdk_gl_texture_fix_up_pixels (gdk_texture_get_format (texture),
+                                    async->gl_read_format,
+                                    async->gl_read_type,
+                                    copy,
+                                    async->read_stride,
+                                    texture->width,
+                                    texture->height);
+      pixels = copy;
+    }
+
+  gdk_memory_convert (async->download.data,
+                      async->download.stride,
+                      async->download.format,
+                      pixels,
+                      async->read_stride,
+                      async->read_format,
+                      texture->width,
+                      texture->height);
+
+  g_free (copy);
+
+  /* The buffer can only be unmapped with the GL context */
+  g_idle_add_full (G_PRIORITY_DEFAULT, gdk_gl_texture_download_done, g_object_ref (task), NULL);
+}
+
+static gboolean
+gdk_gl_texture_download_poll (gpointer data)
+{
+  GTask *task = data;
+  AsyncDownload *async = g_task_get_task_data (task);
+  GdkTexture *texture = g_task_get_source_object (task);
+  GdkGLContext *previous;
+  GError *error = NULL;
+  GLenum status;
+
+  previous = gdk_gl_context_get_current ();
+  gdk_gl_context_make_current (async->context);
+
+  status = glClientWaitSync (async->sync, 0, 0);
+  if (status == GL_TIMEOUT_EXPIRED &&
+      !g_cancellable_is_cancelled (g_task_get_cancellable (task)))
+    {
+      if (previous)
+        gdk_gl_context_make_current (previous);
+      else
+        gdk_gl_context_clear_current ();
+
+      return G_SOURCE_CONTINUE;
+    }
+
+  if (!g_cancellable_set_error_if_cancelled (g_task_get_cancellable (task), &error))
+    {
+      glBindBuffer (GL_PIXEL_PACK_BUFFER, async->buffer);
+      async->pixels = glMapBufferRange (GL_PIXEL_PACK_BUFFER,
+                                        0, async->read_stride * texture->height,
+                                        GL_MAP_READ_BIT);
+      glBindBuffer (GL_PIXEL_PACK_BUFFER, 0);
+
+      if (async->pixels == NULL)
+        g_set_error_literal (&error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             "Failed to map the pixel buffer");
+    }
+
+  if (error)
+    async_download_release_gl (async);
+
+  if (previous)
+    gdk_gl_context_make_current (previous);
+  else
+    gdk_gl_context_clear_current ();
+
+  if (error)
+    g_task_return_error (task, error);
+  else
+    g_task_run_in_thread (task, gdk_gl_texture_download_convert);
+
+  g_object_unref (task);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+gdk_gl_texture_download_start (gpointer data)
+{
+  GTask *task = data;
+  AsyncDownload *async = g_task_get_task_data (task);
+  GdkGLTexture *self = g_task_get_source_object (task);
+  GdkTexture *texture = GDK_TEXTURE (self);
+  GdkGLContext *previous;
+  GLuint fbo;
+
+  if (self->saved)
+    {
+      g_task_run_in_thread (task, gdk_gl_texture_download_in_thread);
+      g_object_unref (task);
+      return G_SOURCE_REMOVE;
+    }
+
+  async->context = g_object_ref (gdk_display_get_gl_context (gdk_gl_context_get_display (self->context)));
+
+  previous = gdk_gl_context_get_current ();
+  gdk_gl_context_make_current (async->context);
+
+  if (self->sync && async->context != self->context)
+    glWaitSync (self->sync, 0, GL_TIMEOUT_IGNORED);
+
+  glGenFramebuffers (1, &fbo);
+  glBindFramebuffer (GL_FRAMEBUFFER, fbo);
+  glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, self->id, 0);
+  gdk_gl_texture_find_read_format (self, async->context,
+                                   &async->read_format,
+                                   &async->gl_read_format,
+                                   &async->gl_read_type);
+  async->read_stride = texture->width * gdk_memory_format_bytes_per_pixel (async->read_format);
+
+  glGenBuffers (1, &async->buffer);
+  glBindBuffer (GL_PIXEL_PACK_BUFFER, async->buffer);
+  glBufferData (GL_PIXEL_PACK_BUFFER, async->read_stride * texture->height, NULL, GL_STREAM_READ);
+  glPixelStorei (GL_PACK_ALIGNMENT, 1);
+  glReadPixels (0, 0,
+                texture->width, texture->height,
+                async->gl_read_format,
+                async->gl_read_type,
+                NULL);
+  glBindBuffer (GL_PIXEL_PACK_BUFFER, 0);
+
+  glBindFramebuffer (GL_FRAMEBUFFER, 0);
+  glDeleteFramebuffers (1, &fbo);
+
+  async->sync = glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glFlush ();
+
+  if (previous)
+    gdk_gl_context_make_current (previous);
+  else
+    gdk_gl_context_clear_current ();
+
+  g_timeout_add_full (G_PRIORITY_DEFAULT, 1, gdk_gl_texture_download_poll, task, NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*<private>
+ * gdk_gl_texture_download_async:
+ * @self: a `GdkGLTexture`
+ * @format: the format to download into
+ * @data: (array): memory of size @stride * height to download into
+ * @stride: rowstride of @data
+ * @cancellable: (nullable): a `GCancellable`
+ * @callback: called when the download is done
+ * @user_data: data for @callback
+ *
+ * Downloads the texture without blocking the calling thread.
+ *
+ * The pixels are read into a pixel buffer on the main thread
+ * and a fence is polled until the GPU is done, so the main
+ * thread never waits for the GPU. The conversion into @format
+ * happens in a thread.
+ *
+ * GL contexts without fences or pixel buffers fall back to
+ * a download in a thread, which blocks the main thread as
+ * [method@Gdk.Texture.download] does.
+ *
+ * @data must stay valid until @callback has been called.
+ */
+void
+gdk_gl_texture_download_async (GdkGLTexture        *self,
+                               GdkMemoryFormat      format,
+                               guchar              *data,
+                               gsize                stride,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+  AsyncDownload *async;
+  GTask *task;
+
+  g_return_if_fail (GDK_IS_GL_TEXTURE (self));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gdk_gl_texture_download_async);
+
+  async = g_new0 (AsyncDownload, 1);
+  async->download.format = format;
+  async->download.data = data;
+  async->download.stride = stride;
+  g_task_set_task_data (task, async, async_download_free);
+
+  if (self->saved ||
+      !gdk_gl_context_has_feature (self->context, GDK_GL_FEATURE_SYNC) ||
+      !gdk_gl_context_check_version (self->context, "3.0", "3.0"))
+    {
+      g_task_run_in_thread (task, gdk_gl_texture_download_in_thread);
+      g_object_unref (task);
+      return;
+    }
+
+  g_main_context_invoke (NULL, gdk_gl_texture_download_start, task);
+}
+
+gboolean
+gdk_gl_texture_download_finish (GdkGLTexture  *self,
+                                GAsyncResult  *result,
+                                GError       **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+  g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == gdk_gl_texture_download_async, FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
 static void
 gdk_gl_texture_class_init (GdkGLTextureClass *klass)
 {
@@ -17,5 +17,16 @@ guint                   gdk_gl_texture_get_id           (GdkGLTexture
 gboolean                gdk_gl_texture_has_mipmap       (GdkGLTexture           *self);
 gpointer                gdk_gl_texture_get_sync         (GdkGLTexture           *self);
 
+void                    gdk_gl_texture_download_async   (GdkGLTexture           *self,
+                                                         GdkMemoryFormat         format,
+                                                         guchar                 *data,
+                                                         gsize                   stride,
+                                                         GCancellable           *cancellable,
+                                                         GAsyncReadyCallback     callback,
+                                                         gpointer                user_data);
+gboolean                gdk_gl_texture_download_finish  (GdkGLTexture           *self,
+                                                         GAsyncResult           *result,
+                                                         GError                **error);
+
 G_END_DECLS
 
@@ -23,6 +23,8 @@
 
 #include "gdkdmabuffourccprivate.h"
 #include "gdkglcontextprivate.h"
+#include "gdkmemorysimdprivate.h"
+#include "gdkparalleltaskprivate.h"
 
 #include "gsk/gl/fp16private.h"
 
@@ -277,54 +279,6 @@ a32_float_from_float (guchar      *dest_data,
     }
 }
 
-#define PREMULTIPLY_FUNC(name, R1, G1, B1, A1, R2, G2, B2, A2) \
-static void \
-name (guchar *dest, \
-      const guchar *src, \
-      gsize n) \
-{ \
-  for (; n > 0; n--) \
-    { \
-      guchar a = src[A1]; \
-      guint16 r = (guint16)src[R1] * a + 127; \
-      guint16 g = (guint16)src[G1] * a + 127; \
-      guint16 b = (guint16)src[B1] * a + 127; \
-      dest[R2] = (r + (r >> 8) + 1) >> 8; \
-      dest[G2] = (g + (g >> 8) + 1) >> 8; \
-      dest[B2] = (b + (b >> 8) + 1) >> 8; \
-      dest[A2] = a; \
-      dest += 4; \
-      src += 4; \
-    } \
-}
-
-PREMULTIPLY_FUNC(r8g8b8a8_to_r8g8b8a8_premultiplied, 0, 1, 2, 3, 0, 1, 2, 3)
-PREMULTIPLY_FUNC(r8g8b8a8_to_b8g8r8a8_premultiplied, 0, 1, 2, 3, 2, 1, 0, 3)
-PREMULTIPLY_FUNC(r8g8b8a8_to_a8r8g8b8_premultiplied, 0, 1, 2, 3, 1, 2, 3, 0)
-PREMULTIPLY_FUNC(r8g8b8a8_to_a8b8g8r8_premultiplied, 0, 1, 2, 3, 3, 2, 1, 0)
-
-#define ADD_ALPHA_FUNC(name, R1, G1, B1, R2, G2, B2, A2) \
-static void \
-name (guchar *dest, \
-      const guchar *src, \
-      gsize n) \
-{ \
-  for (; n > 0; n--) \
-    { \
-      dest[R2] = src[R1]; \
-      dest[G2] = src[G1]; \
-      dest[B2] = src[B1]; \
-      dest[A2] = 255; \
-      dest += 4; \
-      src += 3; \
-    } \
-}
-
-ADD_ALPHA_FUNC(r8g8b8_to_r8g8b8a8, 0, 1, 2, 0, 1, 2, 3)
-ADD_ALPHA_FUNC(r8g8b8_to_b8g8r8a8, 0, 1, 2, 2, 1, 0, 3)
-ADD_ALPHA_FUNC(r8g8b8_to_a8r8g8b8, 0, 1, 2, 1, 2, 3, 0)
-ADD_ALPHA_FUNC(r8g8b8_to_a8b8g8r8, 0, 1, 2, 3, 2, 1, 0)
-
 struct _GdkMemoryFormatDescription
 {
   GdkMemoryAlpha alpha;
@@ -333,6 +287,10 @@ struct _GdkMemoryFormatDescription
   gsize bytes_per_pixel;
   gsize alignment;
   GdkMemoryDepth depth;
+  /* Only for U8 and U16 formats: the offsets of red, green, blue
+   * and alpha in units of the channel size, or -1 if the channel
+   * doesn't exist. Gray formats use the same offset for all colors. */
+  int channels[4];
   const GdkMemoryFormat *fallbacks;
   struct {
     GLint internal_gl_format;
@@ -372,6 +330,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 4,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { 2, 1, 0, 3 },
     .fallbacks = (GdkMemoryFormat[]) {
         -1,
     },
@@ -400,6 +359,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 4,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { 1, 2, 3, 0 },
     .fallbacks = (GdkMemoryFormat[]) {
         -1,
     },
@@ -428,6 +388,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 4,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { 0, 1, 2, 3 },
     .fallbacks = (GdkMemoryFormat[]) {
         -1,
     },
@@ -455,6 +416,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 4,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { 3, 2, 1, 0 },
     .fallbacks = (GdkMemoryFormat[]) {
         -1,
     },
@@ -483,6 +445,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 4,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { 2, 1, 0, 3 },
     .fallbacks = (GdkMemoryFormat[]) {
         -1,
     },
@@ -511,6 +474,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 4,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { 1, 2, 3, 0 },
     .fallbacks = (GdkMemoryFormat[]) {
         -1,
     },
@@ -539,6 +503,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 4,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { 0, 1, 2, 3 },
     .fallbacks = (GdkMemoryFormat[]) {
         -1,
     },
@@ -566,6 +531,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 4,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { 3, 2, 1, 0 },
     .fallbacks = (GdkMemoryFormat[]) {
         -1,
     },
@@ -594,6 +560,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 4,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { 2, 1, 0, -1 },
     .fallbacks = (GdkMemoryFormat[]) {
         GDK_MEMORY_R8G8B8A8_PREMULTIPLIED,
         -1,
@@ -623,6 +590,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 4,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { 1, 2, 3, -1 },
     .fallbacks = (GdkMemoryFormat[]) {
         GDK_MEMORY_R8G8B8A8_PREMULTIPLIED,
         -1,
@@ -652,6 +620,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 4,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { 0, 1, 2, -1 },
     .fallbacks = (GdkMemoryFormat[]) {
         GDK_MEMORY_R8G8B8A8_PREMULTIPLIED,
         -1,
@@ -680,6 +649,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 4,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { 3, 2, 1, -1 },
     .fallbacks = (GdkMemoryFormat[]) {
         GDK_MEMORY_R8G8B8A8_PREMULTIPLIED,
         -1,
@@ -709,6 +679,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 3,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { 0, 1, 2, -1 },
     .fallbacks = (GdkMemoryFormat[]) {
         GDK_MEMORY_R8G8B8A8_PREMULTIPLIED,
         -1,
@@ -737,6 +708,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 3,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { 2, 1, 0, -1 },
     .fallbacks = (GdkMemoryFormat[]) {
         GDK_MEMORY_R8G8B8A8_PREMULTIPLIED,
         -1,
@@ -766,6 +738,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 6,
     .alignment = G_ALIGNOF (guint16),
     .depth = GDK_MEMORY_U16,
+    .channels = { 0, 1, 2, -1 },
     .fallbacks = (GdkMemoryFormat[]) {
         GDK_MEMORY_R16G16B16A16_PREMULTIPLIED,
         GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED,
@@ -797,6 +770,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 8,
     .alignment = G_ALIGNOF (guint16),
     .depth = GDK_MEMORY_U16,
+    .channels = { 0, 1, 2, 3 },
     .fallbacks = (GdkMemoryFormat[]) {
         GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED,
         GDK_MEMORY_R16G16B16A16_FLOAT_PREMULTIPLIED,
@@ -827,6 +801,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 8,
     .alignment = G_ALIGNOF (guint16),
     .depth = GDK_MEMORY_U16,
+    .channels = { 0, 1, 2, 3 },
     .fallbacks = (GdkMemoryFormat[]) {
         GDK_MEMORY_R32G32B32A32_FLOAT,
         GDK_MEMORY_R16G16B16A16_FLOAT,
@@ -1033,6 +1008,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 2,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { 0, 0, 0, 1 },
     .fallbacks = (GdkMemoryFormat[]) {
         GDK_MEMORY_R8G8B8A8_PREMULTIPLIED,
         -1,
@@ -1061,6 +1037,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 2,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { 0, 0, 0, 1 },
     .fallbacks = (GdkMemoryFormat[]) {
         GDK_MEMORY_R8G8B8A8,
         -1,
@@ -1089,6 +1066,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 1,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { 0, 0, 0, -1 },
     .fallbacks = (GdkMemoryFormat[]) {
         GDK_MEMORY_R8G8B8A8_PREMULTIPLIED,
         -1,
@@ -1117,6 +1095,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 4,
     .alignment = G_ALIGNOF (guint16),
     .depth = GDK_MEMORY_U16,
+    .channels = { 0, 0, 0, 1 },
     .fallbacks = (GdkMemoryFormat[]) {
         GDK_MEMORY_R16G16B16A16_PREMULTIPLIED,
         GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED,
@@ -1148,6 +1127,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 4,
     .alignment = G_ALIGNOF (guint16),
     .depth = GDK_MEMORY_U16,
+    .channels = { 0, 0, 0, 1 },
     .fallbacks = (GdkMemoryFormat[]) {
         GDK_MEMORY_R16G16B16A16,
         GDK_MEMORY_R32G32B32A32_FLOAT,
@@ -1179,6 +1159,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 2,
     .alignment = G_ALIGNOF (guint16),
     .depth = GDK_MEMORY_U16,
+    .channels = { 0, 0, 0, -1 },
     .fallbacks = (GdkMemoryFormat[]) {
         GDK_MEMORY_R16G16B16A16_PREMULTIPLIED,
         GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED,
@@ -1210,6 +1191,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 1,
     .alignment = G_ALIGNOF (guchar),
     .depth = GDK_MEMORY_U8,
+    .channels = { -1, -1, -1, 0 },
     .fallbacks = (GdkMemoryFormat[]) {
         GDK_MEMORY_R8G8B8A8_PREMULTIPLIED,
         -1,
@@ -1238,6 +1220,7 @@ static const GdkMemoryFormatDescription memory_formats[] = {
     .bytes_per_pixel = 2,
     .alignment = G_ALIGNOF (guint16),
     .depth = GDK_MEMORY_U16,
+    .channels = { -1, -1, -1, 0 },
     .fallbacks = (GdkMemoryFormat[]) {
         GDK_MEMORY_R16G16B16A16_PREMULTIPLIED,
         GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED,
@@ -1690,21 +1673,369 @@ unpremultiply (float *rgba,
     }
 }
 
-void
-gdk_memory_convert (guchar              *dest_data,
-                    gsize                dest_stride,
-                    GdkMemoryFormat      dest_format,
-                    const guchar        *src_data,
-                    gsize                src_stride,
-                    GdkMemoryFormat      src_format,
-                    gsize                width,
-                    gsize                height)
+/* Gets the byte offsets of red, green, blue and alpha for 8bit RGB(A)
+ * formats. Alpha is set to -1 for formats without alpha.
+ * Returns the number of bytes per pixel or 0 for other formats.
+ */
+static guint
+gdk_memory_format_get_u8_channels (GdkMemoryFormat format,
+                                   int             channels[4])
+{
+  const GdkMemoryFormatDescription *desc = &memory_formats[format];
+
+  /* skips the gray and alpha-only formats */
+  if (desc->depth != GDK_MEMORY_U8 || desc->bytes_per_pixel < 3)
+    return 0;
+
+  memcpy (channels, desc->channels, sizeof (int) * 4);
+
+  return desc->bytes_per_pixel;
+}
+
+/* Computes the swizzle to use with the SIMD kernels that produces
+ * the dest channels from the source channels.
+ */
+static void
+gdk_memory_simd_swizzle (const int  dest_channels[4],
+                         const int  src_channels[4],
+                         guint8     swizzle[4])
+{
+  for (gsize c = 0; c < 4; c++)
+    {
+      if (dest_channels[c] < 0)
+        continue;
+
+      if (src_channels[c] < 0)
+        swizzle[dest_channels[c]] = GDK_MEMORY_SIMD_ONE;
+      else
+        swizzle[dest_channels[c]] = src_channels[c];
+    }
+}
+
+/* Uses the direct 8bit SIMD kernels if possible. They produce the same
+ * results as the scalar fast paths or the float round trip would.
+ *
+ * Formats with an X byte are not handled as destination, because the
+ * scalar code leaves that byte alone.
+ */
+static gboolean
+gdk_memory_convert_simd_u8 (const GdkMemorySimdFuncs *simd,
+                            guchar                   *dest_data,
+                            gsize                     dest_stride,
+                            GdkMemoryFormat           dest_format,
+                            const guchar             *src_data,
+                            gsize                     src_stride,
+                            GdkMemoryFormat           src_format,
+                            gsize                     width,
+                            gsize                     height)
+{
+  GdkMemoryAlpha src_alpha = memory_formats[src_format].alpha;
+  GdkMemoryAlpha dest_alpha = memory_formats[dest_format].alpha;
+  int src_channels[4], dest_channels[4];
+  guint8 swizzle[4];
+  guint src_bpp;
+  gsize y;
+
+  src_bpp = gdk_memory_format_get_u8_channels (src_format, src_channels);
+  if (src_bpp == 0 ||
+      gdk_memory_format_get_u8_channels (dest_format, dest_channels) != 4 ||
+      dest_channels[3] < 0)
+    return FALSE;
+
+  gdk_memory_simd_swizzle (dest_channels, src_channels, swizzle);
+
+  if (src_bpp == 3)
+    {
+      if (simd->shuffle_888_8888 == NULL)
+        return FALSE;
+
+      for (y = 0; y < height; y++)
+        {
+          simd->shuffle_888_8888 (dest_data, src_data, width, swizzle);
+          src_data += src_stride;
+          dest_data += dest_stride;
+        }
+    }
+  else if (src_alpha == GDK_MEMORY_ALPHA_STRAIGHT && dest_alpha == GDK_MEMORY_ALPHA_PREMULTIPLIED)
+    {
+      if (simd->premultiply_8888 == NULL)
+        return FALSE;
+
+      for (y = 0; y < height; y++)
+        {
+          simd->premultiply_8888 (dest_data, src_data, width, swizzle, dest_channels[3]);
+          src_data += src_stride;
+          dest_data += dest_stride;
+        }
+    }
+  else if (src_alpha == GDK_MEMORY_ALPHA_PREMULTIPLIED && dest_alpha == GDK_MEMORY_ALPHA_STRAIGHT)
+    {
+      if (simd->unpremultiply_8888 == NULL)
+        return FALSE;
+
+      for (y = 0; y < height; y++)
+        {
+          simd->unpremultiply_8888 (dest_data, src_data, width, swizzle, dest_channels[3]);
+          src_data += src_stride;
+          dest_data += dest_stride;
+        }
+    }
+  else
+    {
+      if (simd->shuffle_8888 == NULL)
+        return FALSE;
+
+      for (y = 0; y < height; y++)
+        {
+          simd->shuffle_8888 (dest_data, src_data, width, swizzle);
+          src_data += src_stride;
+          dest_data += dest_stride;
+        }
+    }
+
+  return TRUE;
+}
+
+static gboolean
+gdk_memory_format_is_rgba16 (GdkMemoryFormat format)
+{
+  return format == GDK_MEMORY_R16G16B16A16 ||
+         format == GDK_MEMORY_R16G16B16A16_PREMULTIPLIED;
+}
+
+/* Direct conversions between formats with 8 or 16 bit integer channels.
+ *
+ * They produce the same results as the float round trip, which is why
+ * there is no direct path for pairs that would need to do math on
+ * values that aren't exact in the integer domain, like premultiplying
+ * 16 bit colors or computing gray values from premultiplied colors.
+ */
+typedef void (* GdkMemoryDirectFunc) (guchar                           *dest_data,
+                                      const GdkMemoryFormatDescription *dest_desc,
+                                      const guchar                     *src_data,
+                                      const GdkMemoryFormatDescription *src_desc,
+                                      gsize                             n);
+
+static guint8 unpremultiply_table[256][256];
+
+static void
+init_unpremultiply_table (void)
+{
+  for (guint a = 0; a < 256; a++)
+    {
+      for (guint c = 0; c < 256; c++)
+        {
+          float rgba[4] = { (float) c / 255, 0, 0, (float) a / 255 };
+
+          unpremultiply (rgba, 1);
+          unpremultiply_table[a][c] = CLAMP (rgba[0] * 255 + 0.5, 0, 255);
+        }
+    }
+}
+
+static inline guint
+premultiply_u8 (guint c,
+                guint a)
+{
+  guint v = c * a + 127;
+
+  return (v + (v >> 8) + 1) >> 8;
+}
+
+#define CONVERT_NONE(v) (v)
+#define CONVERT_U8_TO_U16(v) ((v) * 257)
+#define CONVERT_U16_TO_U8(v) (((v) * 255 + 32767) / 65535)
+
+#define ALPHA_NONE(r, g, b, a)
+#define ALPHA_PREMULTIPLY(r, g, b, a) G_STMT_START { \
+  r = premultiply_u8 (r, a); \
+  g = premultiply_u8 (g, a); \
+  b = premultiply_u8 (b, a); \
+} G_STMT_END
+#define ALPHA_UNPREMULTIPLY(r, g, b, a) G_STMT_START { \
+  r = unpremultiply_table[a][r]; \
+  g = unpremultiply_table[a][g]; \
+  b = unpremultiply_table[a][b]; \
+} G_STMT_END
+
+/* Matches the float code for 8bit colors, (r + g + b) / 3 isn't exact */
+#define GRAY_U8(r, g, b) ((2 * ((r) + (g) + (b)) + 3) / 6)
+
+#define DIRECT_FUNC(name, SRC_T, SRC_MAX, DEST_T, CONVERT, ALPHA, GRAY) \
+static void \
+name (guchar                           *dest_data, \
+      const GdkMemoryFormatDescription *dest_desc, \
+      const guchar                     *src_data, \
+      const GdkMemoryFormatDescription *src_desc, \
+      gsize                             n) \
+{ \
+  const int *sc = src_desc->channels; \
+  const int *dc = dest_desc->channels; \
+  gsize src_bpp = src_desc->bytes_per_pixel; \
+  gsize dest_bpp = dest_desc->bytes_per_pixel; \
+\
+  for (gsize i = 0; i < n; i++) \
+    { \
+      const SRC_T *src = (const SRC_T *) (src_data + i * src_bpp); \
+      DEST_T *dest = (DEST_T *) (dest_data + i * dest_bpp); \
+      guint r, g, b, a; \
+\
+      a = sc[3] >= 0 ? src[sc[3]] : SRC_MAX; \
+      if (sc[0] >= 0) \
+        { \
+          r = src[sc[0]]; \
+          g = src[sc[1]]; \
+          b = src[sc[2]]; \
+        } \
+      else \
+        r = g = b = a; \
+\
+      r = CONVERT (r); \
+      g = CONVERT (g); \
+      b = CONVERT (b); \
+      a = CONVERT (a); \
+      ALPHA (r, g, b, a); \
+\
+      if (GRAY) \
+        dest[dc[0]] = GRAY_U8 (r, g, b); \
+      else if (dc[0] >= 0) \
+        { \
+          dest[dc[0]] = r; \
+          dest[dc[1]] = g; \
+          dest[dc[2]] = b; \
+        } \
+      if (dc[3] >= 0) \
+        dest[dc[3]] = a; \
+    } \
+}
+
+DIRECT_FUNC (u8_to_u8, guint8, G_MAXUINT8, guint8, CONVERT_NONE, ALPHA_NONE, FALSE)
+DIRECT_FUNC (u8_to_u8_premultiply, guint8, G_MAXUINT8, guint8, CONVERT_NONE, ALPHA_PREMULTIPLY, FALSE)
+DIRECT_FUNC (u8_to_u8_unpremultiply, guint8, G_MAXUINT8, guint8, CONVERT_NONE, ALPHA_UNPREMULTIPLY, FALSE)
+DIRECT_FUNC (u8_to_u8_gray, guint8, G_MAXUINT8, guint8, CONVERT_NONE, ALPHA_NONE, TRUE)
+DIRECT_FUNC (u8_to_u16, guint8, G_MAXUINT8, guint16, CONVERT_U8_TO_U16, ALPHA_NONE, FALSE)
+DIRECT_FUNC (u16_to_u8, guint16, G_MAXUINT16, guint8, CONVERT_U16_TO_U8, ALPHA_NONE, FALSE)
+DIRECT_FUNC (u16_to_u16, guint16, G_MAXUINT16, guint16, CONVERT_NONE, ALPHA_NONE, FALSE)
+
+static gboolean
+gdk_memory_format_is_gray (const GdkMemoryFormatDescription *desc)
+{
+  return desc->channels[0] >= 0 && desc->channels[0] == desc->channels[1];
+}
+
+static GdkMemoryDirectFunc
+gdk_memory_direct_func_select (GdkMemoryFormat dest_format,
+                               GdkMemoryFormat src_format)
 {
   const GdkMemoryFormatDescription *dest_desc = &memory_formats[dest_format];
   const GdkMemoryFormatDescription *src_desc = &memory_formats[src_format];
+  gboolean premultiply_colors, unpremultiply_colors, gray;
+
+  if (src_format == dest_format ||
+      (src_desc->depth != GDK_MEMORY_U8 && src_desc->depth != GDK_MEMORY_U16) ||
+      (dest_desc->depth != GDK_MEMORY_U8 && dest_desc->depth != GDK_MEMORY_U16))
+    return NULL;
+
+  /* Same conditions as in the float round trip */
+  unpremultiply_colors = src_desc->alpha == GDK_MEMORY_ALPHA_PREMULTIPLIED &&
+                         dest_desc->alpha == GDK_MEMORY_ALPHA_STRAIGHT;
+  premultiply_colors = src_desc->alpha == GDK_MEMORY_ALPHA_STRAIGHT &&
+                       dest_desc->alpha != GDK_MEMORY_ALPHA_STRAIGHT;
+  /* Alpha isn't affected by either */
+  if (dest_desc->channels[0] < 0)
+    premultiply_colors = unpremultiply_colors = FALSE;
+  /* Gray sources have identical colors, so they can be copied */
+  gray = gdk_memory_format_is_gray (dest_desc) &&
+         !gdk_memory_format_is_gray (src_desc) &&
+         src_desc->channels[0] >= 0;
+
+  if (src_desc->depth == GDK_MEMORY_U8 && dest_desc->depth == GDK_MEMORY_U8)
+    {
+      if (gray)
+        return premultiply_colors || unpremultiply_colors ? NULL : u8_to_u8_gray;
+      else if (premultiply_colors)
+        return u8_to_u8_premultiply;
+      else if (unpremultiply_colors)
+        {
+          /* Gray destinations average unpremultiplied floats, which
+           * doesn't always round the same as a single channel */
+          if (gdk_memory_format_is_gray (dest_desc))
+            return NULL;
+          return u8_to_u8_unpremultiply;
+        }
+      else
+        return u8_to_u8;
+    }
+
+  if (gray || premultiply_colors || unpremultiply_colors)
+    return NULL;
+
+  if (src_desc->depth == GDK_MEMORY_U8)
+    return u8_to_u16;
+  else if (dest_desc->depth == GDK_MEMORY_U8)
+    return u16_to_u8;
+  else
+    return u16_to_u16;
+}
+
+static GdkMemoryDirectFunc direct_funcs[GDK_MEMORY_N_FORMATS][GDK_MEMORY_N_FORMATS];
+
+static void
+init_direct_funcs (void)
+{
+  static gsize inited = 0;
+
+  if (g_once_init_enter (&inited))
+    {
+      for (GdkMemoryFormat src = 0; src < GDK_MEMORY_N_FORMATS; src++)
+        for (GdkMemoryFormat dest = 0; dest < GDK_MEMORY_N_FORMATS; dest++)
+          direct_funcs[src][dest] = gdk_memory_direct_func_select (dest, src);
+
+      init_unpremultiply_table ();
+
+      g_once_init_leave (&inited, 1);
+    }
+}
+
+/*<private>
+ * gdk_memory_convert_is_direct:
+ * @dest_format: the format to convert to
+ * @src_format: the format to convert from
+ *
+ * Checks if gdk_memory_convert() can convert between the two formats
+ * without going through floats.
+ *
+ * Returns: %TRUE if the conversion doesn't use floats
+ */
+gboolean
+gdk_memory_convert_is_direct (GdkMemoryFormat dest_format,
+                              GdkMemoryFormat src_format)
+{
+  init_direct_funcs ();
+
+  return src_format == dest_format ||
+         direct_funcs[src_format][dest_format] != NULL;
+}
+
+static void
+gdk_memory_convert_rows (guchar              *dest_data,
+                         gsize                dest_stride,
+                         GdkMemoryFormat      dest_format,
+                         const guchar        *src_data,
+                         gsize                src_stride,
+                         GdkMemoryFormat      src_format,
+                         gsize                width,
+                         gsize                height)
+{
+  const GdkMemoryFormatDescription *dest_desc = &memory_formats[dest_format];
+  const GdkMemoryFormatDescription *src_desc = &memory_formats[src_format];
+  const GdkMemorySimdFuncs *simd;
+  int src_channels[4], dest_channels[4];
+  guint8 src_swizzle[4], dest_swizzle[4];
+  gboolean simd_src_u8, simd_dest_u8, simd_src_u16, simd_dest_u16;
   float *tmp;
+  GdkMemoryDirectFunc func;
   gsize y;
-  void (*func) (guchar *, const guchar *, gsize) = NULL;
 
   g_assert (dest_format < GDK_MEMORY_N_FORMATS);
   g_assert (src_format < GDK_MEMORY_N_FORMATS);
@@ -1729,67 +2060,183 @@ gdk_memory_convert (guchar              *dest_data,
       return;
     }
 
-  if (src_format == GDK_MEMORY_R8G8B8A8 && dest_format == GDK_MEMORY_R8G8B8A8_PREMULTIPLIED)
-    func = r8g8b8a8_to_r8g8b8a8_premultiplied;
-  else if (src_format == GDK_MEMORY_B8G8R8A8 && dest_format == GDK_MEMORY_R8G8B8A8_PREMULTIPLIED)
-    func = r8g8b8a8_to_b8g8r8a8_premultiplied;
-  else if (src_format == GDK_MEMORY_R8G8B8A8 && dest_format == GDK_MEMORY_B8G8R8A8_PREMULTIPLIED)
-    func = r8g8b8a8_to_b8g8r8a8_premultiplied;
-  else if (src_format == GDK_MEMORY_B8G8R8A8 && dest_format == GDK_MEMORY_B8G8R8A8_PREMULTIPLIED)
-    func = r8g8b8a8_to_r8g8b8a8_premultiplied;
-  else if (src_format == GDK_MEMORY_R8G8B8A8 && dest_format == GDK_MEMORY_A8R8G8B8_PREMULTIPLIED)
-    func = r8g8b8a8_to_a8r8g8b8_premultiplied;
-  else if (src_format == GDK_MEMORY_B8G8R8A8 && dest_format == GDK_MEMORY_A8R8G8B8_PREMULTIPLIED)
-    func = r8g8b8a8_to_a8b8g8r8_premultiplied;
-  else if (src_format == GDK_MEMORY_R8G8B8 && dest_format == GDK_MEMORY_R8G8B8A8_PREMULTIPLIED)
-    func = r8g8b8_to_r8g8b8a8;
-  else if (src_format == GDK_MEMORY_B8G8R8 && dest_format == GDK_MEMORY_R8G8B8A8_PREMULTIPLIED)
-    func = r8g8b8_to_b8g8r8a8;
-  else if (src_format == GDK_MEMORY_R8G8B8 && dest_format == GDK_MEMORY_B8G8R8A8_PREMULTIPLIED)
-    func = r8g8b8_to_b8g8r8a8;
-  else if (src_format == GDK_MEMORY_B8G8R8 && dest_format == GDK_MEMORY_B8G8R8A8_PREMULTIPLIED)
-    func = r8g8b8_to_r8g8b8a8;
-  else if (src_format == GDK_MEMORY_R8G8B8 && dest_format == GDK_MEMORY_A8R8G8B8_PREMULTIPLIED)
-    func = r8g8b8_to_a8r8g8b8;
-  else if (src_format == GDK_MEMORY_B8G8R8 && dest_format == GDK_MEMORY_A8R8G8B8_PREMULTIPLIED)
-    func = r8g8b8_to_a8b8g8r8;
-  else if (src_format == GDK_MEMORY_R8G8B8 && dest_format == GDK_MEMORY_R8G8B8A8)
-    func = r8g8b8_to_r8g8b8a8;
-  else if (src_format == GDK_MEMORY_B8G8R8 && dest_format == GDK_MEMORY_R8G8B8A8)
-    func = r8g8b8_to_b8g8r8a8;
-  else if (src_format == GDK_MEMORY_R8G8B8 && dest_format == GDK_MEMORY_B8G8R8A8)
-    func = r8g8b8_to_b8g8r8a8;
-  else if (src_format == GDK_MEMORY_B8G8R8 && dest_format == GDK_MEMORY_B8G8R8A8)
-    func = r8g8b8_to_r8g8b8a8;
-  else if (src_format == GDK_MEMORY_R8G8B8 && dest_format == GDK_MEMORY_A8R8G8B8)
-    func = r8g8b8_to_a8r8g8b8;
-  else if (src_format == GDK_MEMORY_B8G8R8 && dest_format == GDK_MEMORY_A8R8G8B8)
-    func = r8g8b8_to_a8b8g8r8;
+  simd = gdk_memory_simd_get_funcs ();
+  if (simd != NULL &&
+      gdk_memory_convert_simd_u8 (simd,
+                                  dest_data, dest_stride, dest_format,
+                                  src_data, src_stride, src_format,
+                                  width, height))
+    return;
 
+  init_direct_funcs ();
+  func = direct_funcs[src_format][dest_format];
   if (func != NULL)
     {
       for (y = 0; y < height; y++)
         {
-          func (dest_data, src_data, width);
+          func (dest_data, dest_desc, src_data, src_desc, width);
           src_data += src_stride;
           dest_data += dest_stride;
         }
       return;
     }
 
+  /* Figure out which parts of the float round trip have SIMD kernels */
+  simd_src_u8 = simd != NULL && simd->u8888_to_float != NULL &&
+                gdk_memory_format_get_u8_channels (src_format, src_channels) == 4;
+  simd_dest_u8 = simd != NULL && simd->float_to_u8888 != NULL &&
+                 gdk_memory_format_get_u8_channels (dest_format, dest_channels) == 4 &&
+                 dest_channels[3] >= 0;
+  simd_src_u16 = simd != NULL && simd->u16_to_float != NULL &&
+                 gdk_memory_format_is_rgba16 (src_format);
+  simd_dest_u16 = simd != NULL && simd->float_to_u16 != NULL &&
+                  gdk_memory_format_is_rgba16 (dest_format);
+  if (simd_src_u8)
+    {
+      static const int rgba[4] = { 0, 1, 2, 3 };
+      gdk_memory_simd_swizzle (rgba, src_channels, src_swizzle);
+    }
+  if (simd_dest_u8)
+    {
+      for (gsize c = 0; c < 4; c++)
+        dest_swizzle[dest_channels[c]] = c;
+    }
+
   tmp = g_new (float, width * 4);
 
   for (y = 0; y < height; y++)
     {
-      src_desc->to_float (tmp, src_data, width);
+      if (simd_src_u8)
+        simd->u8888_to_float (tmp, src_data, width, src_swizzle);
+      else if (simd_src_u16)
+        simd->u16_to_float (tmp, (const guint16 *) src_data, width * 4);
+      else
+        src_desc->to_float (tmp, src_data, width);
+
       if (src_desc->alpha == GDK_MEMORY_ALPHA_PREMULTIPLIED && dest_desc->alpha == GDK_MEMORY_ALPHA_STRAIGHT)
-        unpremultiply (tmp, width);
+        {
+          if (simd && simd->unpremultiply)
+            simd->unpremultiply (tmp, width);
+          else
+            unpremultiply (tmp, width);
+        }
       else if (src_desc->alpha == GDK_MEMORY_ALPHA_STRAIGHT && dest_desc->alpha != GDK_MEMORY_ALPHA_STRAIGHT)
-        premultiply (tmp, width);
-      dest_desc->from_float (dest_data, tmp, width);
+        {
+          if (simd && simd->premultiply)
+            simd->premultiply (tmp, width);
+          else
+            premultiply (tmp, width);
+        }
+
+      if (simd_dest_u8)
+        simd->float_to_u8888 (dest_data, tmp, width, dest_swizzle);
+      else if (simd_dest_u16)
+        simd->float_to_u16 ((guint16 *) dest_data, tmp, width * 4);
+      else
+        dest_desc->from_float (dest_data, tmp, width);
+
       src_data += src_stride;
       dest_data += dest_stride;
     }
 
   g_free (tmp);
 }
+
+/* Images with fewer pixels than this are converted in the calling
+ * thread, it's not worth the overhead of using threads for them. */
+#define PARALLEL_CONVERT_MIN_PIXELS (512 * 512)
+
+/* The minimum number of pixels converted by one task */
+#define PARALLEL_CONVERT_MIN_TASK_PIXELS (64 * 1024)
+
+typedef struct _MemoryConvert MemoryConvert;
+
+struct _MemoryConvert
+{
+  guchar              *dest_data;
+  gsize                dest_stride;
+  GdkMemoryFormat      dest_format;
+  const guchar        *src_data;
+  gsize                src_stride;
+  GdkMemoryFormat      src_format;
+  gsize                width;
+  gsize                height;
+  gsize                rows_per_task;
+};
+
+static void
+gdk_memory_convert_task (guint    task_index,
+                         gpointer user_data)
+{
+  MemoryConvert *mc = user_data;
+  gsize y = task_index * mc->rows_per_task;
+
+  gdk_memory_convert_rows (mc->dest_data + y * mc->dest_stride,
+                           mc->dest_stride,
+                           mc->dest_format,
+                           mc->src_data + y * mc->src_stride,
+                           mc->src_stride,
+                           mc->src_format,
+                           mc->width,
+                           MIN (mc->rows_per_task, mc->height - y));
+}
+
+/*<private>
+ * gdk_memory_convert:
+ * @dest_data: the destination
+ * @dest_stride: the stride of the destination
+ * @dest_format: the format of the destination
+ * @src_data: the source
+ * @src_stride: the stride of the source
+ * @src_format: the format of the source
+ * @width: the width in pixels
+ * @height: the height in pixels
+ *
+ * Converts pixel data from one format to another.
+ *
+ * Large images are split into bands of rows that are converted
+ * in parallel using gdk_parallel_task_run().
+ *
+ * The source and destination must not overlap.
+ */
+void
+gdk_memory_convert (guchar              *dest_data,
+                    gsize                dest_stride,
+                    GdkMemoryFormat      dest_format,
+                    const guchar        *src_data,
+                    gsize                src_stride,
+                    GdkMemoryFormat      src_format,
+                    gsize                width,
+                    gsize                height)
+{
+  MemoryConvert mc;
+  gsize n_tasks;
+
+  n_tasks = MIN (gdk_parallel_task_get_n_threads () * 4,
+                 width * height / PARALLEL_CONVERT_MIN_TASK_PIXELS);
+  n_tasks = MIN (n_tasks, height);
+
+  if (n_tasks < 2 || width * height < PARALLEL_CONVERT_MIN_PIXELS)
+    {
+      gdk_memory_convert_rows (dest_data, dest_stride, dest_format,
+                               src_data, src_stride, src_format,
+                               width, height);
+      return;
+    }
+
+  mc = (MemoryConvert) {
+    .dest_data = dest_data,
+    .dest_stride = dest_stride,
+    .dest_format = dest_format,
+    .src_data = src_data,
+    .src_stride = src_stride,
+    .src_format = src_format,
+    .width = width,
+    .height = height,
+    .rows_per_task = (height + n_tasks - 1) / n_tasks,
+  };
+
+  gdk_parallel_task_run (gdk_memory_convert_task,
+                         &mc,
+                         (height + mc.rows_per_task - 1) / mc.rows_per_task);
+}
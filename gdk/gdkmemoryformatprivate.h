@@ -85,6 +85,8 @@ void                    gdk_memory_convert                  (guchar
                                                              GdkMemoryFormat             src_format,
                                                              gsize                       width,
                                                              gsize                       height);
+gboolean                gdk_memory_convert_is_direct        (GdkMemoryFormat             dest_format,
+                                                             GdkMemoryFormat             src_format);
 
 
 G_END_DECLS
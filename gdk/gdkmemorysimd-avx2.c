@@ -0,0 +1,379 @@
+/*
+ * Copyright © 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdkmemorysimdprivate.h"
+
+#ifdef HAVE_AVX2
+
+#include <immintrin.h>
+
+/* The AVX2 kernels process 8 pixels at a time. Byte shuffles only
+ * work inside 128bit lanes, which is fine as long as a pixel does
+ * not cross a lane. That's why the 3 byte formats and the fused
+ * unpremultiply kernel are left to the SSE4.1 code. The YUV kernel
+ * gets away with 3 byte output because it stores each lane separately.
+ */
+
+#define LOADU(p) _mm256_loadu_si256 ((const __m256i *) (p))
+#define STOREU(p, v) _mm256_storeu_si256 ((__m256i *) (p), (v))
+
+static inline __m256i
+swizzle_mask (const guint8 swizzle[4])
+{
+  guint8 mask[32];
+
+  for (guint i = 0; i < 32; i++)
+    {
+      if (swizzle[i % 4] == GDK_MEMORY_SIMD_ONE)
+        mask[i] = 0x80;
+      else
+        mask[i] = ((i % 16) & ~3) + swizzle[i % 4];
+    }
+
+  return LOADU (mask);
+}
+
+static inline __m256i
+ones_mask (const guint8 swizzle[4])
+{
+  guint8 mask[32];
+
+  for (guint i = 0; i < 32; i++)
+    mask[i] = swizzle[i % 4] == GDK_MEMORY_SIMD_ONE ? 0xFF : 0;
+
+  return LOADU (mask);
+}
+
+static inline __m256i
+alpha_mask (guint alpha)
+{
+  guint8 mask[32];
+
+  for (guint i = 0; i < 32; i++)
+    mask[i] = ((i % 16) & ~3) + alpha;
+
+  return LOADU (mask);
+}
+
+static inline __m256i
+alpha_select_mask (guint alpha)
+{
+  guint8 mask[32];
+
+  for (guint i = 0; i < 32; i++)
+    mask[i] = (i % 4) == alpha ? 0xFF : 0;
+
+  return LOADU (mask);
+}
+
+/* See the SSE4.1 version for why we don't just add 0.5 */
+static inline __m256i
+quantize (__m256 f,
+          __m256 scale)
+{
+  __m256i i;
+  __m256 frac;
+
+  f = _mm256_mul_ps (f, scale);
+  f = _mm256_min_ps (_mm256_max_ps (f, _mm256_setzero_ps ()), scale);
+  i = _mm256_cvttps_epi32 (f);
+  frac = _mm256_sub_ps (f, _mm256_cvtepi32_ps (i));
+
+  return _mm256_sub_epi32 (i, _mm256_castps_si256 (_mm256_cmp_ps (frac, _mm256_set1_ps (0.5f), _CMP_GE_OQ)));
+}
+
+static inline __m256
+u8_to_float (__m128i v)
+{
+  return _mm256_div_ps (_mm256_cvtepi32_ps (_mm256_cvtepu8_epi32 (v)), _mm256_set1_ps (255.f));
+}
+
+static void
+shuffle_8888_avx2 (guchar       *dest,
+                   const guchar *src,
+                   gsize         n,
+                   const guint8  swizzle[4])
+{
+  __m256i mask = swizzle_mask (swizzle);
+  __m256i ones = ones_mask (swizzle);
+  gsize i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      __m256i v = LOADU (src + 4 * i);
+
+      v = _mm256_or_si256 (_mm256_shuffle_epi8 (v, mask), ones);
+      STOREU (dest + 4 * i, v);
+    }
+
+  gdk_memory_simd_shuffle_8888_c (dest + 4 * i, src + 4 * i, n - i, swizzle, 4);
+}
+
+static void
+premultiply_8888_avx2 (guchar       *dest,
+                       const guchar *src,
+                       gsize         n,
+                       const guint8  swizzle[4],
+                       guint         alpha)
+{
+  __m256i mask = swizzle_mask (swizzle);
+  __m256i ones = ones_mask (swizzle);
+  __m256i amask = alpha_mask (alpha);
+  __m256i aselect = alpha_select_mask (alpha);
+  __m256i c127 = _mm256_set1_epi16 (127);
+  __m256i c1 = _mm256_set1_epi16 (1);
+  gsize i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      __m256i v, a, lo, hi, alo, ahi, r;
+
+      v = LOADU (src + 4 * i);
+      v = _mm256_or_si256 (_mm256_shuffle_epi8 (v, mask), ones);
+      a = _mm256_shuffle_epi8 (v, amask);
+
+      /* pixels 0-3 and 4-7 */
+      lo = _mm256_cvtepu8_epi16 (_mm256_castsi256_si128 (v));
+      hi = _mm256_cvtepu8_epi16 (_mm256_extracti128_si256 (v, 1));
+      alo = _mm256_cvtepu8_epi16 (_mm256_castsi256_si128 (a));
+      ahi = _mm256_cvtepu8_epi16 (_mm256_extracti128_si256 (a, 1));
+
+      lo = _mm256_add_epi16 (_mm256_mullo_epi16 (lo, alo), c127);
+      hi = _mm256_add_epi16 (_mm256_mullo_epi16 (hi, ahi), c127);
+      lo = _mm256_srli_epi16 (_mm256_add_epi16 (_mm256_add_epi16 (lo, _mm256_srli_epi16 (lo, 8)), c1), 8);
+      hi = _mm256_srli_epi16 (_mm256_add_epi16 (_mm256_add_epi16 (hi, _mm256_srli_epi16 (hi, 8)), c1), 8);
+
+      /* packing works per lane, so this yields pixels 0 1 4 5 2 3 6 7 */
+      r = _mm256_permute4x64_epi64 (_mm256_packus_epi16 (lo, hi), _MM_SHUFFLE (3, 1, 2, 0));
+
+      STOREU (dest + 4 * i, _mm256_blendv_epi8 (r, v, aselect));
+    }
+
+  gdk_memory_simd_premultiply_8888_c (dest + 4 * i, src + 4 * i, n - i, swizzle, alpha);
+}
+
+static void
+u8888_to_float_avx2 (float        *dest,
+                     const guchar *src,
+                     gsize         n,
+                     const guint8  swizzle[4])
+{
+  __m256i mask = swizzle_mask (swizzle);
+  __m256i ones = ones_mask (swizzle);
+  gsize i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      __m256i v = LOADU (src + 4 * i);
+      __m128i lo, hi;
+
+      v = _mm256_or_si256 (_mm256_shuffle_epi8 (v, mask), ones);
+      lo = _mm256_castsi256_si128 (v);
+      hi = _mm256_extracti128_si256 (v, 1);
+
+      _mm256_storeu_ps (dest + 4 * i, u8_to_float (lo));
+      _mm256_storeu_ps (dest + 4 * i + 8, u8_to_float (_mm_srli_si128 (lo, 8)));
+      _mm256_storeu_ps (dest + 4 * i + 16, u8_to_float (hi));
+      _mm256_storeu_ps (dest + 4 * i + 24, u8_to_float (_mm_srli_si128 (hi, 8)));
+    }
+
+  gdk_memory_simd_u8888_to_float_c (dest + 4 * i, src + 4 * i, n - i, swizzle);
+}
+
+static void
+float_to_u8888_avx2 (guchar       *dest,
+                     const float  *src,
+                     gsize         n,
+                     const guint8  swizzle[4])
+{
+  __m256i mask = swizzle_mask (swizzle);
+  __m256i order = _mm256_setr_epi32 (0, 4, 1, 5, 2, 6, 3, 7);
+  __m256 scale = _mm256_set1_ps (255.f);
+  gsize i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      __m256i p01, p23, p45, p67, v;
+
+      p01 = quantize (_mm256_loadu_ps (src + 4 * i), scale);
+      p23 = quantize (_mm256_loadu_ps (src + 4 * i + 8), scale);
+      p45 = quantize (_mm256_loadu_ps (src + 4 * i + 16), scale);
+      p67 = quantize (_mm256_loadu_ps (src + 4 * i + 24), scale);
+
+      /* packing works per lane, so this yields pixels 0 2 4 6 1 3 5 7 */
+      v = _mm256_packus_epi16 (_mm256_packus_epi32 (p01, p23), _mm256_packus_epi32 (p45, p67));
+      v = _mm256_permutevar8x32_epi32 (v, order);
+
+      STOREU (dest + 4 * i, _mm256_shuffle_epi8 (v, mask));
+    }
+
+  gdk_memory_simd_float_to_u8888_c (dest + 4 * i, src + 4 * i, n - i, swizzle);
+}
+
+static void
+u16_to_float_avx2 (float         *dest,
+                   const guint16 *src,
+                   gsize          n)
+{
+  __m256 scale = _mm256_set1_ps (65535.f);
+  gsize i;
+
+  for (i = 0; i + 16 <= n; i += 16)
+    {
+      __m256i v = LOADU (src + i);
+
+      _mm256_storeu_ps (dest + i, _mm256_div_ps (_mm256_cvtepi32_ps (_mm256_cvtepu16_epi32 (_mm256_castsi256_si128 (v))), scale));
+      _mm256_storeu_ps (dest + i + 8, _mm256_div_ps (_mm256_cvtepi32_ps (_mm256_cvtepu16_epi32 (_mm256_extracti128_si256 (v, 1))), scale));
+    }
+
+  gdk_memory_simd_u16_to_float_c (dest + i, src + i, n - i);
+}
+
+static void
+float_to_u16_avx2 (guint16     *dest,
+                   const float *src,
+                   gsize        n)
+{
+  __m256 scale = _mm256_set1_ps (65535.f);
+  gsize i;
+
+  for (i = 0; i + 16 <= n; i += 16)
+    {
+      __m256i lo = quantize (_mm256_loadu_ps (src + i), scale);
+      __m256i hi = quantize (_mm256_loadu_ps (src + i + 8), scale);
+      __m256i v = _mm256_packus_epi32 (lo, hi);
+
+      STOREU (dest + i, _mm256_permute4x64_epi64 (v, _MM_SHUFFLE (3, 1, 2, 0)));
+    }
+
+  gdk_memory_simd_float_to_u16_c (dest + i, src + i, n - i);
+}
+
+static void
+premultiply_avx2 (float *rgba,
+                  gsize  n)
+{
+  gsize i;
+
+  for (i = 0; i + 2 <= n; i += 2)
+    {
+      __m256 v = _mm256_loadu_ps (rgba);
+      __m256 a = _mm256_permute_ps (v, _MM_SHUFFLE (3, 3, 3, 3));
+
+      _mm256_storeu_ps (rgba, _mm256_blend_ps (_mm256_mul_ps (v, a), v, 0x88));
+      rgba += 8;
+    }
+
+  if (i < n)
+    {
+      rgba[0] *= rgba[3];
+      rgba[1] *= rgba[3];
+      rgba[2] *= rgba[3];
+    }
+}
+
+static void
+unpremultiply_avx2 (float *rgba,
+                    gsize  n)
+{
+  __m256 threshold = _mm256_set1_ps (GDK_MEMORY_SIMD_UNPREMULTIPLY_THRESHOLD);
+  gsize i;
+
+  for (i = 0; i + 2 <= n; i += 2)
+    {
+      __m256 v = _mm256_loadu_ps (rgba);
+      __m256 a = _mm256_permute_ps (v, _MM_SHUFFLE (3, 3, 3, 3));
+      __m256 q = _mm256_blendv_ps (v, _mm256_div_ps (v, a), _mm256_cmp_ps (a, threshold, _CMP_GT_OQ));
+
+      _mm256_storeu_ps (rgba, _mm256_blend_ps (q, v, 0x88));
+      rgba += 8;
+    }
+
+  if (i < n && rgba[3] > 1/255.0)
+    {
+      rgba[0] /= rgba[3];
+      rgba[1] /= rgba[3];
+      rgba[2] /= rgba[3];
+    }
+}
+
+static void
+yuv_to_rgb_888_avx2 (guchar       *dest,
+                     const guchar *y,
+                     const guchar *u,
+                     const guchar *v,
+                     gsize         n,
+                     const int     coeffs[4])
+{
+  __m256i v_to_r = _mm256_set1_epi32 (coeffs[0]);
+  __m256i u_to_g = _mm256_set1_epi32 (coeffs[1]);
+  __m256i v_to_g = _mm256_set1_epi32 (coeffs[2]);
+  __m256i u_to_b = _mm256_set1_epi32 (coeffs[3]);
+  __m256i offset = _mm256_set1_epi32 (127);
+  /* RRRR GGGG BBBB BBBB => RGB RGB RGB RGB in both lanes */
+  __m256i mask = _mm256_setr_epi8 (0, 4, 8, 1, 5, 9, 2, 6, 10, 3, 7, 11, -1, -1, -1, -1,
+                                   0, 4, 8, 1, 5, 9, 2, 6, 10, 3, 7, 11, -1, -1, -1, -1);
+  gsize i;
+
+  /* Each lane stores 16 bytes but only 12 are valid, make sure
+   * we don't write past the end of the row. */
+  for (i = 0; i + 10 <= n; i += 8)
+    {
+      __m256i y8, u8, v8, r, g, b, rgb;
+
+      y8 = _mm256_slli_epi32 (_mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *) (y + i))), 16);
+      u8 = _mm256_sub_epi32 (_mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *) (u + i))), offset);
+      v8 = _mm256_sub_epi32 (_mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *) (v + i))), offset);
+
+      r = _mm256_add_epi32 (y8, _mm256_mullo_epi32 (v8, v_to_r));
+      g = _mm256_add_epi32 (y8, _mm256_add_epi32 (_mm256_mullo_epi32 (u8, u_to_g),
+                                                  _mm256_mullo_epi32 (v8, v_to_g)));
+      b = _mm256_add_epi32 (y8, _mm256_mullo_epi32 (u8, u_to_b));
+
+      r = _mm256_srai_epi32 (r, 16);
+      g = _mm256_srai_epi32 (g, 16);
+      b = _mm256_srai_epi32 (b, 16);
+
+      /* The packs work per lane, so the low lane holds pixels 0-3
+       * and the high lane pixels 4-7. The saturation does the clamping. */
+      rgb = _mm256_packus_epi16 (_mm256_packs_epi32 (r, g), _mm256_packs_epi32 (b, b));
+      rgb = _mm256_shuffle_epi8 (rgb, mask);
+
+      _mm_storeu_si128 ((__m128i *) (dest + 3 * i), _mm256_castsi256_si128 (rgb));
+      _mm_storeu_si128 ((__m128i *) (dest + 3 * i + 12), _mm256_extracti128_si256 (rgb, 1));
+    }
+
+  gdk_memory_simd_yuv_to_rgb_888_c (dest + 3 * i, y + i, u + i, v + i, n - i, coeffs);
+}
+
+void
+gdk_memory_simd_init_avx2 (GdkMemorySimdFuncs *funcs)
+{
+  funcs->shuffle_8888 = shuffle_8888_avx2;
+  funcs->premultiply_8888 = premultiply_8888_avx2;
+  funcs->u8888_to_float = u8888_to_float_avx2;
+  funcs->float_to_u8888 = float_to_u8888_avx2;
+  funcs->u16_to_float = u16_to_float_avx2;
+  funcs->float_to_u16 = float_to_u16_avx2;
+  funcs->premultiply = premultiply_avx2;
+  funcs->unpremultiply = unpremultiply_avx2;
+  funcs->yuv_to_rgb_888 = yuv_to_rgb_888_avx2;
+}
+
+#endif /* HAVE_AVX2 */
@@ -0,0 +1,460 @@
+/*
+ * Copyright © 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdkmemorysimdprivate.h"
+
+#ifdef HAVE_NEON
+
+#include <arm_neon.h>
+
+/* We only support aarch64, where tbl returns 0 for out of range
+ * indexes just like pshufb does for GDK_MEMORY_SIMD_ONE.
+ */
+
+static inline uint8x16_t
+swizzle_mask (const guint8 swizzle[4],
+              guint        src_bpp)
+{
+  guint8 mask[16];
+
+  for (guint i = 0; i < 16; i++)
+    {
+      if (swizzle[i % 4] == GDK_MEMORY_SIMD_ONE)
+        mask[i] = 0x80;
+      else
+        mask[i] = (i / 4) * src_bpp + swizzle[i % 4];
+    }
+
+  return vld1q_u8 (mask);
+}
+
+static inline uint8x16_t
+ones_mask (const guint8 swizzle[4])
+{
+  guint8 mask[16];
+
+  for (guint i = 0; i < 16; i++)
+    mask[i] = swizzle[i % 4] == GDK_MEMORY_SIMD_ONE ? 0xFF : 0;
+
+  return vld1q_u8 (mask);
+}
+
+static inline uint8x16_t
+alpha_mask (guint alpha)
+{
+  guint8 mask[16];
+
+  for (guint i = 0; i < 16; i++)
+    mask[i] = (i & ~3) + alpha;
+
+  return vld1q_u8 (mask);
+}
+
+static inline uint8x16_t
+alpha_select_mask (guint alpha)
+{
+  guint8 mask[16];
+
+  for (guint i = 0; i < 16; i++)
+    mask[i] = (i % 4) == alpha ? 0xFF : 0;
+
+  return vld1q_u8 (mask);
+}
+
+/* See the SSE4.1 version for why we don't just add 0.5 */
+static inline uint32x4_t
+quantize (float32x4_t f,
+          float32x4_t scale)
+{
+  uint32x4_t i;
+  float32x4_t frac;
+
+  f = vmulq_f32 (f, scale);
+  /* maxnm returns the number if one argument is NaN */
+  f = vminq_f32 (vmaxnmq_f32 (f, vdupq_n_f32 (0.f)), scale);
+  i = vcvtq_u32_f32 (f);
+  frac = vsubq_f32 (f, vcvtq_f32_u32 (i));
+
+  /* the comparison yields all bits set, ie -1, for true */
+  return vsubq_u32 (i, vcgeq_f32 (frac, vdupq_n_f32 (0.5f)));
+}
+
+static inline uint8x16_t
+pack_u32 (uint32x4_t p0,
+          uint32x4_t p1,
+          uint32x4_t p2,
+          uint32x4_t p3)
+{
+  uint16x8_t lo = vcombine_u16 (vqmovn_u32 (p0), vqmovn_u32 (p1));
+  uint16x8_t hi = vcombine_u16 (vqmovn_u32 (p2), vqmovn_u32 (p3));
+
+  return vcombine_u8 (vqmovn_u16 (lo), vqmovn_u16 (hi));
+}
+
+/* converts 4 pixels to 4 vectors of floats */
+static inline void
+u8_to_float (uint8x16_t   v,
+             float32x4_t  f[4])
+{
+  uint16x8_t lo = vmovl_u8 (vget_low_u8 (v));
+  uint16x8_t hi = vmovl_u8 (vget_high_u8 (v));
+  float32x4_t scale = vdupq_n_f32 (255.f);
+
+  f[0] = vdivq_f32 (vcvtq_f32_u32 (vmovl_u16 (vget_low_u16 (lo))), scale);
+  f[1] = vdivq_f32 (vcvtq_f32_u32 (vmovl_u16 (vget_high_u16 (lo))), scale);
+  f[2] = vdivq_f32 (vcvtq_f32_u32 (vmovl_u16 (vget_low_u16 (hi))), scale);
+  f[3] = vdivq_f32 (vcvtq_f32_u32 (vmovl_u16 (vget_high_u16 (hi))), scale);
+}
+
+static void
+shuffle_8888_neon (guchar       *dest,
+                   const guchar *src,
+                   gsize         n,
+                   const guint8  swizzle[4])
+{
+  uint8x16_t mask = swizzle_mask (swizzle, 4);
+  uint8x16_t ones = ones_mask (swizzle);
+  gsize i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      uint8x16_t v = vld1q_u8 (src + 4 * i);
+
+      vst1q_u8 (dest + 4 * i, vorrq_u8 (vqtbl1q_u8 (v, mask), ones));
+    }
+
+  gdk_memory_simd_shuffle_8888_c (dest + 4 * i, src + 4 * i, n - i, swizzle, 4);
+}
+
+static void
+shuffle_888_8888_neon (guchar       *dest,
+                       const guchar *src,
+                       gsize         n,
+                       const guint8  swizzle[4])
+{
+  uint8x16_t mask = swizzle_mask (swizzle, 3);
+  uint8x16_t ones = ones_mask (swizzle);
+  gsize i;
+
+  /* We load 16 bytes but only use 12, make sure we don't
+   * read past the end of the row. */
+  for (i = 0; i + 6 <= n; i += 4)
+    {
+      uint8x16_t v = vld1q_u8 (src + 3 * i);
+
+      vst1q_u8 (dest + 4 * i, vorrq_u8 (vqtbl1q_u8 (v, mask), ones));
+    }
+
+  gdk_memory_simd_shuffle_8888_c (dest + 4 * i, src + 3 * i, n - i, swizzle, 3);
+}
+
+static inline uint16x8_t
+premultiply_u16 (uint8x8_t v,
+                 uint8x8_t a)
+{
+  uint16x8_t r = vaddq_u16 (vmull_u8 (v, a), vdupq_n_u16 (127));
+
+  return vaddq_u16 (vaddq_u16 (r, vshrq_n_u16 (r, 8)), vdupq_n_u16 (1));
+}
+
+static void
+premultiply_8888_neon (guchar       *dest,
+                       const guchar *src,
+                       gsize         n,
+                       const guint8  swizzle[4],
+                       guint         alpha)
+{
+  uint8x16_t mask = swizzle_mask (swizzle, 4);
+  uint8x16_t ones = ones_mask (swizzle);
+  uint8x16_t amask = alpha_mask (alpha);
+  uint8x16_t aselect = alpha_select_mask (alpha);
+  gsize i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      uint8x16_t v, a, r;
+
+      v = vorrq_u8 (vqtbl1q_u8 (vld1q_u8 (src + 4 * i), mask), ones);
+      a = vqtbl1q_u8 (v, amask);
+
+      r = vcombine_u8 (vshrn_n_u16 (premultiply_u16 (vget_low_u8 (v), vget_low_u8 (a)), 8),
+                       vshrn_n_u16 (premultiply_u16 (vget_high_u8 (v), vget_high_u8 (a)), 8));
+
+      vst1q_u8 (dest + 4 * i, vbslq_u8 (aselect, v, r));
+    }
+
+  gdk_memory_simd_premultiply_8888_c (dest + 4 * i, src + 4 * i, n - i, swizzle, alpha);
+}
+
+static void
+unpremultiply_8888_neon (guchar       *dest,
+                         const guchar *src,
+                         gsize         n,
+                         const guint8  swizzle[4],
+                         guint         alpha)
+{
+  uint8x16_t mask = swizzle_mask (swizzle, 4);
+  uint8x16_t amask = alpha_mask (alpha);
+  uint8x16_t aselect = alpha_select_mask (alpha);
+  float32x4_t threshold = vdupq_n_f32 (GDK_MEMORY_SIMD_UNPREMULTIPLY_THRESHOLD);
+  float32x4_t scale = vdupq_n_f32 (255.f);
+  gsize i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      float32x4_t fv[4], fa[4];
+      uint32x4_t p[4];
+      uint8x16_t v, a;
+
+      v = vqtbl1q_u8 (vld1q_u8 (src + 4 * i), mask);
+      a = vqtbl1q_u8 (v, amask);
+
+      u8_to_float (v, fv);
+      u8_to_float (a, fa);
+
+      for (guint j = 0; j < 4; j++)
+        {
+          float32x4_t q = vdivq_f32 (fv[j], fa[j]);
+
+          p[j] = quantize (vbslq_f32 (vcgtq_f32 (fa[j], threshold), q, fv[j]), scale);
+        }
+
+      /* alpha values are unchanged */
+      vst1q_u8 (dest + 4 * i, vbslq_u8 (aselect, v, pack_u32 (p[0], p[1], p[2], p[3])));
+    }
+
+  gdk_memory_simd_unpremultiply_8888_c (dest + 4 * i, src + 4 * i, n - i, swizzle, alpha);
+}
+
+static void
+u8888_to_float_neon (float        *dest,
+                     const guchar *src,
+                     gsize         n,
+                     const guint8  swizzle[4])
+{
+  uint8x16_t mask = swizzle_mask (swizzle, 4);
+  uint8x16_t ones = ones_mask (swizzle);
+  gsize i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      float32x4_t f[4];
+      uint8x16_t v;
+
+      v = vorrq_u8 (vqtbl1q_u8 (vld1q_u8 (src + 4 * i), mask), ones);
+      u8_to_float (v, f);
+
+      vst1q_f32 (dest + 4 * i, f[0]);
+      vst1q_f32 (dest + 4 * i + 4, f[1]);
+      vst1q_f32 (dest + 4 * i + 8, f[2]);
+      vst1q_f32 (dest + 4 * i + 12, f[3]);
+    }
+
+  gdk_memory_simd_u8888_to_float_c (dest + 4 * i, src + 4 * i, n - i, swizzle);
+}
+
+static void
+float_to_u8888_neon (guchar       *dest,
+                     const float  *src,
+                     gsize         n,
+                     const guint8  swizzle[4])
+{
+  uint8x16_t mask = swizzle_mask (swizzle, 4);
+  float32x4_t scale = vdupq_n_f32 (255.f);
+  gsize i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      uint8x16_t v;
+
+      v = pack_u32 (quantize (vld1q_f32 (src + 4 * i), scale),
+                    quantize (vld1q_f32 (src + 4 * i + 4), scale),
+                    quantize (vld1q_f32 (src + 4 * i + 8), scale),
+                    quantize (vld1q_f32 (src + 4 * i + 12), scale));
+
+      vst1q_u8 (dest + 4 * i, vqtbl1q_u8 (v, mask));
+    }
+
+  gdk_memory_simd_float_to_u8888_c (dest + 4 * i, src + 4 * i, n - i, swizzle);
+}
+
+static void
+u16_to_float_neon (float         *dest,
+                   const guint16 *src,
+                   gsize          n)
+{
+  float32x4_t scale = vdupq_n_f32 (65535.f);
+  gsize i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      uint16x8_t v = vld1q_u16 (src + i);
+
+      vst1q_f32 (dest + i, vdivq_f32 (vcvtq_f32_u32 (vmovl_u16 (vget_low_u16 (v))), scale));
+      vst1q_f32 (dest + i + 4, vdivq_f32 (vcvtq_f32_u32 (vmovl_u16 (vget_high_u16 (v))), scale));
+    }
+
+  gdk_memory_simd_u16_to_float_c (dest + i, src + i, n - i);
+}
+
+static void
+float_to_u16_neon (guint16     *dest,
+                   const float *src,
+                   gsize        n)
+{
+  float32x4_t scale = vdupq_n_f32 (65535.f);
+  gsize i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      uint32x4_t lo = quantize (vld1q_f32 (src + i), scale);
+      uint32x4_t hi = quantize (vld1q_f32 (src + i + 4), scale);
+
+      vst1q_u16 (dest + i, vcombine_u16 (vqmovn_u32 (lo), vqmovn_u32 (hi)));
+    }
+
+  gdk_memory_simd_float_to_u16_c (dest + i, src + i, n - i);
+}
+
+static void
+premultiply_neon (float *rgba,
+                  gsize  n)
+{
+  gsize i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      float32x4x4_t v = vld4q_f32 (rgba);
+
+      v.val[0] = vmulq_f32 (v.val[0], v.val[3]);
+      v.val[1] = vmulq_f32 (v.val[1], v.val[3]);
+      v.val[2] = vmulq_f32 (v.val[2], v.val[3]);
+      vst4q_f32 (rgba, v);
+      rgba += 16;
+    }
+
+  for (; i < n; i++)
+    {
+      rgba[0] *= rgba[3];
+      rgba[1] *= rgba[3];
+      rgba[2] *= rgba[3];
+      rgba += 4;
+    }
+}
+
+static void
+unpremultiply_neon (float *rgba,
+                    gsize  n)
+{
+  float32x4_t threshold = vdupq_n_f32 (GDK_MEMORY_SIMD_UNPREMULTIPLY_THRESHOLD);
+  gsize i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      float32x4x4_t v = vld4q_f32 (rgba);
+      uint32x4_t m = vcgtq_f32 (v.val[3], threshold);
+
+      v.val[0] = vbslq_f32 (m, vdivq_f32 (v.val[0], v.val[3]), v.val[0]);
+      v.val[1] = vbslq_f32 (m, vdivq_f32 (v.val[1], v.val[3]), v.val[1]);
+      v.val[2] = vbslq_f32 (m, vdivq_f32 (v.val[2], v.val[3]), v.val[2]);
+      vst4q_f32 (rgba, v);
+      rgba += 16;
+    }
+
+  for (; i < n; i++)
+    {
+      if (rgba[3] > 1/255.0)
+        {
+          rgba[0] /= rgba[3];
+          rgba[1] /= rgba[3];
+          rgba[2] /= rgba[3];
+        }
+      rgba += 4;
+    }
+}
+
+static inline int32x4_t
+yuv_to_channel (int32x4_t y,
+                int32x4_t c)
+{
+  return vshrq_n_s32 (vaddq_s32 (y, c), 16);
+}
+
+static void
+yuv_to_rgb_888_neon (guchar       *dest,
+                     const guchar *y,
+                     const guchar *u,
+                     const guchar *v,
+                     gsize         n,
+                     const int     coeffs[4])
+{
+  int16x8_t offset = vdupq_n_s16 (127);
+  gsize i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      int16x8_t y8, u8, v8;
+      int16x4_t r[2], g[2], b[2];
+      uint8x8x3_t rgb;
+
+      y8 = vreinterpretq_s16_u16 (vmovl_u8 (vld1_u8 (y + i)));
+      u8 = vsubq_s16 (vreinterpretq_s16_u16 (vmovl_u8 (vld1_u8 (u + i))), offset);
+      v8 = vsubq_s16 (vreinterpretq_s16_u16 (vmovl_u8 (vld1_u8 (v + i))), offset);
+
+      for (guint h = 0; h < 2; h++)
+        {
+          int32x4_t y4, u4, v4;
+
+          y4 = vshlq_n_s32 (vmovl_s16 (h ? vget_high_s16 (y8) : vget_low_s16 (y8)), 16);
+          u4 = vmovl_s16 (h ? vget_high_s16 (u8) : vget_low_s16 (u8));
+          v4 = vmovl_s16 (h ? vget_high_s16 (v8) : vget_low_s16 (v8));
+
+          r[h] = vqmovn_s32 (yuv_to_channel (y4, vmulq_n_s32 (v4, coeffs[0])));
+          g[h] = vqmovn_s32 (yuv_to_channel (y4, vaddq_s32 (vmulq_n_s32 (u4, coeffs[1]),
+                                                            vmulq_n_s32 (v4, coeffs[2]))));
+          b[h] = vqmovn_s32 (yuv_to_channel (y4, vmulq_n_s32 (u4, coeffs[3])));
+        }
+
+      /* The saturating narrows do the clamping */
+      rgb.val[0] = vqmovun_s16 (vcombine_s16 (r[0], r[1]));
+      rgb.val[1] = vqmovun_s16 (vcombine_s16 (g[0], g[1]));
+      rgb.val[2] = vqmovun_s16 (vcombine_s16 (b[0], b[1]));
+      vst3_u8 (dest + 3 * i, rgb);
+    }
+
+  gdk_memory_simd_yuv_to_rgb_888_c (dest + 3 * i, y + i, u + i, v + i, n - i, coeffs);
+}
+
+void
+gdk_memory_simd_init_neon (GdkMemorySimdFuncs *funcs)
+{
+  funcs->shuffle_8888 = shuffle_8888_neon;
+  funcs->shuffle_888_8888 = shuffle_888_8888_neon;
+  funcs->premultiply_8888 = premultiply_8888_neon;
+  funcs->unpremultiply_8888 = unpremultiply_8888_neon;
+  funcs->u8888_to_float = u8888_to_float_neon;
+  funcs->float_to_u8888 = float_to_u8888_neon;
+  funcs->u16_to_float = u16_to_float_neon;
+  funcs->float_to_u16 = float_to_u16_neon;
+  funcs->premultiply = premultiply_neon;
+  funcs->unpremultiply = unpremultiply_neon;
+  funcs->yuv_to_rgb_888 = yuv_to_rgb_888_neon;
+}
+
+#endif /* HAVE_NEON */
@@ -0,0 +1,432 @@
+/*
+ * Copyright © 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdkmemorysimdprivate.h"
+
+#ifdef HAVE_SSE4_1
+
+#include <smmintrin.h>
+#include <string.h>
+
+#define LOADU(p) _mm_loadu_si128 ((const __m128i *) (p))
+#define STOREU(p, v) _mm_storeu_si128 ((__m128i *) (p), (v))
+
+/* Shuffle mask for 4 pixels, reading src_bpp bytes per source pixel */
+static inline __m128i
+swizzle_mask (const guint8 swizzle[4],
+              guint        src_bpp)
+{
+  guint8 mask[16];
+
+  for (guint i = 0; i < 16; i++)
+    {
+      if (swizzle[i % 4] == GDK_MEMORY_SIMD_ONE)
+        mask[i] = 0x80;
+      else
+        mask[i] = (i / 4) * src_bpp + swizzle[i % 4];
+    }
+
+  return LOADU (mask);
+}
+
+/* 0xFF for all bytes that are GDK_MEMORY_SIMD_ONE, 0 otherwise */
+static inline __m128i
+ones_mask (const guint8 swizzle[4])
+{
+  guint8 mask[16];
+
+  for (guint i = 0; i < 16; i++)
+    mask[i] = swizzle[i % 4] == GDK_MEMORY_SIMD_ONE ? 0xFF : 0;
+
+  return LOADU (mask);
+}
+
+/* Shuffle mask to broadcast byte @alpha to all bytes of each pixel */
+static inline __m128i
+alpha_mask (guint alpha)
+{
+  guint8 mask[16];
+
+  for (guint i = 0; i < 16; i++)
+    mask[i] = (i & ~3) + alpha;
+
+  return LOADU (mask);
+}
+
+/* 0xFF for the alpha bytes, 0 otherwise */
+static inline __m128i
+alpha_select_mask (guint alpha)
+{
+  guint8 mask[16];
+
+  for (guint i = 0; i < 16; i++)
+    mask[i] = (i % 4) == alpha ? 0xFF : 0;
+
+  return LOADU (mask);
+}
+
+/* Computes CLAMP (f * scale + 0.5, 0, scale) like the scalar code.
+ *
+ * We can't add 0.5 in single precision, because the scalar code
+ * does that in double precision and the results differ for some
+ * values just below 0.5. So we round manually.
+ */
+static inline __m128i
+quantize (__m128 f,
+          __m128 scale)
+{
+  __m128i i;
+  __m128 frac;
+
+  f = _mm_mul_ps (f, scale);
+  /* max() returns its 2nd argument for NaN, so this turns NaN into 0 */
+  f = _mm_min_ps (_mm_max_ps (f, _mm_setzero_ps ()), scale);
+  i = _mm_cvttps_epi32 (f);
+  frac = _mm_sub_ps (f, _mm_cvtepi32_ps (i));
+
+  /* the comparison yields -1 for true */
+  return _mm_sub_epi32 (i, _mm_castps_si128 (_mm_cmpge_ps (frac, _mm_set1_ps (0.5f))));
+}
+
+static inline __m128
+u8_to_float (__m128i v)
+{
+  return _mm_div_ps (_mm_cvtepi32_ps (_mm_cvtepu8_epi32 (v)), _mm_set1_ps (255.f));
+}
+
+static void
+shuffle_8888_sse4_1 (guchar       *dest,
+                     const guchar *src,
+                     gsize         n,
+                     const guint8  swizzle[4])
+{
+  __m128i mask = swizzle_mask (swizzle, 4);
+  __m128i ones = ones_mask (swizzle);
+  gsize i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      __m128i v = LOADU (src + 4 * i);
+
+      v = _mm_or_si128 (_mm_shuffle_epi8 (v, mask), ones);
+      STOREU (dest + 4 * i, v);
+    }
+
+  gdk_memory_simd_shuffle_8888_c (dest + 4 * i, src + 4 * i, n - i, swizzle, 4);
+}
+
+static void
+shuffle_888_8888_sse4_1 (guchar       *dest,
+                         const guchar *src,
+                         gsize         n,
+                         const guint8  swizzle[4])
+{
+  __m128i mask = swizzle_mask (swizzle, 3);
+  __m128i ones = ones_mask (swizzle);
+  gsize i;
+
+  /* We load 16 bytes but only use 12, make sure we don't
+   * read past the end of the row. */
+  for (i = 0; i + 6 <= n; i += 4)
+    {
+      __m128i v = LOADU (src + 3 * i);
+
+      v = _mm_or_si128 (_mm_shuffle_epi8 (v, mask), ones);
+      STOREU (dest + 4 * i, v);
+    }
+
+  gdk_memory_simd_shuffle_8888_c (dest + 4 * i, src + 3 * i, n - i, swizzle, 3);
+}
+
+static void
+premultiply_8888_sse4_1 (guchar       *dest,
+                         const guchar *src,
+                         gsize         n,
+                         const guint8  swizzle[4],
+                         guint         alpha)
+{
+  __m128i mask = swizzle_mask (swizzle, 4);
+  __m128i ones = ones_mask (swizzle);
+  __m128i amask = alpha_mask (alpha);
+  __m128i aselect = alpha_select_mask (alpha);
+  __m128i zero = _mm_setzero_si128 ();
+  __m128i c127 = _mm_set1_epi16 (127);
+  __m128i c1 = _mm_set1_epi16 (1);
+  gsize i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      __m128i v, a, lo, hi, alo, ahi;
+
+      v = LOADU (src + 4 * i);
+      v = _mm_or_si128 (_mm_shuffle_epi8 (v, mask), ones);
+      a = _mm_shuffle_epi8 (v, amask);
+
+      lo = _mm_cvtepu8_epi16 (v);
+      hi = _mm_unpackhi_epi8 (v, zero);
+      alo = _mm_cvtepu8_epi16 (a);
+      ahi = _mm_unpackhi_epi8 (a, zero);
+
+      /* v = v * a + 127; (v + (v >> 8) + 1) >> 8 */
+      lo = _mm_add_epi16 (_mm_mullo_epi16 (lo, alo), c127);
+      hi = _mm_add_epi16 (_mm_mullo_epi16 (hi, ahi), c127);
+      lo = _mm_srli_epi16 (_mm_add_epi16 (_mm_add_epi16 (lo, _mm_srli_epi16 (lo, 8)), c1), 8);
+      hi = _mm_srli_epi16 (_mm_add_epi16 (_mm_add_epi16 (hi, _mm_srli_epi16 (hi, 8)), c1), 8);
+
+      STOREU (dest + 4 * i, _mm_blendv_epi8 (_mm_packus_epi16 (lo, hi), v, aselect));
+    }
+
+  gdk_memory_simd_premultiply_8888_c (dest + 4 * i, src + 4 * i, n - i, swizzle, alpha);
+}
+
+static void
+unpremultiply_8888_sse4_1 (guchar       *dest,
+                           const guchar *src,
+                           gsize         n,
+                           const guint8  swizzle[4],
+                           guint         alpha)
+{
+  __m128i mask = swizzle_mask (swizzle, 4);
+  __m128i amask = alpha_mask (alpha);
+  __m128i aselect = alpha_select_mask (alpha);
+  __m128 threshold = _mm_set1_ps (GDK_MEMORY_SIMD_UNPREMULTIPLY_THRESHOLD);
+  __m128 scale = _mm_set1_ps (255.f);
+  gsize i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      __m128i v, a, p[4];
+
+      v = _mm_shuffle_epi8 (LOADU (src + 4 * i), mask);
+      a = _mm_shuffle_epi8 (v, amask);
+
+      for (guint j = 0; j < 4; j++)
+        {
+          __m128 fv = u8_to_float (v);
+          __m128 fa = u8_to_float (a);
+          __m128 q = _mm_div_ps (fv, fa);
+
+          fv = _mm_blendv_ps (fv, q, _mm_cmpgt_ps (fa, threshold));
+          p[j] = quantize (fv, scale);
+
+          v = _mm_srli_si128 (v, 4);
+          a = _mm_srli_si128 (a, 4);
+        }
+
+      v = _mm_packus_epi16 (_mm_packus_epi32 (p[0], p[1]), _mm_packus_epi32 (p[2], p[3]));
+
+      /* alpha values are unchanged */
+      STOREU (dest + 4 * i, _mm_blendv_epi8 (v, _mm_shuffle_epi8 (LOADU (src + 4 * i), mask), aselect));
+    }
+
+  gdk_memory_simd_unpremultiply_8888_c (dest + 4 * i, src + 4 * i, n - i, swizzle, alpha);
+}
+
+static void
+u8888_to_float_sse4_1 (float        *dest,
+                       const guchar *src,
+                       gsize         n,
+                       const guint8  swizzle[4])
+{
+  __m128i mask = swizzle_mask (swizzle, 4);
+  __m128i ones = ones_mask (swizzle);
+  gsize i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      __m128i v = LOADU (src + 4 * i);
+
+      v = _mm_or_si128 (_mm_shuffle_epi8 (v, mask), ones);
+
+      _mm_storeu_ps (dest + 4 * i, u8_to_float (v));
+      _mm_storeu_ps (dest + 4 * i + 4, u8_to_float (_mm_srli_si128 (v, 4)));
+      _mm_storeu_ps (dest + 4 * i + 8, u8_to_float (_mm_srli_si128 (v, 8)));
+      _mm_storeu_ps (dest + 4 * i + 12, u8_to_float (_mm_srli_si128 (v, 12)));
+    }
+
+  gdk_memory_simd_u8888_to_float_c (dest + 4 * i, src + 4 * i, n - i, swizzle);
+}
+
+static void
+float_to_u8888_sse4_1 (guchar       *dest,
+                       const float  *src,
+                       gsize         n,
+                       const guint8  swizzle[4])
+{
+  __m128i mask = swizzle_mask (swizzle, 4);
+  __m128 scale = _mm_set1_ps (255.f);
+  gsize i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      __m128i p0, p1, p2, p3, v;
+
+      p0 = quantize (_mm_loadu_ps (src + 4 * i), scale);
+      p1 = quantize (_mm_loadu_ps (src + 4 * i + 4), scale);
+      p2 = quantize (_mm_loadu_ps (src + 4 * i + 8), scale);
+      p3 = quantize (_mm_loadu_ps (src + 4 * i + 12), scale);
+
+      v = _mm_packus_epi16 (_mm_packus_epi32 (p0, p1), _mm_packus_epi32 (p2, p3));
+
+      STOREU (dest + 4 * i, _mm_shuffle_epi8 (v, mask));
+    }
+
+  gdk_memory_simd_float_to_u8888_c (dest + 4 * i, src + 4 * i, n - i, swizzle);
+}
+
+static void
+u16_to_float_sse4_1 (float         *dest,
+                     const guint16 *src,
+                     gsize          n)
+{
+  __m128 scale = _mm_set1_ps (65535.f);
+  gsize i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      __m128i v = LOADU (src + i);
+
+      _mm_storeu_ps (dest + i, _mm_div_ps (_mm_cvtepi32_ps (_mm_cvtepu16_epi32 (v)), scale));
+      _mm_storeu_ps (dest + i + 4, _mm_div_ps (_mm_cvtepi32_ps (_mm_cvtepu16_epi32 (_mm_srli_si128 (v, 8))), scale));
+    }
+
+  gdk_memory_simd_u16_to_float_c (dest + i, src + i, n - i);
+}
+
+static void
+float_to_u16_sse4_1 (guint16     *dest,
+                     const float *src,
+                     gsize        n)
+{
+  __m128 scale = _mm_set1_ps (65535.f);
+  gsize i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      __m128i lo = quantize (_mm_loadu_ps (src + i), scale);
+      __m128i hi = quantize (_mm_loadu_ps (src + i + 4), scale);
+
+      STOREU (dest + i, _mm_packus_epi32 (lo, hi));
+    }
+
+  gdk_memory_simd_float_to_u16_c (dest + i, src + i, n - i);
+}
+
+static void
+premultiply_sse4_1 (float *rgba,
+                    gsize  n)
+{
+  for (gsize i = 0; i < n; i++)
+    {
+      __m128 v = _mm_loadu_ps (rgba);
+      __m128 a = _mm_shuffle_ps (v, v, _MM_SHUFFLE (3, 3, 3, 3));
+
+      _mm_storeu_ps (rgba, _mm_blend_ps (_mm_mul_ps (v, a), v, 0x8));
+      rgba += 4;
+    }
+}
+
+static void
+unpremultiply_sse4_1 (float *rgba,
+                      gsize  n)
+{
+  __m128 threshold = _mm_set1_ps (GDK_MEMORY_SIMD_UNPREMULTIPLY_THRESHOLD);
+
+  for (gsize i = 0; i < n; i++)
+    {
+      __m128 v = _mm_loadu_ps (rgba);
+      __m128 a = _mm_shuffle_ps (v, v, _MM_SHUFFLE (3, 3, 3, 3));
+      __m128 q = _mm_blendv_ps (v, _mm_div_ps (v, a), _mm_cmpgt_ps (a, threshold));
+
+      _mm_storeu_ps (rgba, _mm_blend_ps (q, v, 0x8));
+      rgba += 4;
+    }
+}
+
+static inline __m128i
+load_u8_epi32 (const guchar *p)
+{
+  guint32 v;
+
+  memcpy (&v, p, sizeof (guint32));
+
+  return _mm_cvtepu8_epi32 (_mm_cvtsi32_si128 (v));
+}
+
+static void
+yuv_to_rgb_888_sse4_1 (guchar       *dest,
+                       const guchar *y,
+                       const guchar *u,
+                       const guchar *v,
+                       gsize         n,
+                       const int     coeffs[4])
+{
+  __m128i v_to_r = _mm_set1_epi32 (coeffs[0]);
+  __m128i u_to_g = _mm_set1_epi32 (coeffs[1]);
+  __m128i v_to_g = _mm_set1_epi32 (coeffs[2]);
+  __m128i u_to_b = _mm_set1_epi32 (coeffs[3]);
+  __m128i offset = _mm_set1_epi32 (127);
+  /* RRRR GGGG BBBB BBBB => RGB RGB RGB RGB */
+  __m128i mask = _mm_setr_epi8 (0, 4, 8, 1, 5, 9, 2, 6, 10, 3, 7, 11, -1, -1, -1, -1);
+  gsize i;
+
+  /* We store 16 bytes but only 12 are valid, make sure we
+   * don't write past the end of the row. */
+  for (i = 0; i + 6 <= n; i += 4)
+    {
+      __m128i y4, u4, v4, r, g, b, rgb;
+
+      y4 = _mm_slli_epi32 (load_u8_epi32 (y + i), 16);
+      u4 = _mm_sub_epi32 (load_u8_epi32 (u + i), offset);
+      v4 = _mm_sub_epi32 (load_u8_epi32 (v + i), offset);
+
+      r = _mm_add_epi32 (y4, _mm_mullo_epi32 (v4, v_to_r));
+      g = _mm_add_epi32 (y4, _mm_add_epi32 (_mm_mullo_epi32 (u4, u_to_g),
+                                            _mm_mullo_epi32 (v4, v_to_g)));
+      b = _mm_add_epi32 (y4, _mm_mullo_epi32 (u4, u_to_b));
+
+      r = _mm_srai_epi32 (r, 16);
+      g = _mm_srai_epi32 (g, 16);
+      b = _mm_srai_epi32 (b, 16);
+
+      /* The saturating packs do the clamping */
+      rgb = _mm_packus_epi16 (_mm_packs_epi32 (r, g), _mm_packs_epi32 (b, b));
+      STOREU (dest + 3 * i, _mm_shuffle_epi8 (rgb, mask));
+    }
+
+  gdk_memory_simd_yuv_to_rgb_888_c (dest + 3 * i, y + i, u + i, v + i, n - i, coeffs);
+}
+
+void
+gdk_memory_simd_init_sse4_1 (GdkMemorySimdFuncs *funcs)
+{
+  funcs->shuffle_8888 = shuffle_8888_sse4_1;
+  funcs->shuffle_888_8888 = shuffle_888_8888_sse4_1;
+  funcs->premultiply_8888 = premultiply_8888_sse4_1;
+  funcs->unpremultiply_8888 = unpremultiply_8888_sse4_1;
+  funcs->u8888_to_float = u8888_to_float_sse4_1;
+  funcs->float_to_u8888 = float_to_u8888_sse4_1;
+  funcs->u16_to_float = u16_to_float_sse4_1;
+  funcs->float_to_u16 = float_to_u16_sse4_1;
+  funcs->premultiply = premultiply_sse4_1;
+  funcs->unpremultiply = unpremultiply_sse4_1;
+  funcs->yuv_to_rgb_888 = yuv_to_rgb_888_sse4_1;
+}
+
+#endif /* HAVE_SSE4_1 */
@@ -0,0 +1,207 @@
+/*
+ * Copyright © 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdkmemorysimdprivate.h"
+
+#include <string.h>
+
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(HAVE_SSE4_1) || defined(HAVE_AVX2))
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static GdkMemorySimdFuncs simd_funcs;
+static GdkMemorySimd simd_enabled;
+static gsize simd_inited = 0;
+
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(HAVE_SSE4_1) || defined(HAVE_AVX2))
+static GdkMemorySimd
+detect_simd_msvc (void)
+{
+  GdkMemorySimd result = 0;
+  int cpuinfo[4] = { -1 };
+
+  __cpuid (cpuinfo, 0);
+  if (cpuinfo[0] < 1)
+    return 0;
+
+  __cpuid (cpuinfo, 1);
+  if (cpuinfo[2] & (1 << 19))
+    result |= GDK_MEMORY_SIMD_SSE4_1;
+
+  /* AVX2 needs OSXSAVE and the OS saving the ymm registers */
+  if ((cpuinfo[2] & (1 << 27)) &&
+      (cpuinfo[2] & (1 << 28)) &&
+      (_xgetbv (0) & 6) == 6)
+    {
+      __cpuid (cpuinfo, 0);
+      if (cpuinfo[0] >= 7)
+        {
+          __cpuidex (cpuinfo, 7, 0);
+          if (cpuinfo[1] & (1 << 5))
+            result |= GDK_MEMORY_SIMD_AVX2;
+        }
+    }
+
+  return result;
+}
+#endif
+
+static GdkMemorySimd
+detect_simd (void)
+{
+  GdkMemorySimd result = 0;
+
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(HAVE_SSE4_1) || defined(HAVE_AVX2))
+  result = detect_simd_msvc ();
+#elif defined(HAVE_SSE4_1) || defined(HAVE_AVX2)
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("sse4.1"))
+    result |= GDK_MEMORY_SIMD_SSE4_1;
+  if (__builtin_cpu_supports ("avx2"))
+    result |= GDK_MEMORY_SIMD_AVX2;
+#endif
+
+#ifdef HAVE_NEON
+  /* NEON is part of the aarch64 baseline */
+  result |= GDK_MEMORY_SIMD_NEON;
+#endif
+
+#ifndef HAVE_SSE4_1
+  result &= ~GDK_MEMORY_SIMD_SSE4_1;
+#endif
+#ifndef HAVE_AVX2
+  result &= ~GDK_MEMORY_SIMD_AVX2;
+#endif
+
+  return result;
+}
+
+static void
+gdk_memory_simd_init_funcs (GdkMemorySimdFuncs *funcs,
+                            GdkMemorySimd       simd)
+{
+  memset (funcs, 0, sizeof (GdkMemorySimdFuncs));
+
+#ifdef HAVE_SSE4_1
+  if (simd & GDK_MEMORY_SIMD_SSE4_1)
+    gdk_memory_simd_init_sse4_1 (funcs);
+#endif
+#ifdef HAVE_AVX2
+  /* AVX2 only implements some of the kernels and relies on
+   * SSE4.1 for the rest. */
+  if ((simd & GDK_MEMORY_SIMD_AVX2) && (simd & GDK_MEMORY_SIMD_SSE4_1))
+    gdk_memory_simd_init_avx2 (funcs);
+#endif
+#ifdef HAVE_NEON
+  if (simd & GDK_MEMORY_SIMD_NEON)
+    gdk_memory_simd_init_neon (funcs);
+#endif
+}
+
+static void
+gdk_memory_simd_ensure_inited (void)
+{
+  if (g_once_init_enter (&simd_inited))
+    {
+      simd_enabled = gdk_memory_simd_get_supported ();
+      gdk_memory_simd_init_funcs (&simd_funcs, simd_enabled);
+      g_once_init_leave (&simd_inited, 1);
+    }
+}
+
+/*<private>
+ * gdk_memory_simd_get_supported:
+ *
+ * Gets the instruction sets that GTK was compiled with and that
+ * the current CPU supports.
+ *
+ * Returns: the supported instruction sets
+ */
+GdkMemorySimd
+gdk_memory_simd_get_supported (void)
+{
+  static GdkMemorySimd supported;
+  static gsize supported_inited = 0;
+
+  if (g_once_init_enter (&supported_inited))
+    {
+      supported = detect_simd ();
+      g_once_init_leave (&supported_inited, 1);
+    }
+
+  return supported;
+}
+
+/*<private>
+ * gdk_memory_simd_get_enabled:
+ *
+ * Gets the instruction sets currently in use by gdk_memory_convert().
+ *
+ * Returns: the enabled instruction sets
+ */
+GdkMemorySimd
+gdk_memory_simd_get_enabled (void)
+{
+  gdk_memory_simd_ensure_inited ();
+
+  return simd_enabled;
+}
+
+/*<private>
+ * gdk_memory_simd_set_enabled:
+ * @simd: the instruction sets to enable
+ *
+ * Restricts the instruction sets used by gdk_memory_convert().
+ *
+ * Instruction sets that are not supported are ignored, so passing
+ * %GDK_MEMORY_SIMD_ALL restores the default.
+ *
+ * This is meant for testing that the vectorized code matches the
+ * scalar code. It must not be called while conversions are running
+ * in other threads.
+ */
+void
+gdk_memory_simd_set_enabled (GdkMemorySimd simd)
+{
+  gdk_memory_simd_ensure_inited ();
+
+  simd_enabled = simd & gdk_memory_simd_get_supported ();
+  gdk_memory_simd_init_funcs (&simd_funcs, simd_enabled);
+}
+
+/*<private>
+ * gdk_memory_simd_get_funcs:
+ *
+ * Gets the kernels to use for the enabled instruction sets.
+ *
+ * Returns: (nullable): the kernels or %NULL if no vectorized
+ *   kernels are available
+ */
+const GdkMemorySimdFuncs *
+gdk_memory_simd_get_funcs (void)
+{
+  gdk_memory_simd_ensure_inited ();
+
+  if (simd_enabled == GDK_MEMORY_SIMD_NONE)
+    return NULL;
+
+  return &simd_funcs;
+}
+
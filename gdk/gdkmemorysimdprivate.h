@@ -0,0 +1,292 @@
+/*
+ * Copyright © 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+  GDK_MEMORY_SIMD_NONE   = 0,
+  GDK_MEMORY_SIMD_SSE4_1 = 1 << 0,
+  GDK_MEMORY_SIMD_AVX2   = 1 << 1,
+  GDK_MEMORY_SIMD_NEON   = 1 << 2,
+} GdkMemorySimd;
+
+#define GDK_MEMORY_SIMD_ALL (GDK_MEMORY_SIMD_SSE4_1 | GDK_MEMORY_SIMD_AVX2 | GDK_MEMORY_SIMD_NEON)
+
+/* Used in a swizzle to produce a constant 0xFF byte instead of
+ * reading one from the source. The value is chosen so that it
+ * makes pshufb and tbl produce 0, which is then or'ed with 0xFF.
+ */
+#define GDK_MEMORY_SIMD_ONE 0x80
+
+typedef struct _GdkMemorySimdFuncs GdkMemorySimdFuncs;
+
+/*<private>
+ * GdkMemorySimdFuncs:
+ *
+ * Vectorized row conversion kernels for gdk_memory_convert().
+ *
+ * Every kernel must produce results that are bit for bit identical
+ * to the scalar code path in gdkmemoryformat.c that it replaces.
+ * Kernels that are %NULL are not available and the scalar code
+ * will be used.
+ *
+ * Swizzles describe for every destination byte which source byte
+ * (or float channel) to use. For the 8bit kernels, the value
+ * %GDK_MEMORY_SIMD_ONE can be used to produce 0xFF.
+ */
+struct _GdkMemorySimdFuncs
+{
+  /* 4 bytes => 4 bytes, no alpha changes */
+  void (* shuffle_8888)       (guchar        *dest,
+                               const guchar  *src,
+                               gsize          n,
+                               const guint8   swizzle[4]);
+  /* 3 bytes => 4 bytes, no alpha changes */
+  void (* shuffle_888_8888)   (guchar        *dest,
+                               const guchar  *src,
+                               gsize          n,
+                               const guint8   swizzle[4]);
+  /* straight => premultiplied, @alpha is the destination alpha byte */
+  void (* premultiply_8888)   (guchar        *dest,
+                               const guchar  *src,
+                               gsize          n,
+                               const guint8   swizzle[4],
+                               guint          alpha);
+  /* premultiplied => straight, @alpha is the destination alpha byte */
+  void (* unpremultiply_8888) (guchar        *dest,
+                               const guchar  *src,
+                               gsize          n,
+                               const guint8   swizzle[4],
+                               guint          alpha);
+  /* swizzle maps float RGBA channels to source bytes */
+  void (* u8888_to_float)     (float         *dest,
+                               const guchar  *src,
+                               gsize          n,
+                               const guint8   swizzle[4]);
+  /* swizzle maps destination bytes to float RGBA channels */
+  void (* float_to_u8888)     (guchar        *dest,
+                               const float   *src,
+                               gsize          n,
+                               const guint8   swizzle[4]);
+  /* n is the number of values, not pixels */
+  void (* u16_to_float)       (float         *dest,
+                               const guint16 *src,
+                               gsize          n);
+  void (* float_to_u16)       (guint16       *dest,
+                               const float   *src,
+                               gsize          n);
+  void (* premultiply)        (float         *rgba,
+                               gsize          n);
+  void (* unpremultiply)      (float         *rgba,
+                               gsize          n);
+  /* One Y, U and V value per pixel => 3 byte RGB, used by the dmabuf
+   * download. coeffs are v_to_r, u_to_g, v_to_g and u_to_b, scaled
+   * by 65536 */
+  void (* yuv_to_rgb_888)     (guchar        *dest,
+                               const guchar  *y,
+                               const guchar  *u,
+                               const guchar  *v,
+                               gsize          n,
+                               const int      coeffs[4]);
+};
+
+GdkMemorySimd                   gdk_memory_simd_get_supported   (void);
+GdkMemorySimd                   gdk_memory_simd_get_enabled     (void);
+void                            gdk_memory_simd_set_enabled     (GdkMemorySimd               simd);
+
+const GdkMemorySimdFuncs *      gdk_memory_simd_get_funcs       (void);
+
+/* Implemented in the per-instruction-set files, they override
+ * the kernels they have an implementation for. */
+void                            gdk_memory_simd_init_sse4_1     (GdkMemorySimdFuncs         *funcs);
+void                            gdk_memory_simd_init_avx2       (GdkMemorySimdFuncs         *funcs);
+void                            gdk_memory_simd_init_neon       (GdkMemorySimdFuncs         *funcs);
+
+/*<private>
+ * GDK_MEMORY_SIMD_UNPREMULTIPLY_THRESHOLD:
+ *
+ * The scalar code only unpremultiplies if `alpha > 1/255.0`, which
+ * compares in double precision. This is the largest float that is
+ * not larger than 1/255.0, so that `alpha > threshold` in float
+ * precision gives the same result.
+ */
+#define GDK_MEMORY_SIMD_UNPREMULTIPLY_THRESHOLD 0.003921568393707275f
+
+/* Scalar versions of the kernels, used by the vectorized code for
+ * the pixels that don't fill a whole vector. They follow the code
+ * in gdkmemoryformat.c exactly.
+ */
+
+static inline guchar
+gdk_memory_simd_quantize_u8 (float f)
+{
+  return CLAMP (f * 255 + 0.5, 0, 255);
+}
+
+static inline guint16
+gdk_memory_simd_quantize_u16 (float f)
+{
+  return CLAMP (f * 65535 + 0.5, 0, 65535);
+}
+
+static inline void
+gdk_memory_simd_shuffle_8888_c (guchar       *dest,
+                                const guchar *src,
+                                gsize         n,
+                                const guint8  swizzle[4],
+                                gsize         src_bpp)
+{
+  for (gsize i = 0; i < n; i++)
+    {
+      for (gsize c = 0; c < 4; c++)
+        dest[c] = swizzle[c] == GDK_MEMORY_SIMD_ONE ? 0xFF : src[swizzle[c]];
+      dest += 4;
+      src += src_bpp;
+    }
+}
+
+static inline void
+gdk_memory_simd_premultiply_8888_c (guchar       *dest,
+                                    const guchar *src,
+                                    gsize         n,
+                                    const guint8  swizzle[4],
+                                    guint         alpha)
+{
+  gdk_memory_simd_shuffle_8888_c (dest, src, n, swizzle, 4);
+
+  for (gsize i = 0; i < n; i++)
+    {
+      guchar a = dest[alpha];
+
+      for (gsize c = 0; c < 4; c++)
+        {
+          guint16 v;
+
+          if (c == alpha)
+            continue;
+
+          v = (guint16) dest[c] * a + 127;
+          dest[c] = (v + (v >> 8) + 1) >> 8;
+        }
+      dest += 4;
+    }
+}
+
+static inline void
+gdk_memory_simd_unpremultiply_8888_c (guchar       *dest,
+                                      const guchar *src,
+                                      gsize         n,
+                                      const guint8  swizzle[4],
+                                      guint         alpha)
+{
+  gdk_memory_simd_shuffle_8888_c (dest, src, n, swizzle, 4);
+
+  for (gsize i = 0; i < n; i++)
+    {
+      float a = (float) dest[alpha] / 255;
+
+      for (gsize c = 0; c < 4; c++)
+        {
+          float f;
+
+          if (c == alpha)
+            continue;
+
+          f = (float) dest[c] / 255;
+          if (a > 1/255.0)
+            f /= a;
+          dest[c] = gdk_memory_simd_quantize_u8 (f);
+        }
+      dest += 4;
+    }
+}
+
+static inline void
+gdk_memory_simd_u8888_to_float_c (float        *dest,
+                                  const guchar *src,
+                                  gsize         n,
+                                  const guint8  swizzle[4])
+{
+  for (gsize i = 0; i < n; i++)
+    {
+      for (gsize c = 0; c < 4; c++)
+        dest[c] = swizzle[c] == GDK_MEMORY_SIMD_ONE ? 1.0 : (float) src[swizzle[c]] / 255;
+      dest += 4;
+      src += 4;
+    }
+}
+
+static inline void
+gdk_memory_simd_float_to_u8888_c (guchar       *dest,
+                                  const float  *src,
+                                  gsize         n,
+                                  const guint8  swizzle[4])
+{
+  for (gsize i = 0; i < n; i++)
+    {
+      for (gsize c = 0; c < 4; c++)
+        dest[c] = gdk_memory_simd_quantize_u8 (src[swizzle[c]]);
+      dest += 4;
+      src += 4;
+    }
+}
+
+static inline void
+gdk_memory_simd_u16_to_float_c (float         *dest,
+                                const guint16 *src,
+                                gsize          n)
+{
+  for (gsize i = 0; i < n; i++)
+    dest[i] = (float) src[i] / 65535;
+}
+
+static inline void
+gdk_memory_simd_float_to_u16_c (guint16     *dest,
+                                const float *src,
+                                gsize        n)
+{
+  for (gsize i = 0; i < n; i++)
+    dest[i] = gdk_memory_simd_quantize_u16 (src[i]);
+}
+
+static inline void
+gdk_memory_simd_yuv_to_rgb_888_c (guchar       *dest,
+                                  const guchar *y,
+                                  const guchar *u,
+                                  const guchar *v,
+                                  gsize         n,
+                                  const int     coeffs[4])
+{
+  for (gsize i = 0; i < n; i++)
+    {
+      int y2 = (int) y[i] * 65536;
+      int u2 = (int) u[i] - 127;
+      int v2 = (int) v[i] - 127;
+
+      dest[0] = CLAMP ((y2 + coeffs[0] * v2) >> 16, 0, 255);
+      dest[1] = CLAMP ((y2 + coeffs[1] * u2 + coeffs[2] * v2) >> 16, 0, 255);
+      dest[2] = CLAMP ((y2 + coeffs[3] * u2) >> 16, 0, 255);
+      dest += 3;
+    }
+}
+
+G_END_DECLS
+
@@ -0,0 +1,267 @@
+/*
+ * Copyright © 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdkparalleltaskprivate.h"
+
+struct _GdkParallelTask
+{
+  gatomicrefcount ref_count;
+
+  GdkTaskFunc task_func;
+  gpointer task_data;
+  guint n_tasks;
+
+  int next_task;        /* atomic */
+
+  GMutex mutex;
+  GCond cond;
+  guint n_done;         /* protected by mutex */
+};
+
+static void
+gdk_parallel_task_unref (GdkParallelTask *task)
+{
+  if (!g_atomic_ref_count_dec (&task->ref_count))
+    return;
+
+  g_mutex_clear (&task->mutex);
+  g_cond_clear (&task->cond);
+  g_free (task);
+}
+
+/* Runs tasks until there are none left to start.
+ *
+ * Both the calling thread and the thread pool threads do this. So
+ * even if all pool threads are busy - for example because they are
+ * running a parallel task themselves - the calling thread will
+ * eventually run all the tasks and we can't deadlock.
+ */
+static void
+gdk_parallel_task_run_tasks (GdkParallelTask *task)
+{
+  guint n_run = 0;
+
+  while (TRUE)
+    {
+      guint i = g_atomic_int_add (&task->next_task, 1);
+
+      if (i >= task->n_tasks)
+        break;
+
+      task->task_func (i, task->task_data);
+      n_run++;
+    }
+
+  if (n_run == 0)
+    return;
+
+  g_mutex_lock (&task->mutex);
+  task->n_done += n_run;
+  if (task->n_done == task->n_tasks)
+    g_cond_broadcast (&task->cond);
+  g_mutex_unlock (&task->mutex);
+}
+
+static void
+gdk_parallel_task_thread_func (gpointer data,
+                               gpointer unused)
+{
+  GdkParallelTask *task = data;
+
+  gdk_parallel_task_run_tasks (task);
+  gdk_parallel_task_unref (task);
+}
+
+static GThreadPool *
+gdk_parallel_task_get_pool (void)
+{
+  static GThreadPool *pool;
+
+  if (g_once_init_enter (&pool))
+    {
+      GThreadPool *new_pool;
+
+      new_pool = g_thread_pool_new (gdk_parallel_task_thread_func,
+                                    NULL,
+                                    MAX (1, gdk_parallel_task_get_n_threads () - 1),
+                                    FALSE,
+                                    NULL);
+
+      g_once_init_leave (&pool, new_pool);
+    }
+
+  return pool;
+}
+
+/*<private>
+ * gdk_parallel_task_get_n_threads:
+ *
+ * Gets the number of threads that gdk_parallel_task_run() will use
+ * at most, including the calling thread.
+ *
+ * Use this to decide how to split up work.
+ *
+ * Returns: The number of threads, at least 1
+ */
+guint
+gdk_parallel_task_get_n_threads (void)
+{
+  static guint n_threads;
+  static gsize n_threads_inited = 0;
+
+  if (g_once_init_enter (&n_threads_inited))
+    {
+      const char *s = g_getenv ("GDK_MAX_THREADS");
+      guint n = 0;
+
+      if (s)
+        n = g_ascii_strtoull (s, NULL, 10);
+      if (n == 0)
+        n = g_get_num_processors ();
+
+      n_threads = MAX (n, 1);
+
+      g_once_init_leave (&n_threads_inited, 1);
+    }
+
+  return n_threads;
+}
+
+/*<private>
+ * gdk_parallel_task_start:
+ * @task_func: the function to run
+ * @task_data: data to pass to @task_func
+ * @n_tasks: the number of times to run @task_func
+ *
+ * Starts running @task_func @n_tasks times on the shared thread pool,
+ * like gdk_parallel_task_run(), but returns right away so the calling
+ * thread can do other work in the meantime.
+ *
+ * Call gdk_parallel_task_finish() on the result to wait for the tasks.
+ * Tasks that no thread has picked up by then run on the calling thread.
+ *
+ * Returns: (transfer full): the running task
+ */
+GdkParallelTask *
+gdk_parallel_task_start (GdkTaskFunc task_func,
+                         gpointer    task_data,
+                         guint       n_tasks)
+{
+  GdkParallelTask *task;
+  guint i, n_helpers;
+
+  task = g_new0 (GdkParallelTask, 1);
+  g_atomic_ref_count_init (&task->ref_count);
+  task->task_func = task_func;
+  task->task_data = task_data;
+  task->n_tasks = n_tasks;
+  g_mutex_init (&task->mutex);
+  g_cond_init (&task->cond);
+
+  /* The calling thread only helps in gdk_parallel_task_finish(),
+   * so with a single thread, all the work happens there */
+  n_helpers = MIN (n_tasks, gdk_parallel_task_get_n_threads () - 1);
+
+  for (i = 0; i < n_helpers; i++)
+    {
+      g_atomic_ref_count_inc (&task->ref_count);
+      g_thread_pool_push (gdk_parallel_task_get_pool (), task, NULL);
+    }
+
+  return task;
+}
+
+/*<private>
+ * gdk_parallel_task_finish:
+ * @task: (transfer full): a task returned by gdk_parallel_task_start()
+ *
+ * Runs the tasks that haven't been started yet on the calling thread
+ * and waits for the others to finish. After that, @task is freed.
+ */
+void
+gdk_parallel_task_finish (GdkParallelTask *task)
+{
+  gdk_parallel_task_run_tasks (task);
+
+  g_mutex_lock (&task->mutex);
+  while (task->n_done < task->n_tasks)
+    g_cond_wait (&task->cond, &task->mutex);
+  g_mutex_unlock (&task->mutex);
+
+  gdk_parallel_task_unref (task);
+}
+
+/*<private>
+ * gdk_parallel_task_run:
+ * @task_func: the function to run
+ * @task_data: data to pass to @task_func
+ * @n_tasks: the number of times to run @task_func
+ *
+ * Runs @task_func @n_tasks times, with the task index going from 0
+ * to @n_tasks - 1. The tasks are distributed over a shared thread
+ * pool and the calling thread.
+ *
+ * This function returns once all tasks have finished.
+ *
+ * The tasks may run in any order and in parallel, so they must not
+ * depend on each other.
+ */
+void
+gdk_parallel_task_run (GdkTaskFunc task_func,
+                       gpointer    task_data,
+                       guint       n_tasks)
+{
+  GdkParallelTask *task;
+  guint i, n_helpers;
+
+  if (n_tasks == 0)
+    return;
+
+  n_helpers = MIN (n_tasks, gdk_parallel_task_get_n_threads ()) - 1;
+
+  if (n_helpers == 0)
+    {
+      for (i = 0; i < n_tasks; i++)
+        task_func (i, task_data);
+      return;
+    }
+
+  task = g_new0 (GdkParallelTask, 1);
+  g_atomic_ref_count_init (&task->ref_count);
+  task->task_func = task_func;
+  task->task_data = task_data;
+  task->n_tasks = n_tasks;
+  g_mutex_init (&task->mutex);
+  g_cond_init (&task->cond);
+
+  for (i = 0; i < n_helpers; i++)
+    {
+      g_atomic_ref_count_inc (&task->ref_count);
+      g_thread_pool_push (gdk_parallel_task_get_pool (), task, NULL);
+    }
+
+  gdk_parallel_task_run_tasks (task);
+
+  g_mutex_lock (&task->mutex);
+  while (task->n_done < task->n_tasks)
+    g_cond_wait (&task->cond, &task->mutex);
+  g_mutex_unlock (&task->mutex);
+
+  gdk_parallel_task_unref (task);
+}
@@ -49,6 +49,7 @@
 #include "loaders/gdkpngprivate.h"
 #include "loaders/gdktiffprivate.h"
 #include "loaders/gdkjpegprivate.h"
+#include "loaders/gdkrawprivate.h"
 
 G_DEFINE_QUARK (gdk-texture-error-quark, gdk_texture_error)
 
@@ -510,6 +511,43 @@ gdk_texture_new_from_resource (const char *resource_path)
   return texture;
 }
 
+/* Local raw images are mapped instead of read. That way, they
+ * don't need to be copied at all, their textures use the mapped
+ * pages directly.
+ *
+ * Everything else is read, because decoders don't keep the data
+ * around, and reading from a mapping of a file that gets truncated
+ * meanwhile crashes with SIGBUS.
+ */
+static GBytes *
+gdk_texture_load_file_bytes (GFile   *file,
+                             GError **error)
+{
+  char *path;
+
+  path = g_file_get_path (file);
+  if (path != NULL)
+    {
+      GMappedFile *mapped;
+
+      mapped = g_mapped_file_new (path, FALSE, NULL);
+      g_free (path);
+
+      if (mapped != NULL)
+        {
+          GBytes *bytes = g_mapped_file_get_bytes (mapped);
+          g_mapped_file_unref (mapped);
+
+          if (gdk_is_raw (bytes))
+            return bytes;
+
+          g_bytes_unref (bytes);
+        }
+    }
+
+  return g_file_load_bytes (file, NULL, NULL, error);
+}
+
 /**
  * gdk_texture_new_from_file:
  * @file: `GFile` to load
@@ -538,7 +576,7 @@ gdk_texture_new_from_file (GFile   *file,
   g_return_val_if_fail (G_IS_FILE (file), NULL);
   g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
-  bytes = g_file_load_bytes (file, NULL, NULL, error);
+  bytes = gdk_texture_load_file_bytes (file, error);
   if (bytes == NULL)
     return NULL;
 
@@ -554,24 +592,30 @@ gdk_texture_can_load (GBytes *bytes)
 {
   return gdk_is_png (bytes) ||
          gdk_is_jpeg (bytes) ||
-         gdk_is_tiff (bytes);
+         gdk_is_tiff (bytes) ||
+         gdk_is_raw (bytes);
 }
 
 static GdkTexture *
-gdk_texture_new_from_bytes_internal (GBytes  *bytes,
-                                     GError **error)
+gdk_texture_new_from_bytes_internal (GBytes                  *bytes,
+                                     const GdkLoaderOptions  *options,
+                                     GError                 **error)
 {
   if (gdk_is_png (bytes))
     {
-      return gdk_load_png (bytes, error);
+      return gdk_load_png_with_options (bytes, options, error);
     }
   else if (gdk_is_jpeg (bytes))
     {
-      return gdk_load_jpeg (bytes, error);
+      return gdk_load_jpeg_with_options (bytes, options, error);
     }
   else if (gdk_is_tiff (bytes))
     {
-      return gdk_load_tiff (bytes, error);
+      return gdk_load_tiff_with_options (bytes, options, error);
+    }
+  else if (gdk_is_raw (bytes))
+    {
+      return gdk_load_raw_with_options (bytes, options, error);
     }
   else
     {
@@ -583,12 +627,14 @@ gdk_texture_new_from_bytes_internal (GBytes  *bytes,
 }
 
 static GdkTexture *
-gdk_texture_new_from_bytes_pixbuf (GBytes  *bytes,
-                                   GError **error)
+gdk_texture_new_from_bytes_pixbuf (GBytes                  *bytes,
+                                   const GdkLoaderOptions  *options,
+                                   GError                 **error)
 {
   GInputStream *stream;
   GdkPixbuf *pixbuf;
   GdkTexture *texture;
+  GdkRectangle area;
 
   stream = g_memory_input_stream_new_from_bytes (bytes);
   pixbuf = gdk_pixbuf_new_from_stream (stream, NULL, error);
@@ -596,12 +642,71 @@ gdk_texture_new_from_bytes_pixbuf (GBytes  *bytes,
   if (pixbuf == NULL)
     return NULL;
 
+  if (!gdk_loader_options_get_area (options,
+                                    gdk_pixbuf_get_width (pixbuf),
+                                    gdk_pixbuf_get_height (pixbuf),
+                                    &area,
+                                    error))
+    {
+      g_object_unref (pixbuf);
+      return NULL;
+    }
+
   texture = gdk_texture_new_for_pixbuf (pixbuf);
   g_object_unref (pixbuf);
 
-  return texture;
+  return gdk_loader_crop_texture (texture, &area);
+}
+
+static GdkTexture *
+gdk_texture_new_from_bytes_with_fallback (GBytes                  *bytes,
+                                          const GdkLoaderOptions  *options,
+                                          GError                 **error)
+{
+  GdkTexture *texture;
+  GError *internal_error = NULL;
+
+  texture = gdk_texture_new_from_bytes_internal (bytes, options, &internal_error);
+  if (texture)
+    return texture;
+
+  if (!g_error_matches (internal_error, GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_UNSUPPORTED_CONTENT) &&
+      !g_error_matches (internal_error, GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_UNSUPPORTED_FORMAT))
+    {
+      g_propagate_error (error, internal_error);
+      return NULL;
+    }
+
+  g_clear_error (&internal_error);
+
+  return gdk_texture_new_from_bytes_pixbuf (bytes, options, error);
 }
 
+/*<private>
+ * gdk_texture_new_from_bytes_with_options:
+ * @bytes: a `GBytes` containing the data to load
+ * @options: (nullable): the part of the image to load and
+ *   the size it is going to be drawn at
+ * @error: Return location for an error
+ *
+ * Like [ctor@Gdk.Texture.new_from_bytes], but only loads the area of
+ * the image given in @options.
+ *
+ * If @options contains a size, loaders may decode the image at a
+ * lower resolution, as long as the result isn't smaller than that.
+ *
+ * Return value: A newly-created `GdkTexture`
+ */
+GdkTexture *
+gdk_texture_new_from_bytes_with_options (GBytes                  *bytes,
+                                         const GdkLoaderOptions  *options,
+                                         GError                 **error)
+{
+  g_return_val_if_fail (bytes != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  return gdk_texture_new_from_bytes_with_fallback (bytes, options, error);
+}
 
 /**
  * gdk_texture_new_from_bytes:
@@ -627,26 +732,10 @@ GdkTexture *
 gdk_texture_new_from_bytes (GBytes  *bytes,
                             GError **error)
 {
-  GdkTexture *texture;
-  GError *internal_error = NULL;
-
   g_return_val_if_fail (bytes != NULL, NULL);
   g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
-  texture = gdk_texture_new_from_bytes_internal (bytes, &internal_error);
-  if (texture)
-    return texture;
-
-  if (!g_error_matches (internal_error, GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_UNSUPPORTED_CONTENT) &&
-      !g_error_matches (internal_error, GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_UNSUPPORTED_FORMAT))
-    {
-      g_propagate_error (error, internal_error);
-      return NULL;
-    }
-
-  g_clear_error (&internal_error);
-
-  return gdk_texture_new_from_bytes_pixbuf (bytes, error);
+  return gdk_texture_new_from_bytes_with_fallback (bytes, NULL, error);
 }
 
 /**
@@ -36,6 +36,7 @@
 
 #include "gdktexturedownloaderprivate.h"
 
+#include "gdkgltextureprivate.h"
 #include "gdkmemoryformatprivate.h"
 #include "gdkmemorytextureprivate.h"
 #include "gdktextureprivate.h"
@@ -266,3 +267,387 @@ gdk_texture_downloader_download_bytes (const GdkTextureDownloader *self,
   return g_bytes_new_take (data, stride * self->texture->height);
 }
 
+typedef struct _GdkDownloadBuffer GdkDownloadBuffer;
+
+struct _GdkDownloadPool
+{
+  gatomicrefcount ref_count;
+
+  GMutex lock;
+  gsize max_size;
+  gsize size;           /* protected by lock */
+  GQueue buffers;       /* protected by lock, most recently used first */
+};
+
+struct _GdkDownloadBuffer
+{
+  GdkDownloadPool *pool;        /* only set while in use */
+  GdkMemoryFormat format;
+  gsize width;
+  gsize height;
+  gsize stride;
+  GList link;
+  guchar *data;
+};
+
+static void
+gdk_download_buffer_free (GdkDownloadBuffer *buffer)
+{
+  g_free (buffer->data);
+  g_free (buffer);
+}
+
+/*<private>
+ * gdk_download_pool_new:
+ * @max_size: the number of bytes to keep around at most
+ *
+ * Creates a pool of buffers for gdk_texture_downloader_download_bytes_pooled().
+ *
+ * Once the bytes returned from a pooled download are freed, their
+ * memory goes back to the pool, and the next download with the same
+ * size and format reuses it instead of allocating new memory. This
+ * is meant for code that downloads textures of the same size over
+ * and over, like one per frame.
+ *
+ * The pool keeps the most recently used buffers, up to @max_size bytes.
+ *
+ * Returns: (transfer full): a new pool
+ */
+GdkDownloadPool *
+gdk_download_pool_new (gsize max_size)
+{
+  GdkDownloadPool *self;
+
+  self = g_new0 (GdkDownloadPool, 1);
+  g_atomic_ref_count_init (&self->ref_count);
+  g_mutex_init (&self->lock);
+  self->max_size = max_size;
+
+  return self;
+}
+
+GdkDownloadPool *
+gdk_download_pool_ref (GdkDownloadPool *self)
+{
+  g_atomic_ref_count_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+gdk_download_pool_unref (GdkDownloadPool *self)
+{
+  GList *l;
+
+  if (!g_atomic_ref_count_dec (&self->ref_count))
+    return;
+
+  while ((l = g_queue_pop_head_link (&self->buffers)))
+    gdk_download_buffer_free (l->data);
+
+  g_mutex_clear (&self->lock);
+  g_free (self);
+}
+
+static GdkDownloadBuffer *
+gdk_download_pool_acquire (GdkDownloadPool *self,
+                           GdkMemoryFormat  format,
+                           gsize            width,
+                           gsize            height)
+{
+  GdkDownloadBuffer *buffer = NULL;
+  GList *l;
+
+  g_mutex_lock (&self->lock);
+
+  for (l = self->buffers.head; l; l = l->next)
+    {
+      GdkDownloadBuffer *b = l->data;
+
+      if (b->format == format && b->width == width && b->height == height)
+        {
+          g_queue_unlink (&self->buffers, l);
+          self->size -= b->stride * b->height;
+          buffer = b;
+          break;
+        }
+    }
+
+  g_mutex_unlock (&self->lock);
+
+  if (buffer == NULL)
+    {
+      buffer = g_new0 (GdkDownloadBuffer, 1);
+      buffer->format = format;
+      buffer->width = width;
+      buffer->height = height;
+      buffer->stride = width * gdk_memory_format_bytes_per_pixel (format);
+      buffer->link.data = buffer;
+      buffer->data = g_malloc_n (buffer->stride, height);
+    }
+
+  buffer->pool = gdk_download_pool_ref (self);
+
+  return buffer;
+}
+
+/* Called when the GBytes wrapping the buffer are freed, possibly
+ * from a different thread */
+static void
+gdk_download_pool_release (gpointer data)
+{
+  GdkDownloadBuffer *buffer = data;
+  GdkDownloadPool *self = g_steal_pointer (&buffer->pool);
+  gsize size = buffer->stride * buffer->height;
+
+  g_mutex_lock (&self->lock);
+
+  if (size <= self->max_size)
+    {
+      g_queue_push_head_link (&self->buffers, &buffer->link);
+      self->size += size;
+      buffer = NULL;
+
+      while (self->size > self->max_size)
+        {
+          GdkDownloadBuffer *oldest = g_queue_pop_tail_link (&self->buffers)->data;
+
+          self->size -= oldest->stride * oldest->height;
+          gdk_download_buffer_free (oldest);
+        }
+    }
+
+  g_mutex_unlock (&self->lock);
+
+  g_clear_pointer (&buffer, gdk_download_buffer_free);
+  gdk_download_pool_unref (self);
+}
+
+/*<private>
+ * gdk_texture_downloader_download_bytes_pooled:
+ * @self: the downloader
+ * @pool: the pool to take the memory from
+ * @out_stride: (out): The stride of the resulting data in bytes
+ *
+ * Like [method@Gdk.TextureDownloader.download_bytes], but reuses
+ * memory from @pool if possible. See gdk_download_pool_new() for
+ * details.
+ *
+ * Returns: The downloaded pixels
+ */
+GBytes *
+gdk_texture_downloader_download_bytes_pooled (const GdkTextureDownloader *self,
+                                              GdkDownloadPool            *pool,
+                                              gsize                      *out_stride)
+{
+  GdkDownloadBuffer *buffer;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (pool != NULL, NULL);
+  g_return_val_if_fail (out_stride != NULL, NULL);
+
+  /* No need for memory if we don't copy */
+  if (GDK_IS_MEMORY_TEXTURE (self->texture) &&
+      gdk_texture_get_format (self->texture) == self->format)
+    return gdk_texture_downloader_download_bytes (self, out_stride);
+
+  buffer = gdk_download_pool_acquire (pool,
+                                      self->format,
+                                      self->texture->width,
+                                      self->texture->height);
+
+  gdk_texture_do_download (self->texture, self->format, buffer->data, buffer->stride);
+
+  *out_stride = buffer->stride;
+  return g_bytes_new_with_free_func (buffer->data,
+                                     buffer->stride * buffer->height,
+                                     gdk_download_pool_release,
+                                     buffer);
+}
+
+typedef struct _DownloadData DownloadData;
+
+struct _DownloadData
+{
+  GdkTextureDownloader downloader;
+  GdkDownloadPool *pool;
+  GBytes *bytes;
+  gsize stride;
+};
+
+static void
+download_data_free (gpointer data)
+{
+  DownloadData *download = data;
+
+  gdk_texture_downloader_finish (&download->downloader);
+  g_clear_pointer (&download->pool, gdk_download_pool_unref);
+  g_clear_pointer (&download->bytes, g_bytes_unref);
+  g_free (download);
+}
+
+static void
+download_data_run (DownloadData *download,
+                   GTask        *task)
+{
+  GBytes *bytes;
+
+  if (download->pool)
+    bytes = gdk_texture_downloader_download_bytes_pooled (&download->downloader, download->pool, &download->stride);
+  else
+    bytes = gdk_texture_downloader_download_bytes (&download->downloader, &download->stride);
+
+  g_task_return_pointer (task, bytes, (GDestroyNotify) g_bytes_unref);
+}
+
+static void
+download_thread (GTask        *task,
+                 gpointer      source_object,
+                 gpointer      task_data,
+                 GCancellable *cancellable)
+{
+  download_data_run (task_data, task);
+}
+
+/* The memory for GL downloads is allocated up front, because
+ * the GL texture writes into it from a thread of its own */
+static guchar *
+download_data_alloc (DownloadData *download)
+{
+  GdkTexture *texture = download->downloader.texture;
+
+  if (download->pool)
+    {
+      GdkDownloadBuffer *buffer;
+
+      buffer = gdk_download_pool_acquire (download->pool,
+                                          download->downloader.format,
+                                          texture->width,
+                                          texture->height);
+      download->stride = buffer->stride;
+      download->bytes = g_bytes_new_with_free_func (buffer->data,
+                                                    buffer->stride * buffer->height,
+                                                    gdk_download_pool_release,
+                                                    buffer);
+    }
+  else
+    {
+      download->stride = texture->width * gdk_memory_format_bytes_per_pixel (download->downloader.format);
+      download->bytes = g_bytes_new_take (g_malloc_n (download->stride, texture->height),
+                                          download->stride * texture->height);
+    }
+
+  return (guchar *) g_bytes_get_data (download->bytes, NULL);
+}
+
+static void
+download_gl_done (GObject      *source,
+                  GAsyncResult *result,
+                  gpointer      data)
+{
+  GTask *task = data;
+  DownloadData *download = g_task_get_task_data (task);
+  GError *error = NULL;
+
+  if (gdk_gl_texture_download_finish (GDK_GL_TEXTURE (source), result, &error))
+    g_task_return_pointer (task, g_steal_pointer (&download->bytes), (GDestroyNotify) g_bytes_unref);
+  else
+    g_task_return_error (task, error);
+
+  g_object_unref (task);
+}
+
+/*<private>
+ * gdk_texture_downloader_download_bytes_async:
+ * @self: the downloader
+ * @pool: (nullable): the pool to take the memory from
+ * @cancellable: (nullable): optional `GCancellable` object
+ * @callback: (scope async): callback to call when the download is done
+ * @user_data: the data to pass to callback function
+ *
+ * Downloads the texture in a thread, so that waiting for the pixels
+ * and converting them doesn't block the calling thread.
+ *
+ * The downloader is copied, so it can be changed or freed right away.
+ *
+ * Textures that are already in memory in the right format are
+ * returned right away.
+ *
+ * GL textures are read back into a pixel buffer and only polled
+ * from the main thread, so it does not wait for the GPU either.
+ */
+void
+gdk_texture_downloader_download_bytes_async (const GdkTextureDownloader *self,
+                                             GdkDownloadPool            *pool,
+                                             GCancellable               *cancellable,
+                                             GAsyncReadyCallback         callback,
+                                             gpointer                    user_data)
+{
+  DownloadData *download;
+  GTask *task;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  download = g_new0 (DownloadData, 1);
+  gdk_texture_downloader_init (&download->downloader, self->texture);
+  download->downloader.format = self->format;
+  if (pool)
+    download->pool = gdk_download_pool_ref (pool);
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gdk_texture_downloader_download_bytes_async);
+  g_task_set_task_data (task, download, download_data_free);
+
+  if (GDK_IS_MEMORY_TEXTURE (self->texture) &&
+      gdk_texture_get_format (self->texture) == self->format)
+    download_data_run (download, task);
+  else if (GDK_IS_GL_TEXTURE (self->texture))
+    {
+      guchar *data = download_data_alloc (download);
+
+      gdk_gl_texture_download_async (GDK_GL_TEXTURE (self->texture),
+                                     download->downloader.format,
+                                     data,
+                                     download->stride,
+                                     cancellable,
+                                     download_gl_done,
+                                     g_object_ref (task));
+    }
+  else
+    g_task_run_in_thread (task, download_thread);
+
+  g_object_unref (task);
+}
+
+/*<private>
+ * gdk_texture_downloader_download_bytes_finish:
+ * @result: a `GAsyncResult`
+ * @out_stride: (out): The stride of the resulting data in bytes
+ * @error: Return location for an error
+ *
+ * Finishes a call to gdk_texture_downloader_download_bytes_async().
+ *
+ * Returns: The downloaded pixels, or %NULL if the download was cancelled
+ */
+GBytes *
+gdk_texture_downloader_download_bytes_finish (GAsyncResult  *result,
+                                              gsize         *out_stride,
+                                              GError       **error)
+{
+  DownloadData *download;
+  GBytes *bytes;
+
+  g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+  g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == gdk_texture_downloader_download_bytes_async, NULL);
+  g_return_val_if_fail (out_stride != NULL, NULL);
+
+  bytes = g_task_propagate_pointer (G_TASK (result), error);
+  if (bytes == NULL)
+    return NULL;
+
+  download = g_task_get_task_data (G_TASK (result));
+  *out_stride = download->stride;
+
+  return bytes;
+}
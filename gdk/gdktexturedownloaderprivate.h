@@ -34,6 +34,28 @@ void                    gdk_texture_downloader_init              (GdkTextureDown
                                                                   GdkTexture                     *texture);
 void                    gdk_texture_downloader_finish            (GdkTextureDownloader           *self);
 
+typedef struct _GdkDownloadPool GdkDownloadPool;
+
+GdkDownloadPool *       gdk_download_pool_new                    (gsize                           max_size);
+GdkDownloadPool *       gdk_download_pool_ref                    (GdkDownloadPool                *self);
+void                    gdk_download_pool_unref                  (GdkDownloadPool                *self);
+
+GBytes *                gdk_texture_downloader_download_bytes_pooled
+                                                                 (const GdkTextureDownloader     *self,
+                                                                  GdkDownloadPool                *pool,
+                                                                  gsize                          *out_stride);
+
+void                    gdk_texture_downloader_download_bytes_async
+                                                                 (const GdkTextureDownloader     *self,
+                                                                  GdkDownloadPool                *pool,
+                                                                  GCancellable                   *cancellable,
+                                                                  GAsyncReadyCallback             callback,
+                                                                  gpointer                        user_data);
+GBytes *                gdk_texture_downloader_download_bytes_finish
+                                                                 (GAsyncResult                   *result,
+                                                                  gsize                          *out_stride,
+                                                                  GError                        **error);
+
 
 G_END_DECLS
 
@@ -3,6 +3,7 @@
 #include "gdktexture.h"
 
 #include "gdkenums.h"
+#include "loaders/gdkloaderprivate.h"
 
 G_BEGIN_DECLS
 
@@ -51,6 +52,10 @@ struct _GdkTextureClass {
 };
 
 gboolean                gdk_texture_can_load            (GBytes                 *bytes);
+GdkTexture *            gdk_texture_new_from_bytes_with_options
+                                                        (GBytes                 *bytes,
+                                                         const GdkLoaderOptions *options,
+                                                         GError                **error);
 
 GdkTexture *            gdk_texture_new_for_surface     (cairo_surface_t        *surface);
 cairo_surface_t *       gdk_texture_download_surface    (GdkTexture             *texture);
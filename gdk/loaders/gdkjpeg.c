@@ -137,6 +137,14 @@ convert_cmyk_to_rgba (guchar *data,
 GdkTexture *
 gdk_load_jpeg (GBytes  *input_bytes,
                GError **error)
+{
+  return gdk_load_jpeg_with_options (input_bytes, NULL, error);
+}
+
+GdkTexture *
+gdk_load_jpeg_with_options (GBytes                  *input_bytes,
+                            const GdkLoaderOptions  *options,
+                            GError                 **error)
 {
   struct jpeg_decompress_struct info;
   struct error_handler_data jerr;
@@ -146,6 +154,9 @@ gdk_load_jpeg (GBytes  *input_bytes,
   GBytes *bytes;
   GdkTexture *texture;
   GdkMemoryFormat format;
+  GdkRectangle area;
+  JDIMENSION x0, y0, x1, y1, crop_x, crop_width;
+  int scale;
   G_GNUC_UNUSED guint64 before = GDK_PROFILER_CURRENT_TIME;
 
   info.err = jpeg_std_error (&jerr.pub);
@@ -170,10 +181,49 @@ gdk_load_jpeg (GBytes  *input_bytes,
                 g_bytes_get_size (input_bytes));
 
   jpeg_read_header (&info, TRUE);
+
+  if (!gdk_loader_options_get_area (options, info.image_width, info.image_height, &area, error))
+    {
+      jpeg_destroy_decompress (&info);
+      return NULL;
+    }
+
+  /* libjpeg can shrink by 2, 4 or 8 while decoding, which is
+   * a lot cheaper than decoding at full size */
+  scale = gdk_loader_options_get_scale (options, &area);
+  info.scale_num = 1;
+  if (scale >= 8)
+    info.scale_denom = 8;
+  else if (scale >= 4)
+    info.scale_denom = 4;
+  else if (scale >= 2)
+    info.scale_denom = 2;
+  else
+    info.scale_denom = 1;
+
   jpeg_start_decompress (&info);
 
+  /* The area in output coordinates */
+  x0 = area.x / info.scale_denom;
+  y0 = area.y / info.scale_denom;
+  x1 = MIN ((area.x + area.width + info.scale_denom - 1) / info.scale_denom, info.output_width);
+  y1 = MIN ((area.y + area.height + info.scale_denom - 1) / info.scale_denom, info.output_height);
+
+  crop_x = 0;
+  crop_width = info.output_width;
+#ifdef HAVE_JPEG_CROP_SCANLINE
+  /* This aligns the crop to the iMCU size, so it might include
+   * some extra columns on the left. */
+  if (x1 - x0 < info.output_width)
+    {
+      crop_x = x0;
+      crop_width = x1 - x0;
+      jpeg_crop_scanline (&info, &crop_x, &crop_width);
+    }
+#endif
+
   width = info.output_width;
-  height = info.output_height;
+  height = y1 - y0;
 
   switch ((int)info.out_color_space)
     {
@@ -205,9 +255,19 @@ gdk_load_jpeg (GBytes  *input_bytes,
       return NULL;
     }
 
-  while (info.output_scanline < info.output_height)
+  while (info.output_scanline < y0)
     {
-       row[0] = (unsigned char *)(&data[stride * info.output_scanline]);
+#ifdef HAVE_JPEG_CROP_SCANLINE
+      jpeg_skip_scanlines (&info, y0 - info.output_scanline);
+#else
+      row[0] = data;
+      jpeg_read_scanlines (&info, row, 1);
+#endif
+    }
+
+  while (info.output_scanline < y1)
+    {
+       row[0] = (unsigned char *)(&data[stride * (info.output_scanline - y0)]);
        jpeg_read_scanlines (&info, row, 1);
     }
 
@@ -226,7 +286,10 @@ gdk_load_jpeg (GBytes  *input_bytes,
       g_assert_not_reached ();
     }
 
-  jpeg_finish_decompress (&info);
+  /* Finishing checks the rest of the data, which we don't need
+   * to look at if we stopped early */
+  if (info.output_scanline == info.output_height)
+    jpeg_finish_decompress (&info);
   jpeg_destroy_decompress (&info);
 
   bytes = g_bytes_new_take (data, stride * height);
@@ -237,6 +300,9 @@ gdk_load_jpeg (GBytes  *input_bytes,
 
   g_bytes_unref (bytes);
 
+  texture = gdk_loader_crop_texture (texture,
+                                     &(GdkRectangle) { x0 - crop_x, 0, x1 - x0, height });
+
   gdk_profiler_end_mark (before, "Load jpeg", NULL);
  
   return texture;
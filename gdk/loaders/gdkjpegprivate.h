@@ -17,15 +17,19 @@
 
 #pragma once
 
+#include "gdkloaderprivate.h"
 #include "gdkmemorytexture.h"
 #include <gio/gio.h>
 
 #define JPEG_SIGNATURE "\xff\xd8"
 
-GdkTexture *gdk_load_jpeg         (GBytes           *bytes,
-                                   GError          **error);
+GdkTexture *gdk_load_jpeg              (GBytes                  *bytes,
+                                        GError                 **error);
+GdkTexture *gdk_load_jpeg_with_options (GBytes                  *bytes,
+                                        const GdkLoaderOptions  *options,
+                                        GError                 **error);
 
-GBytes     *gdk_save_jpeg         (GdkTexture     *texture);
+GBytes     *gdk_save_jpeg              (GdkTexture              *texture);
 
 static inline gboolean
 gdk_is_jpeg (GBytes *bytes)
@@ -0,0 +1,97 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdkloaderprivate.h"
+
+#include <glib/gi18n-lib.h>
+#include <gio/gio.h>
+#include "gdkmemorytextureprivate.h"
+#include "gdkrectangle.h"
+
+/* Gets the area of the image to load. Sets @error and returns
+ * %FALSE if the requested area is outside of the image. */
+gboolean
+gdk_loader_options_get_area (const GdkLoaderOptions  *options,
+                             int                      image_width,
+                             int                      image_height,
+                             GdkRectangle            *area,
+                             GError                 **error)
+{
+  GdkRectangle image = { 0, 0, image_width, image_height };
+
+  if (options == NULL || options->area.width <= 0 || options->area.height <= 0)
+    {
+      *area = image;
+      return TRUE;
+    }
+
+  if (!gdk_rectangle_intersect (&options->area, &image, area))
+    {
+      g_set_error (error,
+                   G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   _("Requested area is outside of the %dx%d image"), image_width, image_height);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Gets the largest integer factor to shrink @area by that
+ * keeps it at least as large as the requested size. */
+int
+gdk_loader_options_get_scale (const GdkLoaderOptions *options,
+                              const GdkRectangle     *area)
+{
+  int scale = G_MAXINT;
+
+  if (options == NULL)
+    return 1;
+
+  if (options->width > 0)
+    scale = MIN (scale, area->width / options->width);
+  if (options->height > 0)
+    scale = MIN (scale, area->height / options->height);
+
+  if (scale == G_MAXINT)
+    return 1;
+
+  return MAX (scale, 1);
+}
+
+/* For loaders that can't skip parts of the image: Takes ownership
+ * of the fully loaded @texture and returns the part of it that
+ * was asked for. */
+GdkTexture *
+gdk_loader_crop_texture (GdkTexture         *texture,
+                         const GdkRectangle *area)
+{
+  GdkTexture *result;
+
+  if (texture == NULL ||
+      (area->width == gdk_texture_get_width (texture) &&
+       area->height == gdk_texture_get_height (texture)))
+    return texture;
+
+  result = gdk_memory_texture_new_subtexture (GDK_MEMORY_TEXTURE (texture),
+                                              area->x, area->y,
+                                              area->width, area->height);
+  g_object_unref (texture);
+
+  return result;
+}
@@ -0,0 +1,45 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "gdktexture.h"
+
+typedef struct _GdkLoaderOptions GdkLoaderOptions;
+
+struct _GdkLoaderOptions
+{
+  /* The part of the image to load, in image coordinates.
+   * An empty area loads the whole image. */
+  GdkRectangle area;
+  /* The size that the area is going to be drawn at, or 0 if
+   * that isn't known. Loaders may decode at a lower resolution,
+   * but the result is never smaller than this. */
+  int width;
+  int height;
+};
+
+gboolean        gdk_loader_options_get_area     (const GdkLoaderOptions  *options,
+                                                 int                      image_width,
+                                                 int                      image_height,
+                                                 GdkRectangle            *area,
+                                                 GError                 **error);
+int             gdk_loader_options_get_scale    (const GdkLoaderOptions  *options,
+                                                 const GdkRectangle      *area);
+
+GdkTexture *    gdk_loader_crop_texture         (GdkTexture              *texture,
+                                                 const GdkRectangle      *area);
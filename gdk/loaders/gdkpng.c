@@ -22,10 +22,12 @@
 #include <glib/gi18n-lib.h>
 #include "gdkmemoryformatprivate.h"
 #include "gdkmemorytexture.h"
+#include "gdkparalleltaskprivate.h"
 #include "gdkprofilerprivate.h"
 #include "gdktexturedownloaderprivate.h"
 #include "gsk/gl/fp16private.h"
 #include <png.h>
+#include <zlib.h>
 #include <stdio.h>
 
 /* The main difference between the png load/save code here and
@@ -126,12 +128,291 @@ png_simple_warning_callback (png_structp     png,
 {
 }
 
+/* }}} */
+/* {{{ Fast encoding */
+
+/* The fast mode does its own filtering and compression, so that the
+ * image can be split into stripes that are compressed in parallel.
+ *
+ * Every stripe is a raw deflate stream of its own. All but the last
+ * one end with a sync flush, which leaves them on a byte boundary
+ * without marking the last block as final, so they can just be
+ * concatenated. That costs a bit of compression, because matches
+ * can't reach back into the previous stripe.
+ */
+
+/* Don't bother with threads for less image data than this per stripe */
+#define PNG_STRIPE_MIN_SIZE (512 * 1024)
+
+typedef struct
+{
+  guchar *data;
+  gsize size;
+  uLong adler;
+  gsize n_bytes;
+  gboolean failed;
+} PngStripe;
+
+typedef struct
+{
+  const guchar *data;
+  gsize stride;
+  gsize row_size;
+  gsize bpp;
+  gboolean swap;
+  gsize height;
+  gsize rows_per_stripe;
+  guint n_stripes;
+  PngStripe *stripes;
+} PngEncode;
+
+/* Writes the row with a filter type byte in front, using the Sub
+ * filter for all rows. Trying all filters for every row is what
+ * makes libpng slow, and Sub does well for most images. */
+static void
+png_filter_row (guchar       *dest,
+                const guchar *src,
+                gsize         row_size,
+                gsize         bpp,
+                gboolean      swap)
+{
+  gsize i;
+
+  *dest++ = PNG_FILTER_VALUE_SUB;
+
+  if (swap)
+    {
+      /* 16bit values in PNG are big endian */
+      for (i = 0; i < row_size; i += 2)
+        {
+          dest[i] = src[i + 1];
+          dest[i + 1] = src[i];
+        }
+    }
+  else
+    memcpy (dest, src, row_size);
+
+  for (i = row_size; i-- > bpp; )
+    dest[i] -= dest[i - bpp];
+}
+
+static void
+png_encode_stripe (guint    stripe_index,
+                   gpointer user_data)
+{
+  PngEncode *encode = user_data;
+  PngStripe *stripe = &encode->stripes[stripe_index];
+  gsize y, y_start, y_end, capacity;
+  guchar *row;
+  z_stream zs = { 0, };
+  int flush;
+
+  y_start = stripe_index * encode->rows_per_stripe;
+  y_end = MIN (y_start + encode->rows_per_stripe, encode->height);
+
+  if (deflateInit2 (&zs, 1, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+      stripe->failed = TRUE;
+      return;
+    }
+
+  row = g_malloc (encode->row_size + 1);
+  stripe->adler = adler32 (0, NULL, 0);
+  /* Room for the sync flush marker */
+  capacity = deflateBound (&zs, (encode->row_size + 1) * (y_end - y_start)) + 16;
+  stripe->data = g_malloc (capacity);
+  zs.next_out = stripe->data;
+  zs.avail_out = capacity;
+
+  for (y = y_start; y < y_end; y++)
+    {
+      png_filter_row (row, encode->data + y * encode->stride, encode->row_size, encode->bpp, encode->swap);
+      stripe->adler = adler32 (stripe->adler, row, encode->row_size + 1);
+
+      if (y + 1 < y_end)
+        flush = Z_NO_FLUSH;
+      else if (stripe_index + 1 < encode->n_stripes)
+        flush = Z_SYNC_FLUSH;
+      else
+        flush = Z_FINISH;
+
+      zs.next_in = row;
+      zs.avail_in = encode->row_size + 1;
+
+      while (TRUE)
+        {
+          int status = deflate (&zs, flush);
+
+          if (status == Z_STREAM_ERROR)
+            {
+              stripe->failed = TRUE;
+              goto out;
+            }
+
+          if (zs.avail_in == 0 && zs.avail_out > 0 && (flush != Z_FINISH || status == Z_STREAM_END))
+            break;
+
+          if (zs.avail_out == 0)
+            {
+              /* Can't happen with deflateBound(), but let's be safe */
+              gsize used = zs.next_out - stripe->data;
+
+              capacity *= 2;
+              stripe->data = g_realloc (stripe->data, capacity);
+              zs.next_out = stripe->data + used;
+              zs.avail_out = capacity - used;
+            }
+        }
+    }
+
+  stripe->size = zs.next_out - stripe->data;
+  stripe->n_bytes = (encode->row_size + 1) * (y_end - y_start);
+
+out:
+  deflateEnd (&zs);
+  g_free (row);
+}
+
+static PngStripe *
+png_encode_fast (const guchar *data,
+                 gsize         stride,
+                 gsize         width,
+                 gsize         height,
+                 gsize         bpp,
+                 gboolean      swap,
+                 guint        *n_stripes)
+{
+  PngEncode encode;
+  gsize n;
+
+  encode.data = data;
+  encode.stride = stride;
+  encode.row_size = width * bpp;
+  encode.bpp = bpp;
+  encode.swap = swap;
+  encode.height = height;
+
+  n = MIN (gdk_parallel_task_get_n_threads (), encode.row_size * height / PNG_STRIPE_MIN_SIZE);
+  /* zlib counts in 32bit, keep stripes well below that */
+  n = MAX (n, encode.row_size * height / G_MAXINT32 + 1);
+  n = MIN (n, height);
+  encode.rows_per_stripe = (height + n - 1) / n;
+  encode.n_stripes = (height + encode.rows_per_stripe - 1) / encode.rows_per_stripe;
+  encode.stripes = g_new0 (PngStripe, encode.n_stripes);
+
+  gdk_parallel_task_run (png_encode_stripe, &encode, encode.n_stripes);
+
+  *n_stripes = encode.n_stripes;
+  return encode.stripes;
+}
+
+static void
+png_stripes_free (PngStripe *stripes,
+                  guint      n_stripes)
+{
+  for (guint i = 0; i < n_stripes; i++)
+    g_free (stripes[i].data);
+  g_free (stripes);
+}
+
+/* Wraps the stripes into a zlib stream and writes it as one IDAT chunk */
+static void
+png_write_stripes (png_struct *png,
+                   PngStripe  *stripes,
+                   guint       n_stripes)
+{
+  /* deflate, 32K window, fastest compression */
+  const guchar header[2] = { 0x78, 0x01 };
+  guchar trailer[4];
+  uLong adler;
+  gsize size;
+  guint i;
+
+  size = sizeof (header) + sizeof (trailer);
+  adler = stripes[0].adler;
+  for (i = 0; i < n_stripes; i++)
+    {
+      if (stripes[i].failed)
+        png_error (png, "Compression failed");
+      size += stripes[i].size;
+      if (i > 0)
+        adler = adler32_combine (adler, stripes[i].adler, stripes[i].n_bytes);
+    }
+
+  if (size > PNG_UINT_31_MAX)
+    png_error (png, "Image too large");
+
+  trailer[0] = adler >> 24;
+  trailer[1] = adler >> 16;
+  trailer[2] = adler >> 8;
+  trailer[3] = adler;
+
+  png_write_chunk_start (png, (png_const_bytep) "IDAT", size);
+  png_write_chunk_data (png, header, sizeof (header));
+  for (i = 0; i < n_stripes; i++)
+    png_write_chunk_data (png, stripes[i].data, stripes[i].size);
+  png_write_chunk_data (png, trailer, sizeof (trailer));
+  png_write_chunk_end (png);
+}
+
 /* }}} */
 /* {{{ Public API */ 
 
+/* Reads the rows of the area one by one, and only keeps every
+ * scale'th pixel of every scale'th row. This saves the memory
+ * for the full image, and stops decoding after the last row. */
+static void
+png_read_area (png_struct         *png,
+               const GdkRectangle *area,
+               int                 scale,
+               gsize               bpp,
+               guchar             *row,
+               guchar             *buffer,
+               gsize               stride)
+{
+  int out_width, out_height, x, y, src_x, src_y;
+
+  out_width = (area->width + scale - 1) / scale;
+  out_height = (area->height + scale - 1) / scale;
+
+  src_y = area->y + MIN (scale / 2, area->height - 1);
+  for (y = 0; y < area->y + area->height; y++)
+    {
+      png_read_row (png, row, NULL);
+      if (y != src_y)
+        continue;
+
+      if (scale == 1)
+        {
+          memcpy (buffer, row + area->x * bpp, out_width * bpp);
+        }
+      else
+        {
+          for (x = 0; x < out_width; x++)
+            {
+              src_x = area->x + MIN (x * scale + scale / 2, area->width - 1);
+              memcpy (buffer + x * bpp, row + src_x * bpp, bpp);
+            }
+        }
+
+      buffer += stride;
+      if (--out_height == 0)
+        break;
+      src_y = MIN (src_y + scale, area->y + area->height - 1);
+    }
+}
+
 GdkTexture *
 gdk_load_png (GBytes  *bytes,
               GError **error)
+{
+  return gdk_load_png_with_options (bytes, NULL, error);
+}
+
+GdkTexture *
+gdk_load_png_with_options (GBytes                  *bytes,
+                           const GdkLoaderOptions  *options,
+                           GError                 **error)
 {
   png_io io;
   png_struct *png = NULL;
@@ -143,9 +424,12 @@ gdk_load_png (GBytes  *bytes,
   GdkMemoryFormat format;
   guchar *buffer = NULL;
   guchar **row_pointers = NULL;
+  guchar *row = NULL;
   GBytes *out_bytes;
   GdkTexture *texture;
-  int bpp;
+  GdkRectangle area;
+  guint out_width, out_height;
+  int bpp, scale;
   G_GNUC_UNUSED gint64 before = GDK_PROFILER_CURRENT_TIME;
 
   io.data = (guchar *)g_bytes_get_data (bytes, &io.size);
@@ -171,6 +455,7 @@ gdk_load_png (GBytes  *bytes,
     {
       g_free (buffer);
       g_free (row_pointers);
+      g_free (row);
       png_destroy_read_struct (&png, &info, NULL);
       return NULL;
     }
@@ -263,8 +548,29 @@ gdk_load_png (GBytes  *bytes,
       return NULL;
     }
 
+  if (!gdk_loader_options_get_area (options, width, height, &area, error))
+    {
+      png_destroy_read_struct (&png, &info, NULL);
+      return NULL;
+    }
+
+  /* Interlaced images are only complete after the last pass,
+   * so we have to decode them fully and crop afterwards */
+  if (interlace != PNG_INTERLACE_NONE)
+    {
+      scale = 1;
+      out_width = width;
+      out_height = height;
+    }
+  else
+    {
+      scale = gdk_loader_options_get_scale (options, &area);
+      out_width = (area.width + scale - 1) / scale;
+      out_height = (area.height + scale - 1) / scale;
+    }
+
   bpp = gdk_memory_format_bytes_per_pixel (format);
-  if (!g_size_checked_mul (&stride, width, bpp) ||
+  if (!g_size_checked_mul (&stride, out_width, bpp) ||
       !g_size_checked_add (&stride, stride, (8 - stride % 8) % 8))
     {
       g_set_error (error,
@@ -273,13 +579,17 @@ gdk_load_png (GBytes  *bytes,
       return NULL;
     }
 
-  buffer = g_try_malloc_n (height, stride);
-  row_pointers = g_try_malloc_n (height, sizeof (char *));
+  buffer = g_try_malloc_n (out_height, stride);
+  if (out_width == width && out_height == height)
+    row_pointers = g_try_malloc_n (height, sizeof (char *));
+  else
+    row = g_try_malloc_n (width, bpp);
 
-  if (!buffer || !row_pointers)
+  if (!buffer || (!row_pointers && !row))
     {
       g_free (buffer);
       g_free (row_pointers);
+      g_free (row);
       png_destroy_read_struct (&png, &info, NULL);
       g_set_error (error,
                    GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_TOO_LARGE,
@@ -287,19 +597,31 @@ gdk_load_png (GBytes  *bytes,
       return NULL;
     }
 
-  for (i = 0; i < height; i++)
-    row_pointers[i] = &buffer[i * stride];
+  if (row_pointers)
+    {
+      for (i = 0; i < height; i++)
+        row_pointers[i] = &buffer[i * stride];
 
-  png_read_image (png, row_pointers);
-  png_read_end (png, info);
+      png_read_image (png, row_pointers);
+      png_read_end (png, info);
+    }
+  else
+    {
+      /* We might stop before the end, so don't read it */
+      png_read_area (png, &area, scale, bpp, row, buffer, stride);
+    }
 
-  out_bytes = g_bytes_new_take (buffer, height * stride);
-  texture = gdk_memory_texture_new (width, height, format, out_bytes, stride);
+  out_bytes = g_bytes_new_take (buffer, out_height * stride);
+  texture = gdk_memory_texture_new (out_width, out_height, format, out_bytes, stride);
   g_bytes_unref (out_bytes);
 
   g_free (row_pointers);
+  g_free (row);
   png_destroy_read_struct (&png, &info, NULL);
 
+  if (interlace != PNG_INTERLACE_NONE)
+    texture = gdk_loader_crop_texture (texture, &area);
+
   if (GDK_PROFILER_IS_RUNNING)
     {
       gint64 end = GDK_PROFILER_CURRENT_TIME;
@@ -312,6 +634,25 @@ gdk_load_png (GBytes  *bytes,
 
 GBytes *
 gdk_save_png (GdkTexture *texture)
+{
+  return gdk_save_png_with_compression (texture, GDK_PNG_COMPRESSION_DEFAULT);
+}
+
+/*<private>
+ * gdk_save_png_with_compression:
+ * @texture: the texture to save
+ * @compression: how hard to try to make the result small
+ *
+ * Encodes @texture as PNG.
+ *
+ * With %GDK_PNG_COMPRESSION_FAST, large images are compressed
+ * in parallel. The result is larger, but it is a lot faster.
+ *
+ * Returns: (nullable): the PNG data
+ */
+GBytes *
+gdk_save_png_with_compression (GdkTexture        *texture,
+                               GdkPngCompression  compression)
 {
   png_struct *png = NULL;
   png_info *info;
@@ -325,6 +666,8 @@ gdk_save_png (GdkTexture *texture)
   const guchar *data;
   int png_format;
   int depth;
+  PngStripe *stripes = NULL;
+  guint n_stripes = 0;
 
   width = gdk_texture_get_width (texture);
   height = gdk_texture_get_height (texture);
@@ -435,8 +778,16 @@ gdk_save_png (GdkTexture *texture)
   gdk_texture_downloader_finish (&downloader);
   data = g_bytes_get_data (bytes, NULL);
 
+  if (compression == GDK_PNG_COMPRESSION_FAST)
+    stripes = png_encode_fast (data, stride, width, height,
+                               gdk_memory_format_bytes_per_pixel (format),
+                               depth == 16 && G_BYTE_ORDER == G_LITTLE_ENDIAN,
+                               &n_stripes);
+
   if (sigsetjmp (png_jmpbuf (png), 1))
     {
+      if (stripes)
+        png_stripes_free (stripes, n_stripes);
       g_bytes_unref (bytes);
       g_free (io.data);
       png_destroy_read_struct (&png, &info, NULL);
@@ -453,22 +804,97 @@ gdk_save_png (GdkTexture *texture)
 
   png_write_info (png, info);
 
+  if (stripes)
+    {
+      png_write_stripes (png, stripes, n_stripes);
+      /* png_write_end() insists on IDATs written by libpng */
+      png_write_chunk (png, (png_const_bytep) "IEND", NULL, 0);
+    }
+  else
+    {
 #if G_BYTE_ORDER == G_LITTLE_ENDIAN
-  png_set_swap (png);
+      png_set_swap (png);
 #endif
 
-  for (y = 0; y < height; y++)
-    png_write_row (png, data + y * stride);
+      for (y = 0; y < height; y++)
+        png_write_row (png, data + y * stride);
 
-  png_write_end (png, info);
+      png_write_end (png, info);
+    }
 
   png_destroy_write_struct (&png, &info);
 
+  if (stripes)
+    png_stripes_free (stripes, n_stripes);
   g_bytes_unref (bytes);
 
   return g_bytes_new_take (io.data, io.size);
 }
 
+static void
+gdk_save_png_thread (GTask        *task,
+                     gpointer      source_object,
+                     gpointer      task_data,
+                     GCancellable *cancellable)
+{
+  GBytes *bytes;
+
+  bytes = gdk_save_png_with_compression (source_object, GPOINTER_TO_INT (task_data));
+  if (bytes)
+    g_task_return_pointer (task, bytes, (GDestroyNotify) g_bytes_unref);
+  else
+    g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             _("Failed to save the image as PNG"));
+}
+
+/*<private>
+ * gdk_save_png_async:
+ * @texture: the texture to save
+ * @compression: how hard to try to make the result small
+ * @cancellable: (nullable): optional `GCancellable` object
+ * @callback: (scope async): callback to call when the PNG is done
+ * @user_data: the data to pass to callback function
+ *
+ * Does gdk_save_png_with_compression() in a thread, including
+ * downloading and converting the texture.
+ */
+void
+gdk_save_png_async (GdkTexture          *texture,
+                    GdkPngCompression    compression,
+                    GCancellable        *cancellable,
+                    GAsyncReadyCallback  callback,
+                    gpointer             user_data)
+{
+  GTask *task;
+
+  task = g_task_new (texture, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gdk_save_png_async);
+  g_task_set_task_data (task, GINT_TO_POINTER (compression), NULL);
+  g_task_run_in_thread (task, gdk_save_png_thread);
+  g_object_unref (task);
+}
+
+/*<private>
+ * gdk_save_png_finish:
+ * @texture: the texture that was saved
+ * @result: a `GAsyncResult`
+ * @error: Return location for an error
+ *
+ * Finishes a call to gdk_save_png_async().
+ *
+ * Returns: The PNG data, or %NULL on error
+ */
+GBytes *
+gdk_save_png_finish (GdkTexture    *texture,
+                     GAsyncResult  *result,
+                     GError       **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, texture), NULL);
+  g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == gdk_save_png_async, NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
 /* }}} */
 
 /* vim:set foldmethod=marker expandtab: */
@@ -17,15 +17,35 @@
 
 #pragma once
 
+#include "gdkloaderprivate.h"
 #include "gdktexture.h"
 #include <gio/gio.h>
 
 #define PNG_SIGNATURE "\x89PNG"
 
-GdkTexture *gdk_load_png        (GBytes         *bytes,
-                                 GError        **error);
-
-GBytes     *gdk_save_png        (GdkTexture     *texture);
+GdkTexture *gdk_load_png              (GBytes                  *bytes,
+                                       GError                 **error);
+GdkTexture *gdk_load_png_with_options (GBytes                  *bytes,
+                                       const GdkLoaderOptions  *options,
+                                       GError                 **error);
+
+typedef enum {
+  GDK_PNG_COMPRESSION_DEFAULT,
+  GDK_PNG_COMPRESSION_FAST,
+} GdkPngCompression;
+
+GBytes     *gdk_save_png              (GdkTexture              *texture);
+GBytes     *gdk_save_png_with_compression
+                                      (GdkTexture              *texture,
+                                       GdkPngCompression        compression);
+void        gdk_save_png_async        (GdkTexture              *texture,
+                                       GdkPngCompression        compression,
+                                       GCancellable            *cancellable,
+                                       GAsyncReadyCallback      callback,
+                                       gpointer                 user_data);
+GBytes     *gdk_save_png_finish       (GdkTexture              *texture,
+                                       GAsyncResult            *result,
+                                       GError                 **error);
 
 static inline gboolean
 gdk_is_png (GBytes *bytes)
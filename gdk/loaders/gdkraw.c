@@ -0,0 +1,196 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdkrawprivate.h"
+
+#include <glib/gi18n-lib.h>
+#include "gdkmemoryformatprivate.h"
+#include "gdkmemorytexture.h"
+#include "gdkprofilerprivate.h"
+#include "gdktexturedownloaderprivate.h"
+
+/* The raw format is a trivial container for uncompressed pixel
+ * data in any of our memory formats. Its point is that loading it
+ * does not need to touch the pixels: the texture refers to the
+ * loaded bytes, and if those are a mapped file, the data is only
+ * read from disk when it is used.
+ *
+ * The file starts with a header of 32bit little endian values:
+ *
+ *   signature    8 bytes, RAW_SIGNATURE
+ *   format       the GdkMemoryFormat of the data
+ *   width        in pixels
+ *   height       in pixels
+ *   stride       in bytes
+ *   offset       of the pixel data from the start of the file
+ *
+ * The offset and stride must be multiples of the alignment of the
+ * format, or the data has to be copied.
+ */
+
+#define RAW_HEADER_SIZE (8 + 5 * 4)
+
+/* Leaves room for additions to the header, and it keeps the
+ * data aligned to cache lines. */
+#define RAW_DATA_OFFSET 64
+
+static guint32
+read_uint32 (const guchar *data)
+{
+  guint32 value;
+
+  memcpy (&value, data, sizeof (guint32));
+
+  return GUINT32_FROM_LE (value);
+}
+
+static void
+write_uint32 (guchar  *data,
+              guint32  value)
+{
+  value = GUINT32_TO_LE (value);
+  memcpy (data, &value, sizeof (guint32));
+}
+
+/* {{{ Public API */
+
+GdkTexture *
+gdk_load_raw (GBytes  *bytes,
+              GError **error)
+{
+  return gdk_load_raw_with_options (bytes, NULL, error);
+}
+
+GdkTexture *
+gdk_load_raw_with_options (GBytes                  *bytes,
+                           const GdkLoaderOptions  *options,
+                           GError                 **error)
+{
+  const guchar *data;
+  gsize size, bpp, needed;
+  guint32 format, width, height, stride, offset;
+  GBytes *pixels;
+  GdkTexture *texture;
+  GdkRectangle area;
+  G_GNUC_UNUSED gint64 before = GDK_PROFILER_CURRENT_TIME;
+
+  data = g_bytes_get_data (bytes, &size);
+
+  if (size < RAW_HEADER_SIZE)
+    {
+      g_set_error_literal (error,
+                           GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_CORRUPT_IMAGE,
+                           _("Raw image header is truncated"));
+      return NULL;
+    }
+
+  format = read_uint32 (data + 8);
+  width = read_uint32 (data + 12);
+  height = read_uint32 (data + 16);
+  stride = read_uint32 (data + 20);
+  offset = read_uint32 (data + 24);
+
+  if (format >= GDK_MEMORY_N_FORMATS)
+    {
+      g_set_error (error,
+                   GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_UNSUPPORTED_CONTENT,
+                   _("Unsupported memory format %u in raw image"), format);
+      return NULL;
+    }
+
+  if (width == 0 || height == 0 || width > G_MAXINT || height > G_MAXINT)
+    {
+      g_set_error (error,
+                   GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_CORRUPT_IMAGE,
+                   _("Invalid image size %ux%u in raw image"), width, height);
+      return NULL;
+    }
+
+  bpp = gdk_memory_format_bytes_per_pixel (format);
+  if (stride / bpp < width ||
+      offset < RAW_HEADER_SIZE ||
+      !g_size_checked_mul (&needed, stride, height - 1) ||
+      !g_size_checked_add (&needed, needed, width * bpp) ||
+      !g_size_checked_add (&needed, needed, offset) ||
+      needed > size)
+    {
+      g_set_error (error,
+                   GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_CORRUPT_IMAGE,
+                   _("Not enough data for image size %ux%u"), width, height);
+      return NULL;
+    }
+
+  if (!gdk_loader_options_get_area (options, width, height, &area, error))
+    return NULL;
+
+  pixels = g_bytes_new_from_bytes (bytes, offset, size - offset);
+  texture = gdk_memory_texture_new (width, height, format, pixels, stride);
+  g_bytes_unref (pixels);
+
+  /* Cropping doesn't copy, and there's no use in scaling */
+  texture = gdk_loader_crop_texture (texture, &area);
+
+  if (GDK_PROFILER_IS_RUNNING)
+    {
+      gint64 end = GDK_PROFILER_CURRENT_TIME;
+      if (end - before > 500000)
+        gdk_profiler_add_mark (before, end - before, "Load raw", NULL);
+    }
+
+  return texture;
+}
+
+GBytes *
+gdk_save_raw (GdkTexture *texture)
+{
+  GdkTextureDownloader downloader;
+  GdkMemoryFormat format;
+  gsize width, height, stride, align;
+  guchar *data;
+
+  width = gdk_texture_get_width (texture);
+  height = gdk_texture_get_height (texture);
+  format = gdk_texture_get_format (texture);
+  align = gdk_memory_format_alignment (format);
+  stride = (width * gdk_memory_format_bytes_per_pixel (format) + align - 1) & ~(align - 1);
+
+  if (stride > G_MAXUINT32 ||
+      height > (G_MAXSIZE - RAW_DATA_OFFSET) / stride)
+    return NULL;
+
+  data = g_malloc0 (RAW_DATA_OFFSET + stride * height);
+
+  memcpy (data, RAW_SIGNATURE, strlen (RAW_SIGNATURE));
+  write_uint32 (data + 8, format);
+  write_uint32 (data + 12, width);
+  write_uint32 (data + 16, height);
+  write_uint32 (data + 20, stride);
+  write_uint32 (data + 24, RAW_DATA_OFFSET);
+
+  gdk_texture_downloader_init (&downloader, texture);
+  gdk_texture_downloader_set_format (&downloader, format);
+  gdk_texture_downloader_download_into (&downloader, data + RAW_DATA_OFFSET, stride);
+  gdk_texture_downloader_finish (&downloader);
+
+  return g_bytes_new_take (data, RAW_DATA_OFFSET + stride * height);
+}
+
+/* }}} */
+
+/* vim:set foldmethod=marker expandtab: */
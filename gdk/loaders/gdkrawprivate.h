@@ -0,0 +1,44 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "gdkloaderprivate.h"
+#include "gdktexture.h"
+#include <gio/gio.h>
+
+#define RAW_SIGNATURE "\x89GDKRAW\n"
+
+GdkTexture *gdk_load_raw              (GBytes                  *bytes,
+                                       GError                 **error);
+GdkTexture *gdk_load_raw_with_options (GBytes                  *bytes,
+                                       const GdkLoaderOptions  *options,
+                                       GError                 **error);
+
+GBytes     *gdk_save_raw              (GdkTexture              *texture);
+
+static inline gboolean
+gdk_is_raw (GBytes *bytes)
+{
+  const char *data;
+  gsize size;
+
+  data = g_bytes_get_data (bytes, &size);
+
+  return size > strlen (RAW_SIGNATURE) &&
+         memcmp (data, RAW_SIGNATURE, strlen (RAW_SIGNATURE)) == 0;
+}
@@ -375,6 +375,14 @@ load_fallback (TIFF    *tif,
 GdkTexture *
 gdk_load_tiff (GBytes  *input_bytes,
                GError **error)
+{
+  return gdk_load_tiff_with_options (input_bytes, NULL, error);
+}
+
+GdkTexture *
+gdk_load_tiff_with_options (GBytes                  *input_bytes,
+                            const GdkLoaderOptions  *options,
+                            GError                 **error)
 {
   TIFF *tif;
   guint16 samples_per_pixel;
@@ -386,11 +394,12 @@ gdk_load_tiff (GBytes  *input_bytes,
   guint32 width, height;
   guint16 alpha_samples;
   GdkMemoryFormat format;
-  guchar *data, *line;
+  guchar *data, *line, *scanline;
   gsize stride;
   int bpp;
   GBytes *bytes;
   GdkTexture *texture;
+  GdkRectangle area;
   G_GNUC_UNUSED gint64 before = GDK_PROFILER_CURRENT_TIME;
 
   tif = tiff_open_read (input_bytes);
@@ -413,6 +422,12 @@ gdk_load_tiff (GBytes  *input_bytes,
   TIFFGetFieldDefaulted (tif, TIFFTAG_IMAGEWIDTH, &width);
   TIFFGetFieldDefaulted (tif, TIFFTAG_IMAGELENGTH, &height);
 
+  if (!gdk_loader_options_get_area (options, width, height, &area, error))
+    {
+      TIFFClose (tif);
+      return NULL;
+    }
+
   if (samples_per_pixel == 2 || samples_per_pixel == 4)
     {
       guint16 extra;
@@ -427,7 +442,7 @@ gdk_load_tiff (GBytes  *input_bytes,
         {
           texture = load_fallback (tif, error);
           TIFFClose (tif);
-          return texture;
+          return gdk_loader_crop_texture (texture, &area);
         }
     }
   else
@@ -457,26 +472,37 @@ gdk_load_tiff (GBytes  *input_bytes,
     {
       texture = load_fallback (tif, error);
       TIFFClose (tif);
-      return texture;
+      return gdk_loader_crop_texture (texture, &area);
     }
 
-  stride = width * gdk_memory_format_bytes_per_pixel (format);
+  bpp = gdk_memory_format_bytes_per_pixel (format);
+  stride = area.width * bpp;
 
-  g_assert (TIFFScanlineSize (tif) == stride);
+  g_assert (TIFFScanlineSize (tif) == width * bpp);
 
-  data = g_try_malloc_n (height, stride);
-  if (!data)
+  data = g_try_malloc_n (area.height, stride);
+  /* Rows outside of the area need to be decoded, too */
+  scanline = g_try_malloc_n (width, bpp);
+
+  if (!data || !scanline)
     {
       g_set_error (error,
                    GDK_TEXTURE_ERROR, GDK_TEXTURE_ERROR_TOO_LARGE,
                    _("Not enough memory for image size %ux%u"), width, height);
       TIFFClose (tif);
+      g_free (data);
+      g_free (scanline);
       return NULL;
     }
 
-  line = data;
-  for (int y = 0; y < height; y++)
+  /* There's no need to decode the rows after the area */
+  for (int y = 0; y < area.y + area.height; y++)
     {
+      if (area.width == width && y >= area.y)
+        line = data + (y - area.y) * stride;
+      else
+        line = scanline;
+
       if (TIFFReadScanline (tif, line, y, 0) == -1)
         {
           g_set_error (error,
@@ -484,18 +510,21 @@ gdk_load_tiff (GBytes  *input_bytes,
                        _("Reading data failed at row %d"), y);
           TIFFClose (tif);
           g_free (data);
+          g_free (scanline);
           return NULL;
         }
 
-      line += stride;
+      if (line == scanline && y >= area.y)
+        memcpy (data + (y - area.y) * stride, scanline + area.x * bpp, stride);
     }
 
-  bpp = gdk_memory_format_bytes_per_pixel (format);
-  bytes = g_bytes_new_take (data, width * height * bpp);
+  g_free (scanline);
 
-  texture = gdk_memory_texture_new (width, height,
+  bytes = g_bytes_new_take (data, area.height * stride);
+
+  texture = gdk_memory_texture_new (area.width, area.height,
                                     format,
-                                    bytes, width * bpp);
+                                    bytes, stride);
   g_bytes_unref (bytes);
 
   TIFFClose (tif);
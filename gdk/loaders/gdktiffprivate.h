@@ -17,16 +17,20 @@
 
 #pragma once
 
+#include "gdkloaderprivate.h"
 #include "gdktexture.h"
 #include <gio/gio.h>
 
 #define TIFF_SIGNATURE1 "MM\x00\x2a"
 #define TIFF_SIGNATURE2 "II\x2a\x00"
 
-GdkTexture *gdk_load_tiff         (GBytes           *bytes,
-                                   GError          **error);
+GdkTexture *gdk_load_tiff              (GBytes                  *bytes,
+                                        GError                 **error);
+GdkTexture *gdk_load_tiff_with_options (GBytes                  *bytes,
+                                        const GdkLoaderOptions  *options,
+                                        GError                 **error);
 
-GBytes *    gdk_save_tiff         (GdkTexture       *texture);
+GBytes *    gdk_save_tiff              (GdkTexture              *texture);
 
 static inline gboolean
 gdk_is_tiff (GBytes *bytes)
@@ -24,6 +24,8 @@
 #include <gio/gio.h>
 #include <string.h>
 
+#include "gdk/gdkglprogramcacheprivate.h"
+
 #include "gskglcommandqueueprivate.h"
 #include "gskglcompilerprivate.h"
 #include "gskglprogramprivate.h"
@@ -548,6 +550,8 @@ gsk_gl_compiler_compile (GskGLCompiler  *self,
   const char *gl3 = "";
   const char *gles = "";
   const char *gles3 = "";
+  GdkGLContext *context;
+  GChecksum *checksum;
   int program_id;
   int vertex_id;
   int fragment_id;
@@ -580,6 +584,40 @@ gsk_gl_compiler_compile (GskGLCompiler  *self,
   if (self->gl3)
     gl3 = "#define GSK_GL3 1\n";
 
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guchar *) name, -1);
+  g_checksum_update (checksum, (const guchar *) version, -1);
+  g_checksum_update (checksum, (const guchar *) debug, -1);
+  g_checksum_update (checksum, (const guchar *) legacy, -1);
+  g_checksum_update (checksum, (const guchar *) gl3, -1);
+  g_checksum_update (checksum, (const guchar *) gles, -1);
+  g_checksum_update (checksum, (const guchar *) gles3, -1);
+  g_checksum_update (checksum, (const guchar *) clip, -1);
+  g_checksum_update (checksum, (const guchar *) get_shader_string (self->all_preamble), -1);
+  g_checksum_update (checksum, (const guchar *) get_shader_string (self->vertex_preamble), -1);
+  g_checksum_update (checksum, (const guchar *) get_shader_string (self->vertex_source), -1);
+  g_checksum_update (checksum, (const guchar *) get_shader_string (self->vertex_suffix), -1);
+  g_checksum_update (checksum, (const guchar *) get_shader_string (self->fragment_preamble), -1);
+  g_checksum_update (checksum, (const guchar *) get_shader_string (self->fragment_source), -1);
+  g_checksum_update (checksum, (const guchar *) get_shader_string (self->fragment_suffix), -1);
+  for (guint i = 0; i < self->attrib_locations->len; i++)
+    {
+      const GskGLProgramAttrib *attrib;
+
+      attrib = &g_array_index (self->attrib_locations, GskGLProgramAttrib, i);
+      g_checksum_update (checksum, (const guchar *) attrib->name, -1);
+      g_checksum_update (checksum, (const guchar *) &attrib->location, sizeof attrib->location);
+    }
+
+  context = self->driver->command_queue->context;
+  program_id = glCreateProgram ();
+
+  if (gdk_gl_context_load_program_binary (context, g_checksum_get_string (checksum), program_id))
+    {
+      g_checksum_free (checksum);
+      return gsk_gl_program_new (self->driver, name, program_id);
+    }
+
   vertex_id = glCreateShader (GL_VERTEX_SHADER);
   glShaderSource (vertex_id,
                   11,
@@ -608,6 +646,8 @@ gsk_gl_compiler_compile (GskGLCompiler  *self,
   if (!check_shader_error (vertex_id, error))
     {
       glDeleteShader (vertex_id);
+      glDeleteProgram (program_id);
+      g_checksum_free (checksum);
       return NULL;
     }
 
@@ -642,12 +682,13 @@ gsk_gl_compiler_compile (GskGLCompiler  *self,
     {
       glDeleteShader (vertex_id);
       glDeleteShader (fragment_id);
+      glDeleteProgram (program_id);
+      g_checksum_free (checksum);
       return NULL;
     }
 
   print_shader_info ("Fragment shader", fragment_id, name);
 
-  program_id = glCreateProgram ();
   glAttachShader (program_id, vertex_id);
   glAttachShader (program_id, fragment_id);
 
@@ -695,9 +736,13 @@ gsk_gl_compiler_compile (GskGLCompiler  *self,
       g_free (buffer);
 
       glDeleteProgram (program_id);
+      g_checksum_free (checksum);
 
       return NULL;
     }
 
+  gdk_gl_context_store_program_binary (context, g_checksum_get_string (checksum), program_id);
+  g_checksum_free (checksum);
+
   return gsk_gl_program_new (self->driver, name, program_id);
 }
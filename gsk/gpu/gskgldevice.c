@@ -9,6 +9,7 @@
 
 #include "gdk/gdkdisplayprivate.h"
 #include "gdk/gdkglcontextprivate.h"
+#include "gdk/gdkglprogramcacheprivate.h"
 #include "gdk/gdkprofilerprivate.h"
 
 #include <glib/gi18n-lib.h>
@@ -365,19 +366,14 @@ print_shader_info (const char *prefix,
     }
 }
 
-static GLuint
-gsk_gl_device_load_shader (GskGLDevice      *self,
-                           const char       *program_name,
-                           GLenum            shader_type,
-                           guint32           variation,
-                           GskGpuShaderClip  clip,
-                           guint             n_external_textures,
-                           GError          **error)
+static GString *
+gsk_gl_device_create_preamble (GskGLDevice      *self,
+                               GLenum            shader_type,
+                               guint32           variation,
+                               GskGpuShaderClip  clip,
+                               guint             n_external_textures)
 {
   GString *preamble;
-  char *resource_name;
-  GBytes *bytes;
-  GLuint shader_id;
 
   preamble = g_string_new (NULL);
 
@@ -413,7 +409,7 @@ gsk_gl_device_load_shader (GskGLDevice      *self,
 
       default:
         g_assert_not_reached ();
-        return 0;
+        break;
     }
 
   g_string_append_printf (preamble, "#define GSK_VARIATION %uu\n", variation);
@@ -434,11 +430,18 @@ gsk_gl_device_load_shader (GskGLDevice      *self,
       break;
   }
 
-  resource_name = g_strconcat ("/org/gtk/libgsk/shaders/gl/", program_name, ".glsl", NULL);
-  bytes = g_resources_lookup_data (resource_name, 0, error);
-  g_free (resource_name);
-  if (bytes == NULL)
-    return 0;
+  return preamble;
+}
+
+static GLuint
+gsk_gl_device_load_shader (GskGLDevice      *self,
+                           const char       *program_name,
+                           GLenum            shader_type,
+                           const GString    *preamble,
+                           GBytes           *source,
+                           GError          **error)
+{
+  GLuint shader_id;
 
   shader_id = glCreateShader (shader_type);
 
@@ -446,12 +449,12 @@ gsk_gl_device_load_shader (GskGLDevice      *self,
                   2,
                   (const char *[]) {
                     preamble->str,
-                    g_bytes_get_data (bytes, NULL),
+                    g_bytes_get_data (source, NULL),
                   },
-                  NULL);
-
-  g_bytes_unref (bytes);
-  g_string_free (preamble, TRUE);
+                  (GLint[]) {
+                    preamble->len,
+                    g_bytes_get_size (source),
+                  });
 
   glCompileShader (shader_id);
 
@@ -475,19 +478,60 @@ gsk_gl_device_load_program (GskGLDevice               *self,
                             GError                   **error)
 {
   G_GNUC_UNUSED gint64 begin_time = GDK_PROFILER_CURRENT_TIME;
+  GdkGLContext *context;
   GLuint vertex_shader_id, fragment_shader_id, program_id;
+  GString *vertex_preamble, *fragment_preamble;
+  GChecksum *checksum;
+  char *resource_name;
+  GBytes *source;
   GLint link_status;
 
-  vertex_shader_id = gsk_gl_device_load_shader (self, op_class->shader_name, GL_VERTEX_SHADER, variation, clip, n_external_textures, error);
-  if (vertex_shader_id == 0)
+  resource_name = g_strconcat ("/org/gtk/libgsk/shaders/gl/", op_class->shader_name, ".glsl", NULL);
+  source = g_resources_lookup_data (resource_name, 0, error);
+  g_free (resource_name);
+  if (source == NULL)
     return 0;
 
-  fragment_shader_id = gsk_gl_device_load_shader (self, op_class->shader_name, GL_FRAGMENT_SHADER, variation, clip, n_external_textures, error);
-  if (fragment_shader_id == 0)
-    return 0;
+  vertex_preamble = gsk_gl_device_create_preamble (self, GL_VERTEX_SHADER, variation, clip, n_external_textures);
+  fragment_preamble = gsk_gl_device_create_preamble (self, GL_FRAGMENT_SHADER, variation, clip, n_external_textures);
+
+  /* The attribute locations are set up by the op class, so they
+   * are covered by the name and the GTK version of the cache. */
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guchar *) op_class->shader_name, -1);
+  g_checksum_update (checksum, (const guchar *) vertex_preamble->str, vertex_preamble->len);
+  g_checksum_update (checksum, (const guchar *) fragment_preamble->str, fragment_preamble->len);
+  g_checksum_update (checksum, g_bytes_get_data (source, NULL), g_bytes_get_size (source));
 
+  context = gdk_display_get_gl_context (gsk_gpu_device_get_display (GSK_GPU_DEVICE (self)));
   program_id = glCreateProgram ();
 
+  if (gdk_gl_context_load_program_binary (context, g_checksum_get_string (checksum), program_id))
+    {
+      gdk_profiler_end_markf (begin_time,
+                              "Load Program",
+                              "name=%s id=%u",
+                              op_class->shader_name, program_id);
+      goto out;
+    }
+
+  vertex_shader_id = gsk_gl_device_load_shader (self, op_class->shader_name, GL_VERTEX_SHADER, vertex_preamble, source, error);
+  if (vertex_shader_id == 0)
+    {
+      glDeleteProgram (program_id);
+      program_id = 0;
+      goto out;
+    }
+
+  fragment_shader_id = gsk_gl_device_load_shader (self, op_class->shader_name, GL_FRAGMENT_SHADER, fragment_preamble, source, error);
+  if (fragment_shader_id == 0)
+    {
+      glDeleteShader (vertex_shader_id);
+      glDeleteProgram (program_id);
+      program_id = 0;
+      goto out;
+    }
+
   glAttachShader (program_id, vertex_shader_id);
   glAttachShader (program_id, fragment_shader_id);
 
@@ -525,15 +569,23 @@ gsk_gl_device_load_program (GskGLDevice               *self,
       g_free (buffer);
 
       glDeleteProgram (program_id);
-
-      return 0;
+      program_id = 0;
+      goto out;
     }
 
+  gdk_gl_context_store_program_binary (context, g_checksum_get_string (checksum), program_id);
+
   gdk_profiler_end_markf (begin_time,
                           "Compile Program",
                           "name=%s id=%u frag=%u vert=%u",
                           op_class->shader_name, program_id, fragment_shader_id, vertex_shader_id);
 
+out:
+  g_checksum_free (checksum);
+  g_string_free (fragment_preamble, TRUE);
+  g_string_free (vertex_preamble, TRUE);
+  g_bytes_unref (source);
+
   return program_id;
 }
 
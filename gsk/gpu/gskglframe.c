@@ -23,6 +23,9 @@ struct _GskGLFrame
   GLsync sync;
 
   GHashTable *vaos;
+
+  gboolean has_timer_queries;
+  GArray *timestamp_queries;
 };
 
 struct _GskGLFrameClass
@@ -60,6 +63,53 @@ gsk_gl_frame_setup (GskGpuFrame *frame)
   GskGLFrame *self = GSK_GL_FRAME (frame);
 
   glGenBuffers (1, &self->globals_buffer_id);
+
+  self->has_timer_queries = epoxy_is_desktop_gl () &&
+                            (epoxy_gl_version () >= 33 || epoxy_has_gl_extension ("GL_ARB_timer_query"));
+}
+
+static void
+gsk_gl_frame_read_timestamps (GskGLFrame *self)
+{
+  guint i, n_timestamps;
+  guint64 *timestamps;
+
+  n_timestamps = gsk_gpu_frame_get_n_timestamps (GSK_GPU_FRAME (self));
+  if (n_timestamps == 0)
+    return;
+
+  timestamps = g_new (guint64, n_timestamps);
+  for (i = 0; i < n_timestamps; i++)
+    {
+      glGetQueryObjectui64v (g_array_index (self->timestamp_queries, GLuint, i),
+                             GL_QUERY_RESULT,
+                             &timestamps[i]);
+    }
+
+  gsk_gpu_frame_report_timestamps (GSK_GPU_FRAME (self), timestamps);
+
+  g_free (timestamps);
+}
+
+/* Writes a timestamp query before the command for @op,
+ * or after the last command if @op is NULL */
+void
+gsk_gl_frame_write_timestamp (GskGLFrame *self,
+                              GskGpuOp   *op)
+{
+  guint i;
+
+  i = gsk_gpu_frame_add_timestamp (GSK_GPU_FRAME (self), op);
+  if (i >= self->timestamp_queries->len)
+    {
+      GLuint query;
+
+      /* queries are kept around for the next frames */
+      glGenQueries (1, &query);
+      g_array_append_val (self->timestamp_queries, query);
+    }
+
+  glQueryCounter (g_array_index (self->timestamp_queries, GLuint, i), GL_TIMESTAMP);
 }
 
 static void
@@ -73,6 +123,8 @@ gsk_gl_frame_cleanup (GskGpuFrame *frame)
       g_clear_pointer (&self->sync, glDeleteSync);
     }
 
+  gsk_gl_frame_read_timestamps (self);
+
   self->next_texture_slot = 0;
 
   GSK_GPU_FRAME_CLASS (gsk_gl_frame_parent_class)->cleanup (frame);
@@ -172,6 +224,10 @@ gsk_gl_frame_submit (GskGpuFrame  *frame,
 {
   GskGLFrame *self = GSK_GL_FRAME (frame);
   GskGLCommandState state = { 0, };
+  gboolean measure;
+
+  measure = self->has_timer_queries && gsk_gpu_frame_should_measure (frame);
+  state.measure = measure;
 
   glEnable (GL_SCISSOR_TEST);
 
@@ -189,9 +245,15 @@ gsk_gl_frame_submit (GskGpuFrame  *frame,
 
   while (op)
     {
+      if (measure)
+        gsk_gl_frame_write_timestamp (self, op);
+
       op = gsk_gpu_op_gl_command (op, frame, &state);
     }
 
+  if (measure)
+    gsk_gl_frame_write_timestamp (self, NULL);
+
   if (gdk_gl_context_has_feature (GDK_GL_CONTEXT (gsk_gpu_frame_get_context (frame)),
                                   GDK_GL_FEATURE_SYNC))
     self->sync = glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
@@ -204,6 +266,9 @@ gsk_gl_frame_finalize (GObject *object)
 
   g_hash_table_unref (self->vaos);
   glDeleteBuffers (1, &self->globals_buffer_id);
+  if (self->timestamp_queries->len > 0)
+    glDeleteQueries (self->timestamp_queries->len, (GLuint *) self->timestamp_queries->data);
+  g_array_unref (self->timestamp_queries);
 
   G_OBJECT_CLASS (gsk_gl_frame_parent_class)->finalize (object);
 }
@@ -237,6 +302,7 @@ static void
 gsk_gl_frame_init (GskGLFrame *self)
 {
   self->vaos = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, free_vao);
+  self->timestamp_queries = g_array_new (FALSE, FALSE, sizeof (GLuint));
 }
 
 void
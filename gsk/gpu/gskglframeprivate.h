@@ -15,5 +15,7 @@ void                    gsk_gl_frame_use_program                        (GskGLFr
                                                                          guint                   n_external_textures);
 
 void                    gsk_gl_frame_bind_globals                       (GskGLFrame             *self);
+void                    gsk_gl_frame_write_timestamp                    (GskGLFrame             *self,
+                                                                         GskGpuOp               *op);
 
 G_END_DECLS
@@ -31,6 +31,7 @@ gsk_gpu_blend_mode_op_print_instance (GskGpuShaderOp *shader,
 
 static const GskGpuShaderOpClass GSK_GPU_BLEND_MODE_OP_CLASS = {
   {
+    "blendmode",
     GSK_GPU_OP_SIZE (GskGpuBlendModeOp),
     GSK_GPU_STAGE_SHADER,
     gsk_gpu_shader_op_finish,
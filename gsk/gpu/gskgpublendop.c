@@ -87,6 +87,7 @@ gsk_gpu_blend_op_gl_command (GskGpuOp          *op,
 }
 
 static const GskGpuOpClass GSK_GPU_BLEND_OP_CLASS = {
+  "blend",
   GSK_GPU_OP_SIZE (GskGpuBlendOp),
   GSK_GPU_STAGE_COMMAND,
   gsk_gpu_blend_op_finish,
@@ -94,7 +95,8 @@ static const GskGpuOpClass GSK_GPU_BLEND_OP_CLASS = {
 #ifdef GDK_RENDERING_VULKAN
   gsk_gpu_blend_op_vk_command,
 #endif
-  gsk_gpu_blend_op_gl_command
+  gsk_gpu_blend_op_gl_command,
+  TRUE
 };
 
 void
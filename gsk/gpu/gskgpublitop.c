@@ -187,6 +187,7 @@ gsk_gpu_blit_op_gl_command (GskGpuOp          *op,
 }
 
 static const GskGpuOpClass GSK_GPU_BLIT_OP_CLASS = {
+  "blit",
   GSK_GPU_OP_SIZE (GskGpuBlitOp),
   GSK_GPU_STAGE_PASS,
   gsk_gpu_blit_op_finish,
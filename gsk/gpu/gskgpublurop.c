@@ -33,6 +33,7 @@ gsk_gpu_blur_op_print_instance (GskGpuShaderOp *shader,
 
 static const GskGpuShaderOpClass GSK_GPU_BLUR_OP_CLASS = {
   {
+    "blur",
     GSK_GPU_OP_SIZE (GskGpuBlurOp),
     GSK_GPU_STAGE_SHADER,
     gsk_gpu_shader_op_finish,
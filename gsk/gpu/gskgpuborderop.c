@@ -74,6 +74,7 @@ gsk_gpu_border_op_gl_command (GskGpuOp          *op,
 
 static const GskGpuShaderOpClass GSK_GPU_BORDER_OP_CLASS = {
   {
+    "border",
     GSK_GPU_OP_SIZE (GskGpuBorderOp),
     GSK_GPU_STAGE_SHADER,
     gsk_gpu_shader_op_finish,
@@ -53,6 +53,7 @@ gsk_gpu_box_shadow_op_gl_command (GskGpuOp          *op,
 
 static const GskGpuShaderOpClass GSK_GPU_BOX_SHADOW_OP_CLASS = {
   {
+    "boxshadow",
     GSK_GPU_OP_SIZE (GskGpuBoxShadowOp),
     GSK_GPU_STAGE_SHADER,
     gsk_gpu_shader_op_finish,
@@ -101,6 +101,7 @@ gsk_gpu_clear_op_gl_command (GskGpuOp          *op,
 }
 
 static const GskGpuOpClass GSK_GPU_CLEAR_OP_CLASS = {
+  "clear",
   GSK_GPU_OP_SIZE (GskGpuClearOp),
   GSK_GPU_STAGE_COMMAND,
   gsk_gpu_clear_op_finish,
@@ -108,7 +109,8 @@ static const GskGpuOpClass GSK_GPU_CLEAR_OP_CLASS = {
 #ifdef GDK_RENDERING_VULKAN
   gsk_gpu_clear_op_vk_command,
 #endif
-  gsk_gpu_clear_op_gl_command
+  gsk_gpu_clear_op_gl_command,
+  TRUE
 };
 
 void
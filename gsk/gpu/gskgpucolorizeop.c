@@ -29,6 +29,7 @@ gsk_gpu_colorize_op_print_instance (GskGpuShaderOp *shader,
 
 static const GskGpuShaderOpClass GSK_GPU_COLORIZE_OP_CLASS = {
   {
+    "colorize",
     GSK_GPU_OP_SIZE (GskGpuColorizeOp),
     GSK_GPU_STAGE_SHADER,
     gsk_gpu_shader_op_finish,
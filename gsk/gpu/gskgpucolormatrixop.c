@@ -28,6 +28,7 @@ gsk_gpu_color_matrix_op_print_instance (GskGpuShaderOp *shader,
 
 static const GskGpuShaderOpClass GSK_GPU_COLOR_MATRIX_OP_CLASS = {
   {
+    "colormatrix",
     GSK_GPU_OP_SIZE (GskGpuColorMatrixOp),
     GSK_GPU_STAGE_SHADER,
     gsk_gpu_shader_op_finish,
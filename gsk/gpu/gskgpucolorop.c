@@ -29,6 +29,7 @@ gsk_gpu_color_op_print_instance (GskGpuShaderOp *shader,
 
 static const GskGpuShaderOpClass GSK_GPU_COLOR_OP_CLASS = {
   {
+    "color",
     GSK_GPU_OP_SIZE (GskGpuColorOp),
     GSK_GPU_STAGE_SHADER,
     gsk_gpu_shader_op_finish,
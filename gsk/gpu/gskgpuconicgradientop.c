@@ -29,6 +29,7 @@ gsk_gpu_conic_gradient_op_print_instance (GskGpuShaderOp *shader,
 
 static const GskGpuShaderOpClass GSK_GPU_CONIC_GRADIENT_OP_CLASS = {
   {
+    "conicgradient",
     GSK_GPU_OP_SIZE (GskGpuConicGradientOp),
     GSK_GPU_STAGE_SHADER,
     gsk_gpu_shader_op_finish,
@@ -30,6 +30,7 @@ gsk_gpu_cross_fade_op_print_instance (GskGpuShaderOp *shader,
 
 static const GskGpuShaderOpClass GSK_GPU_CROSS_FADE_OP_CLASS = {
   {
+    "crossfade",
     GSK_GPU_OP_SIZE (GskGpuCrossFadeOp),
     GSK_GPU_STAGE_SHADER,
     gsk_gpu_shader_op_finish,
@@ -2,8 +2,10 @@
 
 #include "gskgpudeviceprivate.h"
 
+#include "gskgpublitopprivate.h"
 #include "gskgpuframeprivate.h"
 #include "gskgpuimageprivate.h"
+#include "gskgputessellationprivate.h"
 #include "gskgpuuploadopprivate.h"
 
 #include "gdk/gdkdisplayprivate.h"
@@ -12,6 +14,9 @@
 
 #include "gsk/gskdebugprivate.h"
 #include "gsk/gskprivate.h"
+#include "gsk/gskrendernodeprivate.h"
+
+#include <math.h>
 
 #define MAX_SLICES_PER_ATLAS 64
 
@@ -21,15 +26,41 @@
 
 #define MAX_DEAD_PIXELS (ATLAS_SIZE * ATLAS_SIZE / 2)
 
+/* When a new atlas would exceed this, the least recently used atlas
+ * is compacted into the new one instead of being kept around.
+ */
+#define MAX_ATLAS_PIXELS (4 * ATLAS_SIZE * ATLAS_SIZE)
+
+/* How much of a fresh atlas compaction may fill with old glyphs */
+#define MAX_COMPACTED_PIXELS (ATLAS_SIZE * ATLAS_SIZE * 3 / 4)
+
+/* Glyphs in atlases have a 1 pixel border */
+#define ATLAS_GLYPH_PADDING 1
+
 #define CACHE_TIMEOUT 15  /* seconds */
 
+#define MAX_NODE_IMAGE_PIXELS (8 * 1024 * 1024)
+
+#define MAX_NODE_IMAGE_ITEM_PIXELS (MAX_NODE_IMAGE_PIXELS / 4)
+
+#define MAX_RECORDING_BYTES (4 * 1024 * 1024)
+
+#define MAX_RECORDING_ITEM_BYTES (MAX_RECORDING_BYTES / 16)
+
+/* What we account for entries that don't hold a recording */
+#define RECORDING_ENTRY_BYTES 128
+
 G_STATIC_ASSERT (MAX_ATLAS_ITEM_SIZE < ATLAS_SIZE);
 G_STATIC_ASSERT (MAX_DEAD_PIXELS < ATLAS_SIZE * ATLAS_SIZE);
+G_STATIC_ASSERT (MAX_ATLAS_PIXELS >= 2 * ATLAS_SIZE * ATLAS_SIZE);
 
 typedef struct _GskGpuCached GskGpuCached;
 typedef struct _GskGpuCachedClass GskGpuCachedClass;
 typedef struct _GskGpuCachedAtlas GskGpuCachedAtlas;
 typedef struct _GskGpuCachedGlyph GskGpuCachedGlyph;
+typedef struct _GskGpuCachedNodeImage GskGpuCachedNodeImage;
+typedef struct _GskGpuCachedRecording GskGpuCachedRecording;
+typedef struct _GskGpuCachedTessellation GskGpuCachedTessellation;
 typedef struct _GskGpuCachedTexture GskGpuCachedTexture;
 typedef struct _GskGpuDevicePrivate GskGpuDevicePrivate;
 
@@ -38,6 +69,13 @@ struct _GskGpuDevicePrivate
   GdkDisplay *display;
   gsize max_image_size;
 
+  /* Protects the caches and image creation while recording in parallel */
+  GRecMutex lock;
+  gint64 parallel_timestamp;
+  /* Images created while recording in parallel. Only the thread
+   * that created them knows about them. */
+  GHashTable *parallel_images;
+
   GskGpuCached *first_cached;
   GskGpuCached *last_cached;
   guint cache_gc_source;
@@ -45,14 +83,28 @@ struct _GskGpuDevicePrivate
 
   GHashTable *texture_cache;
   GHashTable *glyph_cache;
+  GHashTable *node_image_cache;
+  gsize node_image_pixels;
+  GHashTable *recording_cache;
+  gsize recording_bytes;
+  GHashTable *tessellation_cache;
 
   GskGpuCachedAtlas *current_atlas;
 
+  /* glyph lookups, and their numbers when they were last reported */
+  guint glyph_hits;
+  guint glyph_misses;
+  guint reported_glyph_hits;
+  guint reported_glyph_misses;
+
   /* atomic */ gsize dead_texture_pixels;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GskGpuDevice, gsk_gpu_device, G_TYPE_OBJECT)
 
+static guint profiler_glyph_hit_rate_id;
+static guint profiler_atlas_fill_id;
+
 /* {{{ Cached base class */
 
 struct _GskGpuCachedClass
@@ -76,7 +128,7 @@ struct _GskGpuCached
 
   gint64 timestamp;
   gboolean stale;
-  guint pixels;   /* For glyphs and textures, pixels. For atlases, dead pixels */
+  guint pixels;   /* For glyphs, textures and node images, pixels. For atlases, dead pixels */
 };
 
 static inline void
@@ -157,6 +209,31 @@ gsk_gpu_cached_use (GskGpuDevice *device,
   mark_as_stale (cached, FALSE);
 }
 
+/* Items, including glyphs in an atlas, are moved to the end of the
+ * list when they are used. That way those items are ordered by last
+ * use and the first ones are the ones to evict.
+ */
+static void
+gsk_gpu_cached_move_to_end (GskGpuDevice *device,
+                            GskGpuCached *cached)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (device);
+
+  if (priv->last_cached == cached)
+    return;
+
+  if (cached->prev)
+    cached->prev->next = cached->next;
+  else
+    priv->first_cached = cached->next;
+  cached->next->prev = cached->prev;
+
+  cached->prev = priv->last_cached;
+  cached->next = NULL;
+  priv->last_cached->next = cached;
+  priv->last_cached = cached;
+}
+
 static inline gboolean
 gsk_gpu_cached_is_old (GskGpuDevice *device,
                        GskGpuCached *cached,
@@ -179,6 +256,8 @@ struct _GskGpuCachedAtlas
 
   GskGpuImage *image;
 
+  gsize used_pixels;  /* allocated, dead or alive */
+
   gsize n_slices;
   struct {
     gsize width;
@@ -249,6 +328,7 @@ struct _GskGpuCachedTexture
                                */
 
   gsize *dead_pixels_counter;
+  gint64 created;
 
   GdkTexture *texture;
   GskGpuImage *image;
@@ -434,6 +514,255 @@ static const GskGpuCachedClass GSK_GPU_CACHED_GLYPH_CLASS =
   gsk_gpu_cached_glyph_should_collect
 };
 
+/* }}} */
+/* {{{ CachedNodeImage */
+
+struct _GskGpuCachedNodeImage
+{
+  GskGpuCached parent;
+
+  GskRenderNode *node;
+  float scale_x;
+  float scale_y;
+  gint64 created;
+
+  GskGpuImage *image;
+  graphene_rect_t bounds;
+};
+
+static void
+gsk_gpu_cached_node_image_free (GskGpuDevice *device,
+                                GskGpuCached *cached)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (device);
+  GskGpuCachedNodeImage *self = (GskGpuCachedNodeImage *) cached;
+
+  g_hash_table_remove (priv->node_image_cache, self);
+  priv->node_image_pixels -= cached->pixels;
+
+  gsk_render_node_unref (self->node);
+  g_object_unref (self->image);
+
+  g_free (self);
+}
+
+static gboolean
+gsk_gpu_cached_node_image_should_collect (GskGpuDevice *device,
+                                          GskGpuCached *cached,
+                                          gint64        timestamp)
+{
+  return gsk_gpu_cached_is_old (device, cached, timestamp);
+}
+
+static guint
+gsk_gpu_cached_node_image_hash (gconstpointer data)
+{
+  const GskGpuCachedNodeImage *self = data;
+
+  return g_direct_hash (self->node) ^
+         ((guint) (self->scale_x * 64) << 16) ^
+         (guint) (self->scale_y * 64);
+}
+
+static gboolean
+gsk_gpu_cached_node_image_equal (gconstpointer v1,
+                                 gconstpointer v2)
+{
+  const GskGpuCachedNodeImage *image1 = v1;
+  const GskGpuCachedNodeImage *image2 = v2;
+
+  return image1->node == image2->node
+      && image1->scale_x == image2->scale_x
+      && image1->scale_y == image2->scale_y;
+}
+
+static const GskGpuCachedClass GSK_GPU_CACHED_NODE_IMAGE_CLASS =
+{
+  sizeof (GskGpuCachedNodeImage),
+  gsk_gpu_cached_node_image_free,
+  gsk_gpu_cached_node_image_should_collect
+};
+
+static void
+gsk_gpu_device_shrink_node_image_cache (GskGpuDevice *self,
+                                        gsize         needed)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+  GskGpuCached *cached, *next;
+
+  for (cached = priv->first_cached;
+       cached != NULL && priv->node_image_pixels + needed > MAX_NODE_IMAGE_PIXELS;
+       cached = next)
+    {
+      next = cached->next;
+      if (cached->class == &GSK_GPU_CACHED_NODE_IMAGE_CLASS)
+        gsk_gpu_cached_free (self, cached);
+    }
+}
+
+/* }}} */
+/* {{{ CachedRecording */
+
+struct _GskGpuCachedRecording
+{
+  GskGpuCached parent;
+
+  GskRenderNode *node;  /* only a ref when we hold a recording */
+  guchar *key;
+  gsize key_size;
+
+  GskGpuRecordingState state;
+  GskGpuRecording *recording;
+  gsize size;
+};
+
+static void
+gsk_gpu_cached_recording_free (GskGpuDevice *device,
+                               GskGpuCached *cached)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (device);
+  GskGpuCachedRecording *self = (GskGpuCachedRecording *) cached;
+
+  g_hash_table_remove (priv->recording_cache, self);
+  priv->recording_bytes -= self->size;
+
+  if (self->recording)
+    {
+      gsk_gpu_recording_unref (self->recording);
+      gsk_render_node_unref (self->node);
+    }
+  g_free (self->key);
+
+  g_free (self);
+}
+
+static gboolean
+gsk_gpu_cached_recording_should_collect (GskGpuDevice *device,
+                                         GskGpuCached *cached,
+                                         gint64        timestamp)
+{
+  return gsk_gpu_cached_is_old (device, cached, timestamp);
+}
+
+static guint
+gsk_gpu_cached_recording_hash (gconstpointer data)
+{
+  const GskGpuCachedRecording *self = data;
+  guint hash;
+  gsize i;
+
+  hash = g_direct_hash (self->node);
+  for (i = 0; i < self->key_size; i++)
+    hash = hash * 31 + self->key[i];
+
+  return hash;
+}
+
+static gboolean
+gsk_gpu_cached_recording_equal (gconstpointer v1,
+                                gconstpointer v2)
+{
+  const GskGpuCachedRecording *recording1 = v1;
+  const GskGpuCachedRecording *recording2 = v2;
+
+  return recording1->node == recording2->node
+      && recording1->key_size == recording2->key_size
+      && memcmp (recording1->key, recording2->key, recording1->key_size) == 0;
+}
+
+static const GskGpuCachedClass GSK_GPU_CACHED_RECORDING_CLASS =
+{
+  sizeof (GskGpuCachedRecording),
+  gsk_gpu_cached_recording_free,
+  gsk_gpu_cached_recording_should_collect
+};
+
+static void
+gsk_gpu_device_shrink_recording_cache (GskGpuDevice *self,
+                                       gsize         needed)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+  GskGpuCached *cached, *next;
+
+  for (cached = priv->first_cached;
+       cached != NULL && priv->recording_bytes + needed > MAX_RECORDING_BYTES;
+       cached = next)
+    {
+      next = cached->next;
+      if (cached->class == &GSK_GPU_CACHED_RECORDING_CLASS)
+        gsk_gpu_cached_free (self, cached);
+    }
+}
+
+/* }}} */
+/* {{{ CachedTessellation */
+
+struct _GskGpuCachedTessellation
+{
+  GskGpuCached parent;
+
+  GskPath *path;
+  float scale_x;
+  float scale_y;
+  float line_width;
+
+  GskGpuTessellation *tessellation;  /* NULL if shaders can't draw the path */
+};
+
+static void
+gsk_gpu_cached_tessellation_free (GskGpuDevice *device,
+                                  GskGpuCached *cached)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (device);
+  GskGpuCachedTessellation *self = (GskGpuCachedTessellation *) cached;
+
+  g_hash_table_remove (priv->tessellation_cache, self);
+
+  gsk_path_unref (self->path);
+  g_clear_pointer (&self->tessellation, gsk_gpu_tessellation_unref);
+
+  g_free (self);
+}
+
+static gboolean
+gsk_gpu_cached_tessellation_should_collect (GskGpuDevice *device,
+                                            GskGpuCached *cached,
+                                            gint64        timestamp)
+{
+  return gsk_gpu_cached_is_old (device, cached, timestamp);
+}
+
+static guint
+gsk_gpu_cached_tessellation_hash (gconstpointer data)
+{
+  const GskGpuCachedTessellation *self = data;
+
+  return g_direct_hash (self->path) ^
+         ((guint) (self->scale_x * 64) << 16) ^
+         (guint) (self->scale_y * 64) ^
+         ((guint) (self->line_width * 64) << 8);
+}
+
+static gboolean
+gsk_gpu_cached_tessellation_equal (gconstpointer v1,
+                                   gconstpointer v2)
+{
+  const GskGpuCachedTessellation *tess1 = v1;
+  const GskGpuCachedTessellation *tess2 = v2;
+
+  return tess1->path == tess2->path
+      && tess1->scale_x == tess2->scale_x
+      && tess1->scale_y == tess2->scale_y
+      && tess1->line_width == tess2->line_width;
+}
+
+static const GskGpuCachedClass GSK_GPU_CACHED_TESSELLATION_CLASS =
+{
+  sizeof (GskGpuCachedTessellation),
+  gsk_gpu_cached_tessellation_free,
+  gsk_gpu_cached_tessellation_should_collect
+};
+
 /* }}} */
 /* {{{ GskGpuDevice */
 
@@ -445,6 +774,11 @@ print_cache_stats (GskGpuDevice *self)
   guint glyphs = 0;
   guint stale_glyphs = 0;
   guint textures = 0;
+  guint node_images = 0;
+  guint recordings = 0;
+  guint tessellations = 0;
+  gsize tessellation_bytes = 0;
+  guint retained = 0;
   guint atlases = 0;
   GString *ratios = g_string_new ("");
 
@@ -460,6 +794,24 @@ print_cache_stats (GskGpuDevice *self)
         {
           textures++;
         }
+      else if (cached->class == &GSK_GPU_CACHED_NODE_IMAGE_CLASS)
+        {
+          node_images++;
+        }
+      else if (cached->class == &GSK_GPU_CACHED_TESSELLATION_CLASS)
+        {
+          GskGpuTessellation *tessellation = ((GskGpuCachedTessellation *) cached)->tessellation;
+
+          tessellations++;
+          if (tessellation)
+            tessellation_bytes += gsk_gpu_tessellation_get_size (tessellation);
+        }
+      else if (cached->class == &GSK_GPU_CACHED_RECORDING_CLASS)
+        {
+          recordings++;
+          if (((GskGpuCachedRecording *) cached)->recording)
+            retained++;
+        }
       else if (cached->class == &GSK_GPU_CACHED_ATLAS_CLASS)
         {
           double ratio;
@@ -472,24 +824,69 @@ print_cache_stats (GskGpuDevice *self)
             g_string_append (ratios, " (ratios ");
           else
             g_string_append (ratios, ", ");
-          g_string_append_printf (ratios, "%.2f", ratio);
+          g_string_append_printf (ratios, "%.2f/%.2f",
+                                  ratio,
+                                  (double) (((GskGpuCachedAtlas *) cached)->used_pixels - cached->pixels) / (double) (ATLAS_SIZE * ATLAS_SIZE));
         }
     }
 
   if (ratios->len > 0)
-    g_string_append (ratios, ")");
+    g_string_append (ratios, " dead/live)");
 
   gdk_debug_message ("Cached items\n"
                      "  glyphs:   %5u (%u stale)\n"
                      "  textures: %5u (%u in hash)\n"
-                     "  atlases:  %5u%s",
+                     "  nodes:    %5u (%" G_GSIZE_FORMAT " pixels)\n"
+                     "  subtrees: %5u (%u retained, %" G_GSIZE_FORMAT " bytes)\n"
+                     "  paths:    %5u (%" G_GSIZE_FORMAT " bytes)\n"
+                     "  atlases:  %5u%s\n"
+                     "  glyph hit rate: %.2f",
                      glyphs, stale_glyphs,
                      textures, g_hash_table_size (priv->texture_cache),
-                     atlases, ratios->str);
+                     node_images, priv->node_image_pixels,
+                     recordings, retained, priv->recording_bytes,
+                     tessellations, tessellation_bytes,
+                     atlases, ratios->str,
+                     priv->glyph_hits + priv->glyph_misses > 0
+                       ? (double) priv->glyph_hits / (priv->glyph_hits + priv->glyph_misses)
+                       : 1.0);
 
   g_string_free (ratios, TRUE);
 }
 
+static void
+gsk_gpu_device_report_glyph_stats (GskGpuDevice *self)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+
+  if (gdk_profiler_is_running ())
+    {
+      GskGpuCached *cached;
+      gsize atlas_pixels = 0, live_pixels = 0;
+      guint hits, misses;
+
+      for (cached = priv->first_cached; cached != NULL; cached = cached->next)
+        {
+          if (cached->class != &GSK_GPU_CACHED_ATLAS_CLASS)
+            continue;
+
+          atlas_pixels += ATLAS_SIZE * ATLAS_SIZE;
+          live_pixels += ((GskGpuCachedAtlas *) cached)->used_pixels - cached->pixels;
+        }
+
+      hits = priv->glyph_hits - priv->reported_glyph_hits;
+      misses = priv->glyph_misses - priv->reported_glyph_misses;
+
+      if (hits + misses > 0)
+        gdk_profiler_set_counter (profiler_glyph_hit_rate_id, (double) hits / (hits + misses));
+      if (atlas_pixels > 0)
+        gdk_profiler_set_counter (profiler_atlas_fill_id, (double) live_pixels / atlas_pixels);
+    }
+
+  priv->reported_glyph_hits = priv->glyph_hits;
+  priv->reported_glyph_misses = priv->glyph_misses;
+}
+
 static void
 gsk_gpu_device_gc (GskGpuDevice *self,
                    gint64        timestamp)
@@ -539,6 +936,8 @@ gsk_gpu_device_maybe_gc (GskGpuDevice *self)
   GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
   gsize dead_texture_pixels;
 
+  gsk_gpu_device_report_glyph_stats (self);
+
   if (priv->cache_timeout < 0)
     return;
 
@@ -591,6 +990,9 @@ gsk_gpu_device_dispose (GObject *object)
   GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
 
   gsk_gpu_device_clear_cache (self);
+  g_hash_table_unref (priv->tessellation_cache);
+  g_hash_table_unref (priv->recording_cache);
+  g_hash_table_unref (priv->node_image_cache);
   g_hash_table_unref (priv->glyph_cache);
   g_hash_table_unref (priv->texture_cache);
   g_clear_handle_id (&priv->cache_gc_source, g_source_remove);
@@ -605,6 +1007,7 @@ gsk_gpu_device_finalize (GObject *object)
   GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
 
   g_object_unref (priv->display);
+  g_rec_mutex_clear (&priv->lock);
 
   G_OBJECT_CLASS (gsk_gpu_device_parent_class)->finalize (object);
 }
@@ -616,6 +1019,9 @@ gsk_gpu_device_class_init (GskGpuDeviceClass *klass)
 
   object_class->dispose = gsk_gpu_device_dispose;
   object_class->finalize = gsk_gpu_device_finalize;
+
+  profiler_glyph_hit_rate_id = gdk_profiler_define_counter ("glyph-cache-hit-rate", "Ratio of glyphs found in the cache");
+  profiler_atlas_fill_id = gdk_profiler_define_counter ("atlas-fill", "Ratio of atlas pixels used by live glyphs");
 }
 
 static void
@@ -627,6 +1033,13 @@ gsk_gpu_device_init (GskGpuDevice *self)
                                         gsk_gpu_cached_glyph_equal);
   priv->texture_cache = g_hash_table_new (g_direct_hash,
                                           g_direct_equal);
+  priv->node_image_cache = g_hash_table_new (gsk_gpu_cached_node_image_hash,
+                                             gsk_gpu_cached_node_image_equal);
+  priv->recording_cache = g_hash_table_new (gsk_gpu_cached_recording_hash,
+                                            gsk_gpu_cached_recording_equal);
+  priv->tessellation_cache = g_hash_table_new (gsk_gpu_cached_tessellation_hash,
+                                               gsk_gpu_cached_tessellation_equal);
+  g_rec_mutex_init (&priv->lock);
 }
 
 void
@@ -685,6 +1098,105 @@ gsk_gpu_device_get_max_image_size (GskGpuDevice *self)
   return priv->max_image_size;
 }
 
+/*<private>
+ * gsk_gpu_device_lock:
+ * @self: a device
+ *
+ * Locks the device. While ops are recorded in parallel, the
+ * caches and the creation of images and descriptors must only
+ * be accessed with the lock held.
+ *
+ * The lock is recursive.
+ */
+void
+gsk_gpu_device_lock (GskGpuDevice *self)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+
+  g_rec_mutex_lock (&priv->lock);
+}
+
+void
+gsk_gpu_device_unlock (GskGpuDevice *self)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+
+  g_rec_mutex_unlock (&priv->lock);
+}
+
+/*<private>
+ * gsk_gpu_device_begin_parallel:
+ * @self: a device
+ * @timestamp: the timestamp of the frame being recorded
+ *
+ * Tells the device that a frame is recorded in parallel.
+ *
+ * Until gsk_gpu_device_end_parallel() is called, cached textures
+ * and node images that were created in this frame are not handed
+ * out. Another thread may have recorded the ops producing them and
+ * its ops might end up after ours.
+ */
+void
+gsk_gpu_device_begin_parallel (GskGpuDevice *self,
+                               gint64        timestamp)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+
+  priv->parallel_timestamp = timestamp;
+  priv->parallel_images = g_hash_table_new (NULL, NULL);
+}
+
+void
+gsk_gpu_device_end_parallel (GskGpuDevice *self)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+
+  priv->parallel_timestamp = 0;
+  g_clear_pointer (&priv->parallel_images, g_hash_table_unref);
+}
+
+/*<private>
+ * gsk_gpu_device_is_shared_image:
+ * @self: a device
+ * @image: an image
+ *
+ * Checks if other threads recording in parallel may use @image,
+ * because it existed before they started. Images created while
+ * recording in parallel are only known to the thread creating them.
+ *
+ * Must be called with the device lock held.
+ *
+ * Returns: %TRUE if the image may be used by other threads
+ */
+gboolean
+gsk_gpu_device_is_shared_image (GskGpuDevice *self,
+                                GskGpuImage  *image)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+
+  return priv->parallel_images != NULL &&
+         !g_hash_table_contains (priv->parallel_images, image);
+}
+
+static void
+gsk_gpu_device_add_parallel_image (GskGpuDevice *self,
+                                   GskGpuImage  *image)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+
+  if (priv->parallel_images && image)
+    g_hash_table_add (priv->parallel_images, image);
+}
+
+static inline gboolean
+gsk_gpu_device_is_usable_in_parallel (GskGpuDevice *self,
+                                      gint64        created)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+
+  return priv->parallel_timestamp == 0 || created != priv->parallel_timestamp;
+}
+
 GskGpuImage *
 gsk_gpu_device_create_offscreen_image (GskGpuDevice   *self,
                                        gboolean        with_mipmap,
@@ -692,7 +1204,14 @@ gsk_gpu_device_create_offscreen_image (GskGpuDevice   *self,
                                        gsize           width,
                                        gsize           height)
 {
-  return GSK_GPU_DEVICE_GET_CLASS (self)->create_offscreen_image (self, with_mipmap, depth, width, height);
+  GskGpuImage *image;
+
+  gsk_gpu_device_lock (self);
+  image = GSK_GPU_DEVICE_GET_CLASS (self)->create_offscreen_image (self, with_mipmap, depth, width, height);
+  gsk_gpu_device_add_parallel_image (self, image);
+  gsk_gpu_device_unlock (self);
+
+  return image;
 }
 
 GskGpuImage *
@@ -702,7 +1221,14 @@ gsk_gpu_device_create_upload_image (GskGpuDevice   *self,
                                     gsize           width,
                                     gsize           height)
 {
-  return GSK_GPU_DEVICE_GET_CLASS (self)->create_upload_image (self, with_mipmap, format, width, height);
+  GskGpuImage *image;
+
+  gsk_gpu_device_lock (self);
+  image = GSK_GPU_DEVICE_GET_CLASS (self)->create_upload_image (self, with_mipmap, format, width, height);
+  gsk_gpu_device_add_parallel_image (self, image);
+  gsk_gpu_device_unlock (self);
+
+  return image;
 }
 
 void
@@ -717,7 +1243,14 @@ gsk_gpu_device_create_download_image (GskGpuDevice   *self,
                                       gsize           width,
                                       gsize           height)
 {
-  return GSK_GPU_DEVICE_GET_CLASS (self)->create_download_image (self, depth, width, height);
+  GskGpuImage *image;
+
+  gsk_gpu_device_lock (self);
+  image = GSK_GPU_DEVICE_GET_CLASS (self)->create_download_image (self, depth, width, height);
+  gsk_gpu_device_add_parallel_image (self, image);
+  gsk_gpu_device_unlock (self);
+
+  return image;
 }
 
 /* This rounds up to the next number that has <= 2 bits set:
@@ -799,6 +1332,8 @@ gsk_gpu_cached_atlas_allocate (GskGpuCachedAtlas *atlas,
   atlas->slices[best_slice].width += width;
   g_assert (atlas->slices[best_slice].width <= ATLAS_SIZE);
 
+  atlas->used_pixels += width * height;
+
   return TRUE;
 }
 
@@ -818,20 +1353,137 @@ GskGpuImage *
 gsk_gpu_device_get_atlas_image (GskGpuDevice *self)
 {
   GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+  GskGpuImage *image;
 
+  gsk_gpu_device_lock (self);
   gsk_gpu_device_ensure_atlas (self, FALSE);
+  image = priv->current_atlas->image;
+  gsk_gpu_device_unlock (self);
+
+  return image;
+}
+
+/* Returns the atlas that was used least recently if we are at our
+ * memory budget for atlases, NULL otherwise.
+ * Atlases that the current frame uses are never compacted, the frame
+ * may have recorded ops with the old glyph positions. We rather go
+ * over the budget for a while.
+ */
+static GskGpuCachedAtlas *
+gsk_gpu_device_find_atlas_to_compact (GskGpuDevice *self,
+                                      gint64        timestamp)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+  GskGpuCached *cached, *lru = NULL;
+  gsize atlas_pixels = 0;
+
+  /* Other threads may hold on to glyph images they just looked up */
+  if (priv->parallel_timestamp != 0)
+    return NULL;
+
+  for (cached = priv->first_cached; cached != NULL; cached = cached->next)
+    {
+      if (cached->class != &GSK_GPU_CACHED_ATLAS_CLASS)
+        continue;
+
+      atlas_pixels += ATLAS_SIZE * ATLAS_SIZE;
+
+      if (cached->timestamp == timestamp)
+        continue;
+
+      if (lru == NULL || cached->timestamp < lru->timestamp)
+        lru = cached;
+    }
+
+  /* account for the atlas we are about to create */
+  if (atlas_pixels + ATLAS_SIZE * ATLAS_SIZE <= MAX_ATLAS_PIXELS)
+    return NULL;
+
+  return (GskGpuCachedAtlas *) lru;
+}
+
+/* Copies the glyphs of @atlas that are still alive into the current
+ * atlas on the GPU, most recently used ones first, and frees @atlas
+ * together with the glyphs that did not make it.
+ */
+static void
+gsk_gpu_device_compact_atlas (GskGpuDevice      *self,
+                              GskGpuFrame       *frame,
+                              GskGpuCachedAtlas *atlas)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+  GskGpuCachedAtlas *target = priv->current_atlas;
+  GskGpuCached *cached;
+  GPtrArray *glyphs;
+  gint64 timestamp;
+  gsize copied_pixels;
+  guint i, n_copied;
+
+  timestamp = gsk_gpu_frame_get_timestamp (frame);
+  glyphs = g_ptr_array_new ();
 
-  return priv->current_atlas->image;
+  if (gsk_gpu_frame_should_optimize (frame, GSK_GPU_OPTIMIZE_BLIT) &&
+      !(gsk_gpu_image_get_flags (atlas->image) & GSK_GPU_IMAGE_NO_BLIT) &&
+      !(gsk_gpu_image_get_flags (target->image) & GSK_GPU_IMAGE_NO_BLIT))
+    {
+      /* Used glyphs are moved to the end, so this is most recent first */
+      for (cached = priv->last_cached; cached != NULL; cached = cached->prev)
+        {
+          if (cached->atlas == atlas &&
+              !cached->stale &&
+              !gsk_gpu_cached_is_old (self, cached, timestamp))
+            g_ptr_array_add (glyphs, cached);
+        }
+    }
+
+  copied_pixels = 0;
+  for (n_copied = 0; n_copied < glyphs->len; n_copied++)
+    {
+      GskGpuCachedGlyph *glyph = g_ptr_array_index (glyphs, n_copied);
+      cairo_rectangle_int_t src, dest;
+      gsize x, y;
+
+      src.x = glyph->bounds.origin.x - ATLAS_GLYPH_PADDING;
+      src.y = glyph->bounds.origin.y - ATLAS_GLYPH_PADDING;
+      src.width = glyph->bounds.size.width + 2 * ATLAS_GLYPH_PADDING;
+      src.height = glyph->bounds.size.height + 2 * ATLAS_GLYPH_PADDING;
+
+      if (copied_pixels + src.width * src.height > MAX_COMPACTED_PIXELS ||
+          !gsk_gpu_cached_atlas_allocate (target, src.width, src.height, &x, &y))
+        break;
+
+      dest = (cairo_rectangle_int_t) { x, y, src.width, src.height };
+      gsk_gpu_blit_op (frame, atlas->image, target->image, &src, &dest, GSK_GPU_BLIT_NEAREST);
+
+      glyph->bounds.origin.x = x + ATLAS_GLYPH_PADDING;
+      glyph->bounds.origin.y = y + ATLAS_GLYPH_PADDING;
+      g_object_unref (glyph->image);
+      glyph->image = g_object_ref (target->image);
+      ((GskGpuCached *) glyph)->atlas = target;
+      copied_pixels += src.width * src.height;
+    }
+
+  /* Glyphs need to come after their atlas in the list, keep them in LRU order */
+  for (i = n_copied; i > 0; i--)
+    gsk_gpu_cached_move_to_end (self, g_ptr_array_index (glyphs, i - 1));
+
+  GSK_DEBUG (GLYPH_CACHE, "Compacted atlas, kept %u glyphs (%" G_GSIZE_FORMAT " pixels)", n_copied, copied_pixels);
+
+  g_ptr_array_unref (glyphs);
+
+  gsk_gpu_cached_free (self, (GskGpuCached *) atlas);
 }
 
 static GskGpuImage *
 gsk_gpu_device_add_atlas_image (GskGpuDevice      *self,
+                                GskGpuFrame       *frame,
                                 gsize              width,
                                 gsize              height,
                                 gsize             *out_x,
                                 gsize             *out_y)
 {
   GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+  GskGpuCachedAtlas *compact;
 
   if (width > MAX_ATLAS_ITEM_SIZE || height > MAX_ATLAS_ITEM_SIZE)
     return NULL;
@@ -841,7 +1493,13 @@ gsk_gpu_device_add_atlas_image (GskGpuDevice      *self,
   if (gsk_gpu_cached_atlas_allocate (priv->current_atlas, width, height, out_x, out_y))
     return priv->current_atlas->image;
 
+  compact = gsk_gpu_device_find_atlas_to_compact (self, gsk_gpu_frame_get_timestamp (frame));
+
   gsk_gpu_device_ensure_atlas (self, TRUE);
+  ((GskGpuCached *) priv->current_atlas)->timestamp = gsk_gpu_frame_get_timestamp (frame);
+
+  if (compact)
+    gsk_gpu_device_compact_atlas (self, frame, compact);
 
   if (gsk_gpu_cached_atlas_allocate (priv->current_atlas, width, height, out_x, out_y))
     return priv->current_atlas->image;
@@ -856,17 +1514,24 @@ gsk_gpu_device_lookup_texture_image (GskGpuDevice *self,
 {
   GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
   GskGpuCachedTexture *cache;
+  GskGpuImage *image = NULL;
+
+  gsk_gpu_device_lock (self);
 
   cache = gdk_texture_get_render_data (texture, self);
   if (cache == NULL)
     cache = g_hash_table_lookup (priv->texture_cache, texture);
 
-  if (!cache || !cache->image || gsk_gpu_cached_texture_is_invalid (cache))
-    return NULL;
+  if (cache && cache->image && !gsk_gpu_cached_texture_is_invalid (cache) &&
+      gsk_gpu_device_is_usable_in_parallel (self, cache->created))
+    {
+      gsk_gpu_cached_use (self, (GskGpuCached *) cache, timestamp);
+      image = g_object_ref (cache->image);
+    }
 
-  gsk_gpu_cached_use (self, (GskGpuCached *) cache, timestamp);
+  gsk_gpu_device_unlock (self);
 
-  return g_object_ref (cache->image);
+  return image;
 }
 
 void
@@ -877,20 +1542,342 @@ gsk_gpu_device_cache_texture_image (GskGpuDevice *self,
 {
   GskGpuCachedTexture *cache;
 
+  gsk_gpu_device_lock (self);
+
   cache = gsk_gpu_cached_texture_new (self, texture, image);
+  cache->created = timestamp;
 
   gsk_gpu_cached_use (self, (GskGpuCached *) cache, timestamp);
+
+  gsk_gpu_device_unlock (self);
 }
 
+/*<private>
+ * gsk_gpu_device_lookup_node_image:
+ * @self: a device
+ * @node: the node that was rendered
+ * @scale: the scale the node was rendered at
+ * @clip_bounds: the area of the node that is needed
+ * @timestamp: the timestamp of the current frame
+ * @out_bounds: (out): the area of the node covered by the image
+ *
+ * Looks up an image previously stored with
+ * gsk_gpu_device_cache_node_image().
+ *
+ * The image is only returned if it covers @clip_bounds and its pixels
+ * are aligned with the pixels of @clip_bounds.
+ *
+ * Returns: (transfer full) (nullable): the cached image
+ */
 GskGpuImage *
-gsk_gpu_device_lookup_glyph_image (GskGpuDevice           *self,
-                                   GskGpuFrame            *frame,
-                                   PangoFont              *font,
-                                   PangoGlyph              glyph,
-                                   GskGpuGlyphLookupFlags  flags,
-                                   float                   scale,
-                                   graphene_rect_t        *out_bounds,
-                                   graphene_point_t       *out_origin)
+gsk_gpu_device_lookup_node_image (GskGpuDevice          *self,
+                                  GskRenderNode         *node,
+                                  const graphene_vec2_t *scale,
+                                  const graphene_rect_t *clip_bounds,
+                                  gint64                 timestamp,
+                                  graphene_rect_t       *out_bounds)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+  GskGpuCachedNodeImage lookup = {
+    .node = node,
+    .scale_x = graphene_vec2_get_x (scale),
+    .scale_y = graphene_vec2_get_y (scale),
+  };
+  GskGpuCachedNodeImage *cache;
+  GskGpuImage *image = NULL;
+  float dx, dy;
+
+  gsk_gpu_device_lock (self);
+
+  cache = g_hash_table_lookup (priv->node_image_cache, &lookup);
+  if (cache == NULL ||
+      !gsk_gpu_device_is_usable_in_parallel (self, cache->created) ||
+      !graphene_rect_contains_rect (&cache->bounds, clip_bounds))
+    goto out;
+
+  dx = (clip_bounds->origin.x - cache->bounds.origin.x) * lookup.scale_x;
+  dy = (clip_bounds->origin.y - cache->bounds.origin.y) * lookup.scale_y;
+  if (fabsf (dx - roundf (dx)) > 0.001f || fabsf (dy - roundf (dy)) > 0.001f)
+    goto out;
+
+  gsk_gpu_cached_use (self, (GskGpuCached *) cache, timestamp);
+  gsk_gpu_cached_move_to_end (self, (GskGpuCached *) cache);
+
+  *out_bounds = cache->bounds;
+  image = g_object_ref (cache->image);
+
+out:
+  gsk_gpu_device_unlock (self);
+
+  return image;
+}
+
+/*<private>
+ * gsk_gpu_device_cache_node_image:
+ * @self: a device
+ * @node: the node that was rendered
+ * @scale: the scale the node was rendered at
+ * @timestamp: the timestamp of the current frame
+ * @image: the image the node was rendered to
+ * @bounds: the area of the node covered by @image
+ *
+ * Keeps @image around so that future frames rendering the same
+ * node at the same scale can reuse it.
+ *
+ * The cache has a memory budget, once that is exceeded the least
+ * recently used images are dropped. Images that are too large for
+ * the budget are not cached.
+ */
+void
+gsk_gpu_device_cache_node_image (GskGpuDevice          *self,
+                                 GskRenderNode         *node,
+                                 const graphene_vec2_t *scale,
+                                 gint64                 timestamp,
+                                 GskGpuImage           *image,
+                                 const graphene_rect_t *bounds)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+  GskGpuCachedNodeImage lookup = {
+    .node = node,
+    .scale_x = graphene_vec2_get_x (scale),
+    .scale_y = graphene_vec2_get_y (scale),
+  };
+  GskGpuCachedNodeImage *cache;
+  gsize pixels;
+
+  pixels = gsk_gpu_image_get_width (image) * gsk_gpu_image_get_height (image);
+  if (pixels > MAX_NODE_IMAGE_ITEM_PIXELS)
+    return;
+
+  gsk_gpu_device_lock (self);
+
+  cache = g_hash_table_lookup (priv->node_image_cache, &lookup);
+  if (cache)
+    gsk_gpu_cached_free (self, (GskGpuCached *) cache);
+
+  gsk_gpu_device_shrink_node_image_cache (self, pixels);
+
+  cache = gsk_gpu_cached_new (self, &GSK_GPU_CACHED_NODE_IMAGE_CLASS, NULL);
+  cache->node = gsk_render_node_ref (node);
+  cache->scale_x = lookup.scale_x;
+  cache->scale_y = lookup.scale_y;
+  cache->image = g_object_ref (image);
+  cache->bounds = *bounds;
+  cache->created = timestamp;
+  ((GskGpuCached *) cache)->pixels = pixels;
+  priv->node_image_pixels += pixels;
+
+  g_hash_table_insert (priv->node_image_cache, cache, cache);
+  gsk_gpu_cached_use (self, (GskGpuCached *) cache, timestamp);
+
+  gsk_gpu_device_unlock (self);
+}
+
+/*<private>
+ * gsk_gpu_device_lookup_recording:
+ * @self: a device
+ * @node: the node to look up
+ * @key: the state the node is rendered with
+ * @key_size: size of @key in bytes
+ * @timestamp: the timestamp of the current frame
+ * @out_recording: (out) (transfer full): the recording if the
+ *   node has been retained
+ *
+ * Looks up what is known about rendering @node with the state
+ * given by @key in previous frames.
+ *
+ * Returns: the state of the node
+ */
+GskGpuRecordingState
+gsk_gpu_device_lookup_recording (GskGpuDevice           *self,
+                                 GskRenderNode          *node,
+                                 gconstpointer           key,
+                                 gsize                   key_size,
+                                 gint64                  timestamp,
+                                 GskGpuRecording       **out_recording)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+  GskGpuCachedRecording lookup = {
+    .node = node,
+    .key = (guchar *) key,
+    .key_size = key_size,
+  };
+  GskGpuCachedRecording *cache;
+  GskGpuRecordingState state;
+
+  gsk_gpu_device_lock (self);
+
+  cache = g_hash_table_lookup (priv->recording_cache, &lookup);
+  if (cache == NULL)
+    {
+      state = GSK_GPU_RECORDING_UNKNOWN;
+    }
+  else
+    {
+      gsk_gpu_cached_use (self, (GskGpuCached *) cache, timestamp);
+      gsk_gpu_cached_move_to_end (self, (GskGpuCached *) cache);
+      state = cache->state;
+      if (cache->recording)
+        *out_recording = gsk_gpu_recording_ref (cache->recording);
+    }
+
+  gsk_gpu_device_unlock (self);
+
+  return state;
+}
+
+/*<private>
+ * gsk_gpu_device_cache_recording:
+ * @self: a device
+ * @node: the node that was rendered
+ * @key: the state the node was rendered with
+ * @key_size: size of @key in bytes
+ * @timestamp: the timestamp of the current frame
+ * @state: the new state of the node
+ * @recording: (transfer full) (nullable): the recording if @state
+ *   is %GSK_GPU_RECORDING_RETAINED
+ *
+ * Remembers what happened when rendering @node, so that later frames
+ * can decide if they want to record it or replay the ops of @recording.
+ *
+ * Like node images, recordings have a memory budget and the least
+ * recently used ones are dropped when it is exceeded.
+ */
+void
+gsk_gpu_device_cache_recording (GskGpuDevice           *self,
+                                GskRenderNode          *node,
+                                gconstpointer           key,
+                                gsize                   key_size,
+                                gint64                  timestamp,
+                                GskGpuRecordingState    state,
+                                GskGpuRecording        *recording)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+  GskGpuCachedRecording lookup = {
+    .node = node,
+    .key = (guchar *) key,
+    .key_size = key_size,
+  };
+  GskGpuCachedRecording *cache;
+  gsize size;
+
+  g_assert ((state == GSK_GPU_RECORDING_RETAINED) == (recording != NULL));
+
+  size = RECORDING_ENTRY_BYTES + key_size;
+  if (recording)
+    {
+      size += gsk_gpu_recording_get_size (recording);
+      if (size > MAX_RECORDING_ITEM_BYTES)
+        {
+          gsk_gpu_recording_unref (recording);
+          state = GSK_GPU_RECORDING_UNRETAINABLE;
+          recording = NULL;
+          size = RECORDING_ENTRY_BYTES + key_size;
+        }
+    }
+
+  gsk_gpu_device_lock (self);
+
+  cache = g_hash_table_lookup (priv->recording_cache, &lookup);
+  if (cache)
+    gsk_gpu_cached_free (self, (GskGpuCached *) cache);
+
+  gsk_gpu_device_shrink_recording_cache (self, size);
+
+  cache = gsk_gpu_cached_new (self, &GSK_GPU_CACHED_RECORDING_CLASS, NULL);
+  if (recording)
+    cache->node = gsk_render_node_ref (node);
+  else
+    cache->node = node;
+  cache->key = g_memdup2 (key, key_size);
+  cache->key_size = key_size;
+  cache->state = state;
+  cache->recording = recording;
+  cache->size = size;
+  priv->recording_bytes += size;
+
+  g_hash_table_insert (priv->recording_cache, cache, cache);
+  gsk_gpu_cached_use (self, (GskGpuCached *) cache, timestamp);
+
+  gsk_gpu_device_unlock (self);
+}
+
+/*<private>
+ * gsk_gpu_device_get_tessellation:
+ * @self: a device
+ * @path: the path to draw
+ * @scale: the scale to draw the path at
+ * @line_width: the width of the stroke or 0 to fill the path
+ * @timestamp: the timestamp of the current frame
+ *
+ * Gets the tessellation for drawing @path, creating it if it
+ * wasn't used recently.
+ *
+ * Returns: (transfer full) (nullable): the tessellation or %NULL if
+ *   the path can't be drawn with shaders
+ */
+GskGpuTessellation *
+gsk_gpu_device_get_tessellation (GskGpuDevice          *self,
+                                 GskPath               *path,
+                                 const graphene_vec2_t *scale,
+                                 float                  line_width,
+                                 gint64                 timestamp)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+  GskGpuCachedTessellation lookup = {
+    .path = path,
+    .scale_x = graphene_vec2_get_x (scale),
+    .scale_y = graphene_vec2_get_y (scale),
+    .line_width = line_width,
+  };
+  GskGpuCachedTessellation *cache;
+  GskGpuTessellation *tessellation;
+
+  gsk_gpu_device_lock (self);
+
+  cache = g_hash_table_lookup (priv->tessellation_cache, &lookup);
+  if (cache)
+    {
+      gsk_gpu_cached_use (self, (GskGpuCached *) cache, timestamp);
+      tessellation = cache->tessellation ? gsk_gpu_tessellation_ref (cache->tessellation) : NULL;
+      gsk_gpu_device_unlock (self);
+      return tessellation;
+    }
+
+  gsk_gpu_device_unlock (self);
+
+  /* Don't block other threads while tessellating */
+  tessellation = gsk_gpu_tessellation_new (path, scale, line_width);
+
+  gsk_gpu_device_lock (self);
+
+  cache = g_hash_table_lookup (priv->tessellation_cache, &lookup);
+  if (cache == NULL)
+    {
+      cache = gsk_gpu_cached_new (self, &GSK_GPU_CACHED_TESSELLATION_CLASS, NULL);
+      cache->path = gsk_path_ref (path);
+      cache->scale_x = lookup.scale_x;
+      cache->scale_y = lookup.scale_y;
+      cache->line_width = line_width;
+      cache->tessellation = tessellation ? gsk_gpu_tessellation_ref (tessellation) : NULL;
+      g_hash_table_insert (priv->tessellation_cache, cache, cache);
+    }
+  gsk_gpu_cached_use (self, (GskGpuCached *) cache, timestamp);
+
+  gsk_gpu_device_unlock (self);
+
+  return tessellation;
+}
+
+static GskGpuImage *
+gsk_gpu_device_lookup_glyph_image_locked (GskGpuDevice           *self,
+                                          GskGpuFrame            *frame,
+                                          PangoFont              *font,
+                                          PangoGlyph              glyph,
+                                          GskGpuGlyphLookupFlags  flags,
+                                          float                   scale,
+                                          graphene_rect_t        *out_bounds,
+                                          graphene_point_t       *out_origin)
 {
   GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
   GskGpuCachedGlyph lookup = {
@@ -911,7 +1898,14 @@ gsk_gpu_device_lookup_glyph_image (GskGpuDevice           *self,
   cache = g_hash_table_lookup (priv->glyph_cache, &lookup);
   if (cache)
     {
-      gsk_gpu_cached_use (self, (GskGpuCached *) cache, gsk_gpu_frame_get_timestamp (frame));
+      GskGpuCached *cached = (GskGpuCached *) cache;
+
+      priv->glyph_hits++;
+
+      gsk_gpu_cached_use (self, cached, gsk_gpu_frame_get_timestamp (frame));
+      gsk_gpu_cached_move_to_end (self, cached);
+      if (cached->atlas)
+        ((GskGpuCached *) cached->atlas)->timestamp = cached->timestamp;
 
       *out_bounds = cache->bounds;
       *out_origin = cache->origin;
@@ -923,6 +1917,8 @@ gsk_gpu_device_lookup_glyph_image (GskGpuDevice           *self,
    * hinting influence the rendering of hexboxes, and we get bad outcomes if
    * that happens.
    */
+  priv->glyph_misses++;
+
   scaled_font = gsk_reload_font (font, scale, CAIRO_HINT_METRICS_OFF, CAIRO_HINT_STYLE_DEFAULT, CAIRO_ANTIALIAS_DEFAULT);
 
   subpixel_x = (flags & 3) / 4.f;
@@ -932,9 +1928,10 @@ gsk_gpu_device_lookup_glyph_image (GskGpuDevice           *self,
   origin.y = floor (ink_rect.y * 1.0 / PANGO_SCALE + subpixel_y);
   rect.size.width = ceil ((ink_rect.x + ink_rect.width) * 1.0 / PANGO_SCALE + subpixel_x) - origin.x;
   rect.size.height = ceil ((ink_rect.y + ink_rect.height) * 1.0 / PANGO_SCALE + subpixel_y) - origin.y;
-  padding = 1;
+  padding = ATLAS_GLYPH_PADDING;
 
   image = gsk_gpu_device_add_atlas_image (self,
+                                          frame,
                                           rect.size.width + 2 * padding, rect.size.height + 2 * padding,
                                           &atlas_x, &atlas_y);
   if (image)
@@ -978,6 +1975,8 @@ gsk_gpu_device_lookup_glyph_image (GskGpuDevice           *self,
 
   g_hash_table_insert (priv->glyph_cache, cache, cache);
   gsk_gpu_cached_use (self, (GskGpuCached *) cache, gsk_gpu_frame_get_timestamp (frame));
+  if (((GskGpuCached *) cache)->atlas)
+    ((GskGpuCached *) priv->current_atlas)->timestamp = ((GskGpuCached *) cache)->timestamp;
 
   *out_bounds = cache->bounds;
   *out_origin = cache->origin;
@@ -987,5 +1986,24 @@ gsk_gpu_device_lookup_glyph_image (GskGpuDevice           *self,
   return cache->image;
 }
 
+GskGpuImage *
+gsk_gpu_device_lookup_glyph_image (GskGpuDevice           *self,
+                                   GskGpuFrame            *frame,
+                                   PangoFont              *font,
+                                   PangoGlyph              glyph,
+                                   GskGpuGlyphLookupFlags  flags,
+                                   float                   scale,
+                                   graphene_rect_t        *out_bounds,
+                                   graphene_point_t       *out_origin)
+{
+  GskGpuImage *image;
+
+  gsk_gpu_device_lock (self);
+  image = gsk_gpu_device_lookup_glyph_image_locked (self, frame, font, glyph, flags, scale, out_bounds, out_origin);
+  gsk_gpu_device_unlock (self);
+
+  return image;
+}
+
 /* }}} */
 /* vim:set foldmethod=marker expandtab: */
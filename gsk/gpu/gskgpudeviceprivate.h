@@ -1,6 +1,7 @@
 #pragma once
 
 #include "gskgputypesprivate.h"
+#include "gsktypes.h"
 
 #include <graphene.h>
 
@@ -52,6 +53,13 @@ void                    gsk_gpu_device_setup                            (GskGpuD
                                                                          gsize                   max_image_size);
 void                    gsk_gpu_device_maybe_gc                         (GskGpuDevice           *self);
 void                    gsk_gpu_device_queue_gc                         (GskGpuDevice           *self);
+void                    gsk_gpu_device_lock                             (GskGpuDevice           *self);
+void                    gsk_gpu_device_unlock                           (GskGpuDevice           *self);
+void                    gsk_gpu_device_begin_parallel                   (GskGpuDevice           *self,
+                                                                         gint64                  timestamp);
+void                    gsk_gpu_device_end_parallel                     (GskGpuDevice           *self);
+gboolean                gsk_gpu_device_is_shared_image                  (GskGpuDevice           *self,
+                                                                         GskGpuImage            *image);
 GdkDisplay *            gsk_gpu_device_get_display                      (GskGpuDevice           *self);
 gsize                   gsk_gpu_device_get_max_image_size               (GskGpuDevice           *self);
 GskGpuImage *           gsk_gpu_device_get_atlas_image                  (GskGpuDevice           *self);
@@ -78,6 +86,46 @@ void                    gsk_gpu_device_cache_texture_image              (GskGpuD
                                                                          GdkTexture             *texture,
                                                                          gint64                  timestamp,
                                                                          GskGpuImage            *image);
+GskGpuImage *           gsk_gpu_device_lookup_node_image                (GskGpuDevice           *self,
+                                                                         GskRenderNode          *node,
+                                                                         const graphene_vec2_t  *scale,
+                                                                         const graphene_rect_t  *clip_bounds,
+                                                                         gint64                  timestamp,
+                                                                         graphene_rect_t        *out_bounds);
+void                    gsk_gpu_device_cache_node_image                 (GskGpuDevice           *self,
+                                                                         GskRenderNode          *node,
+                                                                         const graphene_vec2_t  *scale,
+                                                                         gint64                  timestamp,
+                                                                         GskGpuImage            *image,
+                                                                         const graphene_rect_t  *bounds);
+
+GskGpuTessellation *    gsk_gpu_device_get_tessellation                 (GskGpuDevice           *self,
+                                                                         GskPath                *path,
+                                                                         const graphene_vec2_t  *scale,
+                                                                         float                   line_width,
+                                                                         gint64                  timestamp);
+
+typedef enum
+{
+  GSK_GPU_RECORDING_UNKNOWN,
+  GSK_GPU_RECORDING_SEEN,
+  GSK_GPU_RECORDING_UNRETAINABLE,
+  GSK_GPU_RECORDING_RETAINED
+} GskGpuRecordingState;
+
+GskGpuRecordingState    gsk_gpu_device_lookup_recording                 (GskGpuDevice           *self,
+                                                                         GskRenderNode          *node,
+                                                                         gconstpointer           key,
+                                                                         gsize                   key_size,
+                                                                         gint64                  timestamp,
+                                                                         GskGpuRecording       **out_recording);
+void                    gsk_gpu_device_cache_recording                  (GskGpuDevice           *self,
+                                                                         GskRenderNode          *node,
+                                                                         gconstpointer           key,
+                                                                         gsize                   key_size,
+                                                                         gint64                  timestamp,
+                                                                         GskGpuRecordingState    state,
+                                                                         GskGpuRecording        *recording);
 
 typedef enum
 {
@@ -293,6 +293,7 @@ gsk_gpu_download_op_gl_command (GskGpuOp          *op,
 }
 
 static const GskGpuOpClass GSK_GPU_DOWNLOAD_OP_CLASS = {
+  "download",
   GSK_GPU_OP_SIZE (GskGpuDownloadOp),
   GSK_GPU_STAGE_COMMAND,
   gsk_gpu_download_op_finish,
@@ -10,12 +10,16 @@
 #include "gskgpuopprivate.h"
 #include "gskgpurendererprivate.h"
 #include "gskgpurenderpassopprivate.h"
+#include "gskgpushaderopprivate.h"
 #include "gskgpuuploadopprivate.h"
 
 #include "gskdebugprivate.h"
+#include "gskprofilerprivate.h"
 #include "gskrendererprivate.h"
 
 #include "gdk/gdkdmabufdownloaderprivate.h"
+#include "gdk/gdkparalleltaskprivate.h"
+#include "gdk/gdkprofilerprivate.h"
 #include "gdk/gdktexturedownloaderprivate.h"
 
 #define DEFAULT_VERTEX_BUFFER_SIZE 128 * 1024
@@ -30,6 +34,7 @@
 #include "gdk/gdkarrayimpl.c"
 
 typedef struct _GskGpuFramePrivate GskGpuFramePrivate;
+typedef struct _GskGpuFrameArena GskGpuFrameArena;
 
 struct _GskGpuFramePrivate
 {
@@ -48,10 +53,91 @@ struct _GskGpuFramePrivate
   GskGpuBuffer *storage_buffer;
   guchar *storage_buffer_data;
   gsize storage_buffer_used;
+
+  /* ops that must run before the ops of all threads recording in parallel */
+  GskGpuFrameArena *prelude;
+
+  /* names of the ops measured by each timestamp query, NULL for the last one */
+  GPtrArray *timestamp_names;
+};
+
+/* While recording in parallel, every thread records its ops and
+ * vertex data into its own arena. Arenas are appended to the frame
+ * in order once all threads are done.
+ * Arenas are also used to record ops that may be retained for
+ * later frames, those are appended to the parent arena or the frame
+ * when recording ends.
+ */
+struct _GskGpuFrameArena
+{
+  GskGpuFrame *frame;
+  GskGpuFrameArena *parent;
+
+  GskGpuOps ops;
+  GskGpuOp *last_op;
+
+  guchar *vertex_data;
+  gsize vertex_data_size;
+  gsize vertex_data_used;
+
+  gboolean unretainable;
+
+  /* Only for recordings: the NestedRecordings in ops */
+  GArray *nested;
+};
+
+/* A retained recording that was replayed or recorded inside
+ * another recording. The outer recording references it instead
+ * of keeping a copy of its ops.
+ */
+typedef struct _NestedRecording NestedRecording;
+
+struct _NestedRecording
+{
+  gsize ops_start;
+  gsize ops_end;
+  gsize vertex_start;
+  gsize vertex_end;
+  GskGpuRecording *recording;
 };
 
+typedef struct _GskGpuRecordingPart GskGpuRecordingPart;
+
+/* Either ops with their vertex data, or a nested recording */
+struct _GskGpuRecordingPart
+{
+  guchar *ops;
+  gsize ops_size;
+  guchar *vertex_data;
+  gsize vertex_data_size;
+  GskGpuRecording *nested;
+};
+
+struct _GskGpuRecording
+{
+  gatomicrefcount ref_count;
+
+  GskGpuRecordingPart *parts;
+  gsize n_parts;
+  gsize size;
+  guint flags;
+};
+
+static GPrivate current_arena;
+
 G_DEFINE_TYPE_WITH_PRIVATE (GskGpuFrame, gsk_gpu_frame, G_TYPE_OBJECT)
 
+static inline GskGpuFrameArena *
+gsk_gpu_frame_get_arena (GskGpuFrame *self)
+{
+  GskGpuFrameArena *arena = g_private_get (&current_arena);
+
+  if (arena && arena->frame == self)
+    return arena;
+
+  return NULL;
+}
+
 static void
 gsk_gpu_frame_default_setup (GskGpuFrame *self)
 {
@@ -71,6 +157,7 @@ gsk_gpu_frame_default_cleanup (GskGpuFrame *self)
       gsk_gpu_op_finish (op);
     }
   gsk_gpu_ops_set_size (&priv->ops, 0);
+  g_ptr_array_set_size (priv->timestamp_names, 0);
 
   priv->last_op = NULL;
 }
@@ -112,6 +199,7 @@ gsk_gpu_frame_finalize (GObject *object)
   GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
 
   gsk_gpu_ops_clear (&priv->ops);
+  g_ptr_array_unref (priv->timestamp_names);
 
   g_clear_object (&priv->vertex_buffer);
   g_clear_object (&priv->storage_buffer);
@@ -140,6 +228,7 @@ gsk_gpu_frame_init (GskGpuFrame *self)
   GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
 
   gsk_gpu_ops_init (&priv->ops);
+  priv->timestamp_names = g_ptr_array_new ();
 }
 
 void
@@ -378,8 +467,19 @@ gsk_gpu_frame_alloc_op (GskGpuFrame *self,
                         gsize        size)
 {
   GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
+  GskGpuFrameArena *arena;
   gsize pos;
 
+  arena = gsk_gpu_frame_get_arena (self);
+  if (arena)
+    {
+      pos = gsk_gpu_ops_get_size (&arena->ops);
+      gsk_gpu_ops_splice (&arena->ops, pos, 0, FALSE, NULL, size);
+      arena->last_op = (GskGpuOp *) gsk_gpu_ops_index (&arena->ops, pos);
+
+      return arena->last_op;
+    }
+
   pos = gsk_gpu_ops_get_size (&priv->ops);
 
   gsk_gpu_ops_splice (&priv->ops,
@@ -393,10 +493,48 @@ gsk_gpu_frame_alloc_op (GskGpuFrame *self,
   return priv->last_op;
 }
 
+/*<private>
+ * gsk_gpu_frame_alloc_prelude_op:
+ * @self: a frame
+ * @size: the size of the op
+ *
+ * Allocates an op that runs before the ops of all threads that are
+ * recording in parallel, like generating mipmaps of an image that
+ * any of them may sample. Otherwise this is the same as
+ * gsk_gpu_frame_alloc_op().
+ *
+ * Must be called with the device lock held.
+ *
+ * Returns: the new op
+ */
+gpointer
+gsk_gpu_frame_alloc_prelude_op (GskGpuFrame *self,
+                                gsize        size)
+{
+  GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
+  gsize pos;
+
+  if (priv->prelude == NULL)
+    return gsk_gpu_frame_alloc_op (self, size);
+
+  /* The op doesn't end up in the recordings of this thread */
+  gsk_gpu_frame_mark_unretainable (self);
+
+  pos = gsk_gpu_ops_get_size (&priv->prelude->ops);
+  gsk_gpu_ops_splice (&priv->prelude->ops, pos, 0, FALSE, NULL, size);
+
+  return gsk_gpu_ops_index (&priv->prelude->ops, pos);
+}
+
 GskGpuOp *
 gsk_gpu_frame_get_last_op (GskGpuFrame *self)
 {
   GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
+  GskGpuFrameArena *arena;
+
+  arena = gsk_gpu_frame_get_arena (self);
+  if (arena)
+    return arena->last_op;
 
   return priv->last_op;
 }
@@ -409,18 +547,29 @@ gsk_gpu_frame_upload_texture (GskGpuFrame  *self,
   GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
   GskGpuImage *image;
 
+  gsk_gpu_device_lock (priv->device);
+
   image = GSK_GPU_FRAME_GET_CLASS (self)->upload_texture (self, with_mipmap, texture);
 
   if (image)
     gsk_gpu_device_cache_texture_image (priv->device, texture, priv->timestamp, image);
 
+  gsk_gpu_device_unlock (priv->device);
+
   return image;
 }
 
 GskGpuDescriptors *
 gsk_gpu_frame_create_descriptors (GskGpuFrame *self)
 {
-  return GSK_GPU_FRAME_GET_CLASS (self)->create_descriptors (self);
+  GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
+  GskGpuDescriptors *desc;
+
+  gsk_gpu_device_lock (priv->device);
+  desc = GSK_GPU_FRAME_GET_CLASS (self)->create_descriptors (self);
+  gsk_gpu_device_unlock (priv->device);
+
+  return desc;
 }
 
 static GskGpuBuffer *
@@ -448,8 +597,23 @@ gsk_gpu_frame_reserve_vertex_data (GskGpuFrame *self,
                                    gsize        size)
 {
   GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
+  GskGpuFrameArena *arena;
   gsize size_needed;
 
+  arena = gsk_gpu_frame_get_arena (self);
+  if (arena)
+    {
+      size_needed = round_up (arena->vertex_data_used, size) + size;
+      if (size_needed > arena->vertex_data_size)
+        {
+          arena->vertex_data_size = MAX (MAX (arena->vertex_data_size * 2, size_needed), 4096);
+          arena->vertex_data = g_realloc (arena->vertex_data, arena->vertex_data_size);
+        }
+      arena->vertex_data_used = size_needed;
+
+      return size_needed - size;
+    }
+
   if (priv->vertex_buffer == NULL)
     priv->vertex_buffer = gsk_gpu_frame_create_vertex_buffer (self, DEFAULT_VERTEX_BUFFER_SIZE);
 
@@ -481,6 +645,11 @@ gsk_gpu_frame_get_vertex_data (GskGpuFrame *self,
                                gsize        offset)
 {
   GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
+  GskGpuFrameArena *arena;
+
+  arena = gsk_gpu_frame_get_arena (self);
+  if (arena)
+    return arena->vertex_data + offset;
 
   if (priv->vertex_buffer_data == NULL)
     priv->vertex_buffer_data = gsk_gpu_buffer_map (priv->vertex_buffer);
@@ -509,8 +678,11 @@ gsk_gpu_frame_write_storage_buffer (GskGpuFrame  *self,
                                     gsize        *out_offset)
 {
   GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
+  GskGpuBuffer *buffer;
   gsize offset;
 
+  gsk_gpu_device_lock (priv->device);
+
   gsk_gpu_frame_ensure_storage_buffer (self);
 
   offset = priv->storage_buffer_used;
@@ -534,7 +706,445 @@ gsk_gpu_frame_write_storage_buffer (GskGpuFrame  *self,
     }
 
   *out_offset = offset;
-  return priv->storage_buffer;
+  buffer = priv->storage_buffer;
+
+  gsk_gpu_device_unlock (priv->device);
+
+  return buffer;
+}
+
+typedef struct
+{
+  GskGpuFrameRecordFunc func;
+  gpointer data;
+  GskGpuFrameArena *arenas;
+} ParallelRecord;
+
+static void
+gsk_gpu_frame_record_task (guint    task_index,
+                           gpointer data)
+{
+  ParallelRecord *record = data;
+  GskGpuFrameArena *arena = &record->arenas[task_index];
+  gpointer old_arena;
+
+  old_arena = g_private_get (&current_arena);
+  g_private_set (&current_arena, arena);
+
+  record->func (arena->frame, task_index, record->data);
+
+  g_private_set (&current_arena, old_arena);
+}
+
+/* Appends the ops to the frame, and moves their vertex data into the
+ * vertex buffer. Doing that in op order produces the same layout as if
+ * the ops had been recorded right here.
+ */
+static void
+gsk_gpu_frame_append_ops (GskGpuFrame  *self,
+                          const guchar *ops,
+                          gsize         ops_size,
+                          const guchar *vertex_data)
+{
+  const GskGpuOp *op;
+  GskGpuOp *copy;
+  gsize i, j;
+
+  for (i = 0; i < ops_size; i += op->op_class->size)
+    {
+      op = (const GskGpuOp *) (ops + i);
+
+      copy = gsk_gpu_frame_alloc_op (self, op->op_class->size);
+      memcpy (copy, op, op->op_class->size);
+
+      if (op->op_class->stage == GSK_GPU_STAGE_SHADER)
+        {
+          GskGpuShaderOp *shader = (GskGpuShaderOp *) copy;
+          const GskGpuShaderOpClass *shader_class = (const GskGpuShaderOpClass *) op->op_class;
+          gsize vertex_offset;
+
+          vertex_offset = gsk_gpu_frame_reserve_vertex_data (self, shader_class->vertex_size);
+          for (j = 1; j < shader->n_ops; j++)
+            gsk_gpu_frame_reserve_vertex_data (self, shader_class->vertex_size);
+
+          memcpy (gsk_gpu_frame_get_vertex_data (self, vertex_offset),
+                  vertex_data + shader->vertex_offset,
+                  shader->n_ops * shader_class->vertex_size);
+          shader->vertex_offset = vertex_offset;
+        }
+    }
+}
+
+static void
+gsk_gpu_frame_append_arena (GskGpuFrame      *self,
+                            GskGpuFrameArena *arena)
+{
+  gsk_gpu_frame_append_ops (self,
+                            gsk_gpu_ops_get_data (&arena->ops),
+                            gsk_gpu_ops_get_size (&arena->ops),
+                            arena->vertex_data);
+}
+
+/*<private>
+ * gsk_gpu_frame_record_parallel:
+ * @self: a frame
+ * @func: the function recording ops
+ * @data: data to pass to @func
+ * @n_tasks: how often to call @func
+ *
+ * Calls @func @n_tasks times, potentially in parallel on multiple
+ * threads. The ops that each call records are appended to the
+ * frame in the order of the task index, so the result is the same
+ * as calling @func in order on the current thread.
+ * Ops allocated with gsk_gpu_frame_alloc_prelude_op() are appended
+ * before all of them.
+ *
+ * While this runs, @func may only access the device and the frame
+ * through functions that take the device lock.
+ */
+void
+gsk_gpu_frame_record_parallel (GskGpuFrame           *self,
+                               GskGpuFrameRecordFunc  func,
+                               gpointer               data,
+                               guint                  n_tasks)
+{
+  GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
+  GskGpuFrameArena *current;
+  GskGpuFrameArena prelude = { .frame = self, };
+  ParallelRecord record;
+  guint i;
+
+  record.func = func;
+  record.data = data;
+  record.arenas = g_new0 (GskGpuFrameArena, n_tasks);
+  for (i = 0; i < n_tasks; i++)
+    {
+      record.arenas[i].frame = self;
+      gsk_gpu_ops_init (&record.arenas[i].ops);
+    }
+
+  gsk_gpu_ops_init (&prelude.ops);
+  priv->prelude = &prelude;
+
+  gsk_gpu_device_begin_parallel (priv->device, priv->timestamp);
+  gdk_parallel_task_run (gsk_gpu_frame_record_task, &record, n_tasks);
+  gsk_gpu_device_end_parallel (priv->device);
+
+  priv->prelude = NULL;
+  current = gsk_gpu_frame_get_arena (self);
+
+  gsk_gpu_frame_append_arena (self, &prelude);
+  gsk_gpu_ops_clear (&prelude.ops);
+
+  for (i = 0; i < n_tasks; i++)
+    {
+      gsk_gpu_frame_append_arena (self, &record.arenas[i]);
+      if (current && record.arenas[i].unretainable)
+        current->unretainable = TRUE;
+
+      /* The ops have been moved, so don't finish them */
+      gsk_gpu_ops_clear (&record.arenas[i].ops);
+      g_free (record.arenas[i].vertex_data);
+    }
+
+  g_free (record.arenas);
+}
+
+static gboolean
+gsk_gpu_op_is_retainable (const GskGpuOp *op)
+{
+  if (op->op_class->stage == GSK_GPU_STAGE_SHADER)
+    return ((const GskGpuShaderOp *) op)->desc == NULL;
+
+  return op->op_class->retainable;
+}
+
+/*<private>
+ * gsk_gpu_frame_begin_recording:
+ * @self: a frame
+ *
+ * Starts collecting the ops that get recorded from now on, so that
+ * they can be retained for later frames.
+ *
+ * Recordings can be nested, and they must be ended with
+ * gsk_gpu_frame_end_recording() on the same thread.
+ */
+void
+gsk_gpu_frame_begin_recording (GskGpuFrame *self)
+{
+  GskGpuFrameArena *arena;
+
+  arena = g_new0 (GskGpuFrameArena, 1);
+  arena->frame = self;
+  arena->parent = g_private_get (&current_arena);
+  arena->nested = g_array_new (FALSE, FALSE, sizeof (NestedRecording));
+  gsk_gpu_ops_init (&arena->ops);
+
+  g_private_set (&current_arena, arena);
+}
+
+static void
+gsk_gpu_recording_add_ops (GArray                 *parts,
+                           const GskGpuFrameArena *arena,
+                           gsize                   ops_start,
+                           gsize                   ops_end,
+                           gsize                   vertex_start,
+                           gsize                   vertex_end)
+{
+  GskGpuRecordingPart part = { 0, };
+  GskGpuOp *op;
+  gsize i;
+
+  if (ops_start == ops_end)
+    return;
+
+  part.ops_size = ops_end - ops_start;
+  part.ops = g_memdup2 (gsk_gpu_ops_index (&arena->ops, ops_start), part.ops_size);
+  part.vertex_data_size = vertex_end - vertex_start;
+  part.vertex_data = g_memdup2 (arena->vertex_data + vertex_start, part.vertex_data_size);
+
+  /* The vertices of these ops are all in this range */
+  for (i = 0; i < part.ops_size; i += op->op_class->size)
+    {
+      op = (GskGpuOp *) (part.ops + i);
+      if (op->op_class->stage == GSK_GPU_STAGE_SHADER)
+        ((GskGpuShaderOp *) op)->vertex_offset -= vertex_start;
+    }
+
+  g_array_append_val (parts, part);
+}
+
+static GskGpuRecording *
+gsk_gpu_recording_new (const GskGpuFrameArena *arena,
+                       guint                   flags)
+{
+  GskGpuRecording *self;
+  GArray *parts;
+  gsize i, ops_pos, vertex_pos;
+
+  parts = g_array_new (FALSE, FALSE, sizeof (GskGpuRecordingPart));
+  ops_pos = 0;
+  vertex_pos = 0;
+
+  for (i = 0; i < arena->nested->len; i++)
+    {
+      const NestedRecording *nested = &g_array_index (arena->nested, NestedRecording, i);
+      GskGpuRecordingPart part = { 0, };
+
+      gsk_gpu_recording_add_ops (parts, arena,
+                                 ops_pos, nested->ops_start,
+                                 vertex_pos, nested->vertex_start);
+
+      part.nested = gsk_gpu_recording_ref (nested->recording);
+      g_array_append_val (parts, part);
+
+      ops_pos = nested->ops_end;
+      vertex_pos = nested->vertex_end;
+    }
+
+  gsk_gpu_recording_add_ops (parts, arena,
+                             ops_pos, gsk_gpu_ops_get_size (&arena->ops),
+                             vertex_pos, arena->vertex_data_used);
+
+  self = g_new (GskGpuRecording, 1);
+  g_atomic_ref_count_init (&self->ref_count);
+  self->flags = flags;
+  self->n_parts = parts->len;
+  self->parts = (GskGpuRecordingPart *) g_array_free (parts, FALSE);
+
+  /* Nested recordings are accounted for by themselves */
+  self->size = sizeof (GskGpuRecording) + self->n_parts * sizeof (GskGpuRecordingPart);
+  for (i = 0; i < self->n_parts; i++)
+    self->size += self->parts[i].ops_size + self->parts[i].vertex_data_size;
+
+  return self;
+}
+
+static void
+gsk_gpu_frame_arena_clear_nested (GskGpuFrameArena *arena)
+{
+  gsize i;
+
+  for (i = 0; i < arena->nested->len; i++)
+    gsk_gpu_recording_unref (g_array_index (arena->nested, NestedRecording, i).recording);
+  g_array_unref (arena->nested);
+}
+
+static void
+gsk_gpu_frame_append_recording_ops (GskGpuFrame     *self,
+                                    GskGpuRecording *recording)
+{
+  gsize i;
+
+  for (i = 0; i < recording->n_parts; i++)
+    {
+      const GskGpuRecordingPart *part = &recording->parts[i];
+
+      if (part->nested)
+        gsk_gpu_frame_append_recording_ops (self, part->nested);
+      else
+        gsk_gpu_frame_append_ops (self, part->ops, part->ops_size, part->vertex_data);
+    }
+}
+
+/* Appends the ops of @recording to the frame. If a recording is being
+ * made, it remembers where they are, so that it can reference @recording
+ * instead of copying the ops.
+ */
+static void
+gsk_gpu_frame_append_recording (GskGpuFrame     *self,
+                                GskGpuRecording *recording)
+{
+  GskGpuFrameArena *arena = gsk_gpu_frame_get_arena (self);
+  NestedRecording nested;
+
+  if (arena == NULL || arena->nested == NULL)
+    {
+      gsk_gpu_frame_append_recording_ops (self, recording);
+      return;
+    }
+
+  nested.ops_start = gsk_gpu_ops_get_size (&arena->ops);
+  nested.vertex_start = arena->vertex_data_used;
+
+  gsk_gpu_frame_append_recording_ops (self, recording);
+
+  nested.ops_end = gsk_gpu_ops_get_size (&arena->ops);
+  nested.vertex_end = arena->vertex_data_used;
+  nested.recording = gsk_gpu_recording_ref (recording);
+  g_array_append_val (arena->nested, nested);
+
+  /* The next op must not be merged into the ops of the nested recording */
+  arena->last_op = NULL;
+}
+
+/*<private>
+ * gsk_gpu_frame_end_recording:
+ * @self: a frame
+ * @flags: flags to store with the recording
+ *
+ * Ends the recording started with gsk_gpu_frame_begin_recording()
+ * and adds the recorded ops to the frame.
+ *
+ * If all recorded ops can be used in later frames, a copy of them is
+ * returned, which can be passed to gsk_gpu_frame_replay_recording().
+ *
+ * Returns: (transfer full) (nullable): the recording
+ */
+GskGpuRecording *
+gsk_gpu_frame_end_recording (GskGpuFrame *self,
+                             guint        flags)
+{
+  GskGpuFrameArena *arena = g_private_get (&current_arena);
+  GskGpuRecording *recording = NULL;
+  const GskGpuOp *op;
+  gsize i;
+
+  g_assert (arena != NULL && arena->frame == self && arena->nested != NULL);
+
+  g_private_set (&current_arena, arena->parent);
+
+  for (i = 0; i < gsk_gpu_ops_get_size (&arena->ops); i += op->op_class->size)
+    {
+      op = (const GskGpuOp *) gsk_gpu_ops_index (&arena->ops, i);
+      if (!gsk_gpu_op_is_retainable (op))
+        {
+          arena->unretainable = TRUE;
+          break;
+        }
+    }
+
+  if (!arena->unretainable)
+    {
+      recording = gsk_gpu_recording_new (arena, flags);
+      /* Let the parent reference the recording instead of copying it */
+      gsk_gpu_frame_append_recording (self, recording);
+    }
+  else
+    {
+      if (arena->parent && arena->parent->frame == self)
+        arena->parent->unretainable = TRUE;
+
+      gsk_gpu_frame_append_arena (self, arena);
+    }
+
+  /* The ops have been moved, so don't finish them */
+  gsk_gpu_ops_clear (&arena->ops);
+  gsk_gpu_frame_arena_clear_nested (arena);
+  g_free (arena->vertex_data);
+  g_free (arena);
+
+  return recording;
+}
+
+/*<private>
+ * gsk_gpu_frame_mark_unretainable:
+ * @self: a frame
+ *
+ * Makes sure that the currently active recordings don't get retained,
+ * because the ops depend on state outside of the render nodes.
+ */
+void
+gsk_gpu_frame_mark_unretainable (GskGpuFrame *self)
+{
+  GskGpuFrameArena *arena = gsk_gpu_frame_get_arena (self);
+
+  if (arena)
+    arena->unretainable = TRUE;
+}
+
+/*<private>
+ * gsk_gpu_frame_replay_recording:
+ * @self: a frame
+ * @recording: a recording
+ *
+ * Adds the ops of a recording made with gsk_gpu_frame_end_recording()
+ * in this or a previous frame.
+ */
+void
+gsk_gpu_frame_replay_recording (GskGpuFrame     *self,
+                                GskGpuRecording *recording)
+{
+  gsk_gpu_frame_append_recording (self, recording);
+}
+
+guint
+gsk_gpu_recording_get_flags (const GskGpuRecording *self)
+{
+  return self->flags;
+}
+
+gsize
+gsk_gpu_recording_get_size (const GskGpuRecording *self)
+{
+  return self->size;
+}
+
+GskGpuRecording *
+gsk_gpu_recording_ref (GskGpuRecording *self)
+{
+  g_atomic_ref_count_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+gsk_gpu_recording_unref (GskGpuRecording *self)
+{
+  gsize i;
+
+  if (!g_atomic_ref_count_dec (&self->ref_count))
+    return;
+
+  for (i = 0; i < self->n_parts; i++)
+    {
+      if (self->parts[i].nested)
+        gsk_gpu_recording_unref (self->parts[i].nested);
+      g_free (self->parts[i].ops);
+      g_free (self->parts[i].vertex_data);
+    }
+  g_free (self->parts);
+  g_free (self);
 }
 
 gboolean
@@ -581,6 +1191,101 @@ gsk_gpu_frame_record_rect (GskGpuFrame                 *self,
                               GSK_RENDER_PASS_PRESENT);
 }
 
+/* Merging two damage rectangles is worth it if it costs less than
+ * this many extra pixels, as every rectangle means drawing the
+ * nodes that touch it again.
+ */
+#define DAMAGE_MERGE_PIXELS (64 * 64)
+/* Don't bother with finding the best merges for huge regions */
+#define DAMAGE_MAX_INPUT_RECTS 64
+
+static inline gsize
+rect_area (const cairo_rectangle_int_t *rect)
+{
+  return (gsize) rect->width * rect->height;
+}
+
+/* Reduces the damage to at most GSK_GPU_NODE_PROCESSOR_MAX_RECTS
+ * rectangles, by greedily merging the ones that waste the least
+ * pixels when replaced with their bounding box.
+ * The resulting rectangles still don't overlap each other.
+ *
+ * Returns: the number of rectangles in @rects
+ */
+static gsize
+gsk_gpu_frame_merge_damage (const cairo_region_t  *damage,
+                            cairo_rectangle_int_t *rects)
+{
+  gsize n_rects, i, j, k;
+
+  n_rects = cairo_region_num_rectangles (damage);
+  if (n_rects > DAMAGE_MAX_INPUT_RECTS)
+    {
+      cairo_region_get_extents (damage, &rects[0]);
+      return 1;
+    }
+
+  for (i = 0; i < n_rects; i++)
+    cairo_region_get_rectangle (damage, i, &rects[i]);
+
+  while (n_rects > 1)
+    {
+      gsize best_i = 0, best_j = 1;
+      gssize best_waste = G_MAXSSIZE;
+      cairo_rectangle_int_t merged;
+      gboolean changed;
+
+      for (i = 0; i < n_rects; i++)
+        {
+          for (j = i + 1; j < n_rects; j++)
+            {
+              gssize waste;
+
+              gdk_rectangle_union (&rects[i], &rects[j], &merged);
+              waste = rect_area (&merged) - rect_area (&rects[i]) - rect_area (&rects[j]);
+              if (waste < best_waste)
+                {
+                  best_waste = waste;
+                  best_i = i;
+                  best_j = j;
+                }
+            }
+        }
+
+      if (n_rects <= GSK_GPU_NODE_PROCESSOR_MAX_RECTS &&
+          best_waste > DAMAGE_MERGE_PIXELS)
+        break;
+
+      gdk_rectangle_union (&rects[best_i], &rects[best_j], &merged);
+      rects[best_j] = rects[--n_rects];
+      if (best_i == n_rects)
+        best_i = best_j;
+
+      /* The bounding box may overlap others, swallow them, too */
+      do
+        {
+          changed = FALSE;
+          for (k = 0; k < n_rects; k++)
+            {
+              if (k == best_i || !gdk_rectangle_intersect (&merged, &rects[k], NULL))
+                continue;
+
+              gdk_rectangle_union (&merged, &rects[k], &merged);
+              rects[k] = rects[--n_rects];
+              if (best_i == n_rects)
+                best_i = k;
+              changed = TRUE;
+              break;
+            }
+        }
+      while (changed);
+
+      rects[best_i] = merged;
+    }
+
+  return n_rects;
+}
+
 static void
 gsk_gpu_frame_record (GskGpuFrame            *self,
                       gint64                  timestamp,
@@ -594,15 +1299,47 @@ gsk_gpu_frame_record (GskGpuFrame            *self,
 
   priv->timestamp = timestamp;
 
-  if (clip)
+  if (clip && cairo_region_num_rectangles (clip) > 1)
     {
-      int i;
+      cairo_rectangle_int_t rects[DAMAGE_MAX_INPUT_RECTS];
+      cairo_region_t *region;
+      gsize n_rects;
+
+      n_rects = gsk_gpu_frame_merge_damage (clip, rects);
 
-      for (i = 0; i < cairo_region_num_rectangles (clip); i++)
+      if (n_rects == 1)
+        {
+          gsk_gpu_frame_record_rect (self, target, &rects[0], node, viewport);
+        }
+      else
+        {
+          /* One pass and one walk of the node tree for all the rects */
+          region = cairo_region_create_rectangles (rects, n_rects);
+          gsk_gpu_render_pass_begin_region_op (self,
+                                               target,
+                                               region,
+                                               GSK_RENDER_PASS_PRESENT);
+          cairo_region_destroy (region);
+
+          gsk_gpu_node_processor_process_rects (self,
+                                                target,
+                                                rects,
+                                                n_rects,
+                                                node,
+                                                viewport);
+
+          gsk_gpu_render_pass_end_op (self,
+                                      target,
+                                      GSK_RENDER_PASS_PRESENT);
+        }
+    }
+  else if (clip)
+    {
+      if (cairo_region_num_rectangles (clip) == 1)
         {
           cairo_rectangle_int_t rect;
 
-          cairo_region_get_rectangle (clip, i, &rect);
+          cairo_region_get_rectangle (clip, 0, &rect);
           gsk_gpu_frame_record_rect (self, target, &rect, node, viewport);
         }
     }
@@ -623,6 +1360,181 @@ gsk_gpu_frame_record (GskGpuFrame            *self,
     gsk_gpu_download_op (self, target, TRUE, copy_texture, texture);
 }
 
+/*<private>
+ * gsk_gpu_frame_should_measure:
+ * @self: a `GskGpuFrame`
+ *
+ * Checks if backends should emit timestamp queries around the
+ * commands they submit, so the GPU time spent per op can be reported.
+ *
+ * Returns: %TRUE if GPU time should be measured
+ */
+gboolean
+gsk_gpu_frame_should_measure (GskGpuFrame *self)
+{
+  return GSK_DEBUG_CHECK (TIMINGS) || gdk_profiler_is_running ();
+}
+
+/*<private>
+ * gsk_gpu_frame_add_timestamp:
+ * @self: a `GskGpuFrame`
+ * @op: (nullable): the op whose command is about to be submitted
+ *   or %NULL after the last command
+ *
+ * Registers a timestamp query that the backend is about to write
+ * before submitting the command for @op.
+ *
+ * Returns: the index of the query
+ */
+guint
+gsk_gpu_frame_add_timestamp (GskGpuFrame *self,
+                             GskGpuOp    *op)
+{
+  GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
+
+  g_ptr_array_add (priv->timestamp_names,
+                   op ? (gpointer) op->op_class->name : NULL);
+
+  return priv->timestamp_names->len - 1;
+}
+
+guint
+gsk_gpu_frame_get_n_timestamps (GskGpuFrame *self)
+{
+  GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
+
+  return priv->timestamp_names->len;
+}
+
+typedef struct _GskGpuTiming GskGpuTiming;
+
+struct _GskGpuTiming
+{
+  const char *name;
+  guint64 time;
+  guint n_commands;
+};
+
+static void
+gsk_gpu_frame_report_timing (GskGpuFrame        *self,
+                             const GskGpuTiming *timing)
+{
+  GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
+  static GHashTable *counters = NULL;
+  GskProfiler *profiler;
+  char *timer_name;
+  GQuark timer_id;
+
+  timer_name = g_strconcat ("gpu-", timing->name, NULL);
+
+  if (gdk_profiler_is_running ())
+    {
+      guint counter_id;
+
+      if (counters == NULL)
+        counters = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+      counter_id = GPOINTER_TO_UINT (g_hash_table_lookup (counters, timer_name));
+      if (counter_id == 0)
+        {
+          char *description = g_strdup_printf ("GPU time spent in %s (ms)", timing->name);
+          counter_id = gdk_profiler_define_counter (timer_name, description);
+          g_hash_table_insert (counters, g_strdup (timer_name), GUINT_TO_POINTER (counter_id));
+          g_free (description);
+        }
+
+      gdk_profiler_set_counter (counter_id, timing->time / 1000000.0);
+    }
+
+  profiler = gsk_renderer_get_profiler (GSK_RENDERER (priv->renderer));
+  timer_id = g_quark_from_string (timer_name);
+  if (!gsk_profiler_has_timer (profiler, timer_id))
+    {
+      char *description = g_strdup_printf ("GPU %s", timing->name);
+      gsk_profiler_add_timer (profiler, timer_name, description, FALSE, TRUE);
+      g_free (description);
+    }
+  gsk_profiler_timer_set (profiler, timer_id, timing->time / 1000);
+
+  g_free (timer_name);
+}
+
+/*<private>
+ * gsk_gpu_frame_report_timestamps:
+ * @self: a `GskGpuFrame`
+ * @timestamps: (array): the results of the queries registered with
+ *   gsk_gpu_frame_add_timestamp(), in nanoseconds
+ *
+ * Sums up the GPU time spent per op and reports it via GSK_DEBUG=timings,
+ * sysprof counters and the renderer's profiler.
+ *
+ * The registered queries are cleared afterwards.
+ */
+void
+gsk_gpu_frame_report_timestamps (GskGpuFrame   *self,
+                                 const guint64 *timestamps)
+{
+  GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
+  GskGpuTiming total = { "time", 0, 0 };
+  GArray *timings;
+  guint i, j;
+
+  timings = g_array_new (FALSE, FALSE, sizeof (GskGpuTiming));
+
+  for (i = 0; i + 1 < priv->timestamp_names->len; i++)
+    {
+      const char *name = g_ptr_array_index (priv->timestamp_names, i);
+      GskGpuTiming *timing;
+      guint64 time;
+
+      if (name == NULL)
+        continue;
+
+      /* timestamps may wrap or be reordered by the driver */
+      time = timestamps[i + 1] > timestamps[i] ? timestamps[i + 1] - timestamps[i] : 0;
+
+      for (j = 0; j < timings->len; j++)
+        {
+          if (g_array_index (timings, GskGpuTiming, j).name == name)
+            break;
+        }
+      if (j == timings->len)
+        g_array_append_val (timings, ((GskGpuTiming) { name, 0, 0 }));
+
+      timing = &g_array_index (timings, GskGpuTiming, j);
+      timing->time += time;
+      timing->n_commands++;
+      total.time += time;
+      total.n_commands++;
+    }
+
+  if (GSK_DEBUG_CHECK (TIMINGS))
+    {
+      GString *string = g_string_new (NULL);
+
+      g_string_append_printf (string, "GPU time: %.3fms for %u commands\n",
+                              total.time / 1000000.0, total.n_commands);
+      for (j = 0; j < timings->len; j++)
+        {
+          const GskGpuTiming *timing = &g_array_index (timings, GskGpuTiming, j);
+
+          g_string_append_printf (string, "  %-24s %8.3fms %5u\n",
+                                  timing->name, timing->time / 1000000.0, timing->n_commands);
+        }
+
+      gdk_debug_message ("%s", string->str);
+      g_string_free (string, TRUE);
+    }
+
+  if (total.n_commands > 0)
+    gsk_gpu_frame_report_timing (self, &total);
+  for (j = 0; j < timings->len; j++)
+    gsk_gpu_frame_report_timing (self, &g_array_index (timings, GskGpuTiming, j));
+
+  g_array_unref (timings);
+  g_ptr_array_set_size (priv->timestamp_names, 0);
+}
+
 static void
 gsk_gpu_frame_submit (GskGpuFrame *self)
 {
@@ -40,6 +40,10 @@ struct _GskGpuFrameClass
                                                                          GskGpuOp               *op);
 };
 
+typedef void (* GskGpuFrameRecordFunc) (GskGpuFrame *frame,
+                                        guint        task_index,
+                                        gpointer     data);
+
 GType                   gsk_gpu_frame_get_type                          (void) G_GNUC_CONST;
 
 
@@ -56,6 +60,8 @@ gboolean                gsk_gpu_frame_should_optimize                   (GskGpuF
 
 gpointer                gsk_gpu_frame_alloc_op                          (GskGpuFrame            *self,
                                                                          gsize                   size);
+gpointer                gsk_gpu_frame_alloc_prelude_op                  (GskGpuFrame            *self,
+                                                                         gsize                   size);
 GskGpuImage *           gsk_gpu_frame_upload_texture                    (GskGpuFrame            *self,
                                                                          gboolean                with_mipmap,
                                                                          GdkTexture             *texture);
@@ -68,6 +74,28 @@ GskGpuBuffer *          gsk_gpu_frame_write_storage_buffer              (GskGpuF
                                                                          const guchar           *data,
                                                                          gsize                   size,
                                                                          gsize                  *out_offset);
+void                    gsk_gpu_frame_record_parallel                   (GskGpuFrame            *self,
+                                                                         GskGpuFrameRecordFunc   func,
+                                                                         gpointer                data,
+                                                                         guint                   n_tasks);
+void                    gsk_gpu_frame_begin_recording                   (GskGpuFrame            *self);
+GskGpuRecording *       gsk_gpu_frame_end_recording                     (GskGpuFrame            *self,
+                                                                         guint                   flags);
+void                    gsk_gpu_frame_mark_unretainable                 (GskGpuFrame            *self);
+void                    gsk_gpu_frame_replay_recording                  (GskGpuFrame            *self,
+                                                                         GskGpuRecording        *recording);
+
+guint                   gsk_gpu_recording_get_flags                     (const GskGpuRecording  *self);
+gsize                   gsk_gpu_recording_get_size                      (const GskGpuRecording  *self);
+GskGpuRecording *       gsk_gpu_recording_ref                           (GskGpuRecording        *self);
+void                    gsk_gpu_recording_unref                         (GskGpuRecording        *self);
+
+gboolean                gsk_gpu_frame_should_measure                    (GskGpuFrame            *self);
+guint                   gsk_gpu_frame_add_timestamp                     (GskGpuFrame            *self,
+                                                                         GskGpuOp               *op);
+guint                   gsk_gpu_frame_get_n_timestamps                  (GskGpuFrame            *self);
+void                    gsk_gpu_frame_report_timestamps                 (GskGpuFrame            *self,
+                                                                         const guint64          *timestamps);
 
 gboolean                gsk_gpu_frame_is_busy                           (GskGpuFrame            *self);
 void                    gsk_gpu_frame_wait                              (GskGpuFrame            *self);
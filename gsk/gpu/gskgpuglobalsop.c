@@ -81,6 +81,7 @@ gsk_gpu_globals_op_gl_command (GskGpuOp          *op,
 }
 
 static const GskGpuOpClass GSK_GPU_GLOBALS_OP_CLASS = {
+  "globals",
   GSK_GPU_OP_SIZE (GskGpuGlobalsOp),
   GSK_GPU_STAGE_COMMAND,
   gsk_gpu_globals_op_finish,
@@ -88,7 +89,8 @@ static const GskGpuOpClass GSK_GPU_GLOBALS_OP_CLASS = {
 #ifdef GDK_RENDERING_VULKAN
   gsk_gpu_globals_op_vk_command,
 #endif
-  gsk_gpu_globals_op_gl_command
+  gsk_gpu_globals_op_gl_command,
+  TRUE
 };
 
 void
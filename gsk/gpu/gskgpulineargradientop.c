@@ -32,6 +32,7 @@ gsk_gpu_linear_gradient_op_print_instance (GskGpuShaderOp *shader,
 
 static const GskGpuShaderOpClass GSK_GPU_LINEAR_GRADIENT_OP_CLASS = {
   {
+    "lineargradient",
     GSK_GPU_OP_SIZE (GskGpuLinearGradientOp),
     GSK_GPU_STAGE_SHADER,
     gsk_gpu_shader_op_finish,
@@ -29,6 +29,7 @@ gsk_gpu_mask_op_print_instance (GskGpuShaderOp *shader,
 
 static const GskGpuShaderOpClass GSK_GPU_MASK_OP_CLASS = {
   {
+    "mask",
     GSK_GPU_OP_SIZE (GskGpuMaskOp),
     GSK_GPU_STAGE_SHADER,
     gsk_gpu_shader_op_finish,
@@ -3,6 +3,8 @@
 #include "gskgpumipmapopprivate.h"
 
 #include "gskglimageprivate.h"
+#include "gskgpudeviceprivate.h"
+#include "gskgpuframeprivate.h"
 #include "gskgpuprintprivate.h"
 #ifdef GDK_RENDERING_VULKAN
 #include "gskvulkanimageprivate.h"
@@ -167,6 +169,7 @@ gsk_gpu_mipmap_op_gl_command (GskGpuOp          *op,
 }
 
 static const GskGpuOpClass GSK_GPU_MIPMAP_OP_CLASS = {
+  "mipmap",
   GSK_GPU_OP_SIZE (GskGpuMipmapOp),
   GSK_GPU_STAGE_PASS,
   gsk_gpu_mipmap_op_finish,
@@ -181,13 +184,29 @@ void
 gsk_gpu_mipmap_op (GskGpuFrame *frame,
                    GskGpuImage *image)
 {
+  GskGpuDevice *device = gsk_gpu_frame_get_device (frame);
   GskGpuMipmapOp *self;
 
+  /* When recording in parallel, other threads may want to
+   * mipmap the same image. Whoever comes first does it, and
+   * it must happen before any of them samples the image. */
+  gsk_gpu_device_lock (device);
+
   g_assert ((gsk_gpu_image_get_flags (image) & (GSK_GPU_IMAGE_CAN_MIPMAP | GSK_GPU_IMAGE_MIPMAP)) == GSK_GPU_IMAGE_CAN_MIPMAP);
 
-  self = (GskGpuMipmapOp *) gsk_gpu_op_alloc (frame, &GSK_GPU_MIPMAP_OP_CLASS);
+  if (gsk_gpu_device_is_shared_image (device, image))
+    {
+      self = (GskGpuMipmapOp *) gsk_gpu_frame_alloc_prelude_op (frame, GSK_GPU_MIPMAP_OP_CLASS.size);
+      ((GskGpuOp *) self)->op_class = &GSK_GPU_MIPMAP_OP_CLASS;
+    }
+  else
+    {
+      self = (GskGpuMipmapOp *) gsk_gpu_op_alloc (frame, &GSK_GPU_MIPMAP_OP_CLASS);
+    }
 
   self->image = g_object_ref (image);
 
   gsk_gpu_image_set_flags (image, GSK_GPU_IMAGE_MIPMAP);
+
+  gsk_gpu_device_unlock (device);
 }
@@ -23,11 +23,13 @@
 #include "gskgpulineargradientopprivate.h"
 #include "gskgpumaskopprivate.h"
 #include "gskgpumipmapopprivate.h"
+#include "gskgpupathopprivate.h"
 #include "gskgpuradialgradientopprivate.h"
 #include "gskgpurenderpassopprivate.h"
 #include "gskgpuroundedcoloropprivate.h"
 #include "gskgpuscissoropprivate.h"
 #include "gskgpustraightalphaopprivate.h"
+#include "gskgputessellationprivate.h"
 #include "gskgputextureopprivate.h"
 #include "gskgpuuberopprivate.h"
 #include "gskgpuuploadopprivate.h"
@@ -42,6 +44,7 @@
 #include "gsktransformprivate.h"
 #include "gskprivate.h"
 
+#include "gdk/gdkparalleltaskprivate.h"
 #include "gdk/gdkrgbaprivate.h"
 #include "gdk/gdksubsurfaceprivate.h"
 
@@ -120,6 +123,33 @@ struct _GskGpuNodeProcessor
   float                          opacity;
 
   GskGpuGlobals                  pending_globals;
+
+  gboolean                       parallel;
+};
+
+/* Containers with fewer children are not worth recording in parallel */
+#define PARALLEL_MIN_CHILDREN 4
+/* More tasks than threads, so the threads that finish early can pick
+ * up the remaining work */
+#define PARALLEL_TASKS_PER_THREAD 4
+
+/* Smaller containers are cheaper to walk than to look up and replay */
+#define RETAIN_MIN_CHILDREN 8
+
+/* The state that recorded ops depend on. Retained ops can only be
+ * replayed if it is the same. */
+typedef struct _RetainKey RetainKey;
+
+struct _RetainKey
+{
+  float                          modelview[16];
+  float                          projection[16];
+  float                          offset[2];
+  float                          scale[2];
+  GskGpuClip                     clip;
+  cairo_rectangle_int_t          scissor;
+  GskGpuBlend                    blend;
+  float                          opacity;
 };
 
 #define GDK_ARRAY_NAME pattern_buffer
@@ -202,6 +232,7 @@ gsk_gpu_node_processor_init (GskGpuNodeProcessor         *self,
                                       -viewport->origin.y);
   self->opacity = 1.0;
   self->pending_globals = GSK_GPU_GLOBAL_MATRIX | GSK_GPU_GLOBAL_SCALE | GSK_GPU_GLOBAL_CLIP | GSK_GPU_GLOBAL_SCISSOR | GSK_GPU_GLOBAL_BLEND;
+  self->parallel = FALSE;
 }
 
 static void
@@ -261,12 +292,16 @@ gsk_gpu_node_processor_add_image (GskGpuNodeProcessor *self,
                                   GskGpuImage         *image,
                                   GskGpuSampler        sampler)
 {
+  GskGpuDevice *device = gsk_gpu_frame_get_device (self->frame);
   guint32 descriptor;
 
+  /* Descriptors may share their storage with other threads */
+  gsk_gpu_device_lock (device);
+
   if (self->desc != NULL)
     {
       if (gsk_gpu_descriptors_add_image (self->desc, image, sampler, &descriptor))
-        return descriptor;
+        goto out;
 
       g_object_unref (self->desc);
     }
@@ -276,9 +311,12 @@ gsk_gpu_node_processor_add_image (GskGpuNodeProcessor *self,
   if (!gsk_gpu_descriptors_add_image (self->desc, image, sampler, &descriptor))
     {
       g_assert_not_reached ();
-      return 0;
+      descriptor = 0;
     }
-  
+
+out:
+  gsk_gpu_device_unlock (device);
+
   return descriptor;
 }
 
@@ -396,12 +434,191 @@ gsk_gpu_node_processor_process (GskGpuFrame                 *frame,
                                target,
                                clip,
                                viewport);
+  self.parallel = gsk_gpu_frame_should_optimize (frame, GSK_GPU_OPTIMIZE_PARALLEL) &&
+                  gdk_parallel_task_get_n_threads () > 1;
 
   gsk_gpu_node_processor_add_node (&self, node);
 
   gsk_gpu_node_processor_finish (&self);
 }
 
+/* We track the rectangles in a bitmask */
+#define MAX_REGION_RECTS GSK_GPU_NODE_PROCESSOR_MAX_RECTS
+G_STATIC_ASSERT (MAX_REGION_RECTS <= 32);
+
+typedef struct _GskGpuRegionRects GskGpuRegionRects;
+
+struct _GskGpuRegionRects
+{
+  gsize n_rects;
+  gsize current;
+  /* in device coordinates */
+  cairo_rectangle_int_t scissors[MAX_REGION_RECTS];
+  /* in the basic coordinate system */
+  graphene_rect_t clips[MAX_REGION_RECTS];
+};
+
+static void
+gsk_gpu_node_processor_select_rect (GskGpuNodeProcessor *self,
+                                   GskGpuRegionRects   *rects,
+                                   gsize                i)
+{
+  if (rects->current == i)
+    return;
+
+  self->scissor = rects->scissors[i];
+  gsk_gpu_clip_init_empty (&self->clip, &rects->clips[i]);
+  self->pending_globals |= GSK_GPU_GLOBAL_CLIP | GSK_GPU_GLOBAL_SCISSOR;
+  rects->current = i;
+}
+
+/* Walks the node tree once for all rectangles.
+ *
+ * We only look at containers and translations here, as they
+ * don't need any state but the offset. We cull their children
+ * against all rectangles at once and only draw the leaves once
+ * for every rectangle they intersect.
+ * As the rectangles don't overlap, every pixel still sees the
+ * nodes in the right order.
+ */
+static void
+gsk_gpu_node_processor_add_node_rects (GskGpuNodeProcessor *self,
+                                       GskGpuRegionRects   *rects,
+                                       GskRenderNode       *node,
+                                       guint32              mask)
+{
+  graphene_rect_t bounds;
+  gsize i;
+
+  if (node->bounds.size.width == 0 || node->bounds.size.height == 0)
+    return;
+
+  gsk_rect_init_offset (&bounds, &node->bounds, self->offset.x, self->offset.y);
+  for (i = 0; i < rects->n_rects; i++)
+    {
+      if ((mask & (1u << i)) && !gsk_rect_intersects (&rects->clips[i], &bounds))
+        mask &= ~(1u << i);
+    }
+
+  if (mask == 0)
+    return;
+
+  /* more than one rectangle left */
+  if (mask & (mask - 1))
+    {
+      switch ((guint) gsk_render_node_get_node_type (node))
+        {
+        case GSK_CONTAINER_NODE:
+          for (i = 0; i < gsk_container_node_get_n_children (node); i++)
+            gsk_gpu_node_processor_add_node_rects (self, rects, gsk_container_node_get_child (node, i), mask);
+          return;
+
+        case GSK_TRANSFORM_NODE:
+          {
+            GskTransform *transform = gsk_transform_node_get_transform (node);
+
+            if (gsk_transform_get_category (transform) >= GSK_TRANSFORM_CATEGORY_2D_TRANSLATE)
+              {
+                graphene_point_t old_offset;
+                float dx, dy;
+
+                gsk_transform_to_translate (transform, &dx, &dy);
+                old_offset = self->offset;
+                self->offset.x += dx;
+                self->offset.y += dy;
+                gsk_gpu_node_processor_add_node_rects (self, rects, gsk_transform_node_get_child (node), mask);
+                self->offset = old_offset;
+                return;
+              }
+          }
+          break;
+
+        case GSK_DEBUG_NODE:
+          gsk_gpu_node_processor_add_node_rects (self, rects, gsk_debug_node_get_child (node), mask);
+          return;
+
+        default:
+          break;
+        }
+    }
+
+  for (i = 0; i < rects->n_rects; i++)
+    {
+      if ((mask & (1u << i)) == 0)
+        continue;
+
+      gsk_gpu_node_processor_select_rect (self, rects, i);
+      gsk_gpu_node_processor_add_node (self, node);
+    }
+}
+
+/*<private>
+ * gsk_gpu_node_processor_process_rects:
+ * @frame: the frame
+ * @target: the image to render to
+ * @clips: the rectangles to render. They must not overlap.
+ * @n_clips: the number of rectangles, at most
+ *   GSK_GPU_NODE_PROCESSOR_MAX_RECTS
+ * @node: the node to render
+ * @viewport: the viewport
+ *
+ * Renders @node into all the @clips, walking the node tree only once.
+ * The caller must have started a render pass that covers all of them.
+ */
+void
+gsk_gpu_node_processor_process_rects (GskGpuFrame                 *frame,
+                                      GskGpuImage                 *target,
+                                      const cairo_rectangle_int_t *clips,
+                                      gsize                        n_clips,
+                                      GskRenderNode               *node,
+                                      const graphene_rect_t       *viewport)
+{
+  GskGpuNodeProcessor self;
+  GskGpuRegionRects rects;
+  cairo_rectangle_int_t extents;
+  float scale_x, scale_y;
+  gsize i;
+
+  g_return_if_fail (n_clips <= MAX_REGION_RECTS);
+  if (n_clips == 0)
+    return;
+
+  rects.n_rects = n_clips;
+  extents = clips[0];
+  for (i = 1; i < n_clips; i++)
+    gdk_rectangle_union (&extents, &clips[i], &extents);
+
+  gsk_gpu_node_processor_init (&self,
+                               frame,
+                               NULL,
+                               target,
+                               &extents,
+                               viewport);
+
+  scale_x = viewport->size.width / gsk_gpu_image_get_width (target);
+  scale_y = viewport->size.height / gsk_gpu_image_get_height (target);
+  for (i = 0; i < rects.n_rects; i++)
+    {
+      const cairo_rectangle_int_t *rect = &clips[i];
+
+      rects.scissors[i] = *rect;
+      rects.clips[i] = GRAPHENE_RECT_INIT (scale_x * rect->x,
+                                           scale_y * rect->y,
+                                           scale_x * rect->width,
+                                           scale_y * rect->height);
+    }
+  /* force selecting the first rect */
+  rects.current = G_MAXSIZE;
+
+  gsk_gpu_node_processor_add_node_rects (&self,
+                                         &rects,
+                                         node,
+                                         rects.n_rects == MAX_REGION_RECTS ? G_MAXUINT32
+                                                                           : (1u << rects.n_rects) - 1);
+
+  gsk_gpu_node_processor_finish (&self);
+}
+
 static void
 gsk_gpu_pattern_writer_init (GskGpuPatternWriter    *self,
                              GskGpuFrame            *frame,
@@ -554,10 +771,19 @@ gsk_gpu_pattern_writer_add_image (GskGpuPatternWriter *self,
                                   GskGpuSampler        sampler,
                                   guint32             *out_descriptor)
 {
+  GskGpuDevice *device = gsk_gpu_frame_get_device (self->frame);
+  gboolean result;
+
+  gsk_gpu_device_lock (device);
+
   if (self->desc == NULL)
     self->desc = gsk_gpu_frame_create_descriptors (self->frame);
 
-  return gsk_gpu_descriptors_add_image (self->desc, image, sampler, out_descriptor);
+  result = gsk_gpu_descriptors_add_image (self->desc, image, sampler, out_descriptor);
+
+  gsk_gpu_device_unlock (device);
+
+  return result;
 }
 
 static void
@@ -830,6 +1056,18 @@ gsk_gpu_get_node_as_image (GskGpuFrame            *frame,
       break;
     }
 
+  if (gsk_gpu_frame_should_optimize (frame, GSK_GPU_OPTIMIZE_NODE_CACHE))
+    {
+      result = gsk_gpu_device_lookup_node_image (gsk_gpu_frame_get_device (frame),
+                                                 node,
+                                                 scale,
+                                                 clip_bounds,
+                                                 gsk_gpu_frame_get_timestamp (frame),
+                                                 out_bounds);
+      if (result)
+        return result;
+    }
+
   GSK_DEBUG (FALLBACK, "Offscreening node '%s'", g_type_name_from_instance ((GTypeInstance *) node));
   result = gsk_gpu_node_processor_create_offscreen (frame,
                                                     scale,
@@ -837,6 +1075,17 @@ gsk_gpu_get_node_as_image (GskGpuFrame            *frame,
                                                     node);
 
   *out_bounds = *clip_bounds;
+
+  /* Nodes are immutable, so the offscreen can be reused in later
+   * frames that render the same node */
+  if (result && gsk_gpu_frame_should_optimize (frame, GSK_GPU_OPTIMIZE_NODE_CACHE))
+    gsk_gpu_device_cache_node_image (gsk_gpu_frame_get_device (frame),
+                                     node,
+                                     scale,
+                                     gsk_gpu_frame_get_timestamp (frame),
+                                     result,
+                                     out_bounds);
+
   return result;
 }
 
@@ -846,6 +1095,7 @@ gsk_gpu_node_processor_ensure_image (GskGpuFrame      *frame,
                                      GskGpuImageFlags  required_flags,
                                      GskGpuImageFlags  disallowed_flags)
 {
+  GskGpuDevice *device = gsk_gpu_frame_get_device (frame);
   GskGpuImageFlags flags, missing_flags;
   GskGpuImage *copy;
   gsize width, height;
@@ -853,25 +1103,34 @@ gsk_gpu_node_processor_ensure_image (GskGpuFrame      *frame,
   g_assert ((required_flags & disallowed_flags) == 0);
   g_assert ((required_flags & (GSK_GPU_IMAGE_EXTERNAL | GSK_GPU_IMAGE_STRAIGHT_ALPHA | GSK_GPU_IMAGE_NO_BLIT)) == 0);
 
+  /* Another thread recording in parallel may be adding mipmaps */
+  gsk_gpu_device_lock (device);
+
   flags = gsk_gpu_image_get_flags (image);
   missing_flags = required_flags & ~flags;
   if ((flags & disallowed_flags) == 0)
     {
       if (missing_flags == 0)
-        return image;
+        {
+          gsk_gpu_device_unlock (device);
+          return image;
+        }
 
       if (missing_flags == GSK_GPU_IMAGE_MIPMAP &&
           (flags & GSK_GPU_IMAGE_CAN_MIPMAP))
         {
           gsk_gpu_mipmap_op (frame, image);
+          gsk_gpu_device_unlock (device);
           return image;
         }
     }
 
+  gsk_gpu_device_unlock (device);
+
   width = gsk_gpu_image_get_width (image);
   height = gsk_gpu_image_get_height (image);
 
-  copy = gsk_gpu_device_create_offscreen_image (gsk_gpu_frame_get_device (frame),
+  copy = gsk_gpu_device_create_offscreen_image (device,
                                                 required_flags & (GSK_GPU_IMAGE_CAN_MIPMAP | GSK_GPU_IMAGE_MIPMAP) ? TRUE : FALSE,
                                                 gdk_memory_format_get_depth (gsk_gpu_image_get_format (image)),
                                                 width, height);
@@ -1226,6 +1485,7 @@ gsk_gpu_node_processor_try_node_as_pattern (GskGpuNodeProcessor *self,
                                                pattern_buffer_get_data (&writer.buffer),
                                                pattern_buffer_get_size (&writer.buffer),
                                                &offset);
+  gsk_gpu_device_lock (gsk_gpu_frame_get_device (self->frame));
   if (writer.desc == NULL)
     {
       if (self->desc == NULL)
@@ -1238,6 +1498,7 @@ gsk_gpu_node_processor_try_node_as_pattern (GskGpuNodeProcessor *self,
     {
       g_assert_not_reached ();
     }
+  gsk_gpu_device_unlock (gsk_gpu_frame_get_device (self->frame));
 
   pattern_id = (pattern_id << 22) | (offset / sizeof (float));
 
@@ -3528,6 +3789,89 @@ gsk_gpu_node_processor_create_repeat_pattern (GskGpuPatternWriter *self,
   return TRUE;
 }
 
+/* Draws the path with the path shader instead of rasterizing it with
+ * Cairo. The tessellation of the path is cached, and so is the texture
+ * holding its lines, so unchanged paths don't upload anything.
+ */
+static gboolean
+gsk_gpu_node_processor_add_path_with_shader (GskGpuNodeProcessor   *self,
+                                             const graphene_rect_t *clip_bounds,
+                                             GskPath               *path,
+                                             GskGpuPathMode         mode,
+                                             float                  line_width,
+                                             const GdkRGBA         *color)
+{
+  GskGpuDevice *device;
+  GskGpuTessellation *tessellation;
+  GskGpuImage *image;
+  GdkTexture *lines;
+  graphene_rect_t band;
+  guint32 descriptor;
+  guint i, first_line, n_lines;
+  gint64 timestamp;
+  GdkRGBA rgba;
+
+  if (!gsk_gpu_frame_should_optimize (self->frame, GSK_GPU_OPTIMIZE_PATHS))
+    return FALSE;
+
+  device = gsk_gpu_frame_get_device (self->frame);
+  timestamp = gsk_gpu_frame_get_timestamp (self->frame);
+
+  tessellation = gsk_gpu_device_get_tessellation (device, path, &self->scale, line_width, timestamp);
+  if (tessellation == NULL)
+    return FALSE;
+
+  lines = gsk_gpu_tessellation_get_lines (tessellation);
+  image = gsk_gpu_device_lookup_texture_image (device, lines, timestamp);
+  if (image == NULL)
+    {
+      image = gsk_gpu_frame_upload_texture (self->frame, FALSE, lines);
+      if (image == NULL)
+        {
+          gsk_gpu_tessellation_unref (tessellation);
+          return FALSE;
+        }
+    }
+
+  /* The device may have picked a fallback format that can't hold the
+   * coordinates exactly, so let Cairo draw the path instead */
+  if (gsk_gpu_image_get_format (image) != gdk_texture_get_format (lines))
+    {
+      g_object_unref (image);
+      gsk_gpu_tessellation_unref (tessellation);
+      return FALSE;
+    }
+
+  descriptor = gsk_gpu_node_processor_add_image (self, image, GSK_GPU_SAMPLER_NEAREST);
+
+  rgba = *color;
+  rgba.alpha *= self->opacity;
+
+  for (i = 0; i < gsk_gpu_tessellation_get_n_bands (tessellation); i++)
+    {
+      gsk_gpu_tessellation_get_band (tessellation, i, &band, &first_line, &n_lines);
+      if (n_lines == 0 || !gsk_rect_intersects (&band, clip_bounds))
+        continue;
+
+      gsk_gpu_path_op (self->frame,
+                       gsk_gpu_clip_get_shader_clip (&self->clip, &self->offset, &band),
+                       self->desc,
+                       mode,
+                       &band,
+                       &self->offset,
+                       &rgba,
+                       descriptor,
+                       first_line,
+                       n_lines,
+                       line_width / 2 * graphene_vec2_get_x (&self->scale));
+    }
+
+  g_object_unref (image);
+  gsk_gpu_tessellation_unref (tessellation);
+
+  return TRUE;
+}
+
 typedef struct _FillData FillData;
 struct _FillData
 {
@@ -3583,6 +3927,17 @@ gsk_gpu_node_processor_add_fill_node (GskGpuNodeProcessor *self,
 
   child = gsk_fill_node_get_child (node);
 
+  if (GSK_RENDER_NODE_TYPE (child) == GSK_COLOR_NODE &&
+      gsk_gpu_node_processor_add_path_with_shader (self,
+                                                   &clip_bounds,
+                                                   gsk_fill_node_get_path (node),
+                                                   gsk_fill_node_get_fill_rule (node) == GSK_FILL_RULE_EVEN_ODD
+                                                   ? GSK_GPU_PATH_FILL_EVEN_ODD
+                                                   : GSK_GPU_PATH_FILL_WINDING,
+                                                   0,
+                                                   gsk_color_node_get_color (child)))
+    return;
+
   mask_image = gsk_gpu_upload_cairo_op (self->frame,
                                         &self->scale,
                                         &clip_bounds,
@@ -3671,6 +4026,7 @@ gsk_gpu_node_processor_add_stroke_node (GskGpuNodeProcessor *self,
 {
   graphene_rect_t clip_bounds, source_rect;
   GskGpuImage *mask_image, *source_image;
+  const GskStroke *stroke;
   guint32 descriptors[2];
   GskRenderNode *child;
 
@@ -3679,6 +4035,22 @@ gsk_gpu_node_processor_add_stroke_node (GskGpuNodeProcessor *self,
   rect_round_to_pixels (&clip_bounds, &self->scale, &self->offset, &clip_bounds);
 
   child = gsk_stroke_node_get_child (node);
+  stroke = gsk_stroke_node_get_stroke (node);
+
+  /* The shader draws the area close to the lines, that's only
+   * correct with round caps and joins and a uniform scale. */
+  if (GSK_RENDER_NODE_TYPE (child) == GSK_COLOR_NODE &&
+      stroke->line_cap == GSK_LINE_CAP_ROUND &&
+      stroke->line_join == GSK_LINE_JOIN_ROUND &&
+      stroke->n_dash == 0 &&
+      graphene_vec2_get_x (&self->scale) == graphene_vec2_get_y (&self->scale) &&
+      gsk_gpu_node_processor_add_path_with_shader (self,
+                                                   &clip_bounds,
+                                                   gsk_stroke_node_get_path (node),
+                                                   GSK_GPU_PATH_STROKE,
+                                                   stroke->line_width,
+                                                   gsk_color_node_get_color (child)))
+    return;
 
   mask_image = gsk_gpu_upload_cairo_op (self->frame,
                                         &self->scale,
@@ -3738,6 +4110,9 @@ gsk_gpu_node_processor_add_subsurface_node (GskGpuNodeProcessor *self,
 {
   GdkSubsurface *subsurface;
 
+  /* What we draw depends on the state of the subsurface */
+  gsk_gpu_frame_mark_unretainable (self->frame);
+
   subsurface = gsk_subsurface_node_get_subsurface (node);
   if (subsurface == NULL ||
       gdk_subsurface_get_texture (subsurface) == NULL ||
@@ -3799,6 +4174,61 @@ gsk_gpu_node_processor_create_subsurface_pattern (GskGpuPatternWriter *self,
   return gsk_gpu_node_processor_create_node_pattern (self, gsk_subsurface_node_get_child (node));
 }
 
+typedef struct
+{
+  GskGpuNodeProcessor *parent;
+  GskRenderNode *node;
+  guint n_tasks;
+} ParallelContainer;
+
+static void
+gsk_gpu_node_processor_add_container_task (GskGpuFrame *frame,
+                                           guint        task_index,
+                                           gpointer     data)
+{
+  ParallelContainer *container = data;
+  GskGpuNodeProcessor other;
+  guint i, start, end, n_children;
+
+  n_children = gsk_container_node_get_n_children (container->node);
+  start = (gsize) n_children * task_index / container->n_tasks;
+  end = (gsize) n_children * (task_index + 1) / container->n_tasks;
+
+  other = *container->parent;
+  other.desc = NULL;
+  other.modelview = gsk_transform_ref (other.modelview);
+  other.pending_globals = GSK_GPU_GLOBAL_MATRIX | GSK_GPU_GLOBAL_SCALE | GSK_GPU_GLOBAL_CLIP | GSK_GPU_GLOBAL_SCISSOR | GSK_GPU_GLOBAL_BLEND;
+  other.parallel = FALSE;
+
+  for (i = start; i < end; i++)
+    gsk_gpu_node_processor_add_node (&other, gsk_container_node_get_child (container->node, i));
+
+  gsk_gpu_node_processor_finish (&other);
+}
+
+/* Records the children in chunks on multiple threads. Every chunk
+ * starts from our state, and when they are done we can't know what
+ * state the GPU is in, so everything needs to be set again.
+ */
+static void
+gsk_gpu_node_processor_add_container_node_parallel (GskGpuNodeProcessor *self,
+                                                    GskRenderNode       *node)
+{
+  ParallelContainer container;
+
+  container.parent = self;
+  container.node = node;
+  container.n_tasks = MIN (gsk_container_node_get_n_children (node),
+                           PARALLEL_TASKS_PER_THREAD * gdk_parallel_task_get_n_threads ());
+
+  gsk_gpu_frame_record_parallel (self->frame,
+                                 gsk_gpu_node_processor_add_container_task,
+                                 &container,
+                                 container.n_tasks);
+
+  self->pending_globals |= GSK_GPU_GLOBAL_MATRIX | GSK_GPU_GLOBAL_SCALE | GSK_GPU_GLOBAL_CLIP | GSK_GPU_GLOBAL_SCISSOR | GSK_GPU_GLOBAL_BLEND;
+}
+
 static void
 gsk_gpu_node_processor_add_container_node (GskGpuNodeProcessor *self,
                                            GskRenderNode       *node)
@@ -3809,6 +4239,13 @@ gsk_gpu_node_processor_add_container_node (GskGpuNodeProcessor *self,
       return;
     }
 
+  if (self->parallel &&
+      gsk_container_node_get_n_children (node) >= PARALLEL_MIN_CHILDREN)
+    {
+      gsk_gpu_node_processor_add_container_node_parallel (self, node);
+      return;
+    }
+
   for (guint i = 0; i < gsk_container_node_get_n_children (node); i++)
     gsk_gpu_node_processor_add_node (self, gsk_container_node_get_child (node, i));
 }
@@ -4028,6 +4465,100 @@ static const struct
   },
 };
 
+static void
+gsk_gpu_node_processor_init_retain_key (GskGpuNodeProcessor *self,
+                                        RetainKey           *key)
+{
+  graphene_matrix_t modelview;
+
+  /* The key gets hashed and compared bytewise, so clear the padding */
+  memset (key, 0, sizeof (RetainKey));
+
+  if (self->modelview)
+    {
+      gsk_transform_to_matrix (self->modelview, &modelview);
+      graphene_matrix_to_float (&modelview, key->modelview);
+    }
+  graphene_matrix_to_float (&self->projection, key->projection);
+  key->offset[0] = self->offset.x;
+  key->offset[1] = self->offset.y;
+  graphene_vec2_to_float (&self->scale, key->scale);
+  key->clip = self->clip;
+  key->scissor = self->scissor;
+  key->blend = self->blend;
+  key->opacity = self->opacity;
+}
+
+static gboolean
+gsk_gpu_node_processor_should_retain (GskRenderNode *node)
+{
+  switch ((guint) gsk_render_node_get_node_type (node))
+    {
+    case GSK_CONTAINER_NODE:
+      return gsk_container_node_get_n_children (node) >= RETAIN_MIN_CHILDREN;
+
+    case GSK_TRANSFORM_NODE:
+      return gsk_gpu_node_processor_should_retain (gsk_transform_node_get_child (node));
+
+    default:
+      return FALSE;
+    }
+}
+
+/* Subtrees that are drawn again with the same state are recorded once
+ * they have been seen twice, and their ops are replayed after that
+ * instead of walking them again.
+ */
+static void
+gsk_gpu_node_processor_add_retained_node (GskGpuNodeProcessor *self,
+                                          GskRenderNode       *node,
+                                          void                (* process_node) (GskGpuNodeProcessor *, GskRenderNode *))
+{
+  GskGpuDevice *device = gsk_gpu_frame_get_device (self->frame);
+  gint64 timestamp = gsk_gpu_frame_get_timestamp (self->frame);
+  GskGpuRecording *recording = NULL;
+  GskGpuRecordingState state;
+  RetainKey key;
+
+  /* Make sure the ops don't depend on state from before */
+  gsk_gpu_node_processor_sync_globals (self, 0);
+
+  gsk_gpu_node_processor_init_retain_key (self, &key);
+  state = gsk_gpu_device_lookup_recording (device, node, &key, sizeof (key), timestamp, &recording);
+
+  switch (state)
+    {
+    case GSK_GPU_RECORDING_RETAINED:
+      gsk_gpu_frame_replay_recording (self->frame, recording);
+      self->pending_globals = gsk_gpu_recording_get_flags (recording);
+      gsk_gpu_recording_unref (recording);
+      break;
+
+    case GSK_GPU_RECORDING_SEEN:
+      gsk_gpu_frame_begin_recording (self->frame);
+      process_node (self, node);
+      recording = gsk_gpu_frame_end_recording (self->frame, self->pending_globals);
+      gsk_gpu_device_cache_recording (device, node, &key, sizeof (key), timestamp,
+                                      recording ? GSK_GPU_RECORDING_RETAINED : GSK_GPU_RECORDING_UNRETAINABLE,
+                                      recording);
+      break;
+
+    case GSK_GPU_RECORDING_UNKNOWN:
+      process_node (self, node);
+      gsk_gpu_device_cache_recording (device, node, &key, sizeof (key), timestamp,
+                                      GSK_GPU_RECORDING_SEEN, NULL);
+      break;
+
+    case GSK_GPU_RECORDING_UNRETAINABLE:
+      process_node (self, node);
+      break;
+
+    default:
+      g_assert_not_reached ();
+      break;
+    }
+}
+
 static void
 gsk_gpu_node_processor_add_node (GskGpuNodeProcessor *self,
                                  GskRenderNode       *node)
@@ -4060,7 +4591,12 @@ gsk_gpu_node_processor_add_node (GskGpuNodeProcessor *self,
   gsk_gpu_node_processor_sync_globals (self, nodes_vtable[node_type].ignored_globals);
   g_assert ((self->pending_globals & ~nodes_vtable[node_type].ignored_globals) == 0);
 
-  if (nodes_vtable[node_type].process_node)
+  if (gsk_gpu_frame_should_optimize (self->frame, GSK_GPU_OPTIMIZE_RETAIN) &&
+      gsk_gpu_node_processor_should_retain (node))
+    {
+      gsk_gpu_node_processor_add_retained_node (self, node, nodes_vtable[node_type].process_node);
+    }
+  else if (nodes_vtable[node_type].process_node)
     {
       nodes_vtable[node_type].process_node (self, node);
     }
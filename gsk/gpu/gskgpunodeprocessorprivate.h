@@ -5,10 +5,18 @@
 
 G_BEGIN_DECLS
 
+#define GSK_GPU_NODE_PROCESSOR_MAX_RECTS 16
+
 void                    gsk_gpu_node_processor_process                  (GskGpuFrame                    *frame,
                                                                          GskGpuImage                    *target,
                                                                          const cairo_rectangle_int_t    *clip,
                                                                          GskRenderNode                  *node,
                                                                          const graphene_rect_t          *viewport);
+void                    gsk_gpu_node_processor_process_rects            (GskGpuFrame                    *frame,
+                                                                         GskGpuImage                    *target,
+                                                                         const cairo_rectangle_int_t    *clips,
+                                                                         gsize                           n_clips,
+                                                                         GskRenderNode                  *node,
+                                                                         const graphene_rect_t          *viewport);
 
 G_END_DECLS
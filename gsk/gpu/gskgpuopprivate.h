@@ -30,6 +30,8 @@ struct _GskGLCommandState
     gsize n_external;
   } current_program;
   GskGLDescriptors *desc;
+  /* write timestamp queries around commands */
+  gboolean measure;
 };
 
 #ifdef GDK_RENDERING_VULKAN
@@ -42,6 +44,8 @@ struct _GskVulkanCommandState
 
   GskVulkanDescriptors *desc;
   GskVulkanSemaphores *semaphores;
+  /* write timestamp queries around commands */
+  gboolean measure;
 };
 #endif
 
@@ -54,6 +58,8 @@ struct _GskGpuOp
 
 struct _GskGpuOpClass
 {
+  /* used when printing ops and for GPU timings */
+  const char *          name;
   gsize                 size;
   GskGpuStage           stage;
 
@@ -72,6 +78,11 @@ struct _GskGpuOpClass
   GskGpuOp *            (* gl_command)                                  (GskGpuOp               *op,
                                                                          GskGpuFrame            *frame,
                                                                          GskGLCommandState      *state);
+
+  /* The op doesn't reference any resources of the frame, so it can be
+   * copied into later frames. Shader ops are retainable if they don't
+   * use descriptors. */
+  gboolean              retainable;
 };
 
 /* ensures alignment of ops to multiples of 16 bytes - and that makes graphene happy */
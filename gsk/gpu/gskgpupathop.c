@@ -0,0 +1,83 @@
+#include "config.h"
+
+#include "gskgpupathopprivate.h"
+
+#include "gskgpuframeprivate.h"
+#include "gskgpuprintprivate.h"
+#include "gskrectprivate.h"
+
+#include "gpu/shaders/gskgpupathinstance.h"
+
+typedef struct _GskGpuPathOp GskGpuPathOp;
+
+struct _GskGpuPathOp
+{
+  GskGpuShaderOp op;
+};
+
+static void
+gsk_gpu_path_op_print_instance (GskGpuShaderOp *shader,
+                                gpointer        instance_,
+                                GString        *string)
+{
+  GskGpuPathInstance *instance = (GskGpuPathInstance *) instance_;
+
+  gsk_gpu_print_rect (string, instance->rect);
+  gsk_gpu_print_rgba (string, instance->color);
+  gsk_gpu_print_image_descriptor (string, shader->desc, instance->lines_id);
+  g_string_append_printf (string, "%u lines ", instance->lines[1]);
+}
+
+static const GskGpuShaderOpClass GSK_GPU_PATH_OP_CLASS = {
+  {
+    "path",
+    GSK_GPU_OP_SIZE (GskGpuPathOp),
+    GSK_GPU_STAGE_SHADER,
+    gsk_gpu_shader_op_finish,
+    gsk_gpu_shader_op_print,
+#ifdef GDK_RENDERING_VULKAN
+    gsk_gpu_shader_op_vk_command,
+#endif
+    gsk_gpu_shader_op_gl_command
+  },
+  "gskgpupath",
+  sizeof (GskGpuPathInstance),
+#ifdef GDK_RENDERING_VULKAN
+  &gsk_gpu_path_info,
+#endif
+  gsk_gpu_path_op_print_instance,
+  gsk_gpu_path_setup_attrib_locations,
+  gsk_gpu_path_setup_vao
+};
+
+void
+gsk_gpu_path_op (GskGpuFrame            *frame,
+                 GskGpuShaderClip        clip,
+                 GskGpuDescriptors      *desc,
+                 GskGpuPathMode          mode,
+                 const graphene_rect_t  *rect,
+                 const graphene_point_t *offset,
+                 const GdkRGBA          *color,
+                 guint32                 lines_descriptor,
+                 guint                   first_line,
+                 guint                   n_lines,
+                 float                   half_width)
+{
+  GskGpuPathInstance *instance;
+
+  gsk_gpu_shader_op_alloc (frame,
+                           &GSK_GPU_PATH_OP_CLASS,
+                           mode,
+                           clip,
+                           desc,
+                           &instance);
+
+  gsk_gpu_rect_to_float (rect, offset, instance->rect);
+  gsk_gpu_rgba_to_float (color, instance->color);
+  instance->offset[0] = offset->x;
+  instance->offset[1] = offset->y;
+  instance->lines_id = lines_descriptor;
+  instance->lines[0] = first_line;
+  instance->lines[1] = n_lines;
+  instance->half_width = half_width;
+}
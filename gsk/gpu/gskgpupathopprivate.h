@@ -0,0 +1,23 @@
+#pragma once
+
+#include "gskgpushaderopprivate.h"
+
+#include <graphene.h>
+
+G_BEGIN_DECLS
+
+void                    gsk_gpu_path_op                                 (GskGpuFrame                    *frame,
+                                                                         GskGpuShaderClip                clip,
+                                                                         GskGpuDescriptors              *desc,
+                                                                         GskGpuPathMode                  mode,
+                                                                         const graphene_rect_t          *rect,
+                                                                         const graphene_point_t         *offset,
+                                                                         const GdkRGBA                  *color,
+                                                                         guint32                         lines_descriptor,
+                                                                         guint                           first_line,
+                                                                         guint                           n_lines,
+                                                                         float                           half_width);
+
+
+G_END_DECLS
+
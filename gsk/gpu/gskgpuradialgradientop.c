@@ -32,6 +32,7 @@ gsk_gpu_radial_gradient_op_print_instance (GskGpuShaderOp *shader,
 
 static const GskGpuShaderOpClass GSK_GPU_RADIAL_GRADIENT_OP_CLASS = {
   {
+    "radialgradient",
     GSK_GPU_OP_SIZE (GskGpuRadialGradientOp),
     GSK_GPU_STAGE_SHADER,
     gsk_gpu_shader_op_finish,
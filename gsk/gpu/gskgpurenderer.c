@@ -30,6 +30,10 @@ static const GdkDebugKey gsk_gpu_optimization_keys[] = {
   { "blit", GSK_GPU_OPTIMIZE_BLIT, "Use shaders instead of vkCmdBlit()/glBlitFramebuffer()" },
   { "gradients", GSK_GPU_OPTIMIZE_GRADIENTS, "Don't supersample gradients" },
   { "mipmap", GSK_GPU_OPTIMIZE_MIPMAP, "Avoid creating mipmaps" },
+  { "node-cache", GSK_GPU_OPTIMIZE_NODE_CACHE, "Don't reuse offscreens across frames" },
+  { "parallel", GSK_GPU_OPTIMIZE_PARALLEL, "Record operations on a single thread" },
+  { "retain", GSK_GPU_OPTIMIZE_RETAIN, "Record unchanged subtrees again every frame" },
+  { "paths", GSK_GPU_OPTIMIZE_PATHS, "Rasterize paths with Cairo" },
 };
 
 typedef struct _GskGpuRendererPrivate GskGpuRendererPrivate;
@@ -483,6 +487,14 @@ gsk_gpu_renderer_get_device (GskGpuRenderer *self)
   return priv->device;
 }
 
+GskGpuOptimizations
+gsk_gpu_renderer_get_optimizations (GskGpuRenderer *self)
+{
+  GskGpuRendererPrivate *priv = gsk_gpu_renderer_get_instance_private (self);
+
+  return priv->optimizations;
+}
+
 double
 gsk_gpu_renderer_get_scale (GskGpuRenderer *self)
 {
@@ -42,6 +42,7 @@ struct _GskGpuRendererClass
 
 GdkDrawContext *        gsk_gpu_renderer_get_context                    (GskGpuRenderer         *self);
 GskGpuDevice *          gsk_gpu_renderer_get_device                     (GskGpuRenderer         *self);
+GskGpuOptimizations     gsk_gpu_renderer_get_optimizations              (GskGpuRenderer         *self);
 double                  gsk_gpu_renderer_get_scale                      (GskGpuRenderer         *self);
 
 G_END_DECLS
@@ -2,6 +2,7 @@
 
 #include "gskgpurenderpassopprivate.h"
 
+#include "gskglframeprivate.h"
 #include "gskglimageprivate.h"
 #include "gskgpudeviceprivate.h"
 #include "gskgpuframeprivate.h"
@@ -10,6 +11,7 @@
 #include "gskgpushaderopprivate.h"
 #include "gskrendernodeprivate.h"
 #ifdef GDK_RENDERING_VULKAN
+#include "gskvulkanframeprivate.h"
 #include "gskvulkanimageprivate.h"
 #include "gskvulkandescriptorsprivate.h"
 #endif
@@ -22,6 +24,9 @@ struct _GskGpuRenderPassOp
 
   GskGpuImage *target;
   cairo_rectangle_int_t area;
+  /* if set, only clear these rectangles of the area
+   * and keep the rest of the contents */
+  cairo_region_t *clear_region;
   GskRenderPassType pass_type;
 };
 
@@ -31,6 +36,7 @@ gsk_gpu_render_pass_op_finish (GskGpuOp *op)
   GskGpuRenderPassOp *self = (GskGpuRenderPassOp *) op;
 
   g_object_unref (self->target);
+  g_clear_pointer (&self->clear_region, cairo_region_destroy);
 }
 
 static void
@@ -43,6 +49,8 @@ gsk_gpu_render_pass_op_print (GskGpuOp    *op,
 
   gsk_gpu_print_op (string, indent, "begin-render-pass");
   gsk_gpu_print_image (string, self->target);
+  if (self->clear_region)
+    g_string_append_printf (string, "%d rects ", cairo_region_num_rectangles (self->clear_region));
   gsk_gpu_print_newline (string);
 }
 
@@ -110,7 +118,9 @@ gsk_gpu_render_pass_op_vk_command (GskGpuOp              *op,
   state->vk_render_pass = gsk_vulkan_device_get_vk_render_pass (GSK_VULKAN_DEVICE (gsk_gpu_frame_get_device (frame)),
                                                                 state->vk_format,
                                                                 gsk_vulkan_image_get_vk_image_layout (GSK_VULKAN_IMAGE (self->target)),
-                                                                gsk_gpu_render_pass_type_to_vk_image_layout (self->pass_type));
+                                                                gsk_gpu_render_pass_type_to_vk_image_layout (self->pass_type),
+                                                                self->clear_region ? VK_ATTACHMENT_LOAD_OP_LOAD
+                                                                                   : VK_ATTACHMENT_LOAD_OP_CLEAR);
 
 
   vkCmdSetViewport (state->vk_command_buffer,
@@ -142,12 +152,50 @@ gsk_gpu_render_pass_op_vk_command (GskGpuOp              *op,
                         },
                         VK_SUBPASS_CONTENTS_INLINE);
 
+  if (self->clear_region)
+    {
+      int i, n_rects = cairo_region_num_rectangles (self->clear_region);
+      VkClearRect *clear_rects = g_newa (VkClearRect, n_rects);
+
+      for (i = 0; i < n_rects; i++)
+        {
+          cairo_rectangle_int_t rect;
+
+          cairo_region_get_rectangle (self->clear_region, i, &rect);
+          clear_rects[i] = (VkClearRect) {
+                             {
+                               { rect.x, rect.y },
+                               { rect.width, rect.height },
+                             },
+                             0,
+                             1
+                           };
+        }
+
+      vkCmdClearAttachments (state->vk_command_buffer,
+                             1,
+                             &(VkClearAttachment) {
+                               VK_IMAGE_ASPECT_COLOR_BIT,
+                               0,
+                               { .color = { .float32 = { 0.f, 0.f, 0.f, 0.f } } }
+                             },
+                             n_rects,
+                             clear_rects);
+    }
+
+  /* The frame only measures this op, so measure the ones inside */
   op = op->next;
   while (op->op_class->stage != GSK_GPU_STAGE_END_PASS)
     {
+      if (state->measure)
+        gsk_vulkan_frame_write_timestamp (GSK_VULKAN_FRAME (frame), op);
+
       op = gsk_gpu_op_vk_command (op, frame, state);
     }
 
+  if (state->measure)
+    gsk_vulkan_frame_write_timestamp (GSK_VULKAN_FRAME (frame), op);
+
   op = gsk_gpu_op_vk_command (op, frame, state);
 
   return op;
@@ -175,25 +223,52 @@ gsk_gpu_render_pass_op_gl_command (GskGpuOp          *op,
               gsk_gpu_image_get_width (self->target),
               gsk_gpu_image_get_height (self->target));
 
-  if (state->flip_y)
-    glScissor (self->area.x, state->flip_y - self->area.y - self->area.height, self->area.width, self->area.height);
-  else
-    glScissor (self->area.x, self->area.y, self->area.width, self->area.height);
   glClearColor (0, 0, 0, 0);
-  glClear (GL_COLOR_BUFFER_BIT);
+  if (self->clear_region)
+    {
+      int i;
+
+      for (i = 0; i < cairo_region_num_rectangles (self->clear_region); i++)
+        {
+          cairo_rectangle_int_t rect;
+
+          cairo_region_get_rectangle (self->clear_region, i, &rect);
+          if (state->flip_y)
+            glScissor (rect.x, state->flip_y - rect.y - rect.height, rect.width, rect.height);
+          else
+            glScissor (rect.x, rect.y, rect.width, rect.height);
+          glClear (GL_COLOR_BUFFER_BIT);
+        }
+    }
+  else
+    {
+      if (state->flip_y)
+        glScissor (self->area.x, state->flip_y - self->area.y - self->area.height, self->area.width, self->area.height);
+      else
+        glScissor (self->area.x, self->area.y, self->area.width, self->area.height);
+      glClear (GL_COLOR_BUFFER_BIT);
+    }
 
+  /* The frame only measures this op, so measure the ones inside */
   op = op->next;
   while (op->op_class->stage != GSK_GPU_STAGE_END_PASS)
     {
+      if (state->measure)
+        gsk_gl_frame_write_timestamp (GSK_GL_FRAME (frame), op);
+
       op = gsk_gpu_op_gl_command (op, frame, state);
     }
 
+  if (state->measure)
+    gsk_gl_frame_write_timestamp (GSK_GL_FRAME (frame), op);
+
   op = gsk_gpu_op_gl_command (op, frame, state);
 
   return op;
 }
 
 static const GskGpuOpClass GSK_GPU_RENDER_PASS_OP_CLASS = {
+  "begin-render-pass",
   GSK_GPU_OP_SIZE (GskGpuRenderPassOp),
   GSK_GPU_STAGE_BEGIN_PASS,
   gsk_gpu_render_pass_op_finish,
@@ -295,6 +370,7 @@ gsk_gpu_render_pass_end_op_gl_command (GskGpuOp          *op,
 }
 
 static const GskGpuOpClass GSK_GPU_RENDER_PASS_END_OP_CLASS = {
+  "end-render-pass",
   GSK_GPU_OP_SIZE (GskGpuFramePassEndOp),
   GSK_GPU_STAGE_END_PASS,
   gsk_gpu_render_pass_end_op_finish,
@@ -317,6 +393,36 @@ gsk_gpu_render_pass_begin_op (GskGpuFrame                 *frame,
 
   self->target = g_object_ref (image);
   self->area = *area;
+  self->clear_region = NULL;
+  self->pass_type = pass_type;
+}
+
+/*<private>
+ * gsk_gpu_render_pass_begin_region_op:
+ * @frame: the frame
+ * @image: the image to render to
+ * @region: the region to render
+ * @pass_type: the type of render pass
+ *
+ * Like gsk_gpu_render_pass_begin_op() with the extents of @region
+ * as the area, but only the rectangles of @region get cleared, the
+ * rest of the image keeps its contents.
+ *
+ * This allows rendering multiple damage rectangles in one pass.
+ */
+void
+gsk_gpu_render_pass_begin_region_op (GskGpuFrame          *frame,
+                                     GskGpuImage          *image,
+                                     const cairo_region_t *region,
+                                     GskRenderPassType     pass_type)
+{
+  GskGpuRenderPassOp *self;
+
+  self = (GskGpuRenderPassOp *) gsk_gpu_op_alloc (frame, &GSK_GPU_RENDER_PASS_OP_CLASS);
+
+  self->target = g_object_ref (image);
+  cairo_region_get_extents (region, &self->area);
+  self->clear_region = cairo_region_copy (region);
   self->pass_type = pass_type;
 }
 
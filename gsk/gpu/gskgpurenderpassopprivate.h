@@ -19,6 +19,10 @@ void                    gsk_gpu_render_pass_begin_op                    (GskGpuF
                                                                          GskGpuImage                    *image,
                                                                          const cairo_rectangle_int_t    *area,
                                                                          GskRenderPassType               pass_type);
+void                    gsk_gpu_render_pass_begin_region_op             (GskGpuFrame                    *frame,
+                                                                         GskGpuImage                    *image,
+                                                                         const cairo_region_t           *region,
+                                                                         GskRenderPassType               pass_type);
 void                    gsk_gpu_render_pass_end_op                      (GskGpuFrame                    *frame,
                                                                          GskGpuImage                    *image,
                                                                          GskRenderPassType               pass_type);
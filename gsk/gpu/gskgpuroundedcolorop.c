@@ -29,6 +29,7 @@ gsk_gpu_rounded_color_op_print_instance (GskGpuShaderOp *shader,
 
 static const GskGpuShaderOpClass GSK_GPU_ROUNDED_COLOR_OP_CLASS = {
   {
+    "roundedcolor",
     GSK_GPU_OP_SIZE (GskGpuRoundedColorOp),
     GSK_GPU_STAGE_SHADER,
     gsk_gpu_shader_op_finish,
@@ -68,6 +68,7 @@ gsk_gpu_scissor_op_gl_command (GskGpuOp          *op,
 }
 
 static const GskGpuOpClass GSK_GPU_SCISSOR_OP_CLASS = {
+  "scissor",
   GSK_GPU_OP_SIZE (GskGpuScissorOp),
   GSK_GPU_STAGE_COMMAND,
   gsk_gpu_scissor_op_finish,
@@ -75,7 +76,8 @@ static const GskGpuOpClass GSK_GPU_SCISSOR_OP_CLASS = {
 #ifdef GDK_RENDERING_VULKAN
   gsk_gpu_scissor_op_vk_command,
 #endif
-  gsk_gpu_scissor_op_gl_command
+  gsk_gpu_scissor_op_gl_command,
+  TRUE
 };
 
 void
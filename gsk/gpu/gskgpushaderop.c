@@ -37,20 +37,14 @@ gsk_gpu_shader_op_print (GskGpuOp    *op,
 {
   GskGpuShaderOp *self = (GskGpuShaderOp *) op;
   const GskGpuShaderOpClass *shader_class = (const GskGpuShaderOpClass *) op->op_class;
-  const char *shader_name;
   guchar *instance;
   gsize i;
 
-  if (g_str_has_prefix (shader_class->shader_name, "gskgpu"))
-    shader_name = shader_class->shader_name + 6;
-  else
-    shader_name = shader_class->shader_name;
-
   instance = gsk_gpu_frame_get_vertex_data (frame, self->vertex_offset);
 
   for (i = 0; i < self->n_ops; i++)
     {
-      gsk_gpu_print_op (string, indent, shader_name);
+      gsk_gpu_print_op (string, indent, op->op_class->name);
       gsk_gpu_print_shader_info (string, self->clip);
       shader_class->print_instance (self,
                                     instance + i * shader_class->vertex_size,
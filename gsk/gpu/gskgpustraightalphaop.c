@@ -31,6 +31,7 @@ gsk_gpu_straight_alpha_op_print_instance (GskGpuShaderOp *shader,
 
 static const GskGpuShaderOpClass GSK_GPU_STRAIGHT_ALPHA_OP_CLASS = {
   {
+    "straightalpha",
     GSK_GPU_OP_SIZE (GskGpuStraightAlphaOp),
     GSK_GPU_STAGE_SHADER,
     gsk_gpu_shader_op_finish,
@@ -0,0 +1,299 @@
+#include "config.h"
+
+#include "gskgputessellationprivate.h"
+
+#include "gskpathprivate.h"
+
+#include "gdk/gdkmemorytextureprivate.h"
+
+#include <math.h>
+
+/* A tessellation is a path flattened into lines, sorted into
+ * horizontal bands. The path shader draws one band at a time and
+ * only needs to look at the lines of that band for every pixel.
+ *
+ * The lines are stored in a float texture, so that the texture cache
+ * keeps them on the GPU for as long as the tessellation is alive.
+ */
+
+/* flattening tolerance, in device pixels */
+#define TOLERANCE 0.1
+/* height of a band, in device pixels */
+#define BAND_PIXELS 16
+/* width of the lines texture */
+#define LINES_TEXTURE_WIDTH 1024
+/* Bands with more lines are too slow in the shader */
+#define MAX_BAND_LINES 4096
+#define MAX_LINES (LINES_TEXTURE_WIDTH * 1024)
+
+typedef struct _GskGpuTessellationBand GskGpuTessellationBand;
+
+struct _GskGpuTessellationBand
+{
+  guint first_line;
+  guint n_lines;
+};
+
+struct _GskGpuTessellation
+{
+  GdkTexture *lines;
+  gsize size;
+
+  graphene_rect_t bounds;
+  float band_height;
+  guint n_bands;
+  GskGpuTessellationBand *bands;
+};
+
+typedef struct
+{
+  GArray *lines;
+  gboolean close_contours;
+  graphene_point_t start;
+  graphene_point_t current;
+} FlattenData;
+
+static void
+flatten_add_line (FlattenData            *data,
+                  const graphene_point_t *from,
+                  const graphene_point_t *to)
+{
+  float line[4] = { from->x, from->y, to->x, to->y };
+
+  /* Filling ignores empty lines, but a stroke draws a dot */
+  if (data->close_contours && graphene_point_equal (from, to))
+    return;
+
+  g_array_append_vals (data->lines, line, 4);
+}
+
+static void
+flatten_close_contour (FlattenData *data)
+{
+  if (data->close_contours)
+    flatten_add_line (data, &data->current, &data->start);
+}
+
+static gboolean
+flatten_cb (GskPathOperation        op,
+            const graphene_point_t *pts,
+            gsize                   n_pts,
+            float                   weight,
+            gpointer                user_data)
+{
+  FlattenData *data = user_data;
+
+  switch (op)
+    {
+    case GSK_PATH_MOVE:
+      flatten_close_contour (data);
+      data->start = pts[0];
+      data->current = pts[0];
+      break;
+
+    case GSK_PATH_CLOSE:
+    case GSK_PATH_LINE:
+      flatten_add_line (data, &pts[0], &pts[1]);
+      data->current = pts[1];
+      break;
+
+    case GSK_PATH_QUAD:
+    case GSK_PATH_CUBIC:
+    case GSK_PATH_CONIC:
+    default:
+      g_assert_not_reached ();
+      break;
+    }
+
+  return TRUE;
+}
+
+static void
+gsk_gpu_tessellation_finalize (gpointer data)
+{
+  GskGpuTessellation *self = data;
+
+  g_object_unref (self->lines);
+  g_free (self->bands);
+}
+
+/*<private>
+ * gsk_gpu_tessellation_new:
+ * @path: the path to tessellate
+ * @scale: the scale the path will be drawn at
+ * @line_width: the width of the stroke or 0 to fill the path
+ *
+ * Flattens @path and sorts the lines into bands for drawing it at
+ * @scale. For strokes, the lines are used as the center of the stroke,
+ * so only strokes with round caps and joins can be drawn.
+ *
+ * Returns: (nullable): a new tessellation or %NULL if the path is
+ *   empty or too complex to draw it with shaders
+ */
+GskGpuTessellation *
+gsk_gpu_tessellation_new (GskPath               *path,
+                          const graphene_vec2_t *scale,
+                          float                  line_width)
+{
+  GskGpuTessellation *self;
+  FlattenData data;
+  graphene_rect_t bounds;
+  float *lines, *texels;
+  float scale_x, scale_y, margin;
+  guint i, b, n_lines, n_texels, width, height;
+  guint *counts;
+  GBytes *bytes;
+
+  scale_x = graphene_vec2_get_x (scale);
+  scale_y = graphene_vec2_get_y (scale);
+
+  data.lines = g_array_new (FALSE, FALSE, sizeof (float));
+  data.close_contours = line_width <= 0;
+  data.start = data.current = GRAPHENE_POINT_INIT (0, 0);
+  gsk_path_foreach_with_tolerance (path,
+                                   GSK_PATH_FOREACH_ALLOW_ONLY_LINES,
+                                   TOLERANCE / MAX (scale_x, scale_y),
+                                   flatten_cb,
+                                   &data);
+  flatten_close_contour (&data);
+
+  lines = (float *) data.lines->data;
+  n_lines = data.lines->len / 4;
+  if (n_lines == 0 || n_lines > MAX_LINES)
+    {
+      g_array_free (data.lines, TRUE);
+      return NULL;
+    }
+
+  /* Lines closer than this to a band can touch pixels in it */
+  margin = line_width / 2 + 1 / MIN (scale_x, scale_y);
+
+  bounds = GRAPHENE_RECT_INIT (lines[0], lines[1], 0, 0);
+  for (i = 0; i < n_lines; i++)
+    {
+      graphene_rect_expand (&bounds, &GRAPHENE_POINT_INIT (lines[4 * i], lines[4 * i + 1]), &bounds);
+      graphene_rect_expand (&bounds, &GRAPHENE_POINT_INIT (lines[4 * i + 2], lines[4 * i + 3]), &bounds);
+    }
+  graphene_rect_inset (&bounds, - margin, - margin);
+
+  self = g_atomic_rc_box_new0 (GskGpuTessellation);
+  self->bounds = bounds;
+  self->band_height = BAND_PIXELS / scale_y;
+  self->n_bands = MAX (1, (guint) ceilf (bounds.size.height / self->band_height));
+  self->bands = g_new0 (GskGpuTessellationBand, self->n_bands);
+
+  /* Count the lines per band first, so we can lay out the texture */
+  counts = g_new0 (guint, self->n_bands);
+  n_texels = 0;
+  for (i = 0; i < n_lines; i++)
+    {
+      float y0 = MIN (lines[4 * i + 1], lines[4 * i + 3]) - margin - bounds.origin.y;
+      float y1 = MAX (lines[4 * i + 1], lines[4 * i + 3]) + margin - bounds.origin.y;
+      guint first = CLAMP (floorf (y0 / self->band_height), 0, self->n_bands - 1);
+      guint last = CLAMP (floorf (y1 / self->band_height), 0, self->n_bands - 1);
+
+      for (b = first; b <= last; b++)
+        self->bands[b].n_lines++;
+      n_texels += last - first + 1;
+    }
+
+  for (b = 0; b < self->n_bands; b++)
+    {
+      if (self->bands[b].n_lines > MAX_BAND_LINES)
+        break;
+      if (b > 0)
+        self->bands[b].first_line = self->bands[b - 1].first_line + self->bands[b - 1].n_lines;
+    }
+
+  if (b < self->n_bands || n_texels > MAX_LINES)
+    {
+      g_free (counts);
+      g_array_free (data.lines, TRUE);
+      g_free (self->bands);
+      g_atomic_rc_box_release (self);
+      return NULL;
+    }
+
+  width = MIN (n_texels, LINES_TEXTURE_WIDTH);
+  height = (n_texels + width - 1) / width;
+  texels = g_new0 (float, 4 * width * height);
+
+  for (i = 0; i < n_lines; i++)
+    {
+      float y0 = MIN (lines[4 * i + 1], lines[4 * i + 3]) - margin - bounds.origin.y;
+      float y1 = MAX (lines[4 * i + 1], lines[4 * i + 3]) + margin - bounds.origin.y;
+      guint first = CLAMP (floorf (y0 / self->band_height), 0, self->n_bands - 1);
+      guint last = CLAMP (floorf (y1 / self->band_height), 0, self->n_bands - 1);
+
+      for (b = first; b <= last; b++)
+        {
+          guint pos = self->bands[b].first_line + counts[b]++;
+          memcpy (&texels[4 * pos], &lines[4 * i], 4 * sizeof (float));
+        }
+    }
+
+  /* The texels are coordinates, not colors, so they must not be
+   * treated as premultiplied */
+  self->size = sizeof (float) * 4 * width * height;
+  bytes = g_bytes_new_take (texels, self->size);
+  self->lines = gdk_memory_texture_new (width,
+                                        height,
+                                        GDK_MEMORY_R32G32B32A32_FLOAT,
+                                        bytes,
+                                        width * 4 * sizeof (float));
+  g_bytes_unref (bytes);
+
+  g_free (counts);
+  g_array_free (data.lines, TRUE);
+
+  return self;
+}
+
+GskGpuTessellation *
+gsk_gpu_tessellation_ref (GskGpuTessellation *self)
+{
+  return g_atomic_rc_box_acquire (self);
+}
+
+void
+gsk_gpu_tessellation_unref (GskGpuTessellation *self)
+{
+  g_atomic_rc_box_release_full (self, gsk_gpu_tessellation_finalize);
+}
+
+GdkTexture *
+gsk_gpu_tessellation_get_lines (GskGpuTessellation *self)
+{
+  return self->lines;
+}
+
+gsize
+gsk_gpu_tessellation_get_size (GskGpuTessellation *self)
+{
+  return sizeof (GskGpuTessellation) +
+         self->size +
+         self->n_bands * sizeof (GskGpuTessellationBand);
+}
+
+guint
+gsk_gpu_tessellation_get_n_bands (GskGpuTessellation *self)
+{
+  return self->n_bands;
+}
+
+void
+gsk_gpu_tessellation_get_band (GskGpuTessellation *self,
+                               guint               i,
+                               graphene_rect_t    *out_bounds,
+                               guint              *out_first_line,
+                               guint              *out_n_lines)
+{
+  g_assert (i < self->n_bands);
+
+  *out_bounds = GRAPHENE_RECT_INIT (self->bounds.origin.x,
+                                    self->bounds.origin.y + i * self->band_height,
+                                    self->bounds.size.width,
+                                    self->band_height);
+  *out_first_line = self->bands[i].first_line;
+  *out_n_lines = self->bands[i].n_lines;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "gskgputypesprivate.h"
+#include "gskpath.h"
+
+#include <graphene.h>
+
+G_BEGIN_DECLS
+
+GskGpuTessellation *    gsk_gpu_tessellation_new                        (GskPath                        *path,
+                                                                         const graphene_vec2_t          *scale,
+                                                                         float                           line_width);
+
+GskGpuTessellation *    gsk_gpu_tessellation_ref                        (GskGpuTessellation             *self);
+void                    gsk_gpu_tessellation_unref                      (GskGpuTessellation             *self);
+
+GdkTexture *            gsk_gpu_tessellation_get_lines                  (GskGpuTessellation             *self);
+gsize                   gsk_gpu_tessellation_get_size                   (GskGpuTessellation             *self);
+guint                   gsk_gpu_tessellation_get_n_bands                (GskGpuTessellation             *self);
+void                    gsk_gpu_tessellation_get_band                   (GskGpuTessellation             *self,
+                                                                         guint                           i,
+                                                                         graphene_rect_t                *out_bounds,
+                                                                         guint                          *out_first_line,
+                                                                         guint                          *out_n_lines);
+
+G_END_DECLS
+
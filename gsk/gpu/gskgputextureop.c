@@ -28,6 +28,7 @@ gsk_gpu_texture_op_print_instance (GskGpuShaderOp *shader,
 
 static const GskGpuShaderOpClass GSK_GPU_TEXTURE_OP_CLASS = {
   {
+    "texture",
     GSK_GPU_OP_SIZE (GskGpuTextureOp),
     GSK_GPU_STAGE_SHADER,
     gsk_gpu_shader_op_finish,
@@ -15,8 +15,10 @@ typedef struct _GskGpuFrame             GskGpuFrame;
 typedef struct _GskGpuImage             GskGpuImage;
 typedef struct _GskGpuOp                GskGpuOp;
 typedef struct _GskGpuOpClass           GskGpuOpClass;
+typedef struct _GskGpuRecording         GskGpuRecording;
 typedef struct _GskGpuShaderOp          GskGpuShaderOp;
 typedef struct _GskGpuShaderOpClass     GskGpuShaderOpClass;
+typedef struct _GskGpuTessellation      GskGpuTessellation;
 typedef struct _GskVulkanDescriptors    GskVulkanDescriptors;
 typedef struct _GskVulkanSemaphores     GskVulkanSemaphores;
 
@@ -53,6 +55,12 @@ typedef enum {
   GSK_GPU_BLEND_CLEAR
 } GskGpuBlend;
 
+typedef enum {
+  GSK_GPU_PATH_FILL_WINDING,
+  GSK_GPU_PATH_FILL_EVEN_ODD,
+  GSK_GPU_PATH_STROKE
+} GskGpuPathMode;
+
 typedef enum {
   GSK_GPU_PATTERN_DONE,
   GSK_GPU_PATTERN_COLOR,
@@ -118,5 +126,9 @@ typedef enum {
   GSK_GPU_OPTIMIZE_BLIT                 = 1 <<  3,
   GSK_GPU_OPTIMIZE_GRADIENTS            = 1 <<  4,
   GSK_GPU_OPTIMIZE_MIPMAP               = 1 <<  5,
+  GSK_GPU_OPTIMIZE_NODE_CACHE           = 1 <<  6,
+  GSK_GPU_OPTIMIZE_PARALLEL             = 1 <<  7,
+  GSK_GPU_OPTIMIZE_RETAIN               = 1 <<  8,
+  GSK_GPU_OPTIMIZE_PATHS                = 1 <<  9,
 } GskGpuOptimizations;
 
@@ -28,6 +28,7 @@ gsk_gpu_uber_op_print_instance (GskGpuShaderOp *shader,
 
 static const GskGpuShaderOpClass GSK_GPU_UBER_OP_CLASS = {
   {
+    "uber",
     GSK_GPU_OP_SIZE (GskGpuUberOp),
     GSK_GPU_STAGE_SHADER,
     gsk_gpu_shader_op_finish,
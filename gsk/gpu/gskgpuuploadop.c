@@ -13,6 +13,9 @@
 #endif
 
 #include "gdk/gdkglcontextprivate.h"
+#include "gdk/gdkmemorytextureprivate.h"
+#include "gdk/gdkparalleltaskprivate.h"
+#include "gdk/gdktexturedownloaderprivate.h"
 #include "gsk/gskdebugprivate.h"
 
 static GskGpuOp *
@@ -92,27 +95,12 @@ gsk_gpu_upload_op_gl_command (GskGpuOp          *op,
 }
 
 #ifdef GDK_RENDERING_VULKAN
-static GskGpuOp *
-gsk_gpu_upload_op_vk_command_with_area (GskGpuOp                    *op,
-                                        GskGpuFrame                 *frame,
-                                        GskVulkanCommandState       *state,
-                                        GskVulkanImage              *image,
-                                        const cairo_rectangle_int_t *area,
-                                        void           (* draw_func) (GskGpuOp *, guchar *, gsize),
-                                        GskGpuBuffer               **buffer)
+static void
+gsk_gpu_upload_op_vk_copy_buffer (GskVulkanCommandState       *state,
+                                  GskVulkanImage              *image,
+                                  const cairo_rectangle_int_t *area,
+                                  GskGpuBuffer                *buffer)
 {
-  gsize stride;
-  guchar *data;
-
-  stride = area->width * gdk_memory_format_bytes_per_pixel (gsk_gpu_image_get_format (GSK_GPU_IMAGE (image)));
-  *buffer = gsk_vulkan_buffer_new_write (GSK_VULKAN_DEVICE (gsk_gpu_frame_get_device (frame)),
-                                         area->height * stride);
-  data = gsk_gpu_buffer_map (*buffer);
-
-  draw_func (op, data, stride);
-
-  gsk_gpu_buffer_unmap (*buffer, area->height * stride);
-
   vkCmdPipelineBarrier (state->vk_command_buffer,
                         VK_PIPELINE_STAGE_HOST_BIT,
                         VK_PIPELINE_STAGE_TRANSFER_BIT,
@@ -124,7 +112,7 @@ gsk_gpu_upload_op_vk_command_with_area (GskGpuOp                    *op,
                             .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
                             .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                             .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                            .buffer = gsk_vulkan_buffer_get_vk_buffer (GSK_VULKAN_BUFFER (*buffer)),
+                            .buffer = gsk_vulkan_buffer_get_vk_buffer (GSK_VULKAN_BUFFER (buffer)),
                             .offset = 0,
                             .size = VK_WHOLE_SIZE,
                         },
@@ -137,7 +125,7 @@ gsk_gpu_upload_op_vk_command_with_area (GskGpuOp                    *op,
                                VK_ACCESS_TRANSFER_WRITE_BIT);
 
   vkCmdCopyBufferToImage (state->vk_command_buffer,
-                          gsk_vulkan_buffer_get_vk_buffer (GSK_VULKAN_BUFFER (*buffer)),
+                          gsk_vulkan_buffer_get_vk_buffer (GSK_VULKAN_BUFFER (buffer)),
                           gsk_vulkan_image_get_vk_image (image),
                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                           1,
@@ -164,6 +152,30 @@ gsk_gpu_upload_op_vk_command_with_area (GskGpuOp                    *op,
                                    }
                                }
                           });
+}
+
+static GskGpuOp *
+gsk_gpu_upload_op_vk_command_with_area (GskGpuOp                    *op,
+                                        GskGpuFrame                 *frame,
+                                        GskVulkanCommandState       *state,
+                                        GskVulkanImage              *image,
+                                        const cairo_rectangle_int_t *area,
+                                        void           (* draw_func) (GskGpuOp *, guchar *, gsize),
+                                        GskGpuBuffer               **buffer)
+{
+  gsize stride;
+  guchar *data;
+
+  stride = area->width * gdk_memory_format_bytes_per_pixel (gsk_gpu_image_get_format (GSK_GPU_IMAGE (image)));
+  *buffer = gsk_vulkan_buffer_new_write (GSK_VULKAN_DEVICE (gsk_gpu_frame_get_device (frame)),
+                                         area->height * stride);
+  data = gsk_gpu_buffer_map (*buffer);
+
+  draw_func (op, data, stride);
+
+  gsk_gpu_buffer_unmap (*buffer, area->height * stride);
+
+  gsk_gpu_upload_op_vk_copy_buffer (state, image, area, *buffer);
 
   return op->next;
 }
@@ -204,6 +216,76 @@ gsk_gpu_upload_op_vk_command (GskGpuOp              *op,
 }
 #endif
 
+#ifdef GDK_RENDERING_VULKAN
+/* Textures at least this big are converted into their staging
+ * memory on a worker thread while the rest of the frame is recorded.
+ */
+#define STAGED_UPLOAD_MIN_PIXELS (512 * 512)
+
+typedef struct _GskGpuStagedUpload GskGpuStagedUpload;
+
+struct _GskGpuStagedUpload
+{
+  GdkTexture *texture;
+  GdkMemoryFormat format;
+  guchar *data;
+  gsize stride;
+
+  GdkParallelTask *task;
+};
+
+static void
+gsk_gpu_staged_upload_task (guint    task_index,
+                            gpointer data)
+{
+  GskGpuStagedUpload *upload = data;
+  GdkTextureDownloader downloader;
+
+  gdk_texture_downloader_init (&downloader, upload->texture);
+  gdk_texture_downloader_set_format (&downloader, upload->format);
+  gdk_texture_downloader_download_into (&downloader, upload->data, upload->stride);
+  gdk_texture_downloader_finish (&downloader);
+}
+
+static GskGpuStagedUpload *
+gsk_gpu_staged_upload_new (GdkTexture      *texture,
+                           GdkMemoryFormat  format,
+                           guchar          *data,
+                           gsize            stride)
+{
+  GskGpuStagedUpload *upload;
+
+  upload = g_new0 (GskGpuStagedUpload, 1);
+  upload->texture = g_object_ref (texture);
+  upload->format = format;
+  upload->data = data;
+  upload->stride = stride;
+
+  upload->task = gdk_parallel_task_start (gsk_gpu_staged_upload_task, upload, 1);
+
+  return upload;
+}
+
+static void
+gsk_gpu_staged_upload_wait (GskGpuStagedUpload *upload)
+{
+  if (upload->task)
+    {
+      gdk_parallel_task_finish (upload->task);
+      upload->task = NULL;
+    }
+}
+
+static void
+gsk_gpu_staged_upload_free (GskGpuStagedUpload *upload)
+{
+  gsk_gpu_staged_upload_wait (upload);
+
+  g_object_unref (upload->texture);
+  g_free (upload);
+}
+#endif
+
 typedef struct _GskGpuUploadTextureOp GskGpuUploadTextureOp;
 
 struct _GskGpuUploadTextureOp
@@ -213,6 +295,9 @@ struct _GskGpuUploadTextureOp
   GskGpuImage *image;
   GskGpuBuffer *buffer;
   GdkTexture *texture;
+#ifdef GDK_RENDERING_VULKAN
+  GskGpuStagedUpload *staged;
+#endif
 };
 
 static void
@@ -220,6 +305,10 @@ gsk_gpu_upload_texture_op_finish (GskGpuOp *op)
 {
   GskGpuUploadTextureOp *self = (GskGpuUploadTextureOp *) op;
 
+#ifdef GDK_RENDERING_VULKAN
+  /* the worker may still be writing into the buffer */
+  g_clear_pointer (&self->staged, gsk_gpu_staged_upload_free);
+#endif
   g_object_unref (self->image);
   g_clear_object (&self->buffer);
   g_object_unref (self->texture);
@@ -260,6 +349,26 @@ gsk_gpu_upload_texture_op_vk_command (GskGpuOp              *op,
 {
   GskGpuUploadTextureOp *self = (GskGpuUploadTextureOp *) op;
 
+  if (self->staged)
+    {
+      gsk_gpu_staged_upload_wait (self->staged);
+
+      if (self->buffer)
+        {
+          gsk_gpu_buffer_unmap (self->buffer, gsk_gpu_buffer_get_size (self->buffer));
+          gsk_gpu_upload_op_vk_copy_buffer (state,
+                                            GSK_VULKAN_IMAGE (self->image),
+                                            &(cairo_rectangle_int_t) {
+                                                0, 0,
+                                                gsk_gpu_image_get_width (self->image),
+                                                gsk_gpu_image_get_height (self->image),
+                                            },
+                                            self->buffer);
+        }
+
+      return op->next;
+    }
+
   return gsk_gpu_upload_op_vk_command (op,
                                        frame,
                                        state,
@@ -283,6 +392,7 @@ gsk_gpu_upload_texture_op_gl_command (GskGpuOp          *op,
 }
 
 static const GskGpuOpClass GSK_GPU_UPLOAD_TEXTURE_OP_CLASS = {
+  "upload-texture",
   GSK_GPU_OP_SIZE (GskGpuUploadTextureOp),
   GSK_GPU_STAGE_UPLOAD,
   gsk_gpu_upload_texture_op_finish,
@@ -293,6 +403,47 @@ static const GskGpuOpClass GSK_GPU_UPLOAD_TEXTURE_OP_CLASS = {
   gsk_gpu_upload_texture_op_gl_command
 };
 
+#ifdef GDK_RENDERING_VULKAN
+/* Start converting big memory textures on a worker thread right away,
+ * so that happens while the rest of the frame is recorded and the
+ * command only has to wait for whatever is left.
+ * Other textures may need a GL context or are quick to convert, those
+ * are still written when the command is submitted.
+ */
+static void
+gsk_gpu_upload_texture_op_try_stage (GskGpuUploadTextureOp *self,
+                                     GskGpuFrame           *frame)
+{
+  GskVulkanImage *image;
+  GdkMemoryFormat format;
+  gsize width, height, stride;
+  guchar *data;
+
+  if (!GSK_IS_VULKAN_IMAGE (self->image) ||
+      !GDK_IS_MEMORY_TEXTURE (self->texture))
+    return;
+
+  image = GSK_VULKAN_IMAGE (self->image);
+  format = gsk_gpu_image_get_format (self->image);
+  width = gsk_gpu_image_get_width (self->image);
+  height = gsk_gpu_image_get_height (self->image);
+  if (width * height < STAGED_UPLOAD_MIN_PIXELS)
+    return;
+
+  /* The image was just created, so nothing else can be using its memory */
+  data = gsk_vulkan_image_get_data (image, &stride);
+  if (data == NULL)
+    {
+      stride = width * gdk_memory_format_bytes_per_pixel (format);
+      self->buffer = gsk_vulkan_buffer_new_write (GSK_VULKAN_DEVICE (gsk_gpu_frame_get_device (frame)),
+                                                  height * stride);
+      data = gsk_gpu_buffer_map (self->buffer);
+    }
+
+  self->staged = gsk_gpu_staged_upload_new (self->texture, format, data, stride);
+}
+#endif
+
 GskGpuImage *
 gsk_gpu_upload_texture_op_try (GskGpuFrame *frame,
                                gboolean     with_mipmap,
@@ -333,6 +484,10 @@ gsk_gpu_upload_texture_op_try (GskGpuFrame *frame,
   self->texture = g_object_ref (texture);
   self->image = image;
 
+#ifdef GDK_RENDERING_VULKAN
+  gsk_gpu_upload_texture_op_try_stage (self, frame);
+#endif
+
   return self->image;
 }
 
@@ -440,6 +595,7 @@ gsk_gpu_upload_cairo_op_gl_command (GskGpuOp          *op,
 }
 
 static const GskGpuOpClass GSK_GPU_UPLOAD_CAIRO_OP_CLASS = {
+  "upload-cairo",
   GSK_GPU_OP_SIZE (GskGpuUploadCairoOp),
   GSK_GPU_STAGE_UPLOAD,
   gsk_gpu_upload_cairo_op_finish,
@@ -608,6 +764,7 @@ gsk_gpu_upload_glyph_op_gl_command (GskGpuOp          *op,
 }
 
 static const GskGpuOpClass GSK_GPU_UPLOAD_GLYPH_OP_CLASS = {
+  "upload-glyph",
   GSK_GPU_OP_SIZE (GskGpuUploadGlyphOp),
   GSK_GPU_STAGE_UPLOAD,
   gsk_gpu_upload_glyph_op_finish,
@@ -72,6 +72,11 @@ gsk_ngl_renderer_create_context (GskGpuRenderer       *renderer,
    */
   *supported &= ~GSK_GPU_OPTIMIZE_UBER;
 
+  /* Creating images makes GL calls, and those need the context
+   * to be current in the calling thread.
+   */
+  *supported &= ~GSK_GPU_OPTIMIZE_PARALLEL;
+
   return GDK_DRAW_CONTEXT (context);
 }
 
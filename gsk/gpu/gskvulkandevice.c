@@ -87,6 +87,7 @@ struct _RenderPassCacheKey
   VkFormat format;
   VkImageLayout from_layout;
   VkImageLayout to_layout;
+  VkAttachmentLoadOp load_op;
 };
 
 static guint
@@ -138,7 +139,8 @@ render_pass_cache_key_hash (gconstpointer data)
 {
   const RenderPassCacheKey *key = data;
 
-  return (key->from_layout << 20) ^
+  return (key->load_op << 24) ^
+         (key->from_layout << 20) ^
          (key->to_layout << 16) ^
          (key->format);
 }
@@ -152,7 +154,8 @@ render_pass_cache_key_equal (gconstpointer a,
 
   return keya->from_layout == keyb->from_layout &&
          keya->to_layout == keyb->to_layout &&
-         keya->format == keyb->format;
+         keya->format == keyb->format &&
+         keya->load_op == keyb->load_op;
 }
 
 static GskVulkanPipelineLayout *
@@ -817,10 +820,11 @@ gsk_vulkan_device_get_vk_conversion (GskVulkanDevice *self,
 }
 
 VkRenderPass
-gsk_vulkan_device_get_vk_render_pass (GskVulkanDevice *self,
-                                      VkFormat         format,
-                                      VkImageLayout    from_layout,
-                                      VkImageLayout    to_layout)
+gsk_vulkan_device_get_vk_render_pass (GskVulkanDevice    *self,
+                                      VkFormat            format,
+                                      VkImageLayout       from_layout,
+                                      VkImageLayout       to_layout,
+                                      VkAttachmentLoadOp  load_op)
 {
   RenderPassCacheKey cache_key;
   VkRenderPass render_pass;
@@ -830,6 +834,7 @@ gsk_vulkan_device_get_vk_render_pass (GskVulkanDevice *self,
     .format = format,
     .from_layout = from_layout,
     .to_layout = to_layout,
+    .load_op = load_op,
   };
   render_pass = g_hash_table_lookup (self->render_pass_cache, &cache_key);
   if (render_pass)
@@ -845,7 +850,7 @@ gsk_vulkan_device_get_vk_render_pass (GskVulkanDevice *self,
                                            {
                                               .format = format,
                                               .samples = VK_SAMPLE_COUNT_1_BIT,
-                                              .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                              .loadOp = load_op,
                                               .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
                                               .initialLayout = from_layout,
                                               .finalLayout = to_layout
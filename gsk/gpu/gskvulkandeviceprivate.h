@@ -69,7 +69,8 @@ VkSamplerYcbcrConversion
 VkRenderPass            gsk_vulkan_device_get_vk_render_pass            (GskVulkanDevice        *self,
                                                                          VkFormat                format,
                                                                          VkImageLayout           from_layout,
-                                                                         VkImageLayout           to_layout);
+                                                                         VkImageLayout           to_layout,
+                                                                         VkAttachmentLoadOp      load_op);
 VkPipeline              gsk_vulkan_device_get_vk_pipeline               (GskVulkanDevice        *self,
                                                                          GskVulkanPipelineLayout*layout,
                                                                          const GskGpuShaderOpClass *op_class,
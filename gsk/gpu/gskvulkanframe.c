@@ -51,6 +51,12 @@ struct _GskVulkanFrame
 
   GskDescriptors descriptors;
 
+  /* 0 if the queue does not support timestamps */
+  float timestamp_period;
+  guint64 timestamp_mask;
+  VkQueryPool vk_query_pool;
+  guint query_pool_size;
+
   gsize pool_n_sets;
   gsize pool_n_images;
   gsize pool_n_buffers;
@@ -96,11 +102,25 @@ gsk_vulkan_frame_setup (GskGpuFrame *frame)
   GskVulkanDevice *device;
   VkDevice vk_device;
   VkCommandPool vk_command_pool;
+  VkPhysicalDeviceProperties properties;
+  VkQueueFamilyProperties *queue_families;
+  uint32_t n_queue_families, valid_bits;
 
   device = GSK_VULKAN_DEVICE (gsk_gpu_frame_get_device (frame));
   vk_device = gsk_vulkan_device_get_vk_device (device);
   vk_command_pool = gsk_vulkan_device_get_vk_command_pool (device);
 
+  vkGetPhysicalDeviceProperties (gsk_vulkan_device_get_vk_physical_device (device), &properties);
+  vkGetPhysicalDeviceQueueFamilyProperties (gsk_vulkan_device_get_vk_physical_device (device), &n_queue_families, NULL);
+  queue_families = g_newa (VkQueueFamilyProperties, n_queue_families);
+  vkGetPhysicalDeviceQueueFamilyProperties (gsk_vulkan_device_get_vk_physical_device (device), &n_queue_families, queue_families);
+  valid_bits = queue_families[gsk_vulkan_device_get_vk_queue_family_index (device)].timestampValidBits;
+  if (valid_bits > 0)
+    {
+      self->timestamp_period = properties.limits.timestampPeriod;
+      self->timestamp_mask = valid_bits >= 64 ? G_MAXUINT64 : (G_GUINT64_CONSTANT (1) << valid_bits) - 1;
+    }
+
   GSK_VK_CHECK (vkAllocateCommandBuffers, vk_device,
                                           &(VkCommandBufferAllocateInfo) {
                                               .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -119,6 +139,75 @@ gsk_vulkan_frame_setup (GskGpuFrame *frame)
                                &self->vk_fence);
 }
 
+static void
+gsk_vulkan_frame_read_timestamps (GskVulkanFrame *self,
+                                  VkDevice        vk_device)
+{
+  guint i, n_timestamps;
+  guint64 *timestamps;
+
+  n_timestamps = gsk_gpu_frame_get_n_timestamps (GSK_GPU_FRAME (self));
+  if (n_timestamps == 0)
+    return;
+
+  timestamps = g_new (guint64, n_timestamps);
+  if (vkGetQueryPoolResults (vk_device,
+                             self->vk_query_pool,
+                             0, n_timestamps,
+                             n_timestamps * sizeof (guint64),
+                             timestamps,
+                             sizeof (guint64),
+                             VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) == VK_SUCCESS)
+    {
+      for (i = 0; i < n_timestamps; i++)
+        timestamps[i] = (guint64) ((timestamps[i] & self->timestamp_mask) * (double) self->timestamp_period);
+
+      gsk_gpu_frame_report_timestamps (GSK_GPU_FRAME (self), timestamps);
+    }
+
+  g_free (timestamps);
+}
+
+static void
+gsk_vulkan_frame_prepare_query_pool (GskVulkanFrame *self,
+                                     guint           n_queries)
+{
+  VkDevice vk_device;
+
+  vk_device = gsk_vulkan_device_get_vk_device (GSK_VULKAN_DEVICE (gsk_gpu_frame_get_device (GSK_GPU_FRAME (self))));
+
+  if (n_queries > self->query_pool_size)
+    {
+      if (self->vk_query_pool != VK_NULL_HANDLE)
+        vkDestroyQueryPool (vk_device, self->vk_query_pool, NULL);
+
+      self->query_pool_size = MAX (n_queries, 2 * self->query_pool_size);
+
+      GSK_VK_CHECK (vkCreateQueryPool, vk_device,
+                                       &(VkQueryPoolCreateInfo) {
+                                           .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                                           .queryType = VK_QUERY_TYPE_TIMESTAMP,
+                                           .queryCount = self->query_pool_size,
+                                       },
+                                       NULL,
+                                       &self->vk_query_pool);
+    }
+
+  vkCmdResetQueryPool (self->vk_command_buffer, self->vk_query_pool, 0, n_queries);
+}
+
+/* Writes a timestamp query before the command for @op,
+ * or after the last command if @op is NULL */
+void
+gsk_vulkan_frame_write_timestamp (GskVulkanFrame *self,
+                                  GskGpuOp       *op)
+{
+  vkCmdWriteTimestamp (self->vk_command_buffer,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                       self->vk_query_pool,
+                       gsk_gpu_frame_add_timestamp (GSK_GPU_FRAME (self), op));
+}
+
 static void
 gsk_vulkan_frame_cleanup (GskGpuFrame *frame)
 {
@@ -139,6 +228,8 @@ gsk_vulkan_frame_cleanup (GskGpuFrame *frame)
                                1,
                                &self->vk_fence);
 
+  gsk_vulkan_frame_read_timestamps (self, vk_device);
+
   GSK_VK_CHECK (vkResetCommandBuffer, self->vk_command_buffer,
                                       0);
 
@@ -303,6 +394,7 @@ gsk_vulkan_frame_submit (GskGpuFrame  *frame,
   GskVulkanFrame *self = GSK_VULKAN_FRAME (frame);
   GskVulkanSemaphores semaphores;
   GskVulkanCommandState state;
+  gboolean measure;
 
   if (gsk_descriptors_get_size (&self->descriptors) == 0)
     gsk_descriptors_append (&self->descriptors, gsk_vulkan_real_descriptors_new (self));
@@ -315,6 +407,19 @@ gsk_vulkan_frame_submit (GskGpuFrame  *frame,
                                           .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
                                       });
 
+  measure = self->timestamp_period > 0 && gsk_gpu_frame_should_measure (frame);
+  if (measure)
+    {
+      GskGpuOp *o;
+      guint n_ops = 0;
+
+      /* one query per op at most, plus one after the last command */
+      for (o = op; o; o = o->next)
+        n_ops++;
+
+      gsk_vulkan_frame_prepare_query_pool (self, n_ops + 1);
+    }
+
   if (vertex_buffer)
     vkCmdBindVertexBuffers (self->vk_command_buffer,
                             0,
@@ -334,6 +439,7 @@ gsk_vulkan_frame_submit (GskGpuFrame  *frame,
   state.blend = GSK_GPU_BLEND_OVER; /* should we have a BLEND_NONE? */
   state.desc = GSK_VULKAN_DESCRIPTORS (gsk_descriptors_get (&self->descriptors, 0));
   state.semaphores = &semaphores;
+  state.measure = measure;
 
   gsk_vulkan_descriptors_bind (GSK_VULKAN_DESCRIPTORS (gsk_descriptors_get (&self->descriptors, 0)),
                                NULL,
@@ -341,9 +447,15 @@ gsk_vulkan_frame_submit (GskGpuFrame  *frame,
 
   while (op)
     {
+      if (measure)
+        gsk_vulkan_frame_write_timestamp (self, op);
+
       op = gsk_gpu_op_vk_command (op, frame, &state);
     }
 
+  if (measure)
+    gsk_vulkan_frame_write_timestamp (self, NULL);
+
   GSK_VK_CHECK (vkEndCommandBuffer, self->vk_command_buffer);
 
   GSK_VK_CHECK (vkQueueSubmit, gsk_vulkan_device_get_vk_queue (GSK_VULKAN_DEVICE (gsk_gpu_frame_get_device (frame))),
@@ -385,6 +497,13 @@ gsk_vulkan_frame_finalize (GObject *object)
     }
   gsk_descriptors_clear (&self->descriptors);
 
+  if (self->vk_query_pool != VK_NULL_HANDLE)
+    {
+      vkDestroyQueryPool (vk_device,
+                          self->vk_query_pool,
+                          NULL);
+    }
+
   vkFreeCommandBuffers (vk_device,
                         vk_command_pool,
                         1, &self->vk_command_buffer);
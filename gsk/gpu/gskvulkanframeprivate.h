@@ -11,6 +11,8 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE (GskVulkanFrame, gsk_vulkan_frame, GSK, VULKAN_FRAME, GskGpuFrame)
 
 VkFence                 gsk_vulkan_frame_get_vk_fence                   (GskVulkanFrame         *self) G_GNUC_PURE;
+void                    gsk_vulkan_frame_write_timestamp                (GskVulkanFrame         *self,
+                                                                         GskGpuOp               *op);
 
 void                    gsk_vulkan_semaphores_add_wait                  (GskVulkanSemaphores    *self,
                                                                          VkSemaphore             semaphore,
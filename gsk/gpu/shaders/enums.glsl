@@ -52,6 +52,10 @@
 #define GSK_MASK_MODE_LUMINANCE 2u
 #define GSK_MASK_MODE_INVERTED_LUMINANCE 3u
 
+#define GSK_GPU_PATH_FILL_WINDING 0u
+#define GSK_GPU_PATH_FILL_EVEN_ODD 1u
+#define GSK_GPU_PATH_STROKE 2u
+
 #define TOP 0u
 #define RIGHT 1u
 #define BOTTOM 2u
@@ -0,0 +1,116 @@
+#include "common.glsl"
+
+#define VARIATION_PATH_MODE GSK_VARIATION
+
+PASS(0) vec2 _pos;
+PASS_FLAT(1) Rect _rect;
+PASS_FLAT(2) vec4 _color;
+PASS_FLAT(3) vec2 _offset;
+PASS_FLAT(4) uint _lines_id;
+PASS_FLAT(5) uint _first_line;
+PASS_FLAT(6) uint _n_lines;
+PASS_FLAT(7) float _half_width;
+
+
+#ifdef GSK_VERTEX_SHADER
+
+IN(0) vec4 in_rect;
+IN(1) vec4 in_color;
+IN(2) vec2 in_offset;
+IN(3) uint in_lines_id;
+IN(4) uvec2 in_lines;
+IN(5) float in_half_width;
+
+void
+run (out vec2 pos)
+{
+  Rect r = rect_from_gsk (in_rect);
+  
+  pos = rect_get_position (r);
+
+  _pos = pos;
+  _rect = r;
+  _color = color_premultiply (in_color);
+  _offset = in_offset;
+  _lines_id = in_lines_id;
+  _first_line = in_lines.x;
+  _n_lines = in_lines.y;
+  _half_width = in_half_width;
+}
+
+#endif
+
+
+
+#ifdef GSK_FRAGMENT_SHADER
+
+/* The texture contains one line per texel: x0, y0, x1, y1 */
+vec4
+path_get_line (uint i)
+{
+  ivec2 size = gsk_texture_size (_lines_id, 0);
+  ivec2 coord = ivec2 (int (i) % size.x, int (i) / size.x);
+
+  return gsk_texture (_lines_id, (vec2 (coord) + 0.5) / vec2 (size));
+}
+
+void
+run (out vec4 color,
+     out vec2 position)
+{
+  vec2 p = _pos / GSK_GLOBAL_SCALE - _offset;
+  float dist = 1000000.0;
+  int winding = 0;
+  float coverage;
+  uint i;
+
+  /* Bands don't overlap, every pixel is drawn by exactly one of them */
+  if (_pos.y < _rect.bounds.y || _pos.y >= _rect.bounds.w)
+    {
+      color = vec4 (0.0);
+      position = _pos;
+      return;
+    }
+
+  for (i = 0u; i < _n_lines; i++)
+    {
+      vec4 line = path_get_line (_first_line + i);
+      vec2 ba = line.zw - line.xy;
+      vec2 pa = p - line.xy;
+      float h = clamp (dot (pa, ba) / max (dot (ba, ba), 1e-12), 0.0, 1.0);
+
+      /* distance in device pixels */
+      dist = min (dist, length ((pa - ba * h) * GSK_GLOBAL_SCALE));
+
+      if ((line.y <= p.y) != (line.w <= p.y))
+        {
+          float x = line.x + (p.y - line.y) * ba.x / ba.y;
+          if (x > p.x)
+            winding += ba.y > 0.0 ? 1 : -1;
+        }
+    }
+
+  switch (VARIATION_PATH_MODE)
+  {
+    case GSK_GPU_PATH_FILL_WINDING:
+      coverage = winding != 0 ? 0.5 + dist : 0.5 - dist;
+      break;
+
+    case GSK_GPU_PATH_FILL_EVEN_ODD:
+      coverage = (winding & 1) != 0 ? 0.5 + dist : 0.5 - dist;
+      break;
+
+    case GSK_GPU_PATH_STROKE:
+      coverage = _half_width + 0.5 - dist;
+      break;
+
+    default:
+      coverage = 0.0;
+      break;
+  }
+
+  color = _color * clamp (coverage, 0.0, 1.0);
+  position = _pos;
+}
+
+#endif
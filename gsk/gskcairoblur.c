@@ -22,6 +22,8 @@
 
 #include "gskcairoblurprivate.h"
 
+#include "gdk/gdkparalleltaskprivate.h"
+
 #include <math.h>
 #include <string.h>
 
@@ -38,151 +40,227 @@
 
 #define get_box_filter_size(radius) ((int)(GAUSSIAN_SCALE_FACTOR * (radius)))
 
-/* Sadly, clang is picky about get_box_filter_size(2) not being a
- * constant expression, thus we have to use precomputed values.
+/* Columns are blurred in strips of this many bytes */
+#define BLUR_STRIP_WIDTH 64
+/* Rows are blurred in bands of this many rows */
+#define BLUR_BAND_HEIGHT 16
+/* Surfaces smaller than this are blurred in the calling thread */
+#define BLUR_PARALLEL_PIXELS (256 * 256)
+
+typedef struct _BlurPass BlurPass;
+typedef struct _BlurData BlurData;
+
+/* A single box blur pass.
+ *
+ * d is the filter width; for even d shift indicates how the blurred
+ * result is aligned with the original - does ' x ' go to ' yy' (shift=1)
+ * or 'yy ' (shift=-1)
+ */
+struct _BlurPass
+{
+  int d;
+  int offset;
+  guint64 multiplier;
+};
+
+struct _BlurData
+{
+  guchar *buffer;
+  int width;
+  int height;
+  BlurPass passes[3];
+};
+
+static void
+blur_pass_init (BlurPass *pass,
+                int       d,
+                int       shift)
+{
+  pass->d = d;
+  if (d % 2 == 1)
+    pass->offset = d / 2;
+  else
+    pass->offset = (d - shift) / 2;
+  pass->multiplier = (G_GUINT64_CONSTANT (1) << 48) / d + 1;
+}
+
+/* Computes (sum + d / 2) / d without a division.
+ *
+ * The result is exact as long as 257 * d * d < 2^48, which holds for
+ * any filter that fits into an image surface.
  */
-#define BOX_FILTER_SIZE_2 3
-#define BOX_FILTER_SIZE_3 5
-#define BOX_FILTER_SIZE_4 7
-#define BOX_FILTER_SIZE_5 9
-#define BOX_FILTER_SIZE_6 11
-#define BOX_FILTER_SIZE_7 13
-#define BOX_FILTER_SIZE_8 15
-#define BOX_FILTER_SIZE_9 16
-#define BOX_FILTER_SIZE_10 18
+static inline guchar
+blur_pass_divide (const BlurPass *pass,
+                  guint32         sum)
+{
+  return ((sum + pass->d / 2) * pass->multiplier) >> 48;
+}
 
 /* This applies a single box blur pass to a horizontal range of pixels;
  * since the box blur has the same weight for all pixels, we can
  * implement an efficient sliding window algorithm where we add
  * in pixels coming into the window from the right and remove
  * them when they leave the windw to the left.
- *
- * d is the filter width; for even d shift indicates how the blurred
- * result is aligned with the original - does ' x ' go to ' yy' (shift=1)
- * or 'yy ' (shift=-1)
  */
 static void
-blur_xspan (guchar *row,
-            guchar *tmp_buffer,
-            int     row_width,
-            int     d,
-            int     shift)
+blur_xspan (guchar         *row,
+            guchar         *tmp_buffer,
+            int             row_width,
+            const BlurPass *pass)
 {
-  int offset;
-  int sum = 0;
+  int d = pass->d;
+  int offset = pass->offset;
+  guint32 sum = 0;
   int i;
 
-  if (d % 2 == 1)
-    offset = d / 2;
-  else
-    offset = (d - shift) / 2;
-
-  /* All the conditionals in here look slow, but the branches will
-   * be well predicted and there are enough different possibilities
-   * that trying to write this as a series of unconditional loops
-   * is hard and not an obvious win. The main slow down here seems
-   * to be the integer division per pixel; one possible optimization
-   * would be to accumulate into two 16-bit integer buffers and
-   * only divide down after all three passes. (SSE parallel implementation
-   * of the divide step is possible.)
-   */
+  /* The window for pixel i is (i + offset - d, i + offset] */
+  for (i = 0; i < MIN (offset, row_width); i++)
+    sum += row[i];
 
-#define BLUR_ROW_KERNEL(D)                                      \
-  for (i = -(D) + offset; i < row_width + offset; i++)		\
-    {                                                           \
-      if (i >= 0 && i < row_width)                              \
-        sum += row[i];                                          \
-                                                                \
-      if (i >= offset)						\
-	{							\
-	  if (i >= (D))						\
-	    sum -= row[i - (D)];				\
-                                                                \
-	  tmp_buffer[i - offset] = (sum + (D) / 2) / (D);	\
-	}							\
-    }								\
-  break;
-
-  /* We unroll the values for d for radius 2-10 to avoid a generic
-   * divide operation (not radius 1, because its a no-op) */
-  switch (d)
+  for (i = 0; i < row_width; i++)
     {
-    case BOX_FILTER_SIZE_2: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_2);
-    case BOX_FILTER_SIZE_3: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_3);
-    case BOX_FILTER_SIZE_4: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_4);
-    case BOX_FILTER_SIZE_5: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_5);
-    case BOX_FILTER_SIZE_6: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_6);
-    case BOX_FILTER_SIZE_7: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_7);
-    case BOX_FILTER_SIZE_8: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_8);
-    case BOX_FILTER_SIZE_9: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_9);
-    case BOX_FILTER_SIZE_10: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_10);
-    default: BLUR_ROW_KERNEL (d);
+      if (i + offset < row_width)
+        sum += row[i + offset];
+      if (i + offset >= d)
+        sum -= row[i + offset - d];
+
+      tmp_buffer[i] = blur_pass_divide (pass, sum);
     }
 
   memcpy (row, tmp_buffer, row_width);
 }
 
+/* The same as blur_xspan(), but for a strip of columns.
+ *
+ * This works in place, so we don't need to transpose the buffer.
+ * Rows are overwritten before they leave the window, so the ring
+ * keeps a copy of the last d rows.
+ *
+ * The loops over the columns of a strip are independent, so they
+ * can be vectorized. They only are when the width is a constant,
+ * so full strips get their own copy of the loops.
+ */
+#define BLUR_YSPAN_KERNEL(WIDTH)                                        \
+  for (i = -d + offset; i < height + offset; i++)                       \
+    {                                                                   \
+      guchar *saved = ring + slot * (WIDTH);                            \
+                                                                        \
+      if (i >= 0 && i < height)                                         \
+        {                                                               \
+          const guchar *src = strip + i * stride;                       \
+                                                                        \
+          for (x = 0; x < (WIDTH); x++)                                 \
+            sums[x] += src[x] - saved[x];                               \
+          memcpy (saved, src, (WIDTH));                                 \
+        }                                                               \
+      else                                                              \
+        {                                                               \
+          for (x = 0; x < (WIDTH); x++)                                 \
+            sums[x] -= saved[x];                                        \
+          memset (saved, 0, (WIDTH));                                   \
+        }                                                               \
+                                                                        \
+      if (++slot == d)                                                  \
+        slot = 0;                                                       \
+                                                                        \
+      if (i >= offset)                                                  \
+        {                                                               \
+          guchar *dst = strip + (i - offset) * stride;                  \
+                                                                        \
+          for (x = 0; x < (WIDTH); x++)                                 \
+            dst[x] = blur_pass_divide (&local, sums[x]);                \
+        }                                                               \
+    }
+
 static void
-blur_rows (guchar *dst_buffer,
-           guchar *tmp_buffer,
-           int     buffer_width,
-           int     buffer_height,
-           int     d)
+blur_yspan (guchar         *strip,
+            int             stride,
+            int             strip_width,
+            int             height,
+            guchar         *ring,
+            const BlurPass *pass)
 {
-  int i;
+  /* A local copy, so the compiler knows that writing to the
+   * buffer doesn't change it.
+   */
+  const BlurPass local = *pass;
+  guint32 sums[BLUR_STRIP_WIDTH] = { 0, };
+  int d = pass->d;
+  int offset = pass->offset;
+  int i, x, slot;
+
+  memset (ring, 0, d * strip_width);
+  slot = 0;
+
+  if (strip_width == BLUR_STRIP_WIDTH)
+    {
+      BLUR_YSPAN_KERNEL (BLUR_STRIP_WIDTH);
+    }
+  else
+    {
+      BLUR_YSPAN_KERNEL (strip_width);
+    }
+}
+
+#undef BLUR_YSPAN_KERNEL
+
+static void
+blur_rows (guint    band,
+           gpointer user_data)
+{
+  BlurData *data = user_data;
+  guchar *tmp_buffer;
+  int y, y_end;
+  guint p;
 
-  for (i = 0; i < buffer_height; i++)
+  tmp_buffer = g_malloc (data->width);
+
+  y_end = MIN ((int) (band + 1) * BLUR_BAND_HEIGHT, data->height);
+  for (y = band * BLUR_BAND_HEIGHT; y < y_end; y++)
     {
-      guchar *row = dst_buffer + i * buffer_width;
-
-      /* We want to produce a symmetric blur that spreads a pixel
-       * equally far to the left and right. If d is odd that happens
-       * naturally, but for d even, we approximate by using a blur
-       * on either side and then a centered blur of size d + 1.
-       * (technique also from the SVG specification)
-       */
-      if (d % 2 == 1)
-        {
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
-        }
-      else
-        {
-          blur_xspan (row, tmp_buffer, buffer_width, d, 1);
-          blur_xspan (row, tmp_buffer, buffer_width, d, -1);
-          blur_xspan (row, tmp_buffer, buffer_width, d + 1, 0);
-        }
+      for (p = 0; p < G_N_ELEMENTS (data->passes); p++)
+        blur_xspan (data->buffer + y * data->width, tmp_buffer, data->width, &data->passes[p]);
     }
+
+  g_free (tmp_buffer);
 }
 
-/* Swaps width and height.
- */
 static void
-flip_buffer (guchar *dst_buffer,
-             guchar *src_buffer,
-             int     width,
-             int     height)
+blur_columns (guint    strip,
+              gpointer user_data)
 {
-  /* Working in blocks increases cache efficiency, compared to reading
-   * or writing an entire column at once
-   */
-#define BLOCK_SIZE 16
-
-  int i0, j0;
-
-  for (i0 = 0; i0 < width; i0 += BLOCK_SIZE)
-    for (j0 = 0; j0 < height; j0 += BLOCK_SIZE)
-      {
-        int max_j = MIN(j0 + BLOCK_SIZE, height);
-        int max_i = MIN(i0 + BLOCK_SIZE, width);
-        int i, j;
-
-        for (i = i0; i < max_i; i++)
-          for (j = j0; j < max_j; j++)
-            dst_buffer[i * height + j] = src_buffer[j * width + i];
-      }
-#undef BLOCK_SIZE
+  BlurData *data = user_data;
+  guchar *ring;
+  int x, strip_width;
+  guint p;
+
+  ring = g_malloc (data->passes[2].d * BLUR_STRIP_WIDTH);
+
+  x = strip * BLUR_STRIP_WIDTH;
+  strip_width = MIN (BLUR_STRIP_WIDTH, data->width - x);
+
+  for (p = 0; p < G_N_ELEMENTS (data->passes); p++)
+    blur_yspan (data->buffer + x, data->width, strip_width, data->height, ring, &data->passes[p]);
+
+  g_free (ring);
+}
+
+static void
+blur_run (BlurData    *data,
+          GdkTaskFunc  func,
+          guint        n_tasks)
+{
+  guint i;
+
+  if ((gsize) data->width * data->height >= BLUR_PARALLEL_PIXELS)
+    {
+      gdk_parallel_task_run (func, data, n_tasks);
+    }
+  else
+    {
+      for (i = 0; i < n_tasks; i++)
+        func (i, data);
+    }
 }
 
 static void
@@ -192,30 +270,39 @@ _boxblur (guchar      *buffer,
           int          radius,
           GskBlurFlags flags)
 {
-  guchar *flipped_buffer;
+  BlurData data;
   int d = get_box_filter_size (radius);
 
-  flipped_buffer = g_malloc (width * height);
-
-  if (flags & GSK_BLUR_Y)
+  data.buffer = buffer;
+  data.width = width;
+  data.height = height;
+
+  /* We want to produce a symmetric blur that spreads a pixel
+   * equally far to the left and right. If d is odd that happens
+   * naturally, but for d even, we approximate by using a blur
+   * on either side and then a centered blur of size d + 1.
+   * (technique also from the SVG specification)
+   *
+   * The widest pass comes last, the ring buffers are sized for it.
+   */
+  if (d % 2 == 1)
     {
-      /* Step 1: swap rows and columns */
-      flip_buffer (flipped_buffer, buffer, width, height);
-
-      /* Step 2: blur rows (really columns) */
-      blur_rows (flipped_buffer, buffer, height, width, d);
-
-      /* Step 3: swap rows and columns */
-      flip_buffer (buffer, flipped_buffer, height, width);
+      blur_pass_init (&data.passes[0], d, 0);
+      blur_pass_init (&data.passes[1], d, 0);
+      blur_pass_init (&data.passes[2], d, 0);
     }
-
-  if (flags & GSK_BLUR_X)
+  else
     {
-      /* Step 4: blur rows */
-      blur_rows (buffer, flipped_buffer, width, height, d);
+      blur_pass_init (&data.passes[0], d, 1);
+      blur_pass_init (&data.passes[1], d, -1);
+      blur_pass_init (&data.passes[2], d + 1, 0);
     }
 
-  g_free (flipped_buffer);
+  if (flags & GSK_BLUR_Y)
+    blur_run (&data, blur_columns, (width + BLUR_STRIP_WIDTH - 1) / BLUR_STRIP_WIDTH);
+
+  if (flags & GSK_BLUR_X)
+    blur_run (&data, blur_rows, (height + BLUR_BAND_HEIGHT - 1) / BLUR_BAND_HEIGHT);
 }
 
 /*
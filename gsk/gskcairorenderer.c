@@ -20,13 +20,54 @@
 
 #include "config.h"
 
-#include "gskcairorenderer.h"
+#include "gskcairorendererprivate.h"
 
 #include "gskdebugprivate.h"
+#include "gskrectprivate.h"
 #include "gskrendererprivate.h"
 #include "gskrendernodeprivate.h"
+#include "gsktransformprivate.h"
+#include "gdk/gdkmemorytextureprivate.h"
+#include "gdk/gdkparalleltaskprivate.h"
 #include "gdk/gdktextureprivate.h"
 
+/* Bigger textures are drawn in pieces by the texture node,
+ * see gskrendernodeimpl.c
+ */
+#define MAX_CAIRO_IMAGE_SIZE 16384
+
+typedef struct _GskCairoTile GskCairoTile;
+typedef struct _GskCairoTiling GskCairoTiling;
+
+/* How a node can be drawn in tiles. A node gets the biggest
+ * mode of its children.
+ */
+typedef enum {
+  GSK_CAIRO_TILE_PARALLEL,
+  GSK_CAIRO_TILE_SERIAL,
+  GSK_CAIRO_TILE_UNTILED,
+} GskCairoTileMode;
+
+struct _GskCairoTile
+{
+  cairo_rectangle_int_t area;  /* in device pixels */
+  cairo_surface_t *surface;
+};
+
+struct _GskCairoTiling
+{
+  GskRenderNode *node;
+  cairo_matrix_t matrix;
+  double scale_x;
+  double scale_y;
+  GArray *tiles;
+  /* GdkTexture => cairo_surface_t, downloaded before drawing the tiles */
+  GHashTable *textures;
+  /* Nodes that must not be drawn by several tiles at once */
+  GHashTable *serial_nodes;
+  GMutex serial_lock;
+};
+
 typedef struct {
   GQuark cpu_time;
   GQuark gpu_time;
@@ -38,6 +79,9 @@ struct _GskCairoRenderer
 
   GdkCairoContext *cairo_context;
 
+  /* 0 if tiling is disabled */
+  int tile_size;
+
   ProfileTimers profile_timers;
 };
 
@@ -70,19 +114,407 @@ gsk_cairo_renderer_unrealize (GskRenderer *renderer)
   g_clear_object (&self->cairo_context);
 }
 
+static GskCairoTileMode
+gsk_cairo_renderer_prepare_texture (GskCairoTiling *tiling,
+                                    GdkTexture     *texture)
+{
+  /* Other textures may need a GL context to be downloaded */
+  if (!GDK_IS_MEMORY_TEXTURE (texture))
+    return GSK_CAIRO_TILE_UNTILED;
+
+  if (!g_hash_table_contains (tiling->textures, texture))
+    g_hash_table_insert (tiling->textures, texture, gdk_texture_download_surface (texture));
+
+  return GSK_CAIRO_TILE_PARALLEL;
+}
+
+static GskCairoTileMode
+gsk_cairo_renderer_prepare_tiling (GskCairoTiling *tiling,
+                                   GskRenderNode  *node);
+
+static GskCairoTileMode
+gsk_cairo_renderer_prepare_node (GskCairoTiling *tiling,
+                                 GskRenderNode  *node)
+{
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_COLOR_NODE:
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+    case GSK_RADIAL_GRADIENT_NODE:
+    case GSK_REPEATING_RADIAL_GRADIENT_NODE:
+    case GSK_CONIC_GRADIENT_NODE:
+    case GSK_BORDER_NODE:
+    case GSK_INSET_SHADOW_NODE:
+    case GSK_OUTSET_SHADOW_NODE:
+    case GSK_GL_SHADER_NODE:
+      return GSK_CAIRO_TILE_PARALLEL;
+
+    case GSK_TEXT_NODE:
+    case GSK_CAIRO_NODE:
+      return GSK_CAIRO_TILE_SERIAL;
+
+    case GSK_TEXTURE_NODE:
+      {
+        GdkTexture *texture = gsk_texture_node_get_texture (node);
+
+        /* Huge textures are drawn in pieces, not from a surface */
+        if (gdk_texture_get_width (texture) > MAX_CAIRO_IMAGE_SIZE ||
+            gdk_texture_get_height (texture) > MAX_CAIRO_IMAGE_SIZE)
+          return GSK_CAIRO_TILE_UNTILED;
+
+        return gsk_cairo_renderer_prepare_texture (tiling, texture);
+      }
+
+    case GSK_TEXTURE_SCALE_NODE:
+      return gsk_cairo_renderer_prepare_texture (tiling, gsk_texture_scale_node_get_texture (node));
+
+    case GSK_CONTAINER_NODE:
+      {
+        GskRenderNode **children;
+        GskCairoTileMode mode = GSK_CAIRO_TILE_PARALLEL;
+        guint i, n_children;
+
+        children = gsk_container_node_get_children (node, &n_children);
+        for (i = 0; i < n_children && mode != GSK_CAIRO_TILE_UNTILED; i++)
+          mode = MAX (mode, gsk_cairo_renderer_prepare_tiling (tiling, children[i]));
+
+        return mode;
+      }
+
+    case GSK_TRANSFORM_NODE:
+      return gsk_cairo_renderer_prepare_tiling (tiling, gsk_transform_node_get_child (node));
+
+    case GSK_OPACITY_NODE:
+      return gsk_cairo_renderer_prepare_tiling (tiling, gsk_opacity_node_get_child (node));
+
+    case GSK_COLOR_MATRIX_NODE:
+      return gsk_cairo_renderer_prepare_tiling (tiling, gsk_color_matrix_node_get_child (node));
+
+    case GSK_REPEAT_NODE:
+      return gsk_cairo_renderer_prepare_tiling (tiling, gsk_repeat_node_get_child (node));
+
+    case GSK_CLIP_NODE:
+      return gsk_cairo_renderer_prepare_tiling (tiling, gsk_clip_node_get_child (node));
+
+    case GSK_ROUNDED_CLIP_NODE:
+      return gsk_cairo_renderer_prepare_tiling (tiling, gsk_rounded_clip_node_get_child (node));
+
+    case GSK_SHADOW_NODE:
+      return gsk_cairo_renderer_prepare_tiling (tiling, gsk_shadow_node_get_child (node));
+
+    case GSK_BLEND_NODE:
+      return MAX (gsk_cairo_renderer_prepare_tiling (tiling, gsk_blend_node_get_bottom_child (node)),
+                  gsk_cairo_renderer_prepare_tiling (tiling, gsk_blend_node_get_top_child (node)));
+
+    case GSK_CROSS_FADE_NODE:
+      return MAX (gsk_cairo_renderer_prepare_tiling (tiling, gsk_cross_fade_node_get_start_child (node)),
+                  gsk_cairo_renderer_prepare_tiling (tiling, gsk_cross_fade_node_get_end_child (node)));
+
+    case GSK_BLUR_NODE:
+      return gsk_cairo_renderer_prepare_tiling (tiling, gsk_blur_node_get_child (node));
+
+    case GSK_DEBUG_NODE:
+      return gsk_cairo_renderer_prepare_tiling (tiling, gsk_debug_node_get_child (node));
+
+    case GSK_MASK_NODE:
+      return MAX (gsk_cairo_renderer_prepare_tiling (tiling, gsk_mask_node_get_source (node)),
+                  gsk_cairo_renderer_prepare_tiling (tiling, gsk_mask_node_get_mask (node)));
+
+    case GSK_FILL_NODE:
+      return gsk_cairo_renderer_prepare_tiling (tiling, gsk_fill_node_get_child (node));
+
+    case GSK_STROKE_NODE:
+      return gsk_cairo_renderer_prepare_tiling (tiling, gsk_stroke_node_get_child (node));
+
+    case GSK_SUBSURFACE_NODE:
+      return gsk_cairo_renderer_prepare_tiling (tiling, gsk_subsurface_node_get_child (node));
+
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      g_assert_not_reached ();
+      return GSK_CAIRO_TILE_UNTILED;
+    }
+}
+
+/* Makes sure that drawing @node from multiple threads at once is safe,
+ * and downloads the textures, so the tiles don't each do it again.
+ *
+ * Text and cairo nodes share state that is not safe to use from several
+ * threads, like the lazily created data of Pango fonts and the recording
+ * surfaces of cairo nodes. Subtrees containing them are remembered in
+ * @tiling and drawn one at a time.
+ */
+static GskCairoTileMode
+gsk_cairo_renderer_prepare_tiling (GskCairoTiling *tiling,
+                                   GskRenderNode  *node)
+{
+  GskCairoTileMode mode;
+
+  mode = gsk_cairo_renderer_prepare_node (tiling, node);
+  if (mode == GSK_CAIRO_TILE_SERIAL)
+    g_hash_table_add (tiling->serial_nodes, node);
+
+  return mode;
+}
+
+/* Like gsk_render_node_draw(), but skips nodes that are outside
+ * of @clip, which is given in the current coordinate system of @cr.
+ */
 static void
-gsk_cairo_renderer_do_render (GskRenderer   *renderer,
-                              cairo_t       *cr,
-                              GskRenderNode *root)
+gsk_cairo_renderer_draw_culled (GskCairoTiling        *tiling,
+                                GskRenderNode         *node,
+                                cairo_t               *cr,
+                                const graphene_rect_t *clip)
 {
-  GskCairoRenderer *self = GSK_CAIRO_RENDERER (renderer);
+  if (!gsk_rect_intersects (&node->bounds, clip))
+    return;
+
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_CONTAINER_NODE:
+      {
+        GskRenderNode **children;
+        guint i, n_children;
+
+        children = gsk_container_node_get_children (node, &n_children);
+        for (i = 0; i < n_children; i++)
+          gsk_cairo_renderer_draw_culled (tiling, children[i], cr, clip);
+      }
+      break;
+
+    case GSK_DEBUG_NODE:
+      gsk_cairo_renderer_draw_culled (tiling, gsk_debug_node_get_child (node), cr, clip);
+      break;
+
+    case GSK_TRANSFORM_NODE:
+      if (gsk_transform_get_category (gsk_transform_node_get_transform (node)) >= GSK_TRANSFORM_CATEGORY_2D_TRANSLATE)
+        {
+          graphene_rect_t child_clip;
+          float dx, dy;
+
+          gsk_transform_node_get_translate (node, &dx, &dy);
+          gsk_rect_init_offset (&child_clip, clip, - dx, - dy);
+
+          cairo_save (cr);
+          cairo_translate (cr, dx, dy);
+          gsk_cairo_renderer_draw_culled (tiling, gsk_transform_node_get_child (node), cr, &child_clip);
+          cairo_restore (cr);
+          break;
+        }
+      G_GNUC_FALLTHROUGH;
+
+    default:
+      if (g_hash_table_contains (tiling->serial_nodes, node))
+        {
+          g_mutex_lock (&tiling->serial_lock);
+          gsk_render_node_draw (node, cr);
+          g_mutex_unlock (&tiling->serial_lock);
+        }
+      else
+        {
+          gsk_render_node_draw (node, cr);
+        }
+      break;
+    }
+}
+
+static void
+gsk_cairo_renderer_draw_tile (guint    i,
+                              gpointer data)
+{
+  GskCairoTiling *tiling = data;
+  GskCairoTile *tile = &g_array_index (tiling->tiles, GskCairoTile, i);
+  double x1, y1, x2, y2;
+  cairo_t *cr;
+
+  tile->surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                              tile->area.width,
+                                              tile->area.height);
+  cairo_surface_set_device_scale (tile->surface, tiling->scale_x, tiling->scale_y);
+  cairo_surface_set_device_offset (tile->surface, - tile->area.x, - tile->area.y);
+
+  gsk_cairo_surface_set_texture_surfaces (tile->surface, tiling->textures);
+
+  cr = cairo_create (tile->surface);
+  cairo_set_matrix (cr, &tiling->matrix);
+
+  cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+  gsk_cairo_renderer_draw_culled (tiling,
+                                  tiling->node,
+                                  cr,
+                                  &GRAPHENE_RECT_INIT (x1, y1, x2 - x1, y2 - y1));
+
+  cairo_destroy (cr);
+}
+
+static void
+gsk_cairo_renderer_add_tiles (GskCairoTiling              *tiling,
+                              const cairo_rectangle_int_t *area,
+                              int                          tile_size)
+{
+  int x, y;
+
+  for (y = area->y; y < area->y + area->height; y += tile_size)
+    {
+      for (x = area->x; x < area->x + area->width; x += tile_size)
+        {
+          GskCairoTile tile = {
+            .area = {
+              x, y,
+              MIN (tile_size, area->x + area->width - x),
+              MIN (tile_size, area->y + area->height - y)
+            },
+            .surface = NULL
+          };
+
+          g_array_append_val (tiling->tiles, tile);
+        }
+    }
+}
+
+/* Splits the area to be drawn into tiles, draws them from the
+ * parallel task pool into their own image surfaces and then
+ * composites them into @cr.
+ *
+ * Returns: FALSE if @root can't be drawn in tiles
+ */
+static gboolean
+gsk_cairo_renderer_draw_tiled (GskCairoRenderer *self,
+                               cairo_t          *cr,
+                               GskRenderNode    *root)
+{
+  GskCairoTiling tiling;
+  cairo_rectangle_list_t *clips;
+  cairo_region_t *region;
+  cairo_rectangle_int_t bounds, area;
+  double x1, y1, x2, y2;
+  guint j;
+  int i;
+
+  tiling.node = root;
+  tiling.textures = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) cairo_surface_destroy);
+  tiling.serial_nodes = g_hash_table_new (NULL, NULL);
+
+  if (gsk_cairo_renderer_prepare_tiling (&tiling, root) == GSK_CAIRO_TILE_UNTILED)
+    {
+      g_hash_table_unref (tiling.textures);
+      g_hash_table_unref (tiling.serial_nodes);
+      return FALSE;
+    }
+
+  g_mutex_init (&tiling.serial_lock);
+
+  cairo_get_matrix (cr, &tiling.matrix);
+  cairo_surface_get_device_scale (cairo_get_target (cr), &tiling.scale_x, &tiling.scale_y);
+  tiling.tiles = g_array_new (FALSE, FALSE, sizeof (GskCairoTile));
+
+  /* Without a matrix, user space only differs from the pixels by the
+   * device scale, which can be fractional. Tiles are laid out in pixels,
+   * so they are aligned to pixels with any scale.
+   */
+  cairo_save (cr);
+  cairo_identity_matrix (cr);
+
+  x1 = root->bounds.origin.x;
+  y1 = root->bounds.origin.y;
+  x2 = root->bounds.origin.x + root->bounds.size.width;
+  y2 = root->bounds.origin.y + root->bounds.size.height;
+  cairo_matrix_transform_point (&tiling.matrix, &x1, &y1);
+  cairo_matrix_transform_point (&tiling.matrix, &x2, &y2);
+  bounds.x = floor (MIN (x1, x2) * tiling.scale_x);
+  bounds.y = floor (MIN (y1, y2) * tiling.scale_y);
+  bounds.width = ceil (MAX (x1, x2) * tiling.scale_x) - bounds.x;
+  bounds.height = ceil (MAX (y1, y2) * tiling.scale_y) - bounds.y;
+  region = cairo_region_create ();
+
+  clips = cairo_copy_clip_rectangle_list (cr);
+  if (clips->status == CAIRO_STATUS_SUCCESS)
+    {
+      for (i = 0; i < clips->num_rectangles; i++)
+        {
+          x1 = clips->rectangles[i].x;
+          y1 = clips->rectangles[i].y;
+          x2 = x1 + clips->rectangles[i].width;
+          y2 = y1 + clips->rectangles[i].height;
+          area.x = floor (x1 * tiling.scale_x);
+          area.y = floor (y1 * tiling.scale_y);
+          area.width = ceil (x2 * tiling.scale_x) - area.x;
+          area.height = ceil (y2 * tiling.scale_y) - area.y;
+          cairo_region_union_rectangle (region, &area);
+        }
+    }
+  else
+    {
+      cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+      area.x = floor (x1 * tiling.scale_x);
+      area.y = floor (y1 * tiling.scale_y);
+      area.width = ceil (x2 * tiling.scale_x) - area.x;
+      area.height = ceil (y2 * tiling.scale_y) - area.y;
+      cairo_region_union_rectangle (region, &area);
+    }
+  cairo_rectangle_list_destroy (clips);
+
+  cairo_region_intersect_rectangle (region, &bounds);
+  for (i = 0; i < cairo_region_num_rectangles (region); i++)
+    {
+      cairo_region_get_rectangle (region, i, &area);
+      gsk_cairo_renderer_add_tiles (&tiling, &area, self->tile_size);
+    }
+  cairo_region_destroy (region);
+
+  gdk_parallel_task_run (gsk_cairo_renderer_draw_tile, &tiling, tiling.tiles->len);
+
+  for (j = 0; j < tiling.tiles->len; j++)
+    {
+      GskCairoTile *tile = &g_array_index (tiling.tiles, GskCairoTile, j);
+
+      cairo_set_source_surface (cr, tile->surface, 0, 0);
+      cairo_rectangle (cr,
+                       tile->area.x / tiling.scale_x,
+                       tile->area.y / tiling.scale_y,
+                       tile->area.width / tiling.scale_x,
+                       tile->area.height / tiling.scale_y);
+      cairo_fill (cr);
+
+      cairo_surface_destroy (tile->surface);
+    }
+
+  cairo_restore (cr);
+
+  g_array_unref (tiling.tiles);
+  g_hash_table_unref (tiling.textures);
+  g_hash_table_unref (tiling.serial_nodes);
+  g_mutex_clear (&tiling.serial_lock);
+
+  return TRUE;
+}
+
+/*<private>
+ * gsk_cairo_renderer_draw:
+ * @self: a cairo renderer
+ * @cr: the cairo context to draw to
+ * @root: the node to draw
+ *
+ * Draws @root to @cr the way the renderer draws frames, in tiles
+ * if possible.
+ */
+void
+gsk_cairo_renderer_draw (GskCairoRenderer *self,
+                         cairo_t          *cr,
+                         GskRenderNode    *root)
+{
+  GskRenderer *renderer = GSK_RENDERER (self);
   GskProfiler *profiler;
   gint64 cpu_time;
 
   profiler = gsk_renderer_get_profiler (renderer);
   gsk_profiler_timer_begin (profiler, self->profile_timers.cpu_time);
 
-  gsk_render_node_draw (root, cr);
+  if (self->tile_size <= 0 ||
+      gdk_parallel_task_get_n_threads () <= 1 ||
+      !gsk_cairo_renderer_draw_tiled (self, cr, root))
+    gsk_render_node_draw (root, cr);
 
   cpu_time = gsk_profiler_timer_end (profiler, self->profile_timers.cpu_time);
   gsk_profiler_timer_set (profiler, self->profile_timers.cpu_time, cpu_time);
@@ -140,7 +572,7 @@ gsk_cairo_renderer_render_texture (GskRenderer           *renderer,
 
   cairo_translate (cr, - viewport->origin.x, - viewport->origin.y);
 
-  gsk_cairo_renderer_do_render (renderer, cr, root);
+  gsk_cairo_renderer_draw (GSK_CAIRO_RENDERER (renderer), cr, root);
 
   cairo_destroy (cr);
 
@@ -178,7 +610,7 @@ gsk_cairo_renderer_render (GskRenderer          *renderer,
       cairo_restore (cr);
     }
 
-  gsk_cairo_renderer_do_render (renderer, cr, root);
+  gsk_cairo_renderer_draw (self, cr, root);
 
   cairo_destroy (cr);
 
@@ -200,6 +632,22 @@ static void
 gsk_cairo_renderer_init (GskCairoRenderer *self)
 {
   GskProfiler *profiler = gsk_renderer_get_profiler (GSK_RENDERER (self));
+  const char *str;
+
+  str = g_getenv ("GSK_CAIRO_TILE_SIZE");
+  if (str != NULL)
+    {
+      gint64 value;
+      GError *error = NULL;
+
+      if (!g_ascii_string_to_signed (str, 10, 0, G_MAXINT16, &value, &error))
+        {
+          g_warning ("Failed to parse GSK_CAIRO_TILE_SIZE: %s", error->message);
+          g_error_free (error);
+        }
+      else
+        self->tile_size = value;
+    }
 
   self->profile_timers.cpu_time = gsk_profiler_add_timer (profiler, "cpu-time", "CPU time", FALSE, TRUE);
 }
@@ -97,6 +97,13 @@ struct _GskContourClass
   float                 (* get_distance)        (const GskContour       *contour,
                                                  const GskPathPoint     *point,
                                                  gpointer                measure_data);
+  void                  (* get_points)          (const GskContour       *contour,
+                                                 gpointer                measure_data,
+                                                 const float            *distances,
+                                                 gsize                   n_distances,
+                                                 GskPathPoint           *results);
+  void                  (* prepare_measure)     (const GskContour       *contour,
+                                                 gpointer                measure_data);
 };
 
 /* {{{ Utilities */
@@ -518,6 +525,23 @@ gsk_contour_print_default (const GskContour *contour,
   gsk_contour_foreach (contour, foreach_print, string);
 }
 
+static void
+gsk_contour_get_points_default (const GskContour *contour,
+                                gpointer          measure_data,
+                                const float      *distances,
+                                gsize             n_distances,
+                                GskPathPoint     *results)
+{
+  for (gsize i = 0; i < n_distances; i++)
+    contour->klass->get_point (contour, measure_data, distances[i], &results[i]);
+}
+
+static void
+gsk_contour_prepare_measure_default (const GskContour *contour,
+                                     gpointer          measure_data)
+{
+}
+
 /* }}} */
 /* {{{ Standard */
 
@@ -1138,30 +1162,15 @@ find_curve (gconstpointer a,
 }
 
 static void
-gsk_standard_contour_get_point (const GskContour *contour,
-                                gpointer          measure_data,
-                                float             distance,
-                                GskPathPoint     *result)
+gsk_standard_contour_get_curve_point (const GskStandardContour  *self,
+                                      GskStandardContourMeasure *measure,
+                                      CurveMeasure              *curve_measure,
+                                      float                      distance,
+                                      GskPathPoint              *result)
 {
-  const GskStandardContour *self = (const GskStandardContour *) contour;
-  GskStandardContourMeasure *measure = measure_data;
-  CurveMeasure *curve_measure;
-  gboolean found G_GNUC_UNUSED;
-  guint idx;
   gsize i0, i1;
   CurvePoint *p0, *p1;
 
-  if (self->n_ops == 1)
-    {
-      result->idx = 0;
-      result->t = 1;
-      return;
-    }
-
-  found = g_array_binary_search (measure->curves, &distance, find_curve, &idx);
-  g_assert (found);
-
-  curve_measure = &g_array_index (measure->curves, CurveMeasure, idx);
   ensure_samples (self, measure, curve_measure);
 
   i0 = curve_measure->first;
@@ -1213,6 +1222,88 @@ gsk_standard_contour_get_point (const GskContour *contour,
     }
 }
 
+static void
+gsk_standard_contour_get_point (const GskContour *contour,
+                                gpointer          measure_data,
+                                float             distance,
+                                GskPathPoint     *result)
+{
+  const GskStandardContour *self = (const GskStandardContour *) contour;
+  GskStandardContourMeasure *measure = measure_data;
+  gboolean found G_GNUC_UNUSED;
+  guint idx;
+
+  if (self->n_ops == 1)
+    {
+      result->idx = 0;
+      result->t = 1;
+      return;
+    }
+
+  found = g_array_binary_search (measure->curves, &distance, find_curve, &idx);
+  g_assert (found);
+
+  gsk_standard_contour_get_curve_point (self,
+                                        measure,
+                                        &g_array_index (measure->curves, CurveMeasure, idx),
+                                        distance,
+                                        result);
+}
+
+/* Distances are usually sorted, so we walk along the curves
+ * instead of searching for each one.
+ */
+static void
+gsk_standard_contour_get_points (const GskContour *contour,
+                                 gpointer          measure_data,
+                                 const float      *distances,
+                                 gsize             n_distances,
+                                 GskPathPoint     *results)
+{
+  const GskStandardContour *self = (const GskStandardContour *) contour;
+  GskStandardContourMeasure *measure = measure_data;
+  gsize idx = 1;
+
+  for (gsize i = 0; i < n_distances; i++)
+    {
+      float distance = distances[i];
+
+      if (self->n_ops == 1)
+        {
+          results[i].idx = 0;
+          results[i].t = 1;
+          continue;
+        }
+
+      while (idx > 1 &&
+             distance < g_array_index (measure->curves, CurveMeasure, idx).length0)
+        idx--;
+      while (idx + 1 < measure->curves->len &&
+             distance > g_array_index (measure->curves, CurveMeasure, idx).length1)
+        idx++;
+
+      gsk_standard_contour_get_curve_point (self,
+                                            measure,
+                                            &g_array_index (measure->curves, CurveMeasure, idx),
+                                            distance,
+                                            &results[i]);
+    }
+}
+
+/* Computes the arclength samples for all curves upfront,
+ * instead of when they are first needed.
+ */
+static void
+gsk_standard_contour_prepare_measure (const GskContour *contour,
+                                      gpointer          measure_data)
+{
+  const GskStandardContour *self = (const GskStandardContour *) contour;
+  GskStandardContourMeasure *measure = measure_data;
+
+  for (gsize i = 1; i < measure->curves->len; i++)
+    ensure_samples (self, measure, &g_array_index (measure->curves, CurveMeasure, i));
+}
+
 static float
 gsk_standard_contour_get_distance (const GskContour   *contour,
                                    const GskPathPoint *point,
@@ -1280,6 +1371,8 @@ static const GskContourClass GSK_STANDARD_CONTOUR_CLASS =
   gsk_standard_contour_free_measure,
   gsk_standard_contour_get_point,
   gsk_standard_contour_get_distance,
+  gsk_standard_contour_get_points,
+  gsk_standard_contour_prepare_measure,
 };
 
 /* You must ensure the contour has enough size allocated,
@@ -1730,6 +1823,8 @@ static const GskContourClass GSK_CIRCLE_CONTOUR_CLASS =
   gsk_circle_contour_free_measure,
   gsk_circle_contour_get_point,
   gsk_circle_contour_get_distance,
+  gsk_contour_get_points_default,
+  gsk_contour_prepare_measure_default,
 };
 
 GskContour *
@@ -2063,6 +2158,8 @@ static const GskContourClass GSK_RECT_CONTOUR_CLASS =
   gsk_rect_contour_free_measure,
   gsk_rect_contour_get_point,
   gsk_rect_contour_get_distance,
+  gsk_contour_get_points_default,
+  gsk_contour_prepare_measure_default,
 };
 
 GskContour *
@@ -2397,6 +2494,8 @@ static const GskContourClass GSK_ROUNDED_RECT_CONTOUR_CLASS =
   gsk_rounded_rect_contour_free_measure,
   gsk_rounded_rect_contour_get_point,
   gsk_rounded_rect_contour_get_distance,
+  gsk_contour_get_points_default,
+  gsk_contour_prepare_measure_default,
 };
 
 static gsize
@@ -2466,6 +2565,16 @@ gsk_contour_get_type_name (const GskContour *self)
   return self->klass->type_name;
 }
 
+/* Standard contours compute their winding number by
+ * adding up the crossings of their curves, the others
+ * use a shape-specific test.
+ */
+gboolean
+gsk_contour_is_standard (const GskContour *self)
+{
+  return self->klass == &GSK_STANDARD_CONTOUR_CLASS;
+}
+
 gsize
 gsk_contour_get_size (const GskContour *self)
 {
@@ -2634,6 +2743,23 @@ gsk_contour_get_distance (const GskContour   *self,
   return self->klass->get_distance (self, point, measure_data);
 }
 
+void
+gsk_contour_get_points (const GskContour *self,
+                        gpointer          measure_data,
+                        const float      *distances,
+                        gsize             n_distances,
+                        GskPathPoint     *results)
+{
+  self->klass->get_points (self, measure_data, distances, n_distances, results);
+}
+
+void
+gsk_contour_prepare_measure (const GskContour *self,
+                             gpointer          measure_data)
+{
+  self->klass->prepare_measure (self, measure_data);
+}
+
 /* }}} */
 
 /* vim:set foldmethod=marker expandtab: */
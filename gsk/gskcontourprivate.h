@@ -40,6 +40,7 @@ GskContour *            gsk_rect_contour_new                    (const graphene_
 GskContour *            gsk_rounded_rect_contour_new            (const GskRoundedRect   *rounded_rect);
 
 const char *            gsk_contour_get_type_name               (const GskContour       *self);
+gboolean                gsk_contour_is_standard                 (const GskContour       *self);
 void                    gsk_contour_copy                        (GskContour *            dest,
                                                                  const GskContour       *src);
 GskContour *            gsk_contour_dup                         (const GskContour       *src);
@@ -94,5 +95,12 @@ void                    gsk_contour_get_point                   (const GskContou
 float                   gsk_contour_get_distance                (const GskContour       *self,
                                                                  const GskPathPoint     *point,
                                                                  gpointer                measure_data);
+void                    gsk_contour_get_points                  (const GskContour       *self,
+                                                                 gpointer                measure_data,
+                                                                 const float            *distances,
+                                                                 gsize                   n_distances,
+                                                                 GskPathPoint           *results);
+void                    gsk_contour_prepare_measure             (const GskContour       *self,
+                                                                 gpointer                measure_data);
 
 G_END_DECLS
@@ -10,6 +10,7 @@ static const GdkDebugKey gsk_debug_keys[] = {
   { "fallback", GSK_DEBUG_FALLBACK, "Information about fallback usage in renderers" },
   { "glyphcache", GSK_DEBUG_GLYPH_CACHE, "Information about glyph caching" },
   { "verbose", GSK_DEBUG_VERBOSE, "Print verbose output while rendering" },
+  { "timings", GSK_DEBUG_TIMINGS, "Measure GPU time per operation" },
   { "geometry", GSK_DEBUG_GEOMETRY, "Show borders (when using cairo)" },
   { "full-redraw", GSK_DEBUG_FULL_REDRAW, "Force full redraws" },
   { "staging", GSK_DEBUG_STAGING, "Use a staging image for texture upload (Vulkan only)" },
@@ -7,6 +7,7 @@ G_BEGIN_DECLS
 
 typedef enum {
   GSK_DEBUG_RENDERER              = 1 <<  0,
+  GSK_DEBUG_TIMINGS               = 1 <<  1,
   GSK_DEBUG_SHADERS               = 1 <<  2,
   GSK_DEBUG_VULKAN                = 1 <<  3,
   GSK_DEBUG_FALLBACK              = 1 <<  4,
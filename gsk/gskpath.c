@@ -23,6 +23,7 @@
 
 #include "gskcurveprivate.h"
 #include "gskpathbuilder.h"
+#include "gskpathindexprivate.h"
 #include "gskpathpoint.h"
 #include "gskcontourprivate.h"
 
@@ -59,11 +60,19 @@ struct _GskPath
 
   GskPathFlags flags;
 
+  /* for hit testing, see gsk_path_get_index() */
+  gsize n_ops;
+  guint n_queries;
+  GskPathIndex *index;
+
   gsize n_contours;
   GskContour *contours[];
   /* followed by the contours data */
 };
 
+/* Paths with fewer ops are fast enough to search linearly */
+#define GSK_PATH_INDEX_MIN_OPS 64
+
 G_DEFINE_BOXED_TYPE (GskPath, gsk_path, gsk_path_ref, gsk_path_unref)
 
 /* {{{ Private API */
@@ -77,10 +86,12 @@ gsk_path_new_from_contours (const GSList *contours)
   gsize n_contours;
   guint8 *contour_data;
   GskPathFlags flags;
+  gsize n_ops;
 
   flags = GSK_PATH_CLOSED | GSK_PATH_FLAT;
   size = 0;
   n_contours = 0;
+  n_ops = 0;
   for (l = contours; l; l = l->next)
     {
       GskContour *contour = l->data;
@@ -89,11 +100,13 @@ gsk_path_new_from_contours (const GSList *contours)
       size += sizeof (GskContour *);
       size += gsk_contour_get_size (contour);
       flags &= gsk_contour_get_flags (contour);
+      n_ops += gsk_contour_get_n_ops (contour);
     }
 
   path = g_malloc0 (sizeof (GskPath) + size);
   path->ref_count = 1;
   path->flags = flags;
+  path->n_ops = n_ops;
   path->n_contours = n_contours;
   contour_data = (guint8 *) &path->contours[n_contours];
   n_contours = 0;
@@ -134,6 +147,29 @@ gsk_path_get_n_contours (const GskPath *self)
   return self->n_contours;
 }
 
+/* Applications hit test big paths over and over, e.g. on
+ * every pointer motion, so we build a spatial index for
+ * them. We don't bother if a path is only queried once.
+ *
+ * Paths are immutable and may be queried from several threads,
+ * for example by renderers, so the index is built only once.
+ */
+static const GskPathIndex *
+gsk_path_get_index (GskPath *self)
+{
+  if (self->n_ops < GSK_PATH_INDEX_MIN_OPS)
+    return NULL;
+
+  if (g_atomic_int_get (&self->n_queries) == 0 &&
+      g_atomic_int_add (&self->n_queries, 1) == 0)
+    return NULL;
+
+  if (g_once_init_enter (&self->index))
+    g_once_init_leave (&self->index, gsk_path_index_new (self));
+
+  return self->index;
+}
+
 /* }}} */
 /* {{{ Public API */
 
@@ -177,6 +213,7 @@ gsk_path_unref (GskPath *self)
   if (self->ref_count > 0)
     return;
 
+  g_clear_pointer (&self->index, gsk_path_index_free);
   g_free (self);
 }
 
@@ -474,10 +511,17 @@ gsk_path_in_fill (GskPath                *self,
                   const graphene_point_t *point,
                   GskFillRule             fill_rule)
 {
+  const GskPathIndex *index;
   int winding = 0;
 
-  for (int i = 0; i < self->n_contours; i++)
-    winding += gsk_contour_get_winding (self->contours[i], point);
+  index = gsk_path_get_index (self);
+  if (index)
+    winding = gsk_path_index_get_winding (index, point);
+  else
+    {
+      for (int i = 0; i < self->n_contours; i++)
+        winding += gsk_contour_get_winding (self->contours[i], point);
+    }
 
   switch (fill_rule)
     {
@@ -582,6 +626,7 @@ gsk_path_get_closest_point (GskPath                *self,
                             GskPathPoint           *result,
                             float                  *distance)
 {
+  const GskPathIndex *index;
   gboolean found;
 
   g_return_val_if_fail (self != NULL, FALSE);
@@ -589,6 +634,18 @@ gsk_path_get_closest_point (GskPath                *self,
   g_return_val_if_fail (threshold >= 0, FALSE);
   g_return_val_if_fail (result != NULL, FALSE);
 
+  index = gsk_path_get_index (self);
+  if (index)
+    {
+      float dist;
+
+      found = gsk_path_index_get_closest_point (index, point, threshold, result, &dist);
+      if (found && distance)
+        *distance = dist;
+
+      return found;
+    }
+
   found = FALSE;
 
   for (int i = 0; i < self->n_contours; i++)
@@ -0,0 +1,654 @@
+/*
+ * Copyright © 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gskpathindexprivate.h"
+
+#include "gskboundingboxprivate.h"
+#include "gskcontourprivate.h"
+#include "gskcurveprivate.h"
+
+#include <math.h>
+#include <string.h>
+
+/* A bounding volume hierarchy over the curves of a path, so that
+ * hit testing doesn't have to look at every curve of big paths.
+ *
+ * Small contours are kept as a single item and queried with the
+ * contour functions, big standard contours are split into their
+ * curves. Either way, we compute the same thing as iterating over
+ * all contours, the tree only lets us skip what can't matter:
+ *
+ * - A curve only contributes to the winding number if the ray from
+ *   the point to the right hits its bounds, see
+ *   get_crossing_by_bisection() in gskcurve.c. The other contours
+ *   only have a winding number inside their bounds.
+ *
+ * - The closest point on a curve is inside its bounds, so it can't
+ *   be closer than those.
+ *
+ * Only ties between equally close points may be broken differently,
+ * we pick the first one in path order, like the linear search does
+ * for standard contours.
+ */
+
+/* Contours with up to this many ops are not split into curves */
+#define MAX_CONTOUR_ITEM_OPS 16
+#define MAX_LEAF_ITEMS 4
+/* The tree is balanced, so this is plenty */
+#define MAX_DEPTH 64
+
+typedef enum
+{
+  ITEM_WINDING = 1 << 0,
+  ITEM_CLOSEST = 1 << 1,
+} ItemFlags;
+
+typedef struct _Item Item;
+typedef struct _Node Node;
+
+struct _Item
+{
+  GskBoundingBox bounds;
+  guint contour;
+  guint idx;            /* the op of the curve, 0 for whole contours */
+  guint8 flags;
+  guint8 op;            /* GSK_PATH_MOVE for whole contours */
+  guint8 n_pts;
+  float weight;
+  graphene_point_t pts[4];
+};
+
+struct _Node
+{
+  GskBoundingBox bounds;
+  guint offset;         /* first item for leaves, second child otherwise */
+  guint n_items;        /* 0 for inner nodes */
+};
+
+struct _GskPathIndex
+{
+  /* not a reference, the index lives as long as the path */
+  const GskPath *path;
+
+  /* for split contours only */
+  GskBoundingBox *contour_bounds;
+
+  Item *items;
+  guint n_items;
+
+  Node *nodes;
+  guint n_nodes;
+};
+
+/* {{{ Utilities */
+
+static inline gboolean
+ray_hits_bounds (const GskBoundingBox   *bounds,
+                 const graphene_point_t *point)
+{
+  return bounds->min.y <= point->y && point->y <= bounds->max.y &&
+         point->x <= bounds->max.x;
+}
+
+static inline float
+bounds_distance_squared (const GskBoundingBox   *bounds,
+                         const graphene_point_t *point)
+{
+  float dx, dy;
+
+  dx = MAX (0, MAX (bounds->min.x - point->x, point->x - bounds->max.x));
+  dy = MAX (0, MAX (bounds->min.y - point->y, point->y - bounds->max.y));
+
+  return dx * dx + dy * dy;
+}
+
+/* Points that we compute on curves are subject to rounding,
+ * so leave some room to not miss them.
+ */
+static void
+pad_bounds (GskBoundingBox *bounds)
+{
+  float size, epsilon;
+
+  size = MAX (MAX (fabsf (bounds->min.x), fabsf (bounds->max.x)),
+              MAX (fabsf (bounds->min.y), fabsf (bounds->max.y)));
+  epsilon = 1e-5f * (size + 1);
+
+  bounds->min.x -= epsilon;
+  bounds->min.y -= epsilon;
+  bounds->max.x += epsilon;
+  bounds->max.y += epsilon;
+}
+
+/* }}} */
+/* {{{ Building */
+
+typedef struct
+{
+  GArray *items;
+  guint contour;
+  guint idx;
+  graphene_point_t start;
+  graphene_point_t end;
+} CollectData;
+
+static gboolean
+collect_curve (GskPathOperation        op,
+               const graphene_point_t *pts,
+               gsize                   n_pts,
+               float                   weight,
+               gpointer                user_data)
+{
+  CollectData *data = user_data;
+  GskCurve curve;
+  Item item;
+
+  if (op == GSK_PATH_MOVE)
+    {
+      data->start = pts[0];
+      data->end = pts[0];
+      return TRUE;
+    }
+
+  data->idx++;
+  data->end = pts[n_pts - 1];
+
+  memset (&item, 0, sizeof (Item));
+  item.contour = data->contour;
+  item.idx = data->idx;
+  item.flags = ITEM_WINDING | ITEM_CLOSEST;
+  item.op = op;
+  item.n_pts = n_pts;
+  item.weight = weight;
+  memcpy (item.pts, pts, sizeof (graphene_point_t) * n_pts);
+
+  gsk_curve_init_foreach (&curve, op, pts, n_pts, weight);
+  gsk_curve_get_bounds (&curve, &item.bounds);
+  pad_bounds (&item.bounds);
+
+  g_array_append_val (data->items, item);
+
+  return TRUE;
+}
+
+static gboolean
+expand_bounds (GskPathOperation        op,
+               const graphene_point_t *pts,
+               gsize                   n_pts,
+               float                   weight,
+               gpointer                user_data)
+{
+  GskBoundingBox *bounds = user_data;
+
+  for (gsize i = 0; i < n_pts; i++)
+    gsk_bounding_box_expand (bounds, &pts[i]);
+
+  return TRUE;
+}
+
+static void
+add_contour (GskPathIndex     *self,
+             GArray           *items,
+             const GskContour *contour,
+             guint             i)
+{
+  gsize n_ops;
+  Item item;
+
+  n_ops = gsk_contour_get_n_ops (contour);
+
+  if (n_ops > MAX_CONTOUR_ITEM_OPS && gsk_contour_is_standard (contour))
+    {
+      CollectData data = { items, i, 0, };
+
+      gsk_contour_get_bounds (contour, &self->contour_bounds[i]);
+      gsk_contour_foreach (contour, collect_curve, &data);
+
+      /* Filling implicitly closes the contour */
+      if ((gsk_contour_get_flags (contour) & GSK_PATH_CLOSED) == 0)
+        {
+          memset (&item, 0, sizeof (Item));
+          item.contour = i;
+          item.idx = n_ops;
+          item.flags = ITEM_WINDING;
+          item.op = GSK_PATH_CLOSE;
+          item.n_pts = 2;
+          item.pts[0] = data.end;
+          item.pts[1] = data.start;
+          gsk_bounding_box_init (&item.bounds, &data.end, &data.start);
+          pad_bounds (&item.bounds);
+
+          g_array_append_val (items, item);
+        }
+    }
+  else
+    {
+      memset (&item, 0, sizeof (Item));
+      item.contour = i;
+      item.idx = 0;
+      item.op = GSK_PATH_MOVE;
+      /* A lone point has no area */
+      item.flags = n_ops > 1 ? ITEM_WINDING | ITEM_CLOSEST : ITEM_CLOSEST;
+
+      item.bounds.min = GRAPHENE_POINT_INIT (INFINITY, INFINITY);
+      item.bounds.max = GRAPHENE_POINT_INIT (-INFINITY, -INFINITY);
+      gsk_contour_foreach (contour, expand_bounds, &item.bounds);
+      pad_bounds (&item.bounds);
+
+      g_array_append_val (items, item);
+    }
+}
+
+typedef struct
+{
+  float center[2];
+  guint item;
+} BuildItem;
+
+/* Partially sorts @items so that the one at @k is in its
+ * sorted position, with smaller ones before it and larger
+ * ones after it.
+ */
+static void
+select_nth (BuildItem *items,
+            gssize     n,
+            gssize     k,
+            guint      axis)
+{
+  gssize lo = 0, hi = n - 1;
+
+  while (lo < hi)
+    {
+      float pivot = items[lo + (hi - lo) / 2].center[axis];
+      gssize i = lo, j = hi;
+
+      while (i <= j)
+        {
+          while (items[i].center[axis] < pivot)
+            i++;
+          while (items[j].center[axis] > pivot)
+            j--;
+
+          if (i <= j)
+            {
+              BuildItem tmp = items[i];
+              items[i] = items[j];
+              items[j] = tmp;
+              i++;
+              j--;
+            }
+        }
+
+      if (k <= j)
+        hi = j;
+      else if (k >= i)
+        lo = i;
+      else
+        break;
+    }
+}
+
+static guint
+build_node (GArray    *nodes,
+            Item      *items,
+            BuildItem *build,
+            guint      start,
+            guint      end)
+{
+  GskBoundingBox centers;
+  guint index, mid, axis;
+  Node node;
+
+  index = nodes->len;
+  g_array_set_size (nodes, index + 1);
+
+  node.bounds = items[build[start].item].bounds;
+  gsk_bounding_box_init (&centers,
+                         &GRAPHENE_POINT_INIT (build[start].center[0], build[start].center[1]),
+                         &GRAPHENE_POINT_INIT (build[start].center[0], build[start].center[1]));
+  for (guint i = start + 1; i < end; i++)
+    {
+      gsk_bounding_box_union (&node.bounds, &items[build[i].item].bounds, &node.bounds);
+      gsk_bounding_box_expand (&centers, &GRAPHENE_POINT_INIT (build[i].center[0], build[i].center[1]));
+    }
+
+  if (end - start <= MAX_LEAF_ITEMS)
+    {
+      node.offset = start;
+      node.n_items = end - start;
+    }
+  else
+    {
+      axis = centers.max.x - centers.min.x >= centers.max.y - centers.min.y ? 0 : 1;
+      mid = start + (end - start) / 2;
+      select_nth (build + start, end - start, mid - start, axis);
+
+      /* The first child directly follows its parent */
+      build_node (nodes, items, build, start, mid);
+      node.offset = build_node (nodes, items, build, mid, end);
+      node.n_items = 0;
+    }
+
+  g_array_index (nodes, Node, index) = node;
+
+  return index;
+}
+
+/*<private>
+ * gsk_path_index_new:
+ * @path: the path to index
+ *
+ * Creates a spatial index for the curves of @path.
+ *
+ * The index does not keep a reference to @path,
+ * it must not outlive it.
+ *
+ * Returns: (transfer full): the new index
+ */
+GskPathIndex *
+gsk_path_index_new (const GskPath *path)
+{
+  GskPathIndex *self;
+  GArray *items, *nodes;
+  BuildItem *build;
+  gsize n_contours;
+
+  self = g_new0 (GskPathIndex, 1);
+  self->path = path;
+
+  n_contours = gsk_path_get_n_contours (path);
+  self->contour_bounds = g_new0 (GskBoundingBox, n_contours);
+
+  items = g_array_new (FALSE, FALSE, sizeof (Item));
+  for (gsize i = 0; i < n_contours; i++)
+    add_contour (self, items, gsk_path_get_contour (path, i), i);
+
+  self->n_items = items->len;
+  if (self->n_items == 0)
+    {
+      g_array_unref (items);
+      return self;
+    }
+
+  build = g_new (BuildItem, self->n_items);
+  for (guint i = 0; i < self->n_items; i++)
+    {
+      const Item *item = &g_array_index (items, Item, i);
+
+      build[i].center[0] = (item->bounds.min.x + item->bounds.max.x) / 2;
+      build[i].center[1] = (item->bounds.min.y + item->bounds.max.y) / 2;
+      build[i].item = i;
+    }
+
+  nodes = g_array_sized_new (FALSE, FALSE, sizeof (Node), 2 * self->n_items / MAX_LEAF_ITEMS + 1);
+  build_node (nodes, (Item *) items->data, build, 0, self->n_items);
+
+  /* Put the items in tree order, so leaves can refer to a range */
+  self->items = g_new (Item, self->n_items);
+  for (guint i = 0; i < self->n_items; i++)
+    self->items[i] = g_array_index (items, Item, build[i].item);
+
+  self->n_nodes = nodes->len;
+  self->nodes = (Node *) g_array_free (nodes, FALSE);
+
+  g_free (build);
+  g_array_unref (items);
+
+  return self;
+}
+
+void
+gsk_path_index_free (GskPathIndex *self)
+{
+  g_free (self->contour_bounds);
+  g_free (self->items);
+  g_free (self->nodes);
+  g_free (self);
+}
+
+/* }}} */
+/* {{{ Queries */
+
+/*<private>
+ * gsk_path_index_get_winding:
+ * @self: a path index
+ * @point: the point to test
+ *
+ * Computes the winding number of the path around @point.
+ *
+ * This is the sum of gsk_contour_get_winding() over
+ * all contours.
+ *
+ * Returns: the winding number
+ */
+int
+gsk_path_index_get_winding (const GskPathIndex     *self,
+                            const graphene_point_t *point)
+{
+  guint stack[MAX_DEPTH];
+  guint n_stack;
+  int winding = 0;
+
+  if (self->n_nodes == 0)
+    return 0;
+
+  stack[0] = 0;
+  n_stack = 1;
+
+  while (n_stack > 0)
+    {
+      guint index = stack[--n_stack];
+      const Node *node = &self->nodes[index];
+
+      if (!ray_hits_bounds (&node->bounds, point))
+        continue;
+
+      if (node->n_items == 0)
+        {
+          stack[n_stack++] = node->offset;
+          stack[n_stack++] = index + 1;
+          continue;
+        }
+
+      for (guint i = node->offset; i < node->offset + node->n_items; i++)
+        {
+          const Item *item = &self->items[i];
+
+          if ((item->flags & ITEM_WINDING) == 0)
+            continue;
+
+          if (item->op == GSK_PATH_MOVE)
+            {
+              if (gsk_bounding_box_contains_point (&item->bounds, point))
+                winding += gsk_contour_get_winding (gsk_path_get_contour (self->path, item->contour), point);
+            }
+          else if (ray_hits_bounds (&item->bounds, point) &&
+                   gsk_bounding_box_contains_point (&self->contour_bounds[item->contour], point))
+            {
+              GskCurve curve;
+
+              gsk_curve_init_foreach (&curve, item->op, item->pts, item->n_pts, item->weight);
+              winding += gsk_curve_get_crossing (&curve, point);
+            }
+        }
+    }
+
+  return winding;
+}
+
+typedef struct
+{
+  const graphene_point_t *point;
+  float threshold;
+  gboolean found;
+  GskPathPoint result;
+} ClosestData;
+
+static inline gboolean
+closest_is_better (const ClosestData *data,
+                   float              dist,
+                   gsize              contour,
+                   gsize              idx)
+{
+  if (!data->found)
+    return TRUE;
+
+  if (dist != data->threshold)
+    return dist < data->threshold;
+
+  return contour < data->result.contour ||
+         (contour == data->result.contour && idx < data->result.idx);
+}
+
+static void
+closest_item (const GskPathIndex *self,
+              const Item         *item,
+              ClosestData        *data)
+{
+  float threshold, dist;
+
+  /* Once we have a result, we need to see ties
+   * to find the first one in path order
+   */
+  threshold = data->found ? nextafterf (data->threshold, INFINITY) : data->threshold;
+
+  if (item->op == GSK_PATH_MOVE)
+    {
+      GskPathPoint result;
+
+      if (gsk_contour_get_closest_point (gsk_path_get_contour (self->path, item->contour),
+                                         data->point, threshold, &result, &dist) &&
+          closest_is_better (data, dist, item->contour, result.idx))
+        {
+          data->result.contour = item->contour;
+          data->result.idx = result.idx;
+          data->result.t = result.t;
+          data->threshold = dist;
+          data->found = TRUE;
+        }
+    }
+  else
+    {
+      GskCurve curve;
+      float t;
+
+      gsk_curve_init_foreach (&curve, item->op, item->pts, item->n_pts, item->weight);
+      if (gsk_curve_get_closest_point (&curve, data->point, threshold, &dist, &t) &&
+          dist < threshold &&
+          closest_is_better (data, dist, item->contour, item->idx))
+        {
+          data->result.contour = item->contour;
+          data->result.idx = item->idx;
+          data->result.t = t;
+          data->threshold = dist;
+          data->found = TRUE;
+        }
+    }
+}
+
+/*<private>
+ * gsk_path_index_get_closest_point:
+ * @self: a path index
+ * @point: the point
+ * @threshold: maximum allowed distance
+ * @result: return location for the closest point
+ * @out_dist: return location for the distance
+ *
+ * Finds the closest point on the path, like
+ * gsk_path_get_closest_point() does.
+ *
+ * Returns: `TRUE` if a point closer than @threshold was found
+ */
+gboolean
+gsk_path_index_get_closest_point (const GskPathIndex     *self,
+                                  const graphene_point_t *point,
+                                  float                   threshold,
+                                  GskPathPoint           *result,
+                                  float                  *out_dist)
+{
+  ClosestData data;
+  guint stack[MAX_DEPTH];
+  guint n_stack;
+
+  if (self->n_nodes == 0)
+    return FALSE;
+
+  data.point = point;
+  data.threshold = threshold;
+  data.found = FALSE;
+
+  stack[0] = 0;
+  n_stack = 1;
+
+  while (n_stack > 0)
+    {
+      guint index = stack[--n_stack];
+      const Node *node = &self->nodes[index];
+
+      if (bounds_distance_squared (&node->bounds, point) > data.threshold * data.threshold)
+        continue;
+
+      if (node->n_items == 0)
+        {
+          const Node *first = &self->nodes[index + 1];
+          const Node *second = &self->nodes[node->offset];
+
+          /* Look at the closer child first, so we can
+           * skip more of the other one
+           */
+          if (bounds_distance_squared (&first->bounds, point) <=
+              bounds_distance_squared (&second->bounds, point))
+            {
+              stack[n_stack++] = node->offset;
+              stack[n_stack++] = index + 1;
+            }
+          else
+            {
+              stack[n_stack++] = index + 1;
+              stack[n_stack++] = node->offset;
+            }
+          continue;
+        }
+
+      for (guint i = node->offset; i < node->offset + node->n_items; i++)
+        {
+          const Item *item = &self->items[i];
+
+          if ((item->flags & ITEM_CLOSEST) == 0 ||
+              bounds_distance_squared (&item->bounds, point) > data.threshold * data.threshold)
+            continue;
+
+          closest_item (self, item, &data);
+        }
+    }
+
+  if (!data.found)
+    return FALSE;
+
+  result->contour = data.result.contour;
+  result->idx = data.result.idx;
+  result->t = data.result.t;
+  *out_dist = data.threshold;
+
+  return TRUE;
+}
+
+/* }}} */
+
+/* vim:set foldmethod=marker expandtab: */
@@ -19,7 +19,7 @@
 
 #include "config.h"
 
-#include "gskpathmeasure.h"
+#include "gskpathmeasureprivate.h"
 
 #include "gskpathbuilder.h"
 #include "gskpathpointprivate.h"
@@ -47,6 +47,7 @@ typedef struct _GskContourMeasure GskContourMeasure;
 
 struct _GskContourMeasure
 {
+  float offset;
   float length;
   gpointer contour_data;
 };
@@ -117,6 +118,7 @@ gsk_path_measure_new_with_tolerance (GskPath *path,
 
   for (i = 0; i < n_contours; i++)
     {
+      self->measures[i].offset = self->length;
       self->measures[i].contour_data = gsk_contour_init_measure (gsk_path_get_contour (path, i),
                                                                  self->tolerance,
                                                                  &self->measures[i].length);
@@ -240,6 +242,30 @@ gsk_path_measure_clamp_distance (GskPathMeasure *self,
   return CLAMP (distance, 0, self->length);
 }
 
+/* Returns the first contour that ends after @distance,
+ * or the last contour if there is none.
+ */
+static gsize
+gsk_path_measure_find_contour (GskPathMeasure *self,
+                               float           distance)
+{
+  gsize lo, hi;
+
+  lo = 0;
+  hi = self->n_contours - 1;
+  while (lo < hi)
+    {
+      gsize mid = (lo + hi) / 2;
+
+      if (distance < self->measures[mid].offset + self->measures[mid].length)
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+
+  return lo;
+}
+
 /**
  * gsk_path_measure_get_point:
  * @self: a `GskPathMeasure`
@@ -270,17 +296,11 @@ gsk_path_measure_get_point (GskPathMeasure *self,
 
   distance = gsk_path_measure_clamp_distance (self, distance);
 
-  for (i = 0; i < self->n_contours - 1; i++)
-    {
-      if (distance < self->measures[i].length)
-        break;
-
-      distance -= self->measures[i].length;
-    }
+  i = gsk_path_measure_find_contour (self, distance);
 
   g_assert (0 <= i && i < self->n_contours);
 
-  distance = CLAMP (distance, 0, self->measures[i].length);
+  distance = CLAMP (distance - self->measures[i].offset, 0, self->measures[i].length);
 
   contour = gsk_path_get_contour (self->path, i);
 
@@ -309,20 +329,132 @@ float
 gsk_path_point_get_distance (const GskPathPoint *point,
                              GskPathMeasure     *measure)
 {
-  float contour_offset = 0;
-
   g_return_val_if_fail (measure != NULL, 0);
   g_return_val_if_fail (gsk_path_point_valid (point, measure->path), 0);
 
-  for (gsize i = 0; i < measure->n_contours; i++)
+  return measure->measures[point->contour].offset +
+         gsk_contour_get_distance (gsk_path_get_contour (measure->path, point->contour),
+                                   point,
+                                   measure->measures[point->contour].contour_data);
+}
+
+/*<private>
+ * gsk_path_measure_prepare:
+ * @self: a `GskPathMeasure`
+ *
+ * Computes the arclength samples for all curves of the path
+ * at the tolerance of @self.
+ *
+ * Normally, these are computed the first time a point on
+ * a curve is looked up. Doing it upfront avoids the cost
+ * on the first lookups, e.g. before animating along a path.
+ */
+void
+gsk_path_measure_prepare (GskPathMeasure *self)
+{
+  for (gsize i = 0; i < self->n_contours; i++)
+    gsk_contour_prepare_measure (gsk_path_get_contour (self->path, i),
+                                 self->measures[i].contour_data);
+}
+
+#define N_SAMPLES_PER_CHUNK 64
+
+/*<private>
+ * gsk_path_measure_sample:
+ * @self: a `GskPathMeasure`
+ * @distances: (array length=n_distances): the distances to sample at
+ * @n_distances: the number of distances
+ * @direction: the direction for the tangents
+ * @points: (out caller-allocates) (nullable): return location
+ *   for the points
+ * @positions: (out caller-allocates) (nullable): return location
+ *   for the positions of the points
+ * @tangents: (out caller-allocates) (nullable): return location
+ *   for the tangents at the points
+ *
+ * Looks up the points at all the given distances into the path,
+ * like calling [method@Gsk.PathMeasure.get_point] for each of
+ * them, and optionally their positions and tangents.
+ *
+ * This is meant for sampling a path densely, e.g. for placing
+ * glyphs or dashes along it. If @distances is sorted, we walk
+ * along the path once, instead of searching from the start for
+ * every distance. Unsorted distances work too, just slower.
+ *
+ * An empty path has no points, so `FALSE` is returned in that case.
+ *
+ * Returns: `TRUE` if the results were set
+ */
+gboolean
+gsk_path_measure_sample (GskPathMeasure   *self,
+                         const float      *distances,
+                         gsize             n_distances,
+                         GskPathDirection  direction,
+                         GskPathPoint     *points,
+                         graphene_point_t *positions,
+                         graphene_vec2_t  *tangents)
+{
+  float local[N_SAMPLES_PER_CHUNK];
+  GskPathPoint buffer[N_SAMPLES_PER_CHUNK];
+  gsize i, j, n, c;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (distances != NULL || n_distances == 0, FALSE);
+
+  if (self->n_contours == 0)
+    return FALSE;
+
+  c = 0;
+  for (i = 0; i < n_distances; i += n)
     {
-      if (i == point->contour)
-        return contour_offset + gsk_contour_get_distance (gsk_path_get_contour (measure->path, i),
-                                                          point,
-                                                          measure->measures[i].contour_data);
+      const GskContourMeasure *measure;
+      const GskContour *contour;
+      GskPathPoint *results;
+      float distance;
 
-      contour_offset += measure->measures[i].length;
+      distance = gsk_path_measure_clamp_distance (self, distances[i]);
+
+      /* This finds the same contour as gsk_path_measure_find_contour() */
+      while (c > 0 && distance < self->measures[c].offset)
+        c--;
+      while (c + 1 < self->n_contours &&
+             distance >= self->measures[c].offset + self->measures[c].length)
+        c++;
+
+      measure = &self->measures[c];
+      contour = gsk_path_get_contour (self->path, c);
+
+      /* Collect the following distances on the same contour */
+      for (n = 0; n < N_SAMPLES_PER_CHUNK && i + n < n_distances; n++)
+        {
+          distance = gsk_path_measure_clamp_distance (self, distances[i + n]);
+
+          if (c > 0 && distance < measure->offset)
+            break;
+          if (c + 1 < self->n_contours && distance >= measure->offset + measure->length)
+            break;
+
+          local[n] = CLAMP (distance - measure->offset, 0, measure->length);
+        }
+
+      g_assert (n > 0);
+
+      results = points ? &points[i] : buffer;
+
+      gsk_contour_get_points (contour, measure->contour_data, local, n, results);
+
+      for (j = 0; j < n; j++)
+        {
+          g_assert (0 <= results[j].t && results[j].t <= 1);
+
+          results[j].contour = c;
+
+          if (positions)
+            gsk_contour_get_position (contour, &results[j], &positions[i + j]);
+          if (tangents)
+            gsk_contour_get_tangent (contour, &results[j], direction, &tangents[i + j]);
+        }
     }
 
-  g_return_val_if_reached (0);
+  return TRUE;
 }
@@ -0,0 +1,35 @@
+/*
+ * Copyright © 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "gskpathmeasure.h"
+#include "gskpathpoint.h"
+
+G_BEGIN_DECLS
+
+void                    gsk_path_measure_prepare                (GskPathMeasure         *self);
+
+gboolean                gsk_path_measure_sample                 (GskPathMeasure         *self,
+                                                                 const float            *distances,
+                                                                 gsize                   n_distances,
+                                                                 GskPathDirection        direction,
+                                                                 GskPathPoint           *points,
+                                                                 graphene_point_t       *positions,
+                                                                 graphene_vec2_t        *tangents);
+
+G_END_DECLS
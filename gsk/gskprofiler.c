@@ -197,6 +197,15 @@ gsk_profiler_add_timer (GskProfiler *profiler,
   return timer->id;
 }
 
+gboolean
+gsk_profiler_has_timer (GskProfiler *profiler,
+                        GQuark       timer_id)
+{
+  g_return_val_if_fail (GSK_IS_PROFILER (profiler), FALSE);
+
+  return gsk_profiler_get_timer (profiler, timer_id) != NULL;
+}
+
 void
 gsk_profiler_counter_inc (GskProfiler *profiler,
                           GQuark       counter_id)
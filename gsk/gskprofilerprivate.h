@@ -18,6 +18,8 @@ GQuark          gsk_profiler_add_timer          (GskProfiler *profiler,
                                                  const char  *description,
                                                  gboolean     invert,
                                                  gboolean     can_reset);
+gboolean        gsk_profiler_has_timer          (GskProfiler *profiler,
+                                                 GQuark       timer_id);
 
 void            gsk_profiler_counter_inc        (GskProfiler *profiler,
                                                  GQuark       counter_id);
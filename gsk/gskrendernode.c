@@ -40,6 +40,7 @@
 
 #include "gskdebugprivate.h"
 #include "gskrendererprivate.h"
+#include "gskrendernodebinaryprivate.h"
 #include "gskrendernodeparserprivate.h"
 
 #include <graphene-gobject.h>
@@ -573,6 +574,9 @@ gsk_render_node_diff (GskRenderNode  *node1,
  * It is mostly intended for use inside a debugger to quickly dump a render
  * node to a file for later inspection.
  *
+ * If @filename ends in `.bnode`, a more compact binary format is
+ * used. [method@Gsk.RenderNode.deserialize] can load both formats.
+ *
  * Returns: %TRUE if saving was successful
  **/
 gboolean
@@ -587,7 +591,10 @@ gsk_render_node_write_to_file (GskRenderNode *node,
   g_return_val_if_fail (filename != NULL, FALSE);
   g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-  bytes = gsk_render_node_serialize (node);
+  if (g_str_has_suffix (filename, GSK_RENDER_NODE_BINARY_SUFFIX))
+    bytes = gsk_render_node_serialize_binary (node);
+  else
+    bytes = gsk_render_node_serialize (node);
   result = g_file_set_contents (filename,
                                 g_bytes_get_data (bytes, NULL),
                                 g_bytes_get_size (bytes),
@@ -607,6 +614,9 @@ gsk_render_node_write_to_file (GskRenderNode *node,
  *
  * For a discussion of the supported format, see that function.
  *
+ * Data in the binary format written by [method@Gsk.RenderNode.write_to_file]
+ * is recognized and loaded, too.
+ *
  * Returns: (nullable) (transfer full): a new `GskRenderNode`
  */
 GskRenderNode *
@@ -616,7 +626,10 @@ gsk_render_node_deserialize (GBytes            *bytes,
 {
   GskRenderNode *node = NULL;
 
-  node = gsk_render_node_deserialize_from_bytes (bytes, error_func, user_data);
+  if (gsk_render_node_is_binary (bytes))
+    node = gsk_render_node_deserialize_binary (bytes, error_func, user_data);
+  else
+    node = gsk_render_node_deserialize_from_bytes (bytes, error_func, user_data);
 
   return node;
 }
@@ -0,0 +1,2475 @@
+/*
+ * Copyright © 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gskrendernodebinaryprivate.h"
+
+#include "gskpath.h"
+#include "gskprivate.h"
+#include "gskrendernodeparserprivate.h"
+#include "gskrendernodeprivate.h"
+#include "gskstroke.h"
+#include "gsktransformprivate.h"
+
+#include "gdk/gdkmemoryformatprivate.h"
+#include "gdk/gdkrgbaprivate.h"
+#include "gdk/gdktextureprivate.h"
+
+#include <pango/pangocairo.h>
+
+/* The binary format is meant as a faster, smaller alternative to the
+ * text format for big recordings and test corpora. It stores exactly
+ * the same information as the text format, so converting between the
+ * two does not lose anything.
+ *
+ * All numbers are little endian. The file starts with a header that
+ * points to 3 sections:
+ *
+ * - the nodes: one record per node, in post-order, so children are
+ *   always written before their parents and can be referred to by
+ *   their index. Nodes that appear multiple times in the tree are
+ *   only written once. The root is the last node.
+ *   A record is a guint32 node type, a guint32 payload size and the
+ *   payload, which consists only of 32bit values.
+ * - the blob table: offset and size of chunks of data. Strings,
+ *   paths, transforms, fonts and shaders are stored here, and
+ *   identical data is only stored once.
+ * - the texture table: format, size and stride of each texture and
+ *   the blob with its pixels.
+ *
+ * The blob data follows at the end, aligned to 16 bytes, so a mapped
+ * file can be used directly for the pixels of memory textures.
+ *
+ * Data that has its own syntax (paths and transforms) is stored as
+ * text, so that it can be parsed back into the same objects the text
+ * format produces.
+ */
+
+#define BINARY_MAGIC "\x89GSKNODE"
+#define BINARY_MAGIC_SIZE 8
+#define BINARY_VERSION 1
+#define BINARY_NONE G_MAXUINT32
+#define BINARY_BLOB_ALIGNMENT 16
+#define BINARY_NODES_OFFSET 64
+
+#define ALIGN(n, alignment) (((n) + (alignment) - 1) / (alignment) * (alignment))
+
+#define GLYPH_IS_CLUSTER_START (1 << 0)
+#define GLYPH_IS_COLOR         (1 << 1)
+
+typedef struct
+{
+  char magic[BINARY_MAGIC_SIZE];
+  guint32 version;
+  guint32 n_nodes;
+  guint32 n_blobs;
+  guint32 n_textures;
+  guint64 nodes_offset;
+  guint64 nodes_size;
+  guint64 blobs_offset;
+  guint64 textures_offset;
+} BinaryHeader;
+
+typedef struct
+{
+  guint64 offset;
+  guint64 size;
+} BinaryBlob;
+
+typedef struct
+{
+  guint32 format;
+  guint32 width;
+  guint32 height;
+  guint32 blob;
+  guint64 stride;
+} BinaryTexture;
+
+G_STATIC_ASSERT (sizeof (BinaryHeader) <= BINARY_NODES_OFFSET);
+G_STATIC_ASSERT (sizeof (BinaryBlob) == 16);
+G_STATIC_ASSERT (sizeof (BinaryTexture) == 24);
+
+/* {{{ Writing */
+
+typedef struct
+{
+  guint32 name;
+  guint32 file;
+  guint32 hint_style;
+  guint32 antialias;
+} WriterFont;
+
+typedef struct
+{
+  GByteArray *nodes;
+  guint32 n_nodes;
+  GHashTable *node_indices;
+  GPtrArray *blobs;
+  GHashTable *blob_indices;
+  GHashTable *path_indices;
+  GHashTable *font_file_indices;
+  GArray *textures;
+  GHashTable *texture_indices;
+  GHashTable *fonts;
+} Writer;
+
+#define INDEX_TO_POINTER(i) GUINT_TO_POINTER ((i) + 1)
+#define POINTER_TO_INDEX(p) (GPOINTER_TO_UINT (p) - 1)
+
+static void
+writer_init (Writer *self)
+{
+  self->nodes = g_byte_array_new ();
+  self->n_nodes = 0;
+  self->node_indices = g_hash_table_new (NULL, NULL);
+  self->blobs = g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref);
+  self->blob_indices = g_hash_table_new (g_bytes_hash, g_bytes_equal);
+  self->path_indices = g_hash_table_new (NULL, NULL);
+  self->font_file_indices = g_hash_table_new (g_str_hash, g_str_equal);
+  self->textures = g_array_new (FALSE, FALSE, sizeof (BinaryTexture));
+  self->texture_indices = g_hash_table_new (NULL, NULL);
+  self->fonts = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+}
+
+static void
+writer_clear (Writer *self)
+{
+  g_byte_array_unref (self->nodes);
+  g_hash_table_unref (self->node_indices);
+  g_hash_table_unref (self->blob_indices);
+  g_ptr_array_unref (self->blobs);
+  g_hash_table_unref (self->path_indices);
+  g_hash_table_unref (self->font_file_indices);
+  g_array_unref (self->textures);
+  g_hash_table_unref (self->texture_indices);
+  g_hash_table_unref (self->fonts);
+}
+
+static guint32
+writer_add_unique_blob (Writer *self,
+                        GBytes *bytes)
+{
+  g_ptr_array_add (self->blobs, g_bytes_ref (bytes));
+
+  return self->blobs->len - 1;
+}
+
+static guint32
+writer_add_blob (Writer *self,
+                 GBytes *bytes)
+{
+  gpointer value;
+  guint32 index;
+
+  if (g_hash_table_lookup_extended (self->blob_indices, bytes, NULL, &value))
+    return POINTER_TO_INDEX (value);
+
+  index = writer_add_unique_blob (self, bytes);
+  g_hash_table_insert (self->blob_indices, bytes, INDEX_TO_POINTER (index));
+
+  return index;
+}
+
+/* Strings are stored with their terminating NUL, so that they
+ * can be used directly from the data.
+ */
+static guint32
+writer_add_string (Writer     *self,
+                   const char *string)
+{
+  GBytes *bytes;
+  guint32 index;
+
+  if (string == NULL)
+    return BINARY_NONE;
+
+  bytes = g_bytes_new (string, strlen (string) + 1);
+  index = writer_add_blob (self, bytes);
+  g_bytes_unref (bytes);
+
+  return index;
+}
+
+static guint32
+writer_take_string (Writer *self,
+                    char   *string)
+{
+  GBytes *bytes;
+  guint32 index;
+
+  bytes = g_bytes_new_take (string, strlen (string) + 1);
+  index = writer_add_blob (self, bytes);
+  g_bytes_unref (bytes);
+
+  return index;
+}
+
+static guint32
+writer_add_path (Writer  *self,
+                 GskPath *path)
+{
+  gpointer value;
+  guint32 index;
+
+  if (g_hash_table_lookup_extended (self->path_indices, path, NULL, &value))
+    return POINTER_TO_INDEX (value);
+
+  index = writer_take_string (self, gsk_path_to_string (path));
+  g_hash_table_insert (self->path_indices, path, INDEX_TO_POINTER (index));
+
+  return index;
+}
+
+static guint32
+writer_add_texture (Writer     *self,
+                    GdkTexture *texture)
+{
+  GdkTextureDownloader *downloader;
+  BinaryTexture entry;
+  gpointer value;
+  GBytes *bytes;
+  gsize stride;
+
+  if (g_hash_table_lookup_extended (self->texture_indices, texture, NULL, &value))
+    return POINTER_TO_INDEX (value);
+
+  /* For memory textures, this just hands out their bytes */
+  downloader = gdk_texture_downloader_new (texture);
+  gdk_texture_downloader_set_format (downloader, gdk_texture_get_format (texture));
+  bytes = gdk_texture_downloader_download_bytes (downloader, &stride);
+  gdk_texture_downloader_free (downloader);
+
+  entry.format = gdk_texture_get_format (texture);
+  entry.width = gdk_texture_get_width (texture);
+  entry.height = gdk_texture_get_height (texture);
+  entry.blob = writer_add_unique_blob (self, bytes);
+  entry.stride = stride;
+  g_bytes_unref (bytes);
+
+  g_array_append_val (self->textures, entry);
+  g_hash_table_insert (self->texture_indices, texture, INDEX_TO_POINTER (self->textures->len - 1));
+
+  return self->textures->len - 1;
+}
+
+static guint32
+writer_add_font_file (Writer     *self,
+                      const char *path)
+{
+  gpointer value;
+  char *data;
+  gsize len;
+  GBytes *bytes;
+  guint32 index;
+
+  if (path == NULL)
+    return BINARY_NONE;
+
+  if (g_hash_table_lookup_extended (self->font_file_indices, path, NULL, &value))
+    return POINTER_TO_INDEX (value);
+
+  if (g_file_get_contents (path, &data, &len, NULL))
+    {
+      bytes = g_bytes_new_take (data, len);
+      index = writer_add_blob (self, bytes);
+      g_bytes_unref (bytes);
+    }
+  else
+    {
+      index = BINARY_NONE;
+    }
+
+  g_hash_table_insert (self->font_file_indices, (gpointer) path, INDEX_TO_POINTER (index));
+
+  return index;
+}
+
+static const WriterFont *
+writer_add_font (Writer    *self,
+                 PangoFont *font)
+{
+  PangoFontDescription *desc;
+  cairo_hint_style_t hint_style;
+  cairo_antialias_t antialias;
+  WriterFont *result;
+
+  result = g_hash_table_lookup (self->fonts, font);
+  if (result)
+    return result;
+
+  result = g_new (WriterFont, 1);
+
+  desc = pango_font_describe_with_absolute_size (font);
+  result->name = writer_take_string (self, pango_font_description_to_string (desc));
+  pango_font_description_free (desc);
+
+  result->file = writer_add_font_file (self, gsk_render_node_printer_get_font_file (font));
+
+  gsk_render_node_printer_get_font_options (font, &hint_style, &antialias);
+  result->hint_style = hint_style;
+  result->antialias = antialias;
+
+  g_hash_table_insert (self->fonts, font, result);
+
+  return result;
+}
+
+static void
+writer_append_uint (Writer  *self,
+                    guint32  value)
+{
+  value = GUINT32_TO_LE (value);
+  g_byte_array_append (self->nodes, (const guint8 *) &value, sizeof (guint32));
+}
+
+static void
+writer_append_floats (Writer      *self,
+                      const float *values,
+                      gsize        n_values)
+{
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  g_byte_array_append (self->nodes, (const guint8 *) values, n_values * sizeof (float));
+#else
+  for (gsize i = 0; i < n_values; i++)
+    {
+      guint32 u;
+
+      memcpy (&u, &values[i], sizeof (float));
+      writer_append_uint (self, u);
+    }
+#endif
+}
+
+static void
+writer_append_float (Writer *self,
+                     float   value)
+{
+  writer_append_floats (self, &value, 1);
+}
+
+static void
+writer_append_point (Writer                 *self,
+                     const graphene_point_t *point)
+{
+  writer_append_float (self, point->x);
+  writer_append_float (self, point->y);
+}
+
+static void
+writer_append_rect (Writer                *self,
+                    const graphene_rect_t *rect)
+{
+  writer_append_float (self, rect->origin.x);
+  writer_append_float (self, rect->origin.y);
+  writer_append_float (self, rect->size.width);
+  writer_append_float (self, rect->size.height);
+}
+
+static void
+writer_append_rounded_rect (Writer               *self,
+                            const GskRoundedRect *rect)
+{
+  writer_append_rect (self, &rect->bounds);
+  for (guint i = 0; i < 4; i++)
+    {
+      writer_append_float (self, rect->corner[i].width);
+      writer_append_float (self, rect->corner[i].height);
+    }
+}
+
+static void
+writer_append_rgba (Writer        *self,
+                    const GdkRGBA *rgba)
+{
+  writer_append_float (self, rgba->red);
+  writer_append_float (self, rgba->green);
+  writer_append_float (self, rgba->blue);
+  writer_append_float (self, rgba->alpha);
+}
+
+static void
+writer_append_stops (Writer             *self,
+                     const GskColorStop *stops,
+                     gsize               n_stops)
+{
+  writer_append_uint (self, n_stops);
+  for (gsize i = 0; i < n_stops; i++)
+    {
+      writer_append_float (self, stops[i].offset);
+      writer_append_rgba (self, &stops[i].color);
+    }
+}
+
+static guint32 writer_add_node (Writer        *self,
+                                GskRenderNode *node);
+
+static gsize
+writer_start_node (Writer        *self,
+                   GskRenderNode *node)
+{
+  gsize start = self->nodes->len;
+
+  writer_append_uint (self, gsk_render_node_get_node_type (node));
+  writer_append_uint (self, 0);
+
+  return start;
+}
+
+static guint32
+writer_end_node (Writer        *self,
+                 GskRenderNode *node,
+                 gsize          start)
+{
+  guint32 size;
+
+  size = GUINT32_TO_LE (self->nodes->len - start - 2 * sizeof (guint32));
+  memcpy (self->nodes->data + start + sizeof (guint32), &size, sizeof (guint32));
+
+  g_hash_table_insert (self->node_indices, node, INDEX_TO_POINTER (self->n_nodes));
+
+  return self->n_nodes++;
+}
+
+static void
+writer_write_node (Writer        *self,
+                   GskRenderNode *node)
+{
+  gsize start;
+
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_CONTAINER_NODE:
+      {
+        guint i, n = gsk_container_node_get_n_children (node);
+        guint32 *children = g_new (guint32, n);
+
+        for (i = 0; i < n; i++)
+          children[i] = writer_add_node (self, gsk_container_node_get_child (node, i));
+
+        start = writer_start_node (self, node);
+        writer_append_uint (self, n);
+        for (i = 0; i < n; i++)
+          writer_append_uint (self, children[i]);
+
+        g_free (children);
+      }
+      break;
+
+    case GSK_CAIRO_NODE:
+      {
+        cairo_surface_t *surface = gsk_cairo_node_get_surface (node);
+        guint32 pixels = BINARY_NONE;
+        guint32 script = BINARY_NONE;
+
+        if (surface != NULL)
+          {
+            GBytes *bytes;
+
+            bytes = gsk_render_node_printer_save_cairo_pixels (surface);
+            pixels = writer_add_unique_blob (self, bytes);
+            g_bytes_unref (bytes);
+
+            bytes = gsk_render_node_printer_save_cairo_script (surface);
+            if (bytes)
+              {
+                script = writer_add_unique_blob (self, bytes);
+                g_bytes_unref (bytes);
+              }
+          }
+
+        start = writer_start_node (self, node);
+        writer_append_rect (self, &node->bounds);
+        writer_append_uint (self, pixels);
+        writer_append_uint (self, script);
+      }
+      break;
+
+    case GSK_COLOR_NODE:
+      start = writer_start_node (self, node);
+      writer_append_rect (self, &node->bounds);
+      writer_append_rgba (self, gsk_color_node_get_color (node));
+      break;
+
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+      start = writer_start_node (self, node);
+      writer_append_rect (self, &node->bounds);
+      writer_append_point (self, gsk_linear_gradient_node_get_start (node));
+      writer_append_point (self, gsk_linear_gradient_node_get_end (node));
+      writer_append_stops (self,
+                           gsk_linear_gradient_node_get_color_stops (node, NULL),
+                           gsk_linear_gradient_node_get_n_color_stops (node));
+      break;
+
+    case GSK_RADIAL_GRADIENT_NODE:
+    case GSK_REPEATING_RADIAL_GRADIENT_NODE:
+      start = writer_start_node (self, node);
+      writer_append_rect (self, &node->bounds);
+      writer_append_point (self, gsk_radial_gradient_node_get_center (node));
+      writer_append_float (self, gsk_radial_gradient_node_get_hradius (node));
+      writer_append_float (self, gsk_radial_gradient_node_get_vradius (node));
+      writer_append_float (self, gsk_radial_gradient_node_get_start (node));
+      writer_append_float (self, gsk_radial_gradient_node_get_end (node));
+      writer_append_stops (self,
+                           gsk_radial_gradient_node_get_color_stops (node, NULL),
+                           gsk_radial_gradient_node_get_n_color_stops (node));
+      break;
+
+    case GSK_CONIC_GRADIENT_NODE:
+      start = writer_start_node (self, node);
+      writer_append_rect (self, &node->bounds);
+      writer_append_point (self, gsk_conic_gradient_node_get_center (node));
+      writer_append_float (self, gsk_conic_gradient_node_get_rotation (node));
+      writer_append_stops (self,
+                           gsk_conic_gradient_node_get_color_stops (node, NULL),
+                           gsk_conic_gradient_node_get_n_color_stops (node));
+      break;
+
+    case GSK_BORDER_NODE:
+      {
+        const GdkRGBA *colors = gsk_border_node_get_colors (node);
+
+        start = writer_start_node (self, node);
+        writer_append_rounded_rect (self, gsk_border_node_get_outline (node));
+        writer_append_floats (self, gsk_border_node_get_widths (node), 4);
+        for (guint i = 0; i < 4; i++)
+          writer_append_rgba (self, &colors[i]);
+      }
+      break;
+
+    case GSK_TEXTURE_NODE:
+      {
+        guint32 texture = writer_add_texture (self, gsk_texture_node_get_texture (node));
+
+        start = writer_start_node (self, node);
+        writer_append_rect (self, &node->bounds);
+        writer_append_uint (self, texture);
+      }
+      break;
+
+    case GSK_TEXTURE_SCALE_NODE:
+      {
+        guint32 texture = writer_add_texture (self, gsk_texture_scale_node_get_texture (node));
+
+        start = writer_start_node (self, node);
+        writer_append_rect (self, &node->bounds);
+        writer_append_uint (self, texture);
+        writer_append_uint (self, gsk_texture_scale_node_get_filter (node));
+      }
+      break;
+
+    case GSK_INSET_SHADOW_NODE:
+      start = writer_start_node (self, node);
+      writer_append_rounded_rect (self, gsk_inset_shadow_node_get_outline (node));
+      writer_append_rgba (self, gsk_inset_shadow_node_get_color (node));
+      writer_append_float (self, gsk_inset_shadow_node_get_dx (node));
+      writer_append_float (self, gsk_inset_shadow_node_get_dy (node));
+      writer_append_float (self, gsk_inset_shadow_node_get_spread (node));
+      writer_append_float (self, gsk_inset_shadow_node_get_blur_radius (node));
+      break;
+
+    case GSK_OUTSET_SHADOW_NODE:
+      start = writer_start_node (self, node);
+      writer_append_rounded_rect (self, gsk_outset_shadow_node_get_outline (node));
+      writer_append_rgba (self, gsk_outset_shadow_node_get_color (node));
+      writer_append_float (self, gsk_outset_shadow_node_get_dx (node));
+      writer_append_float (self, gsk_outset_shadow_node_get_dy (node));
+      writer_append_float (self, gsk_outset_shadow_node_get_spread (node));
+      writer_append_float (self, gsk_outset_shadow_node_get_blur_radius (node));
+      break;
+
+    case GSK_TRANSFORM_NODE:
+      {
+        GskTransform *transform = gsk_transform_node_get_transform (node);
+        guint32 child = writer_add_node (self, gsk_transform_node_get_child (node));
+        guint32 string;
+
+        /* Like the text format, we drop identity transforms */
+        if (gsk_transform_get_category (transform) != GSK_TRANSFORM_CATEGORY_IDENTITY)
+          string = writer_take_string (self, gsk_transform_to_string (transform));
+        else
+          string = BINARY_NONE;
+
+        start = writer_start_node (self, node);
+        writer_append_uint (self, string);
+        writer_append_uint (self, child);
+      }
+      break;
+
+    case GSK_OPACITY_NODE:
+      {
+        guint32 child = writer_add_node (self, gsk_opacity_node_get_child (node));
+
+        start = writer_start_node (self, node);
+        writer_append_float (self, gsk_opacity_node_get_opacity (node));
+        writer_append_uint (self, child);
+      }
+      break;
+
+    case GSK_COLOR_MATRIX_NODE:
+      {
+        guint32 child = writer_add_node (self, gsk_color_matrix_node_get_child (node));
+        float values[16];
+
+        start = writer_start_node (self, node);
+        graphene_matrix_to_float (gsk_color_matrix_node_get_color_matrix (node), values);
+        writer_append_floats (self, values, 16);
+        graphene_vec4_to_float (gsk_color_matrix_node_get_color_offset (node), values);
+        writer_append_floats (self, values, 4);
+        writer_append_uint (self, child);
+      }
+      break;
+
+    case GSK_REPEAT_NODE:
+      {
+        guint32 child = writer_add_node (self, gsk_repeat_node_get_child (node));
+
+        start = writer_start_node (self, node);
+        writer_append_rect (self, &node->bounds);
+        writer_append_rect (self, gsk_repeat_node_get_child_bounds (node));
+        writer_append_uint (self, child);
+      }
+      break;
+
+    case GSK_CLIP_NODE:
+      {
+        guint32 child = writer_add_node (self, gsk_clip_node_get_child (node));
+
+        start = writer_start_node (self, node);
+        writer_append_rect (self, gsk_clip_node_get_clip (node));
+        writer_append_uint (self, child);
+      }
+      break;
+
+    case GSK_ROUNDED_CLIP_NODE:
+      {
+        guint32 child = writer_add_node (self, gsk_rounded_clip_node_get_child (node));
+
+        start = writer_start_node (self, node);
+        writer_append_rounded_rect (self, gsk_rounded_clip_node_get_clip (node));
+        writer_append_uint (self, child);
+      }
+      break;
+
+    case GSK_SHADOW_NODE:
+      {
+        guint32 child = writer_add_node (self, gsk_shadow_node_get_child (node));
+        gsize i, n = gsk_shadow_node_get_n_shadows (node);
+
+        start = writer_start_node (self, node);
+        writer_append_uint (self, n);
+        for (i = 0; i < n; i++)
+          {
+            const GskShadow *shadow = gsk_shadow_node_get_shadow (node, i);
+
+            writer_append_rgba (self, &shadow->color);
+            writer_append_float (self, shadow->dx);
+            writer_append_float (self, shadow->dy);
+            writer_append_float (self, shadow->radius);
+          }
+        writer_append_uint (self, child);
+      }
+      break;
+
+    case GSK_BLEND_NODE:
+      {
+        guint32 bottom = writer_add_node (self, gsk_blend_node_get_bottom_child (node));
+        guint32 top = writer_add_node (self, gsk_blend_node_get_top_child (node));
+
+        start = writer_start_node (self, node);
+        writer_append_uint (self, gsk_blend_node_get_blend_mode (node));
+        writer_append_uint (self, bottom);
+        writer_append_uint (self, top);
+      }
+      break;
+
+    case GSK_CROSS_FADE_NODE:
+      {
+        guint32 start_child = writer_add_node (self, gsk_cross_fade_node_get_start_child (node));
+        guint32 end_child = writer_add_node (self, gsk_cross_fade_node_get_end_child (node));
+
+        start = writer_start_node (self, node);
+        writer_append_float (self, gsk_cross_fade_node_get_progress (node));
+        writer_append_uint (self, start_child);
+        writer_append_uint (self, end_child);
+      }
+      break;
+
+    case GSK_TEXT_NODE:
+      {
+        const WriterFont *font = writer_add_font (self, gsk_text_node_get_font (node));
+        const PangoGlyphInfo *glyphs;
+        guint i, n_glyphs;
+
+        start = writer_start_node (self, node);
+        writer_append_uint (self, font->name);
+        writer_append_uint (self, font->file);
+        writer_append_uint (self, font->hint_style);
+        writer_append_uint (self, font->antialias);
+        writer_append_rgba (self, gsk_text_node_get_color (node));
+        writer_append_point (self, gsk_text_node_get_offset (node));
+
+        glyphs = gsk_text_node_get_glyphs (node, &n_glyphs);
+        writer_append_uint (self, n_glyphs);
+        for (i = 0; i < n_glyphs; i++)
+          {
+            writer_append_uint (self, glyphs[i].glyph);
+            writer_append_uint (self, glyphs[i].geometry.width);
+            writer_append_uint (self, glyphs[i].geometry.x_offset);
+            writer_append_uint (self, glyphs[i].geometry.y_offset);
+            writer_append_uint (self, (glyphs[i].attr.is_cluster_start ? GLYPH_IS_CLUSTER_START : 0) |
+                                      (glyphs[i].attr.is_color ? GLYPH_IS_COLOR : 0));
+          }
+      }
+      break;
+
+    case GSK_BLUR_NODE:
+      {
+        guint32 child = writer_add_node (self, gsk_blur_node_get_child (node));
+
+        start = writer_start_node (self, node);
+        writer_append_float (self, gsk_blur_node_get_radius (node));
+        writer_append_uint (self, child);
+      }
+      break;
+
+    case GSK_DEBUG_NODE:
+      {
+        guint32 child = writer_add_node (self, gsk_debug_node_get_child (node));
+        guint32 message = writer_add_string (self, gsk_debug_node_get_message (node));
+
+        start = writer_start_node (self, node);
+        writer_append_uint (self, message);
+        writer_append_uint (self, child);
+      }
+      break;
+
+    case GSK_GL_SHADER_NODE:
+      {
+        GskGLShader *shader = gsk_gl_shader_node_get_shader (node);
+        guint i, n = gsk_gl_shader_node_get_n_children (node);
+        guint32 children[4];
+        guint32 source, args;
+
+        g_assert (n <= G_N_ELEMENTS (children));
+
+        for (i = 0; i < n; i++)
+          children[i] = writer_add_node (self, gsk_gl_shader_node_get_child (node, i));
+        source = writer_add_blob (self, gsk_gl_shader_get_source (shader));
+        args = writer_add_blob (self, gsk_gl_shader_node_get_args (node));
+
+        start = writer_start_node (self, node);
+        writer_append_rect (self, &node->bounds);
+        writer_append_uint (self, source);
+        writer_append_uint (self, args);
+        writer_append_uint (self, n);
+        for (i = 0; i < n; i++)
+          writer_append_uint (self, children[i]);
+      }
+      break;
+
+    case GSK_MASK_NODE:
+      {
+        guint32 source = writer_add_node (self, gsk_mask_node_get_source (node));
+        guint32 mask = writer_add_node (self, gsk_mask_node_get_mask (node));
+
+        start = writer_start_node (self, node);
+        writer_append_uint (self, gsk_mask_node_get_mask_mode (node));
+        writer_append_uint (self, source);
+        writer_append_uint (self, mask);
+      }
+      break;
+
+    case GSK_FILL_NODE:
+      {
+        guint32 child = writer_add_node (self, gsk_fill_node_get_child (node));
+        guint32 path = writer_add_path (self, gsk_fill_node_get_path (node));
+
+        start = writer_start_node (self, node);
+        writer_append_uint (self, path);
+        writer_append_uint (self, gsk_fill_node_get_fill_rule (node));
+        writer_append_uint (self, child);
+      }
+      break;
+
+    case GSK_STROKE_NODE:
+      {
+        guint32 child = writer_add_node (self, gsk_stroke_node_get_child (node));
+        guint32 path = writer_add_path (self, gsk_stroke_node_get_path (node));
+        const GskStroke *stroke = gsk_stroke_node_get_stroke (node);
+        const float *dash;
+        gsize n_dash;
+
+        start = writer_start_node (self, node);
+        writer_append_uint (self, path);
+        writer_append_float (self, gsk_stroke_get_line_width (stroke));
+        writer_append_uint (self, gsk_stroke_get_line_cap (stroke));
+        writer_append_uint (self, gsk_stroke_get_line_join (stroke));
+        writer_append_float (self, gsk_stroke_get_miter_limit (stroke));
+        writer_append_float (self, gsk_stroke_get_dash_offset (stroke));
+        dash = gsk_stroke_get_dash (stroke, &n_dash);
+        writer_append_uint (self, n_dash);
+        writer_append_floats (self, dash, n_dash);
+        writer_append_uint (self, child);
+      }
+      break;
+
+    case GSK_SUBSURFACE_NODE:
+      {
+        guint32 child = writer_add_node (self, gsk_subsurface_node_get_child (node));
+
+        start = writer_start_node (self, node);
+        writer_append_uint (self, child);
+      }
+      break;
+
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      g_error ("Unhandled node: %s", g_type_name_from_instance ((GTypeInstance *) node));
+      return;
+    }
+
+  writer_end_node (self, node, start);
+}
+
+static guint32
+writer_add_node (Writer        *self,
+                 GskRenderNode *node)
+{
+  gpointer value;
+
+  if (!g_hash_table_lookup_extended (self->node_indices, node, NULL, &value))
+    {
+      writer_write_node (self, node);
+      value = g_hash_table_lookup (self->node_indices, node);
+    }
+
+  return POINTER_TO_INDEX (value);
+}
+
+static GBytes *
+writer_finish (Writer *self)
+{
+  BinaryHeader header;
+  BinaryBlob *blobs;
+  BinaryTexture *textures;
+  gsize offset;
+  guint8 *data;
+  guint i;
+
+  memcpy (header.magic, BINARY_MAGIC, BINARY_MAGIC_SIZE);
+  header.version = GUINT32_TO_LE (BINARY_VERSION);
+  header.n_nodes = GUINT32_TO_LE (self->n_nodes);
+  header.n_blobs = GUINT32_TO_LE (self->blobs->len);
+  header.n_textures = GUINT32_TO_LE (self->textures->len);
+
+  offset = BINARY_NODES_OFFSET;
+  header.nodes_offset = GUINT64_TO_LE (offset);
+  header.nodes_size = GUINT64_TO_LE (self->nodes->len);
+  offset += self->nodes->len;
+
+  offset = ALIGN (offset, sizeof (guint64));
+  header.blobs_offset = GUINT64_TO_LE (offset);
+  offset += self->blobs->len * sizeof (BinaryBlob);
+
+  header.textures_offset = GUINT64_TO_LE (offset);
+  offset += self->textures->len * sizeof (BinaryTexture);
+
+  blobs = g_new (BinaryBlob, self->blobs->len);
+  for (i = 0; i < self->blobs->len; i++)
+    {
+      gsize size = g_bytes_get_size (g_ptr_array_index (self->blobs, i));
+
+      offset = ALIGN (offset, BINARY_BLOB_ALIGNMENT);
+      blobs[i].offset = GUINT64_TO_LE (offset);
+      blobs[i].size = GUINT64_TO_LE (size);
+      offset += size;
+    }
+
+  textures = (BinaryTexture *) self->textures->data;
+  for (i = 0; i < self->textures->len; i++)
+    {
+      textures[i].format = GUINT32_TO_LE (textures[i].format);
+      textures[i].width = GUINT32_TO_LE (textures[i].width);
+      textures[i].height = GUINT32_TO_LE (textures[i].height);
+      textures[i].blob = GUINT32_TO_LE (textures[i].blob);
+      textures[i].stride = GUINT64_TO_LE (textures[i].stride);
+    }
+
+  data = g_malloc0 (offset);
+  memcpy (data, &header, sizeof (BinaryHeader));
+  memcpy (data + BINARY_NODES_OFFSET, self->nodes->data, self->nodes->len);
+  memcpy (data + GUINT64_FROM_LE (header.blobs_offset), blobs, self->blobs->len * sizeof (BinaryBlob));
+  memcpy (data + GUINT64_FROM_LE (header.textures_offset), textures, self->textures->len * sizeof (BinaryTexture));
+  for (i = 0; i < self->blobs->len; i++)
+    {
+      GBytes *bytes = g_ptr_array_index (self->blobs, i);
+
+      memcpy (data + GUINT64_FROM_LE (blobs[i].offset),
+              g_bytes_get_data (bytes, NULL),
+              g_bytes_get_size (bytes));
+    }
+
+  g_free (blobs);
+
+  return g_bytes_new_take (data, offset);
+}
+
+/*<private>
+ * gsk_render_node_serialize_binary:
+ * @node: a `GskRenderNode`
+ *
+ * Serializes @node in the binary format. The result can be loaded
+ * with [func@Gsk.RenderNode.deserialize] just like the text format.
+ *
+ * Returns: (transfer full): the serialized node
+ */
+GBytes *
+gsk_render_node_serialize_binary (GskRenderNode *node)
+{
+  Writer writer;
+  GBytes *result;
+
+  writer_init (&writer);
+  writer_add_node (&writer, node);
+  result = writer_finish (&writer);
+  writer_clear (&writer);
+
+  return result;
+}
+
+/* }}} */
+/* {{{ Reading */
+
+typedef struct
+{
+  guint32 name;
+  guint32 file;
+  guint32 hint_style;
+  guint32 antialias;
+} FontKey;
+
+static guint
+font_key_hash (gconstpointer data)
+{
+  const FontKey *key = data;
+
+  return key->name ^ (key->file << 8) ^ (key->hint_style << 24) ^ (key->antialias << 28);
+}
+
+static gboolean
+font_key_equal (gconstpointer a,
+                gconstpointer b)
+{
+  return memcmp (a, b, sizeof (FontKey)) == 0;
+}
+
+typedef struct
+{
+  GBytes *bytes;
+  const guint8 *data;
+  gsize size;
+  GskParseErrorFunc error_func;
+  gpointer user_data;
+
+  /* the current node */
+  gsize start;
+  gsize pos;
+  gsize end;
+  gboolean failed;
+
+  gsize blobs_offset;
+  guint32 n_blobs;
+  gsize textures_offset;
+  guint32 n_textures;
+  GdkTexture **textures;
+  GskRenderNode **nodes;
+  guint32 n_nodes;
+  guint32 expected_nodes;
+
+  GHashTable *transforms;
+  GHashTable *paths;
+  GHashTable *shaders;
+  GHashTable *fonts;
+  GHashTable *font_files;
+  PangoFontMap *fontmap;
+} Reader;
+
+static void
+reader_clear (Reader *self)
+{
+  guint32 i;
+
+  for (i = 0; i < self->n_nodes; i++)
+    gsk_render_node_unref (self->nodes[i]);
+  g_free (self->nodes);
+  for (i = 0; i < self->n_textures; i++)
+    g_clear_object (&self->textures[i]);
+  g_free (self->textures);
+
+  g_clear_pointer (&self->transforms, g_hash_table_unref);
+  g_clear_pointer (&self->paths, g_hash_table_unref);
+  g_clear_pointer (&self->shaders, g_hash_table_unref);
+  g_clear_pointer (&self->fonts, g_hash_table_unref);
+  g_clear_pointer (&self->font_files, g_hash_table_unref);
+  g_clear_object (&self->fontmap);
+}
+
+static void
+reader_report (Reader     *self,
+               int         code,
+               const char *format,
+               va_list     args)
+{
+  GskParseLocation start = { 0, }, end = { 0, };
+  GError *error;
+
+  if (self->error_func == NULL)
+    return;
+
+  error = g_error_new_valist (GSK_SERIALIZATION_ERROR, code, format, args);
+
+  /* There are no lines, so we report everything as one
+   * long line.
+   */
+  start.bytes = start.chars = start.line_bytes = start.line_chars = self->start;
+  end.bytes = end.chars = end.line_bytes = end.line_chars = MAX (self->start, self->pos);
+
+  self->error_func (&start, &end, error, self->user_data);
+
+  g_error_free (error);
+}
+
+/* Reports an error that we can recover from */
+static void G_GNUC_PRINTF (2, 3)
+reader_error (Reader     *self,
+              const char *format,
+              ...)
+{
+  va_list args;
+
+  va_start (args, format);
+  reader_report (self, GSK_SERIALIZATION_INVALID_DATA, format, args);
+  va_end (args);
+}
+
+/* Reports an error in the file structure. Only the first one
+ * is reported and reading stops there.
+ */
+static void G_GNUC_PRINTF (3, 4)
+reader_fail_with_code (Reader     *self,
+                       int         code,
+                       const char *format,
+                       ...)
+{
+  va_list args;
+
+  if (self->failed)
+    return;
+
+  self->failed = TRUE;
+
+  va_start (args, format);
+  reader_report (self, code, format, args);
+  va_end (args);
+}
+
+#define reader_fail(self, ...) reader_fail_with_code ((self), GSK_SERIALIZATION_INVALID_DATA, __VA_ARGS__)
+
+static guint32
+reader_read_uint (Reader *self)
+{
+  guint32 value;
+
+  if (self->end - self->pos < sizeof (guint32))
+    {
+      reader_fail (self, "Unexpected end of node data");
+      return 0;
+    }
+
+  memcpy (&value, self->data + self->pos, sizeof (guint32));
+  self->pos += sizeof (guint32);
+
+  return GUINT32_FROM_LE (value);
+}
+
+static float
+reader_read_float (Reader *self)
+{
+  guint32 value;
+  float f;
+
+  value = reader_read_uint (self);
+  memcpy (&f, &value, sizeof (float));
+
+  return f;
+}
+
+static void
+reader_read_floats (Reader *self,
+                    float  *values,
+                    gsize   n_values)
+{
+  for (gsize i = 0; i < n_values; i++)
+    values[i] = reader_read_float (self);
+}
+
+/* Checks that an array of @n elements of @size 32bit values each can
+ * fit into the remaining data, so we don't allocate huge amounts of
+ * memory for broken files.
+ */
+static gboolean
+reader_check_array (Reader *self,
+                    guint32 n,
+                    gsize   size)
+{
+  if ((self->end - self->pos) / (size * sizeof (guint32)) < n)
+    {
+      reader_fail (self, "Array of %u elements exceeds node data", n);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+reader_read_point (Reader           *self,
+                   graphene_point_t *point)
+{
+  point->x = reader_read_float (self);
+  point->y = reader_read_float (self);
+}
+
+static void
+reader_read_rect (Reader          *self,
+                  graphene_rect_t *rect)
+{
+  rect->origin.x = reader_read_float (self);
+  rect->origin.y = reader_read_float (self);
+  rect->size.width = reader_read_float (self);
+  rect->size.height = reader_read_float (self);
+}
+
+static void
+reader_read_rounded_rect (Reader         *self,
+                          GskRoundedRect *rect)
+{
+  reader_read_rect (self, &rect->bounds);
+  for (guint i = 0; i < 4; i++)
+    {
+      rect->corner[i].width = reader_read_float (self);
+      rect->corner[i].height = reader_read_float (self);
+    }
+}
+
+static void
+reader_read_rgba (Reader  *self,
+                  GdkRGBA *rgba)
+{
+  rgba->red = reader_read_float (self);
+  rgba->green = reader_read_float (self);
+  rgba->blue = reader_read_float (self);
+  rgba->alpha = reader_read_float (self);
+}
+
+static guint32
+reader_read_enum (Reader     *self,
+                  guint32     max,
+                  const char *name)
+{
+  guint32 value = reader_read_uint (self);
+
+  if (value > max)
+    {
+      reader_fail (self, "Invalid value %u for %s", value, name);
+      return 0;
+    }
+
+  return value;
+}
+
+static GskColorStop *
+reader_read_stops (Reader *self,
+                   gsize  *n_stops)
+{
+  GskColorStop *stops;
+  guint32 i, n;
+
+  n = reader_read_uint (self);
+  if (!reader_check_array (self, n, 5))
+    return NULL;
+
+  if (n < 2)
+    {
+      reader_fail (self, "Gradients need at least 2 color stops");
+      return NULL;
+    }
+
+  stops = g_new (GskColorStop, n);
+  for (i = 0; i < n; i++)
+    {
+      stops[i].offset = reader_read_float (self);
+      reader_read_rgba (self, &stops[i].color);
+
+      if (!(stops[i].offset >= (i > 0 ? stops[i - 1].offset : 0) && stops[i].offset <= 1))
+        {
+          reader_fail (self, "Color stop offsets must be increasing and between 0 and 1");
+          g_free (stops);
+          return NULL;
+        }
+    }
+
+  *n_stops = n;
+  return stops;
+}
+
+static GskRenderNode *
+reader_read_node_ref (Reader *self)
+{
+  guint32 index = reader_read_uint (self);
+
+  if (self->failed)
+    return NULL;
+
+  if (index >= self->n_nodes)
+    {
+      reader_fail (self, "Invalid reference to node %u", index);
+      return NULL;
+    }
+
+  return self->nodes[index];
+}
+
+/* The tables may not be aligned if the data isn't, so we copy
+ * the entries out.
+ */
+static void
+reader_get_blob_entry (Reader     *self,
+                       guint32     index,
+                       BinaryBlob *entry)
+{
+  memcpy (entry, self->data + self->blobs_offset + index * sizeof (BinaryBlob), sizeof (BinaryBlob));
+  entry->offset = GUINT64_FROM_LE (entry->offset);
+  entry->size = GUINT64_FROM_LE (entry->size);
+}
+
+static void
+reader_get_texture_entry (Reader        *self,
+                          guint32        index,
+                          BinaryTexture *entry)
+{
+  memcpy (entry, self->data + self->textures_offset + index * sizeof (BinaryTexture), sizeof (BinaryTexture));
+  entry->format = GUINT32_FROM_LE (entry->format);
+  entry->width = GUINT32_FROM_LE (entry->width);
+  entry->height = GUINT32_FROM_LE (entry->height);
+  entry->blob = GUINT32_FROM_LE (entry->blob);
+  entry->stride = GUINT64_FROM_LE (entry->stride);
+}
+
+static gboolean
+reader_get_blob (Reader        *self,
+                 guint32        index,
+                 gconstpointer *data,
+                 gsize         *size)
+{
+  BinaryBlob entry;
+
+  if (self->failed)
+    return FALSE;
+
+  if (index >= self->n_blobs)
+    {
+      reader_fail (self, "Invalid reference to data %u", index);
+      return FALSE;
+    }
+
+  /* the blob table has been validated already */
+  reader_get_blob_entry (self, index, &entry);
+  *data = self->data + entry.offset;
+  *size = entry.size;
+
+  return TRUE;
+}
+
+static GBytes *
+reader_get_bytes (Reader  *self,
+                  guint32  index)
+{
+  gconstpointer data;
+  gsize size;
+
+  if (!reader_get_blob (self, index, &data, &size))
+    return NULL;
+
+  return g_bytes_new_from_bytes (self->bytes, (const guint8 *) data - self->data, size);
+}
+
+static const char *
+reader_get_string (Reader  *self,
+                   guint32  index)
+{
+  gconstpointer data;
+  gsize size;
+
+  if (!reader_get_blob (self, index, &data, &size))
+    return NULL;
+
+  if (size == 0 || ((const char *) data)[size - 1] != '\0')
+    {
+      reader_fail (self, "Data %u is not a string", index);
+      return NULL;
+    }
+
+  return data;
+}
+
+static GdkTexture *
+reader_read_texture (Reader *self)
+{
+  guint32 index = reader_read_uint (self);
+  BinaryTexture entry;
+  GdkMemoryFormat format;
+  guint32 width, height;
+  gsize stride, bpp;
+  GBytes *bytes;
+
+  if (self->failed)
+    return NULL;
+
+  if (index >= self->n_textures)
+    {
+      reader_fail (self, "Invalid reference to texture %u", index);
+      return NULL;
+    }
+
+  if (self->textures[index])
+    return self->textures[index];
+
+  reader_get_texture_entry (self, index, &entry);
+  format = entry.format;
+  width = entry.width;
+  height = entry.height;
+  stride = entry.stride;
+
+  if (format >= GDK_MEMORY_N_FORMATS)
+    {
+      reader_fail (self, "Texture %u has invalid format %u", index, format);
+      return NULL;
+    }
+
+  bpp = gdk_memory_format_bytes_per_pixel (format);
+  if (width == 0 || height == 0 ||
+      width > G_MAXINT || height > G_MAXINT ||
+      stride / bpp < width)
+    {
+      reader_fail (self, "Texture %u has invalid size %ux%u", index, width, height);
+      return NULL;
+    }
+
+  bytes = reader_get_bytes (self, entry.blob);
+  if (bytes == NULL)
+    return NULL;
+
+  if (g_bytes_get_size (bytes) / stride < height - 1 ||
+      g_bytes_get_size (bytes) - stride * (height - 1) < width * bpp)
+    {
+      reader_fail (self, "Texture %u is missing pixel data", index);
+      g_bytes_unref (bytes);
+      return NULL;
+    }
+
+  /* This keeps the whole file alive, but if it was mapped,
+   * the pixels are never copied.
+   */
+  self->textures[index] = gdk_memory_texture_new (width, height, format, bytes, stride);
+  g_bytes_unref (bytes);
+
+  return self->textures[index];
+}
+
+static GskTransform *
+reader_read_transform (Reader *self)
+{
+  guint32 index = reader_read_uint (self);
+  GskTransform *transform;
+  const char *string;
+
+  if (self->failed)
+    return NULL;
+
+  /* The text format does this, too */
+  if (index == BINARY_NONE)
+    return gsk_transform_new ();
+
+  transform = g_hash_table_lookup (self->transforms, INDEX_TO_POINTER (index));
+  if (transform)
+    return gsk_transform_ref (transform);
+
+  string = reader_get_string (self, index);
+  if (string == NULL)
+    return NULL;
+
+  if (!gsk_transform_parse (string, &transform))
+    {
+      reader_fail (self, "Invalid transform \"%s\"", string);
+      return NULL;
+    }
+
+  if (transform == NULL)
+    transform = gsk_transform_new ();
+
+  g_hash_table_insert (self->transforms, INDEX_TO_POINTER (index), transform);
+
+  return gsk_transform_ref (transform);
+}
+
+static GskPath *
+reader_read_path (Reader *self)
+{
+  guint32 index = reader_read_uint (self);
+  GskPath *path;
+  const char *string;
+
+  if (self->failed)
+    return NULL;
+
+  path = g_hash_table_lookup (self->paths, INDEX_TO_POINTER (index));
+  if (path)
+    return path;
+
+  string = reader_get_string (self, index);
+  if (string == NULL)
+    return NULL;
+
+  path = gsk_path_parse (string);
+  if (path == NULL)
+    {
+      reader_fail (self, "Invalid path \"%s\"", string);
+      return NULL;
+    }
+
+  g_hash_table_insert (self->paths, INDEX_TO_POINTER (index), path);
+
+  return path;
+}
+
+static GskGLShader *
+reader_read_shader (Reader *self)
+{
+  guint32 index = reader_read_uint (self);
+  GskGLShader *shader;
+  GBytes *bytes;
+
+  if (self->failed)
+    return NULL;
+
+  shader = g_hash_table_lookup (self->shaders, INDEX_TO_POINTER (index));
+  if (shader)
+    return shader;
+
+  bytes = reader_get_bytes (self, index);
+  if (bytes == NULL)
+    return NULL;
+
+  shader = gsk_gl_shader_new_from_bytes (bytes);
+  g_bytes_unref (bytes);
+
+  g_hash_table_insert (self->shaders, INDEX_TO_POINTER (index), shader);
+
+  return shader;
+}
+
+static PangoFont *
+reader_load_font (Reader        *self,
+                  const FontKey *key)
+{
+  PangoFont *font, *hinted;
+  const char *name;
+
+  name = reader_get_string (self, key->name);
+  if (name == NULL)
+    return NULL;
+
+  if (key->file != BINARY_NONE)
+    {
+      if (!g_hash_table_contains (self->font_files, INDEX_TO_POINTER (key->file)))
+        {
+          GError *error = NULL;
+          GBytes *bytes;
+
+          bytes = reader_get_bytes (self, key->file);
+          if (bytes == NULL)
+            return NULL;
+
+          if (!gsk_render_node_parser_add_font_from_bytes (&self->fontmap, bytes, &error))
+            {
+              reader_error (self, "%s", error->message);
+              g_error_free (error);
+            }
+
+          g_bytes_unref (bytes);
+          g_hash_table_add (self->font_files, INDEX_TO_POINTER (key->file));
+        }
+
+      if (self->fontmap)
+        font = gsk_render_node_parser_font_from_string (self->fontmap, name, FALSE);
+      else
+        font = NULL;
+
+      if (font == NULL)
+        reader_error (self, "The font file does not define a font named \"%s\"", name);
+    }
+  else
+    {
+      font = gsk_render_node_parser_font_from_string (pango_cairo_font_map_get_default (), name, TRUE);
+
+      if (font == NULL)
+        reader_error (self, "The font \"%s\" does not exist", name);
+    }
+
+  if (font == NULL)
+    return NULL;
+
+  hinted = gsk_reload_font (font, 1.0, CAIRO_HINT_METRICS_OFF, key->hint_style, key->antialias);
+  g_object_unref (font);
+
+  return hinted;
+}
+
+static PangoFont *
+reader_read_font (Reader *self)
+{
+  FontKey key;
+  PangoFont *font;
+
+  key.name = reader_read_uint (self);
+  key.file = reader_read_uint (self);
+  key.hint_style = reader_read_uint (self);
+  key.antialias = reader_read_uint (self);
+
+  if (self->failed)
+    return NULL;
+
+  if (key.hint_style != CAIRO_HINT_STYLE_NONE &&
+      key.hint_style != CAIRO_HINT_STYLE_SLIGHT &&
+      key.hint_style != CAIRO_HINT_STYLE_FULL)
+    {
+      reader_fail (self, "Unsupported hint style %u", key.hint_style);
+      return NULL;
+    }
+
+  if (key.antialias != CAIRO_ANTIALIAS_NONE &&
+      key.antialias != CAIRO_ANTIALIAS_GRAY)
+    {
+      reader_fail (self, "Unsupported antialias mode %u", key.antialias);
+      return NULL;
+    }
+
+  font = g_hash_table_lookup (self->fonts, &key);
+  if (font)
+    return font;
+
+  font = reader_load_font (self, &key);
+  if (font == NULL)
+    return NULL;
+
+  g_hash_table_insert (self->fonts, g_memdup2 (&key, sizeof (FontKey)), font);
+
+  return font;
+}
+
+/* Used for nodes we can't recreate, just like the text format
+ * does it.
+ */
+static GskRenderNode *
+create_default_render_node (void)
+{
+  return gsk_color_node_new (&GDK_RGBA("FF00CC"), &GRAPHENE_RECT_INIT (0, 0, 50, 50));
+}
+
+static GskRenderNode *
+reader_read_text_node (Reader *self)
+{
+  PangoFont *font;
+  GdkRGBA color;
+  graphene_point_t offset;
+  PangoGlyphString *glyphs;
+  GskRenderNode *node;
+  guint32 i, n_glyphs;
+
+  font = reader_read_font (self);
+  reader_read_rgba (self, &color);
+  reader_read_point (self, &offset);
+  n_glyphs = reader_read_uint (self);
+  if (self->failed || !reader_check_array (self, n_glyphs, 5))
+    return NULL;
+
+  glyphs = pango_glyph_string_new ();
+  pango_glyph_string_set_size (glyphs, n_glyphs);
+  memset (glyphs->glyphs, 0, n_glyphs * sizeof (PangoGlyphInfo));
+  for (i = 0; i < n_glyphs; i++)
+    {
+      PangoGlyphInfo *gi = &glyphs->glyphs[i];
+      guint32 flags;
+
+      gi->glyph = reader_read_uint (self);
+      gi->geometry.width = (gint32) reader_read_uint (self);
+      gi->geometry.x_offset = (gint32) reader_read_uint (self);
+      gi->geometry.y_offset = (gint32) reader_read_uint (self);
+      flags = reader_read_uint (self);
+      gi->attr.is_cluster_start = (flags & GLYPH_IS_CLUSTER_START) ? 1 : 0;
+      gi->attr.is_color = (flags & GLYPH_IS_COLOR) ? 1 : 0;
+    }
+
+  if (font == NULL)
+    {
+      node = create_default_render_node ();
+    }
+  else
+    {
+      node = gsk_text_node_new (font, glyphs, &color, &offset);
+      if (node == NULL)
+        {
+          reader_error (self, "Glyphs result in empty text");
+          node = create_default_render_node ();
+        }
+    }
+
+  pango_glyph_string_free (glyphs);
+
+  return node;
+}
+
+static GskRenderNode *
+reader_read_cairo_node (Reader *self)
+{
+  graphene_rect_t bounds;
+  guint32 pixels, script;
+  cairo_surface_t *surface = NULL;
+  GskRenderNode *node;
+
+  reader_read_rect (self, &bounds);
+  pixels = reader_read_uint (self);
+  script = reader_read_uint (self);
+  if (self->failed)
+    return NULL;
+
+#ifdef HAVE_CAIRO_SCRIPT_INTERPRETER
+  if (script != BINARY_NONE)
+    {
+      GError *error = NULL;
+      GBytes *bytes;
+
+      bytes = reader_get_bytes (self, script);
+      if (bytes == NULL)
+        return NULL;
+
+      surface = gsk_render_node_parser_run_script (bytes, &error);
+      if (surface == NULL)
+        {
+          reader_error (self, "%s", error->message);
+          g_error_free (error);
+        }
+
+      g_bytes_unref (bytes);
+    }
+#endif
+
+  if (surface == NULL && pixels != BINARY_NONE)
+    {
+      GError *error = NULL;
+      GdkTexture *texture;
+      GBytes *bytes;
+
+      bytes = reader_get_bytes (self, pixels);
+      if (bytes == NULL)
+        return NULL;
+
+      texture = gdk_texture_new_from_bytes (bytes, &error);
+      if (texture)
+        {
+          surface = gdk_texture_download_surface (texture);
+          g_object_unref (texture);
+        }
+      else
+        {
+          reader_error (self, "%s", error->message);
+          g_error_free (error);
+        }
+
+      g_bytes_unref (bytes);
+    }
+
+  node = gsk_cairo_node_new (&bounds);
+
+  if (surface != NULL)
+    {
+      cairo_t *cr = gsk_cairo_node_get_draw_context (node);
+      cairo_set_source_surface (cr, surface, 0, 0);
+      cairo_paint (cr);
+      cairo_destroy (cr);
+      cairo_surface_destroy (surface);
+    }
+
+  return node;
+}
+
+static GskRenderNode *
+reader_read_gl_shader_node (Reader *self)
+{
+  graphene_rect_t bounds;
+  GskGLShader *shader;
+  GskRenderNode *children[4];
+  GskRenderNode *node;
+  GBytes *args;
+  guint32 i, n_children;
+
+  reader_read_rect (self, &bounds);
+  shader = reader_read_shader (self);
+  args = reader_get_bytes (self, reader_read_uint (self));
+  n_children = reader_read_uint (self);
+  if (self->failed)
+    goto fail;
+
+  if (n_children > G_N_ELEMENTS (children) ||
+      (n_children > 0 && n_children != gsk_gl_shader_get_n_textures (shader)))
+    {
+      reader_fail (self, "Shader needs %d children, not %u", gsk_gl_shader_get_n_textures (shader), n_children);
+      goto fail;
+    }
+
+  if (g_bytes_get_size (args) != gsk_gl_shader_get_args_size (shader))
+    {
+      reader_fail (self, "Shader arguments have the wrong size");
+      goto fail;
+    }
+
+  for (i = 0; i < n_children; i++)
+    children[i] = reader_read_node_ref (self);
+  if (self->failed)
+    goto fail;
+
+  node = gsk_gl_shader_node_new (shader, &bounds, args, n_children > 0 ? children : NULL, n_children);
+  g_bytes_unref (args);
+
+  return node;
+
+fail:
+  g_clear_pointer (&args, g_bytes_unref);
+  return NULL;
+}
+
+static GskRenderNode *
+reader_read_node (Reader            *self,
+                  GskRenderNodeType  node_type)
+{
+  switch (node_type)
+    {
+    case GSK_CONTAINER_NODE:
+      {
+        GskRenderNode **children;
+        GskRenderNode *result;
+        guint32 i, n;
+
+        n = reader_read_uint (self);
+        if (self->failed || !reader_check_array (self, n, 1))
+          return NULL;
+
+        children = g_new (GskRenderNode *, n);
+        for (i = 0; i < n; i++)
+          children[i] = reader_read_node_ref (self);
+
+        if (self->failed)
+          result = NULL;
+        else
+          result = gsk_container_node_new (children, n);
+
+        g_free (children);
+        return result;
+      }
+
+    case GSK_CAIRO_NODE:
+      return reader_read_cairo_node (self);
+
+    case GSK_COLOR_NODE:
+      {
+        graphene_rect_t bounds;
+        GdkRGBA color;
+
+        reader_read_rect (self, &bounds);
+        reader_read_rgba (self, &color);
+        if (self->failed)
+          return NULL;
+
+        return gsk_color_node_new (&color, &bounds);
+      }
+
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+      {
+        graphene_rect_t bounds;
+        graphene_point_t start, end;
+        GskColorStop *stops;
+        GskRenderNode *result;
+        gsize n_stops;
+
+        reader_read_rect (self, &bounds);
+        reader_read_point (self, &start);
+        reader_read_point (self, &end);
+        stops = reader_read_stops (self, &n_stops);
+        if (self->failed)
+          return NULL;
+
+        if (node_type == GSK_REPEATING_LINEAR_GRADIENT_NODE)
+          result = gsk_repeating_linear_gradient_node_new (&bounds, &start, &end, stops, n_stops);
+        else
+          result = gsk_linear_gradient_node_new (&bounds, &start, &end, stops, n_stops);
+
+        g_free (stops);
+        return result;
+      }
+
+    case GSK_RADIAL_GRADIENT_NODE:
+    case GSK_REPEATING_RADIAL_GRADIENT_NODE:
+      {
+        graphene_rect_t bounds;
+        graphene_point_t center;
+        float hradius, vradius, start, end;
+        GskColorStop *stops;
+        GskRenderNode *result;
+        gsize n_stops;
+
+        reader_read_rect (self, &bounds);
+        reader_read_point (self, &center);
+        hradius = reader_read_float (self);
+        vradius = reader_read_float (self);
+        start = reader_read_float (self);
+        end = reader_read_float (self);
+        if (self->failed)
+          return NULL;
+
+        if (!(hradius > 0 && vradius > 0 && start >= 0 && end > start))
+          {
+            reader_fail (self, "Invalid radial gradient parameters");
+            return NULL;
+          }
+
+        stops = reader_read_stops (self, &n_stops);
+        if (self->failed)
+          return NULL;
+
+        if (node_type == GSK_REPEATING_RADIAL_GRADIENT_NODE)
+          result = gsk_repeating_radial_gradient_node_new (&bounds, &center, hradius, vradius, start, end, stops, n_stops);
+        else
+          result = gsk_radial_gradient_node_new (&bounds, &center, hradius, vradius, start, end, stops, n_stops);
+
+        g_free (stops);
+        return result;
+      }
+
+    case GSK_CONIC_GRADIENT_NODE:
+      {
+        graphene_rect_t bounds;
+        graphene_point_t center;
+        float rotation;
+        GskColorStop *stops;
+        GskRenderNode *result;
+        gsize n_stops;
+
+        reader_read_rect (self, &bounds);
+        reader_read_point (self, &center);
+        rotation = reader_read_float (self);
+        stops = reader_read_stops (self, &n_stops);
+        if (self->failed)
+          return NULL;
+
+        result = gsk_conic_gradient_node_new (&bounds, &center, rotation, stops, n_stops);
+
+        g_free (stops);
+        return result;
+      }
+
+    case GSK_BORDER_NODE:
+      {
+        GskRoundedRect outline;
+        float widths[4];
+        GdkRGBA colors[4];
+        guint i;
+
+        reader_read_rounded_rect (self, &outline);
+        reader_read_floats (self, widths, 4);
+        for (i = 0; i < 4; i++)
+          reader_read_rgba (self, &colors[i]);
+        if (self->failed)
+          return NULL;
+
+        return gsk_border_node_new (&outline, widths, colors);
+      }
+
+    case GSK_TEXTURE_NODE:
+      {
+        graphene_rect_t bounds;
+        GdkTexture *texture;
+
+        reader_read_rect (self, &bounds);
+        texture = reader_read_texture (self);
+        if (self->failed)
+          return NULL;
+
+        return gsk_texture_node_new (texture, &bounds);
+      }
+
+    case GSK_TEXTURE_SCALE_NODE:
+      {
+        graphene_rect_t bounds;
+        GdkTexture *texture;
+        GskScalingFilter filter;
+
+        reader_read_rect (self, &bounds);
+        texture = reader_read_texture (self);
+        filter = reader_read_enum (self, GSK_SCALING_FILTER_TRILINEAR, "scaling filter");
+        if (self->failed)
+          return NULL;
+
+        return gsk_texture_scale_node_new (texture, &bounds, filter);
+      }
+
+    case GSK_INSET_SHADOW_NODE:
+    case GSK_OUTSET_SHADOW_NODE:
+      {
+        GskRoundedRect outline;
+        GdkRGBA color;
+        float dx, dy, spread, blur;
+
+        reader_read_rounded_rect (self, &outline);
+        reader_read_rgba (self, &color);
+        dx = reader_read_float (self);
+        dy = reader_read_float (self);
+        spread = reader_read_float (self);
+        blur = reader_read_float (self);
+        if (self->failed)
+          return NULL;
+
+        if (!(blur >= 0))
+          {
+            reader_fail (self, "Invalid blur radius");
+            return NULL;
+          }
+
+        if (node_type == GSK_INSET_SHADOW_NODE)
+          return gsk_inset_shadow_node_new (&outline, &color, dx, dy, spread, blur);
+        else
+          return gsk_outset_shadow_node_new (&outline, &color, dx, dy, spread, blur);
+      }
+
+    case GSK_TRANSFORM_NODE:
+      {
+        GskTransform *transform;
+        GskRenderNode *child, *result;
+
+        transform = reader_read_transform (self);
+        child = reader_read_node_ref (self);
+        if (self->failed)
+          {
+            gsk_transform_unref (transform);
+            return NULL;
+          }
+
+        result = gsk_transform_node_new (child, transform);
+        gsk_transform_unref (transform);
+
+        return result;
+      }
+
+    case GSK_OPACITY_NODE:
+      {
+        GskRenderNode *child;
+        float opacity;
+
+        opacity = reader_read_float (self);
+        child = reader_read_node_ref (self);
+        if (self->failed)
+          return NULL;
+
+        return gsk_opacity_node_new (child, opacity);
+      }
+
+    case GSK_COLOR_MATRIX_NODE:
+      {
+        graphene_matrix_t matrix;
+        graphene_vec4_t offset;
+        GskRenderNode *child;
+        float values[16];
+
+        reader_read_floats (self, values, 16);
+        graphene_matrix_init_from_float (&matrix, values);
+        reader_read_floats (self, values, 4);
+        graphene_vec4_init_from_float (&offset, values);
+        child = reader_read_node_ref (self);
+        if (self->failed)
+          return NULL;
+
+        return gsk_color_matrix_node_new (child, &matrix, &offset);
+      }
+
+    case GSK_REPEAT_NODE:
+      {
+        graphene_rect_t bounds, child_bounds;
+        GskRenderNode *child;
+
+        reader_read_rect (self, &bounds);
+        reader_read_rect (self, &child_bounds);
+        child = reader_read_node_ref (self);
+        if (self->failed)
+          return NULL;
+
+        return gsk_repeat_node_new (&bounds, child, &child_bounds);
+      }
+
+    case GSK_CLIP_NODE:
+      {
+        graphene_rect_t clip;
+        GskRenderNode *child;
+
+        reader_read_rect (self, &clip);
+        child = reader_read_node_ref (self);
+        if (self->failed)
+          return NULL;
+
+        return gsk_clip_node_new (child, &clip);
+      }
+
+    case GSK_ROUNDED_CLIP_NODE:
+      {
+        GskRoundedRect clip;
+        GskRenderNode *child;
+
+        reader_read_rounded_rect (self, &clip);
+        child = reader_read_node_ref (self);
+        if (self->failed)
+          return NULL;
+
+        return gsk_rounded_clip_node_new (child, &clip);
+      }
+
+    case GSK_SHADOW_NODE:
+      {
+        GskShadow *shadows;
+        GskRenderNode *child, *result;
+        guint32 i, n;
+
+        n = reader_read_uint (self);
+        if (self->failed || !reader_check_array (self, n, 7))
+          return NULL;
+
+        if (n == 0)
+          {
+            reader_fail (self, "Shadow nodes need at least one shadow");
+            return NULL;
+          }
+
+        shadows = g_new (GskShadow, n);
+        for (i = 0; i < n; i++)
+          {
+            reader_read_rgba (self, &shadows[i].color);
+            shadows[i].dx = reader_read_float (self);
+            shadows[i].dy = reader_read_float (self);
+            shadows[i].radius = reader_read_float (self);
+          }
+        child = reader_read_node_ref (self);
+
+        if (self->failed)
+          result = NULL;
+        else
+          result = gsk_shadow_node_new (child, shadows, n);
+
+        g_free (shadows);
+        return result;
+      }
+
+    case GSK_BLEND_NODE:
+      {
+        GskBlendMode mode;
+        GskRenderNode *bottom, *top;
+
+        mode = reader_read_enum (self, GSK_BLEND_MODE_LUMINOSITY, "blend mode");
+        bottom = reader_read_node_ref (self);
+        top = reader_read_node_ref (self);
+        if (self->failed)
+          return NULL;
+
+        return gsk_blend_node_new (bottom, top, mode);
+      }
+
+    case GSK_CROSS_FADE_NODE:
+      {
+        GskRenderNode *start, *end;
+        float progress;
+
+        progress = reader_read_float (self);
+        start = reader_read_node_ref (self);
+        end = reader_read_node_ref (self);
+        if (self->failed)
+          return NULL;
+
+        return gsk_cross_fade_node_new (start, end, progress);
+      }
+
+    case GSK_TEXT_NODE:
+      return reader_read_text_node (self);
+
+    case GSK_BLUR_NODE:
+      {
+        GskRenderNode *child;
+        float radius;
+
+        radius = reader_read_float (self);
+        child = reader_read_node_ref (self);
+        if (self->failed)
+          return NULL;
+
+        if (!(radius >= 0))
+          {
+            reader_fail (self, "Invalid blur radius");
+            return NULL;
+          }
+
+        return gsk_blur_node_new (child, radius);
+      }
+
+    case GSK_DEBUG_NODE:
+      {
+        GskRenderNode *child;
+        const char *message;
+        guint32 index;
+
+        index = reader_read_uint (self);
+        child = reader_read_node_ref (self);
+        if (self->failed)
+          return NULL;
+
+        if (index != BINARY_NONE)
+          {
+            message = reader_get_string (self, index);
+            if (message == NULL)
+              return NULL;
+          }
+        else
+          message = NULL;
+
+        return gsk_debug_node_new (child, g_strdup (message));
+      }
+
+    case GSK_GL_SHADER_NODE:
+      return reader_read_gl_shader_node (self);
+
+    case GSK_MASK_NODE:
+      {
+        GskMaskMode mode;
+        GskRenderNode *source, *mask;
+
+        mode = reader_read_enum (self, GSK_MASK_MODE_INVERTED_LUMINANCE, "mask mode");
+        source = reader_read_node_ref (self);
+        mask = reader_read_node_ref (self);
+        if (self->failed)
+          return NULL;
+
+        return gsk_mask_node_new (source, mask, mode);
+      }
+
+    case GSK_FILL_NODE:
+      {
+        GskPath *path;
+        GskFillRule fill_rule;
+        GskRenderNode *child;
+
+        path = reader_read_path (self);
+        fill_rule = reader_read_enum (self, GSK_FILL_RULE_EVEN_ODD, "fill rule");
+        child = reader_read_node_ref (self);
+        if (self->failed)
+          return NULL;
+
+        return gsk_fill_node_new (child, path, fill_rule);
+      }
+
+    case GSK_STROKE_NODE:
+      {
+        GskPath *path;
+        GskStroke *stroke;
+        GskRenderNode *child, *result;
+        float line_width, miter_limit, dash_offset;
+        GskLineCap line_cap;
+        GskLineJoin line_join;
+        float dash[64];
+        float *dashes;
+        guint32 i, n_dash;
+
+        path = reader_read_path (self);
+        line_width = reader_read_float (self);
+        line_cap = reader_read_enum (self, GSK_LINE_CAP_SQUARE, "line cap");
+        line_join = reader_read_enum (self, GSK_LINE_JOIN_BEVEL, "line join");
+        miter_limit = reader_read_float (self);
+        dash_offset = reader_read_float (self);
+        n_dash = reader_read_uint (self);
+        if (self->failed || !reader_check_array (self, n_dash, 1))
+          return NULL;
+
+        if (!(line_width > 0) || !(miter_limit >= 0))
+          {
+            reader_fail (self, "Invalid stroke parameters");
+            return NULL;
+          }
+
+        dashes = n_dash <= G_N_ELEMENTS (dash) ? dash : g_new (float, n_dash);
+        reader_read_floats (self, dashes, n_dash);
+        for (i = 0; i < n_dash; i++)
+          {
+            if (!(dashes[i] >= 0))
+              reader_fail (self, "Invalid dash length");
+          }
+        child = reader_read_node_ref (self);
+
+        if (self->failed)
+          {
+            result = NULL;
+          }
+        else
+          {
+            stroke = gsk_stroke_new (line_width);
+            gsk_stroke_set_line_cap (stroke, line_cap);
+            gsk_stroke_set_line_join (stroke, line_join);
+            gsk_stroke_set_miter_limit (stroke, miter_limit);
+            gsk_stroke_set_dash (stroke, dashes, n_dash);
+            gsk_stroke_set_dash_offset (stroke, dash_offset);
+
+            result = gsk_stroke_node_new (child, path, stroke);
+
+            gsk_stroke_free (stroke);
+          }
+
+        if (dashes != dash)
+          g_free (dashes);
+
+        return result;
+      }
+
+    case GSK_SUBSURFACE_NODE:
+      {
+        GskRenderNode *child;
+
+        child = reader_read_node_ref (self);
+        if (self->failed)
+          return NULL;
+
+        return gsk_subsurface_node_new (child, NULL);
+      }
+
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      reader_fail (self, "Unknown node type %u", node_type);
+      return NULL;
+    }
+}
+
+static gboolean
+reader_init (Reader            *self,
+             GBytes            *bytes,
+             GskParseErrorFunc  error_func,
+             gpointer           user_data)
+{
+  BinaryHeader header;
+  guint64 nodes_offset, nodes_size, blobs_offset, textures_offset;
+  guint32 i;
+
+  memset (self, 0, sizeof (Reader));
+  self->bytes = bytes;
+  self->data = g_bytes_get_data (bytes, &self->size);
+  self->error_func = error_func;
+  self->user_data = user_data;
+
+  if (self->size < BINARY_NODES_OFFSET)
+    {
+      reader_fail (self, "File is too short");
+      return FALSE;
+    }
+
+  memcpy (&header, self->data, sizeof (BinaryHeader));
+  if (GUINT32_FROM_LE (header.version) != BINARY_VERSION)
+    {
+      reader_fail_with_code (self, GSK_SERIALIZATION_UNSUPPORTED_VERSION,
+                             "Unsupported version %u", GUINT32_FROM_LE (header.version));
+      return FALSE;
+    }
+
+  nodes_offset = GUINT64_FROM_LE (header.nodes_offset);
+  nodes_size = GUINT64_FROM_LE (header.nodes_size);
+  blobs_offset = GUINT64_FROM_LE (header.blobs_offset);
+  textures_offset = GUINT64_FROM_LE (header.textures_offset);
+  self->n_blobs = GUINT32_FROM_LE (header.n_blobs);
+  self->n_textures = GUINT32_FROM_LE (header.n_textures);
+
+  if (nodes_offset > self->size || self->size - nodes_offset < nodes_size ||
+      blobs_offset > self->size || (self->size - blobs_offset) / sizeof (BinaryBlob) < self->n_blobs ||
+      textures_offset > self->size || (self->size - textures_offset) / sizeof (BinaryTexture) < self->n_textures)
+    {
+      reader_fail (self, "File is truncated or damaged");
+      return FALSE;
+    }
+
+  self->blobs_offset = blobs_offset;
+  for (i = 0; i < self->n_blobs; i++)
+    {
+      BinaryBlob entry;
+
+      reader_get_blob_entry (self, i, &entry);
+      if (entry.offset > self->size || self->size - entry.offset < entry.size)
+        {
+          reader_fail (self, "Data %u is outside of the file", i);
+          return FALSE;
+        }
+    }
+
+  self->textures_offset = textures_offset;
+  self->textures = g_new0 (GdkTexture *, self->n_textures);
+
+  /* Don't trust the node count before we've seen the nodes,
+   * every node needs at least 8 bytes.
+   */
+  self->expected_nodes = GUINT32_FROM_LE (header.n_nodes);
+  self->nodes = g_new (GskRenderNode *, MIN (self->expected_nodes, nodes_size / 8));
+
+  self->start = self->pos = nodes_offset;
+  self->end = nodes_offset + nodes_size;
+
+  self->transforms = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) gsk_transform_unref);
+  self->paths = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) gsk_path_unref);
+  self->shaders = g_hash_table_new_full (NULL, NULL, NULL, g_object_unref);
+  self->fonts = g_hash_table_new_full (font_key_hash, font_key_equal, g_free, g_object_unref);
+  self->font_files = g_hash_table_new (NULL, NULL);
+
+  return TRUE;
+}
+
+/*<private>
+ * gsk_render_node_is_binary:
+ * @bytes: serialized render node data
+ *
+ * Checks if @bytes is in the binary format.
+ *
+ * Returns: %TRUE if @bytes should be loaded with
+ *   gsk_render_node_deserialize_binary()
+ */
+gboolean
+gsk_render_node_is_binary (GBytes *bytes)
+{
+  const guint8 *data;
+  gsize size;
+
+  data = g_bytes_get_data (bytes, &size);
+
+  return size >= BINARY_MAGIC_SIZE && memcmp (data, BINARY_MAGIC, BINARY_MAGIC_SIZE) == 0;
+}
+
+/*<private>
+ * gsk_render_node_deserialize_binary:
+ * @bytes: data created by gsk_render_node_serialize_binary()
+ * @error_func: (nullable) (scope call): Callback on errors
+ * @user_data: (closure error_func): user_data for @error_func
+ *
+ * Loads a node from the binary format.
+ *
+ * Textures reference @bytes, so if the data is mapped from a file,
+ * pixel data will not be copied.
+ *
+ * Unlike the text parser, this gives up on the first error
+ * in the file structure and returns %NULL.
+ *
+ * Returns: (nullable) (transfer full): the loaded node
+ */
+GskRenderNode *
+gsk_render_node_deserialize_binary (GBytes            *bytes,
+                                    GskParseErrorFunc  error_func,
+                                    gpointer           user_data)
+{
+  GskRenderNode *result;
+  Reader reader;
+  gsize nodes_end;
+
+  if (!reader_init (&reader, bytes, error_func, user_data))
+    {
+      reader_clear (&reader);
+      return NULL;
+    }
+
+  nodes_end = reader.end;
+
+  while (reader.n_nodes < reader.expected_nodes && reader.pos < nodes_end)
+    {
+      GskRenderNodeType node_type;
+      guint32 size;
+      GskRenderNode *node;
+
+      reader.start = reader.pos;
+      reader.end = nodes_end;
+      node_type = reader_read_uint (&reader);
+      size = reader_read_uint (&reader);
+      if (reader.failed)
+        break;
+
+      if (size > nodes_end - reader.pos)
+        {
+          reader_fail (&reader, "Node data is truncated");
+          break;
+        }
+      reader.end = reader.pos + size;
+
+      node = reader_read_node (&reader, node_type);
+      if (node == NULL)
+        {
+          reader_fail (&reader, "Failed to create node");
+          break;
+        }
+
+      reader.nodes[reader.n_nodes++] = node;
+
+      if (reader.pos != reader.end)
+        {
+          reader_fail (&reader, "Unexpected data at the end of the node");
+          break;
+        }
+    }
+
+  if (!reader.failed && (reader.n_nodes == 0 || reader.n_nodes != reader.expected_nodes))
+    {
+      reader.start = reader.pos;
+      reader_fail (&reader, "File is truncated");
+    }
+
+  if (reader.failed)
+    result = NULL;
+  else
+    result = gsk_render_node_ref (reader.nodes[reader.n_nodes - 1]);
+
+  reader_clear (&reader);
+
+  return result;
+}
+
+/* }}} */
+
+/* vim:set foldmethod=marker expandtab: */
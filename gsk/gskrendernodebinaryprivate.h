@@ -0,0 +1,17 @@
+
+#pragma once
+
+#include "gskrendernode.h"
+
+G_BEGIN_DECLS
+
+#define GSK_RENDER_NODE_BINARY_SUFFIX ".bnode"
+
+GBytes *        gsk_render_node_serialize_binary        (GskRenderNode     *node);
+
+gboolean        gsk_render_node_is_binary               (GBytes            *bytes);
+GskRenderNode * gsk_render_node_deserialize_binary      (GBytes            *bytes,
+                                                         GskParseErrorFunc  error_func,
+                                                         gpointer           user_data);
+
+G_END_DECLS
@@ -1694,6 +1694,62 @@ gsk_texture_node_finalize (GskRenderNode *node)
   parent_class->finalize (node);
 }
 
+static const cairo_user_data_key_t texture_surfaces_key;
+static const cairo_user_data_key_t shared_surface_key;
+
+/*<private>
+ * gsk_cairo_surface_set_texture_surfaces:
+ * @surface: the target surface
+ * @textures: (element-type GdkTexture cairo_surface_t): image surfaces
+ *   with the contents of the textures
+ *
+ * Makes texture nodes drawn to @surface use the given image surfaces
+ * instead of downloading the textures again.
+ *
+ * The tiled drawing of the cairo renderer uses this to only download
+ * every texture once per frame. @textures is only read, so it can be
+ * shared between surfaces that are drawn to from different threads.
+ * It must stay alive as long as it is set on @surface.
+ */
+void
+gsk_cairo_surface_set_texture_surfaces (cairo_surface_t *surface,
+                                        GHashTable      *textures)
+{
+  cairo_surface_set_user_data (surface, &texture_surfaces_key, textures, NULL);
+}
+
+static cairo_surface_t *
+gsk_texture_get_cairo_surface (GdkTexture *texture,
+                               cairo_t    *cr)
+{
+  GHashTable *textures;
+  cairo_surface_t *shared, *surface;
+
+  textures = cairo_surface_get_user_data (cairo_get_target (cr), &texture_surfaces_key);
+  if (textures == NULL)
+    return gdk_texture_download_surface (texture);
+
+  shared = g_hash_table_lookup (textures, texture);
+  if (shared == NULL)
+    return gdk_texture_download_surface (texture);
+
+  /* Using the same image surface as a source from several threads
+   * is not safe in cairo, so every user gets its own surface for the
+   * shared pixels.
+   */
+  surface = cairo_image_surface_create_for_data (cairo_image_surface_get_data (shared),
+                                                 cairo_image_surface_get_format (shared),
+                                                 cairo_image_surface_get_width (shared),
+                                                 cairo_image_surface_get_height (shared),
+                                                 cairo_image_surface_get_stride (shared));
+  cairo_surface_set_user_data (surface,
+                               &shared_surface_key,
+                               cairo_surface_reference (shared),
+                               (cairo_destroy_func_t) cairo_surface_destroy);
+
+  return surface;
+}
+
 static void
 gsk_texture_node_draw_oversized (GskRenderNode *node,
                                  cairo_t       *cr)
@@ -1769,7 +1825,7 @@ gsk_texture_node_draw (GskRenderNode *node,
       return;
     }
 
-  surface = gdk_texture_download_surface (self->texture);
+  surface = gsk_texture_get_cairo_surface (self->texture, cr);
   pattern = cairo_pattern_create_for_surface (surface);
   cairo_pattern_set_extend (pattern, CAIRO_EXTEND_PAD);
 
@@ -1945,7 +2001,7 @@ gsk_texture_scale_node_draw (GskRenderNode *node,
   cairo_surface_set_device_offset (surface2, -clip_rect.origin.x, -clip_rect.origin.y);
   cr2 = cairo_create (surface2);
 
-  surface = gdk_texture_download_surface (self->texture);
+  surface = gsk_texture_get_cairo_surface (self->texture, cr);
   pattern = cairo_pattern_create_for_surface (surface);
   cairo_pattern_set_extend (pattern, CAIRO_EXTEND_PAD);
 
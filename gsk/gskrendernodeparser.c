@@ -317,6 +317,54 @@ csi_hooks_context_destroy (void *closure,
   cairo_destroy (cr);
 }
 
+#ifdef HAVE_CAIRO_SCRIPT_INTERPRETER
+/*<private>
+ * gsk_render_node_parser_run_script:
+ * @bytes: a Cairo script
+ * @error: return location for an error
+ *
+ * Replays the script into a new recording surface.
+ *
+ * Returns: (nullable) (transfer full): the recording surface
+ */
+cairo_surface_t *
+gsk_render_node_parser_run_script (GBytes  *bytes,
+                                   GError **error)
+{
+  cairo_script_interpreter_t *csi;
+  cairo_script_interpreter_hooks_t hooks = {
+    .surface_create = csi_hooks_surface_create,
+    .context_create = csi_hooks_context_create,
+    .context_destroy = csi_hooks_context_destroy,
+  };
+
+  hooks.closure = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA, NULL);
+  csi = cairo_script_interpreter_create ();
+  cairo_script_interpreter_install_hooks (csi, &hooks);
+  cairo_script_interpreter_feed_string (csi, g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes));
+  if (cairo_surface_status (hooks.closure) != CAIRO_STATUS_SUCCESS)
+    {
+      g_set_error (error,
+                   GTK_CSS_PARSER_ERROR,
+                   GTK_CSS_PARSER_ERROR_UNKNOWN_VALUE,
+                   "Invalid Cairo script: %s", cairo_status_to_string (cairo_surface_status (hooks.closure)));
+      cairo_script_interpreter_destroy (csi);
+      return NULL;
+    }
+  if (cairo_script_interpreter_destroy (csi) != CAIRO_STATUS_SUCCESS)
+    {
+      g_set_error (error,
+                   GTK_CSS_PARSER_ERROR,
+                   GTK_CSS_PARSER_ERROR_UNKNOWN_VALUE,
+                   "Invalid Cairo script");
+      cairo_surface_destroy (hooks.closure);
+      return NULL;
+    }
+
+  return hooks.closure;
+}
+#endif
+
 static gboolean
 parse_script (GtkCssParser *parser,
               Context      *context,
@@ -327,12 +375,7 @@ parse_script (GtkCssParser *parser,
   GBytes *bytes;
   GtkCssLocation start_location;
   char *url, *scheme;
-  cairo_script_interpreter_t *csi;
-  cairo_script_interpreter_hooks_t hooks = {
-    .surface_create = csi_hooks_surface_create,
-    .context_create = csi_hooks_context_create,
-    .context_destroy = csi_hooks_context_destroy,
-  };
+  cairo_surface_t *surface;
 
   start_location = *gtk_css_parser_get_start_location (parser);
   url = gtk_css_parser_consume_url (parser);
@@ -377,25 +420,19 @@ parse_script (GtkCssParser *parser,
       return FALSE;
     }
 
-  hooks.closure = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA, NULL);
-  csi = cairo_script_interpreter_create ();
-  cairo_script_interpreter_install_hooks (csi, &hooks);
-  cairo_script_interpreter_feed_string (csi, g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes));
+  surface = gsk_render_node_parser_run_script (bytes, &error);
   g_bytes_unref (bytes);
-  if (cairo_surface_status (hooks.closure) != CAIRO_STATUS_SUCCESS)
+  if (surface == NULL)
     {
-      gtk_css_parser_error_value (parser, "Invalid Cairo script: %s", cairo_status_to_string (cairo_surface_status (hooks.closure)));
-      cairo_script_interpreter_destroy (csi);
-      return FALSE;
-    }
-  if (cairo_script_interpreter_destroy (csi) != CAIRO_STATUS_SUCCESS)
-    {
-      gtk_css_parser_error_value (parser, "Invalid Cairo script");
-      cairo_surface_destroy (hooks.closure);
+      gtk_css_parser_emit_error (parser,
+                                 &start_location,
+                                 gtk_css_parser_get_end_location (parser),
+                                 error);
+      g_clear_error (&error);
       return FALSE;
     }
 
-  *(cairo_surface_t **) out_data = hooks.closure;
+  *(cairo_surface_t **) out_data = surface;
   return TRUE;
 #else
   gtk_css_parser_warn (parser,
@@ -888,10 +925,20 @@ parse_mask_mode (GtkCssParser *parser,
   return FALSE;
 }
 
-static PangoFont *
-font_from_string (PangoFontMap *fontmap,
-                  const char   *string,
-                  gboolean      allow_fallback)
+/*<private>
+ * gsk_render_node_parser_font_from_string:
+ * @fontmap: the fontmap to look up the font in
+ * @string: a font description, as a string
+ * @allow_fallback: whether to accept a font from a different family
+ *
+ * Loads the font described by @string from @fontmap.
+ *
+ * Returns: (nullable) (transfer full): the font
+ */
+PangoFont *
+gsk_render_node_parser_font_from_string (PangoFontMap *fontmap,
+                                         const char   *string,
+                                         gboolean      allow_fallback)
 {
   PangoFontDescription *desc;
   PangoContext *ctx;
@@ -999,45 +1046,45 @@ delete_file (gpointer data)
 }
 
 static void
-ensure_fontmap (Context *context)
+ensure_fontmap (PangoFontMap **fontmap)
 {
   FcConfig *config;
   GPtrArray *files;
 
-  if (context->fontmap)
+  if (*fontmap)
     return;
 
-  context->fontmap = pango_cairo_font_map_new ();
+  *fontmap = pango_cairo_font_map_new ();
 
   config = FcInitLoadConfig ();
-  pango_fc_font_map_set_config (PANGO_FC_FONT_MAP (context->fontmap), config);
+  pango_fc_font_map_set_config (PANGO_FC_FONT_MAP (*fontmap), config);
   FcConfigDestroy (config);
 
   files = g_ptr_array_new_with_free_func (delete_file);
 
-  g_object_set_data_full (G_OBJECT (context->fontmap), "font-files", files, (GDestroyNotify) g_ptr_array_unref);
+  g_object_set_data_full (G_OBJECT (*fontmap), "font-files", files, (GDestroyNotify) g_ptr_array_unref);
 }
 
 static gboolean
-add_font_from_file (Context     *context,
-                    const char  *path,
-                    GError     **error)
+add_font_from_file (PangoFontMap **fontmap,
+                    const char    *path,
+                    GError       **error)
 {
   FcConfig *config;
   GPtrArray *files;
 
-  ensure_fontmap (context);
+  ensure_fontmap (fontmap);
 
-  if (!PANGO_IS_FC_FONT_MAP (context->fontmap))
+  if (!PANGO_IS_FC_FONT_MAP (*fontmap))
     {
       g_set_error (error,
                    GTK_CSS_PARSER_ERROR,
                    GTK_CSS_PARSER_ERROR_FAILED,
-                   "Custom fonts are not implemented for %s", G_OBJECT_TYPE_NAME (context->fontmap));
+                   "Custom fonts are not implemented for %s", G_OBJECT_TYPE_NAME (*fontmap));
       return FALSE;
     }
 
-  config = pango_fc_font_map_get_config (PANGO_FC_FONT_MAP (context->fontmap));
+  config = pango_fc_font_map_get_config (PANGO_FC_FONT_MAP (*fontmap));
 
   if (!FcConfigAppFontAddFile (config, (FcChar8 *) path))
     {
@@ -1048,18 +1095,29 @@ add_font_from_file (Context     *context,
       return FALSE;
     }
 
-  files = (GPtrArray *) g_object_get_data (G_OBJECT (context->fontmap), "font-files");
+  files = (GPtrArray *) g_object_get_data (G_OBJECT (*fontmap), "font-files");
   g_ptr_array_add (files, g_strdup (path));
 
-  pango_fc_font_map_config_changed (PANGO_FC_FONT_MAP (context->fontmap));
+  pango_fc_font_map_config_changed (PANGO_FC_FONT_MAP (*fontmap));
 
   return TRUE;
 }
 
-static gboolean
-add_font_from_bytes (Context  *context,
-                     GBytes   *bytes,
-                     GError  **error)
+/*<private>
+ * gsk_render_node_parser_add_font_from_bytes:
+ * @fontmap: (inout): the fontmap for custom fonts, created on demand
+ * @bytes: the contents of a font file
+ * @error: return location for an error
+ *
+ * Makes the fonts in @bytes available in @fontmap, so that
+ * they can be looked up by name afterwards.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+gsk_render_node_parser_add_font_from_bytes (PangoFontMap **fontmap,
+                                            GBytes        *bytes,
+                                            GError       **error)
 {
   GFile *file;
   GIOStream *iostream;
@@ -1082,7 +1140,7 @@ add_font_from_bytes (Context  *context,
   g_io_stream_close (iostream, NULL, NULL);
   g_object_unref (iostream);
 
-  result = add_font_from_file (context, g_file_peek_path (file), error);
+  result = add_font_from_file (fontmap, g_file_peek_path (file), error);
 
   g_object_unref (file);
 
@@ -1091,10 +1149,10 @@ add_font_from_bytes (Context  *context,
 
 #else /* !HAVE_PANGOFT */
 
-static gboolean
-add_font_from_bytes (Context  *context,
-                     GBytes   *bytes,
-                     GError  **error)
+gboolean
+gsk_render_node_parser_add_font_from_bytes (PangoFontMap **fontmap,
+                                            GBytes        *bytes,
+                                            GError       **error)
 {
   g_set_error (error,
                GTK_CSS_PARSER_ERROR,
@@ -1118,7 +1176,7 @@ parse_font (GtkCssParser *parser,
     return FALSE;
 
   if (context->fontmap)
-    font = font_from_string (context->fontmap, font_name, FALSE);
+    font = gsk_render_node_parser_font_from_string (context->fontmap, font_name, FALSE);
 
   if (gtk_css_parser_has_url (parser))
     {
@@ -1162,7 +1220,7 @@ parse_font (GtkCssParser *parser,
               g_free (url);
               if (bytes != NULL)
                 {
-                  success = add_font_from_bytes (context, bytes, &error);
+                  success = gsk_render_node_parser_add_font_from_bytes (&context->fontmap, bytes, &error);
                   g_bytes_unref (bytes);
                 }
 
@@ -1177,7 +1235,7 @@ parse_font (GtkCssParser *parser,
 
           if (success)
             {
-              font = font_from_string (context->fontmap, font_name, FALSE);
+              font = gsk_render_node_parser_font_from_string (context->fontmap, font_name, FALSE);
               if (!font)
                 {
                   gtk_css_parser_error (parser,
@@ -1193,7 +1251,7 @@ parse_font (GtkCssParser *parser,
   else
     {
       if (!font)
-        font = font_from_string (pango_cairo_font_map_get_default (), font_name, TRUE);
+        font = gsk_render_node_parser_font_from_string (pango_cairo_font_map_get_default (), font_name, TRUE);
 
       if (!font)
         gtk_css_parser_error_value (parser, "The font \"%s\" does not exist", font_name);
@@ -2341,7 +2399,7 @@ parse_text_node (GtkCssParser *parser,
 
   if (font == NULL)
     {
-      font = font_from_string (pango_cairo_font_map_get_default (), "Cantarell 15px", TRUE);
+      font = gsk_render_node_parser_font_from_string (pango_cairo_font_map_get_default (), "Cantarell 15px", TRUE);
       g_assert (font);
     }
 
@@ -3446,6 +3504,70 @@ cairo_destroy_array (gpointer array)
   g_byte_array_free (array, TRUE);
 }
 
+/*<private>
+ * gsk_render_node_printer_save_cairo_pixels:
+ * @surface: the surface of a Cairo node
+ *
+ * Renders @surface and saves the result as PNG.
+ *
+ * Returns: (transfer full): the PNG data
+ */
+GBytes *
+gsk_render_node_printer_save_cairo_pixels (cairo_surface_t *surface)
+{
+  GByteArray *array;
+
+  array = g_byte_array_new ();
+  cairo_surface_write_to_png_stream (surface, cairo_write_array, array);
+
+  return g_byte_array_free_to_bytes (array);
+}
+
+/*<private>
+ * gsk_render_node_printer_save_cairo_script:
+ * @surface: the surface of a Cairo node
+ *
+ * Saves the drawing operations recorded in @surface as
+ * a Cairo script.
+ *
+ * Returns: (nullable) (transfer full): the script or %NULL if
+ *   @surface is not a recording surface
+ */
+GBytes *
+gsk_render_node_printer_save_cairo_script (cairo_surface_t *surface)
+{
+#ifdef CAIRO_HAS_SCRIPT_SURFACE
+  static const cairo_user_data_key_t cairo_is_stupid_key;
+  cairo_device_t *script;
+  GByteArray *array;
+  GBytes *result;
+
+  if (cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_RECORDING)
+    return NULL;
+
+  array = g_byte_array_new ();
+  script = cairo_script_create_for_stream (cairo_write_array, array);
+
+  if (cairo_script_from_recording_surface (script, surface) == CAIRO_STATUS_SUCCESS)
+    result = g_bytes_new (array->data, array->len);
+  else
+    result = NULL;
+
+  /* because Cairo is stupid and writes to the device after we finished it,
+   * we can't just
+  g_byte_array_free (array, TRUE);
+   * but have to
+   */
+  g_byte_array_set_size (array, 0);
+  cairo_device_set_user_data (script, &cairo_is_stupid_key, array, cairo_destroy_array);
+  cairo_device_destroy (script);
+
+  return result;
+#else
+  return NULL;
+#endif
+}
+
 static void
 append_escaping_newlines (GString    *str,
                           const char *string)
@@ -3565,81 +3687,128 @@ append_texture_param (Printer    *p,
   g_bytes_unref (bytes);
 }
 
-static void
-gsk_text_node_serialize_font (GskRenderNode *node,
-                              Printer       *p)
+/*<private>
+ * gsk_render_node_printer_get_font_file:
+ * @font: a font
+ *
+ * Finds the file that @font was loaded from, if it is a custom
+ * font that was created from a url.
+ *
+ * Returns: (nullable): the path of the font file
+ */
+const char *
+gsk_render_node_printer_get_font_file (PangoFont *font)
 {
-  PangoFont *font = gsk_text_node_get_font (node);
   PangoFontMap *fontmap = pango_font_get_font_map (font);
-  PangoFontDescription *desc;
-  char *s;
-
-  desc = pango_font_describe_with_absolute_size (font);
-  s = pango_font_description_to_string (desc);
-  g_string_append_printf (p->str, "\"%s\"", s);
-  g_free (s);
-  pango_font_description_free (desc);
 
   /* Check if this is  a custom font that we created from a url */
   if (!g_object_get_data (G_OBJECT (fontmap), "font-files"))
-    return;
+    return NULL;
 
 #ifdef HAVE_PANGOFT
   {
     FcPattern *pat;
     FcResult res;
     const char *file;
-    char *data;
-    gsize len;
-    char *b64;
 
     pat = pango_fc_font_get_pattern (PANGO_FC_FONT (font));
     res = FcPatternGetString (pat, FC_FILE, 0, (FcChar8 **)&file);
     if (res != FcResultMatch)
-      return;
+      return NULL;
 
-    if (g_hash_table_contains (p->serialized_fonts, file))
-      return;
+    return file;
+  }
+#else
+  return NULL;
+#endif
+}
 
-    if (!g_file_get_contents (file, &data, &len, NULL))
-      return;
+static void
+gsk_text_node_serialize_font (GskRenderNode *node,
+                              Printer       *p)
+{
+  PangoFont *font = gsk_text_node_get_font (node);
+  PangoFontDescription *desc;
+  const char *file;
+  char *s;
+  char *data;
+  gsize len;
+  char *b64;
 
-    g_hash_table_add (p->serialized_fonts, (gpointer) file);
+  desc = pango_font_describe_with_absolute_size (font);
+  s = pango_font_description_to_string (desc);
+  g_string_append_printf (p->str, "\"%s\"", s);
+  g_free (s);
+  pango_font_description_free (desc);
 
-    b64 = base64_encode_with_linebreaks ((const guchar *) data, len);
+  file = gsk_render_node_printer_get_font_file (font);
+  if (file == NULL)
+    return;
 
-    g_string_append (p->str, " url(\"data:font/ttf;base64,");
-    append_escaping_newlines (p->str, b64);
-    g_string_append (p->str, "\")");
+  if (g_hash_table_contains (p->serialized_fonts, file))
+    return;
 
-    g_free (b64);
-    g_free (data);
-  }
-#endif
+  if (!g_file_get_contents (file, &data, &len, NULL))
+    return;
+
+  g_hash_table_add (p->serialized_fonts, (gpointer) file);
+
+  b64 = base64_encode_with_linebreaks ((const guchar *) data, len);
+
+  g_string_append (p->str, " url(\"data:font/ttf;base64,");
+  append_escaping_newlines (p->str, b64);
+  g_string_append (p->str, "\")");
+
+  g_free (b64);
+  g_free (data);
 }
 
-static void
-gsk_text_node_serialize_font_options (GskRenderNode *node,
-                                      Printer       *p)
+/*<private>
+ * gsk_render_node_printer_get_font_options:
+ * @font: a font
+ * @hint_style: (out): return location for the hint style
+ * @antialias: (out): return location for the antialias mode
+ *
+ * Gets the font options of @font, reduced to the values that
+ * the parser accepts.
+ */
+void
+gsk_render_node_printer_get_font_options (PangoFont          *font,
+                                          cairo_hint_style_t *hint_style,
+                                          cairo_antialias_t  *antialias)
 {
-  PangoFont *font = gsk_text_node_get_font (node);
   cairo_scaled_font_t *sf = pango_cairo_font_get_scaled_font (PANGO_CAIRO_FONT (font));
   cairo_font_options_t *options;
-  cairo_hint_style_t hint_style;
-  cairo_antialias_t antialias;
 
   options = cairo_font_options_create ();
   cairo_scaled_font_get_font_options (sf, options);
-  hint_style = cairo_font_options_get_hint_style (options);
-  antialias = cairo_font_options_get_antialias (options);
+  *hint_style = cairo_font_options_get_hint_style (options);
+  *antialias = cairo_font_options_get_antialias (options);
   cairo_font_options_destroy (options);
 
   /* medium and full are identical in the absence of subpixel modes */
-  if (hint_style == CAIRO_HINT_STYLE_MEDIUM)
-    hint_style = CAIRO_HINT_STYLE_FULL;
+  if (*hint_style == CAIRO_HINT_STYLE_MEDIUM)
+    *hint_style = CAIRO_HINT_STYLE_FULL;
+  /* default is treated as slight */
+  else if (*hint_style != CAIRO_HINT_STYLE_NONE &&
+           *hint_style != CAIRO_HINT_STYLE_FULL)
+    *hint_style = CAIRO_HINT_STYLE_SLIGHT;
 
-  if (hint_style == CAIRO_HINT_STYLE_NONE ||
-      hint_style == CAIRO_HINT_STYLE_FULL)
+  /* we only accept none and gray */
+  if (*antialias != CAIRO_ANTIALIAS_NONE)
+    *antialias = CAIRO_ANTIALIAS_GRAY;
+}
+
+static void
+gsk_text_node_serialize_font_options (GskRenderNode *node,
+                                      Printer       *p)
+{
+  cairo_hint_style_t hint_style;
+  cairo_antialias_t antialias;
+
+  gsk_render_node_printer_get_font_options (gsk_text_node_get_font (node), &hint_style, &antialias);
+
+  if (hint_style != CAIRO_HINT_STYLE_SLIGHT)
     append_enum_param (p, "hint-style", CAIRO_GOBJECT_TYPE_HINT_STYLE, hint_style);
 
   /* CAIRO_ANTIALIAS_NONE is the only value we ever emit here, since gray is the default,
@@ -4407,54 +4576,34 @@ render_node_print (Printer       *p,
     case GSK_CAIRO_NODE:
       {
         cairo_surface_t *surface = gsk_cairo_node_get_surface (node);
-        GByteArray *array;
 
         start_node (p, "cairo", node_name);
         append_rect_param (p, "bounds", &node->bounds);
 
         if (surface != NULL)
           {
-            array = g_byte_array_new ();
-            cairo_surface_write_to_png_stream (surface, cairo_write_array, array);
+            GBytes *bytes;
 
+            bytes = gsk_render_node_printer_save_cairo_pixels (surface);
             _indent (p);
             g_string_append (p->str, "pixels: url(\"data:image/png;base64,");
-            b64 = base64_encode_with_linebreaks (array->data, array->len);
+            b64 = base64_encode_with_linebreaks (g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes));
             append_escaping_newlines (p->str, b64);
             g_free (b64);
             g_string_append (p->str, "\");\n");
+            g_bytes_unref (bytes);
 
-            g_byte_array_free (array, TRUE);
-
-#ifdef CAIRO_HAS_SCRIPT_SURFACE
-            if (cairo_surface_get_type (surface) == CAIRO_SURFACE_TYPE_RECORDING)
+            bytes = gsk_render_node_printer_save_cairo_script (surface);
+            if (bytes)
               {
-                static const cairo_user_data_key_t cairo_is_stupid_key;
-                cairo_device_t *script;
-
-                array = g_byte_array_new ();
-                script = cairo_script_create_for_stream (cairo_write_array, array);
-
-                if (cairo_script_from_recording_surface (script, surface) == CAIRO_STATUS_SUCCESS)
-                  {
-                    _indent (p);
-                    g_string_append (p->str, "script: url(\"data:;base64,");
-                    b64 = base64_encode_with_linebreaks (array->data, array->len);
-                    append_escaping_newlines (p->str, b64);
-                    g_free (b64);
-                    g_string_append (p->str, "\");\n");
-                  }
-
-                /* because Cairo is stupid and writes to the device after we finished it,
-                 * we can't just
-                g_byte_array_free (array, TRUE);
-                 * but have to
-                 */
-                g_byte_array_set_size (array, 0);
-                cairo_device_set_user_data (script, &cairo_is_stupid_key, array, cairo_destroy_array);
-                cairo_device_destroy (script);
+                _indent (p);
+                g_string_append (p->str, "script: url(\"data:;base64,");
+                b64 = base64_encode_with_linebreaks (g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes));
+                append_escaping_newlines (p->str, b64);
+                g_free (b64);
+                g_string_append (p->str, "\");\n");
+                g_bytes_unref (bytes);
               }
-#endif
           }
 
         end_node (p);
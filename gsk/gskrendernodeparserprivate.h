@@ -3,6 +3,28 @@
 
 #include "gskrendernode.h"
 
+#include <pango/pango.h>
+
 GskRenderNode * gsk_render_node_deserialize_from_bytes  (GBytes            *bytes,
                                                          GskParseErrorFunc  error_func,
                                                          gpointer           user_data);
+
+/* Shared with the binary format */
+PangoFont *     gsk_render_node_parser_font_from_string         (PangoFontMap        *fontmap,
+                                                                 const char          *string,
+                                                                 gboolean             allow_fallback);
+gboolean        gsk_render_node_parser_add_font_from_bytes      (PangoFontMap       **fontmap,
+                                                                 GBytes              *bytes,
+                                                                 GError             **error);
+#ifdef HAVE_CAIRO_SCRIPT_INTERPRETER
+cairo_surface_t *
+                gsk_render_node_parser_run_script               (GBytes              *bytes,
+                                                                 GError             **error);
+#endif
+
+const char *    gsk_render_node_printer_get_font_file           (PangoFont           *font);
+void            gsk_render_node_printer_get_font_options        (PangoFont           *font,
+                                                                 cairo_hint_style_t  *hint_style,
+                                                                 cairo_antialias_t   *antialias);
+GBytes *        gsk_render_node_printer_save_cairo_pixels       (cairo_surface_t     *surface);
+GBytes *        gsk_render_node_printer_save_cairo_script       (cairo_surface_t     *surface);
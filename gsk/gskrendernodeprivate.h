@@ -81,6 +81,8 @@ void            gsk_container_node_diff_with            (GskRenderNode
                                                          GskDiffData                 *data);
 void            gsk_render_node_draw_fallback           (GskRenderNode               *node,
                                                          cairo_t                     *cr);
+void            gsk_cairo_surface_set_texture_surfaces  (cairo_surface_t             *surface,
+                                                         GHashTable                  *textures);
 
 bool            gsk_border_node_get_uniform             (const GskRenderNode         *self) G_GNUC_PURE;
 bool            gsk_border_node_get_uniform_color       (const GskRenderNode         *self) G_GNUC_PURE;
@@ -43,6 +43,7 @@
 #include <gtk/gtkcolumnview.h>
 #include <gtk/gtkcolumnviewcolumn.h>
 #include <gsk/gskrendererprivate.h>
+#include <gsk/gskrendernodebinaryprivate.h>
 #include <gsk/gskrendernodeprivate.h>
 #include <gsk/gskroundedrectprivate.h>
 #include <gsk/gsktransformprivate.h>
@@ -1924,7 +1925,14 @@ render_node_save_response (GObject *source,
   file = gtk_file_dialog_save_finish (dialog, result, &error);
   if (file)
     {
-      GBytes *bytes = gsk_render_node_serialize (node);
+      char *basename = g_file_get_basename (file);
+      GBytes *bytes;
+
+      if (basename && g_str_has_suffix (basename, GSK_RENDER_NODE_BINARY_SUFFIX))
+        bytes = gsk_render_node_serialize_binary (node);
+      else
+        bytes = gsk_render_node_serialize (node);
+      g_free (basename);
 
       if (!g_file_replace_contents (file,
                                     g_bytes_get_data (bytes, NULL),
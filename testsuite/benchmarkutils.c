@@ -0,0 +1,238 @@
+/*
+ * Copyright © 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The shared parts of the benchmarks: the common options, running
+ * a function repeatedly and printing the results as a table or as
+ * JSON that can be compared between releases.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include <gtk/gtk.h>
+
+#include "benchmarkutils.h"
+
+static int runs = 5;
+static char *filter = NULL;
+static gboolean json = FALSE;
+static gboolean quick = FALSE;
+
+static const GOptionEntry benchmark_entries[] = {
+  { "runs", 0, 0, G_OPTION_ARG_INT, &runs, "Number of runs for each benchmark", "RUNS" },
+  { "filter", 0, 0, G_OPTION_ARG_STRING, &filter, "Only run benchmarks matching the pattern", "GROUP/NAME" },
+  { "json", 0, 0, G_OPTION_ARG_NONE, &json, "Print the results as JSON", NULL },
+  { "quick", 0, 0, G_OPTION_ARG_NONE, &quick, "Run everything once on tiny inputs, to check that it works", NULL },
+  { NULL, }
+};
+
+static GString *info;
+static guint n_results;
+
+void
+benchmark_init (int                 *argc,
+                char              ***argv,
+                const GOptionEntry  *entries,
+                const char          *summary)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+
+  context = g_option_context_new (NULL);
+  if (entries)
+    g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_main_entries (context, benchmark_entries, NULL);
+  g_option_context_set_summary (context, summary);
+  if (!g_option_context_parse (context, argc, argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      exit (1);
+    }
+  g_option_context_free (context);
+
+  if (quick)
+    runs = 1;
+
+  if (runs < 1)
+    {
+      g_printerr ("Need at least one run\n");
+      exit (1);
+    }
+
+  info = g_string_new (NULL);
+}
+
+/* Adds a field to the header of the JSON output, to record
+ * the settings that the numbers depend on.
+ */
+void
+benchmark_add_info (const char *key,
+                    const char *format,
+                    ...)
+{
+  va_list args;
+
+  g_string_append_printf (info, "  \"%s\": ", key);
+  va_start (args, format);
+  g_string_append_vprintf (info, format, args);
+  va_end (args);
+  g_string_append (info, ",\n");
+}
+
+void
+benchmark_begin (void)
+{
+  if (!json)
+    return;
+
+  g_print ("{\n"
+           "  \"version\": \"%d.%d.%d\",\n"
+           "  \"runs\": %d,\n"
+           "%s"
+           "  \"results\": [",
+           gtk_get_major_version (),
+           gtk_get_minor_version (),
+           gtk_get_micro_version (),
+           runs,
+           info->str);
+}
+
+void
+benchmark_end (void)
+{
+  if (json)
+    g_print ("\n  ]\n}\n");
+
+  g_string_free (info, TRUE);
+  g_clear_pointer (&filter, g_free);
+}
+
+gboolean
+benchmark_is_quick (void)
+{
+  return quick;
+}
+
+gboolean
+benchmark_should_run (const char *group,
+                      const char *name)
+{
+  char *full;
+  gboolean result;
+
+  if (filter == NULL)
+    return TRUE;
+
+  full = g_strdup_printf ("%s/%s", group, name);
+  result = g_pattern_match_simple (filter, full);
+  g_free (full);
+
+  return result;
+}
+
+static int
+compare_time (gconstpointer a,
+              gconstpointer b)
+{
+  gint64 ta = *(const gint64 *) a;
+  gint64 tb = *(const gint64 *) b;
+
+  return ta < tb ? -1 : ta > tb;
+}
+
+/* Runs @func once to warm up caches and thread pools, then
+ * @runs times, and reports the median time. @amount is the
+ * number of bytes or operations handled by one run, we use
+ * it to compute the throughput.
+ */
+void
+benchmark_run (const char    *group,
+               const char    *name,
+               const char    *input,
+               BenchmarkUnit  unit,
+               guint64        amount,
+               BenchmarkFunc  func,
+               gpointer       data)
+{
+  gint64 *times;
+  double median, rate;
+  int i;
+
+  if (!benchmark_should_run (group, name))
+    return;
+
+  times = g_new (gint64, runs);
+
+  func (data);
+
+  for (i = 0; i < runs; i++)
+    {
+      gint64 start = g_get_monotonic_time ();
+      func (data);
+      times[i] = g_get_monotonic_time () - start;
+    }
+
+  qsort (times, runs, sizeof (gint64), compare_time);
+  if (runs % 2)
+    median = times[runs / 2];
+  else
+    median = (times[runs / 2 - 1] + times[runs / 2]) / 2.0;
+  median /= G_USEC_PER_SEC;
+  rate = median > 0 ? amount / median : 0;
+  if (unit == BENCHMARK_UNIT_BYTES)
+    rate /= 1024 * 1024;
+
+  if (json)
+    {
+      g_print ("%s\n    { \"group\": \"%s\", \"name\": \"%s\", \"input\": \"%s\", "
+               "\"%s\": %" G_GUINT64_FORMAT ", \"median\": %.9f, \"min\": %.9f, \"max\": %.9f, "
+               "\"%s\": %.3f",
+               n_results > 0 ? "," : "",
+               group, name, input,
+               unit == BENCHMARK_UNIT_BYTES ? "bytes" : "ops",
+               amount,
+               median,
+               (double) times[0] / G_USEC_PER_SEC,
+               (double) times[runs - 1] / G_USEC_PER_SEC,
+               unit == BENCHMARK_UNIT_BYTES ? "mb_per_s" : "ops_per_s",
+               rate);
+      g_print (" }");
+    }
+  else
+    {
+      char *title = g_strdup_printf ("%s/%s/%s", group, name, input);
+      char *size;
+
+      if (unit == BENCHMARK_UNIT_BYTES)
+        size = g_format_size (amount);
+      else
+        size = g_strdup_printf ("%" G_GUINT64_FORMAT " ops", amount);
+
+      g_print ("%-60s %11s %10.3f ms %12.1f %s",
+               title, size, median * 1000, rate,
+               unit == BENCHMARK_UNIT_BYTES ? "MB/s" : "ops/s");
+      g_print ("\n");
+
+      g_free (size);
+      g_free (title);
+    }
+
+  n_results++;
+  g_free (times);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef void (* BenchmarkFunc) (gpointer data);
+
+typedef enum {
+  BENCHMARK_UNIT_BYTES,
+  BENCHMARK_UNIT_OPS,
+} BenchmarkUnit;
+
+void            benchmark_init                  (int                 *argc,
+                                                 char              ***argv,
+                                                 const GOptionEntry  *entries,
+                                                 const char          *summary);
+void            benchmark_add_info              (const char          *key,
+                                                 const char          *format,
+                                                 ...) G_GNUC_PRINTF (2, 3);
+void            benchmark_begin                 (void);
+void            benchmark_end                   (void);
+
+gboolean        benchmark_is_quick              (void);
+gboolean        benchmark_should_run            (const char          *group,
+                                                 const char          *name);
+void            benchmark_run                   (const char          *group,
+                                                 const char          *name,
+                                                 const char          *input,
+                                                 BenchmarkUnit        unit,
+                                                 guint64              amount,
+                                                 BenchmarkFunc        func,
+                                                 gpointer             data);
+
+G_END_DECLS
@@ -0,0 +1,289 @@
+#include "config.h"
+
+#include <gtk/gtk.h>
+#include <gdk/gdkdmabufprivate.h>
+#include <gdk/gdkdmabuffourccprivate.h>
+#include <gdk/gdkmemorysimdprivate.h>
+
+#ifdef HAVE_DMABUF
+
+typedef enum {
+  SEMI_PLANAR,  /* Y plane and interleaved UV plane */
+  PLANAR,       /* separate Y, U and V planes */
+  PACKED,       /* YUYV and friends */
+} Layout;
+
+typedef struct {
+  guint32 fourcc;
+  Layout layout;
+  /* byte offsets for SEMI_PLANAR and PACKED, planes for PLANAR */
+  guint y, u, v;
+  guint x_sub, y_sub;
+} YUVFormat;
+
+static const YUVFormat formats[] = {
+  { DRM_FORMAT_NV12, SEMI_PLANAR, 0, 0, 1, 2, 2 },
+  { DRM_FORMAT_NV21, SEMI_PLANAR, 0, 1, 0, 2, 2 },
+  { DRM_FORMAT_NV16, SEMI_PLANAR, 0, 0, 1, 2, 1 },
+  { DRM_FORMAT_NV61, SEMI_PLANAR, 0, 1, 0, 2, 1 },
+  { DRM_FORMAT_NV24, SEMI_PLANAR, 0, 0, 1, 1, 1 },
+  { DRM_FORMAT_NV42, SEMI_PLANAR, 0, 1, 0, 1, 1 },
+  { DRM_FORMAT_YUV410, PLANAR, 0, 1, 2, 4, 4 },
+  { DRM_FORMAT_YVU410, PLANAR, 0, 2, 1, 4, 4 },
+  { DRM_FORMAT_YUV411, PLANAR, 0, 1, 2, 4, 1 },
+  { DRM_FORMAT_YVU411, PLANAR, 0, 2, 1, 4, 1 },
+  { DRM_FORMAT_YUV420, PLANAR, 0, 1, 2, 2, 2 },
+  { DRM_FORMAT_YVU420, PLANAR, 0, 2, 1, 2, 2 },
+  { DRM_FORMAT_YUV422, PLANAR, 0, 1, 2, 2, 1 },
+  { DRM_FORMAT_YVU422, PLANAR, 0, 2, 1, 2, 1 },
+  { DRM_FORMAT_YUV444, PLANAR, 0, 1, 2, 1, 1 },
+  { DRM_FORMAT_YVU444, PLANAR, 0, 2, 1, 1, 1 },
+  { DRM_FORMAT_YUYV, PACKED, 0, 1, 3, 2, 1 },
+  { DRM_FORMAT_YVYU, PACKED, 0, 3, 1, 2, 1 },
+  { DRM_FORMAT_UYVY, PACKED, 1, 0, 2, 2, 1 },
+  { DRM_FORMAT_VYUY, PACKED, 1, 2, 0, 2, 1 },
+};
+
+typedef struct {
+  GdkDmabuf dmabuf;
+  guchar *planes[GDK_DMABUF_MAX_PLANES];
+  gsize sizes[GDK_DMABUF_MAX_PLANES];
+  gsize width;
+  gsize height;
+} YUVImage;
+
+static void
+yuv_image_add_plane (YUVImage *image,
+                     gsize     stride,
+                     gsize     rows)
+{
+  guint i = image->dmabuf.n_planes++;
+  gsize j;
+
+  image->dmabuf.planes[i].fd = -1;
+  image->dmabuf.planes[i].stride = stride;
+  image->dmabuf.planes[i].offset = 0;
+  image->sizes[i] = stride * rows;
+  image->planes[i] = g_malloc (image->sizes[i]);
+  for (j = 0; j < image->sizes[i]; j++)
+    image->planes[i][j] = g_test_rand_int_range (0, 256);
+}
+
+static void
+yuv_image_init (YUVImage        *image,
+                const YUVFormat *format,
+                gsize            width,
+                gsize            height)
+{
+  gsize chroma_width = (width + format->x_sub - 1) / format->x_sub;
+  gsize chroma_height = (height + format->y_sub - 1) / format->y_sub;
+
+  memset (image, 0, sizeof (YUVImage));
+  image->dmabuf.fourcc = format->fourcc;
+  image->dmabuf.modifier = DRM_FORMAT_MOD_LINEAR;
+  image->width = width;
+  image->height = height;
+
+  /* Add some padding to the strides to catch mistakes */
+  switch (format->layout)
+    {
+    case SEMI_PLANAR:
+      yuv_image_add_plane (image, width + 5, height);
+      yuv_image_add_plane (image, 2 * chroma_width + 3, chroma_height);
+      break;
+
+    case PLANAR:
+      yuv_image_add_plane (image, width + 5, height);
+      yuv_image_add_plane (image, chroma_width + 3, chroma_height);
+      yuv_image_add_plane (image, chroma_width + 7, chroma_height);
+      break;
+
+    case PACKED:
+      yuv_image_add_plane (image, 4 * chroma_width + 4, height);
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+static void
+yuv_image_clear (YUVImage *image)
+{
+  for (guint i = 0; i < image->dmabuf.n_planes; i++)
+    g_free (image->planes[i]);
+}
+
+/* This is how the dmabuf download converted pixels before it
+ * was vectorized, one pixel at a time. */
+static void
+reference_download (const YUVImage  *image,
+                    const YUVFormat *format,
+                    guchar          *data,
+                    gsize            stride)
+{
+  const GdkDmabuf *dmabuf = &image->dmabuf;
+  gsize x, y;
+
+  for (y = 0; y < image->height; y++)
+    {
+      for (x = 0; x < image->width; x++)
+        {
+          guchar *rgb = data + y * stride + 3 * x;
+          const guchar *row;
+          int Y, U, V, y2, u2, v2;
+
+          switch (format->layout)
+            {
+            case SEMI_PLANAR:
+              Y = image->planes[0][y * dmabuf->planes[0].stride + x];
+              row = image->planes[1] + y / format->y_sub * dmabuf->planes[1].stride;
+              U = row[x / format->x_sub * 2 + format->u];
+              V = row[x / format->x_sub * 2 + format->v];
+              break;
+
+            case PLANAR:
+              Y = image->planes[0][y * dmabuf->planes[0].stride + x];
+              U = image->planes[format->u][y / format->y_sub * dmabuf->planes[format->u].stride + x / format->x_sub];
+              V = image->planes[format->v][y / format->y_sub * dmabuf->planes[format->v].stride + x / format->x_sub];
+              break;
+
+            case PACKED:
+              row = image->planes[0] + y * dmabuf->planes[0].stride + x / 2 * 4;
+              Y = row[format->y + x % 2 * 2];
+              U = row[format->u];
+              V = row[format->v];
+              break;
+
+            default:
+              g_assert_not_reached ();
+            }
+
+          y2 = Y * 65536;
+          u2 = U - 127;
+          v2 = V - 127;
+          rgb[0] = CLAMP ((y2 + 74711 * v2) >> 16, 0, 255);
+          rgb[1] = CLAMP ((y2 - 25864 * u2 - 38050 * v2) >> 16, 0, 255);
+          rgb[2] = CLAMP ((y2 + 133176 * u2) >> 16, 0, 255);
+        }
+    }
+}
+
+static void
+download (const YUVImage *image,
+          guchar         *data,
+          gsize           stride)
+{
+  GdkMemoryFormat format;
+
+  g_assert_true (gdk_dmabuf_get_memory_format (image->dmabuf.fourcc, FALSE, &format));
+
+  gdk_dmabuf_download_data (&image->dmabuf,
+                            (const guchar **) image->planes,
+                            (gsize *) image->sizes,
+                            format,
+                            image->width,
+                            image->height,
+                            data,
+                            stride);
+}
+
+static void
+test_yuv_download (gconstpointer data)
+{
+  const YUVFormat *format = data;
+  /* odd sizes to exercise the partial chroma blocks and the
+   * scalar tails of the vectorized code */
+  const gsize sizes[][2] = { { 1, 1 }, { 7, 3 }, { 67, 33 }, { 1031, 517 } };
+  GdkMemorySimd simd = gdk_memory_simd_get_enabled ();
+
+  for (gsize i = 0; i < G_N_ELEMENTS (sizes); i++)
+    {
+      YUVImage image;
+      guchar *expected, *actual;
+      gsize stride;
+
+      yuv_image_init (&image, format, sizes[i][0], sizes[i][1]);
+      stride = 3 * image.width + 1;
+      expected = g_malloc0 (stride * image.height);
+      actual = g_malloc0 (stride * image.height);
+
+      reference_download (&image, format, expected, stride);
+
+      gdk_memory_simd_set_enabled (GDK_MEMORY_SIMD_NONE);
+      download (&image, actual, stride);
+      g_assert_cmpmem (expected, stride * image.height, actual, stride * image.height);
+
+      gdk_memory_simd_set_enabled (GDK_MEMORY_SIMD_ALL);
+      memset (actual, 0, stride * image.height);
+      download (&image, actual, stride);
+      g_assert_cmpmem (expected, stride * image.height, actual, stride * image.height);
+
+      g_free (actual);
+      g_free (expected);
+      yuv_image_clear (&image);
+    }
+
+  gdk_memory_simd_set_enabled (simd);
+}
+
+/* Use -m perf to get useful timings of a 1080p frame */
+static void
+test_yuv_benchmark (void)
+{
+  gsize width = g_test_perf () ? 1920 : 64;
+  gsize height = g_test_perf () ? 1080 : 32;
+  guint n_runs = g_test_perf () ? 20 : 1;
+  gsize stride = 3 * width;
+  guchar *dest;
+
+  dest = g_malloc (stride * height);
+
+  for (gsize i = 0; i < G_N_ELEMENTS (formats); i++)
+    {
+      YUVImage image;
+      double reference, elapsed;
+
+      yuv_image_init (&image, &formats[i], width, height);
+
+      g_test_timer_start ();
+      for (guint run = 0; run < n_runs; run++)
+        reference_download (&image, &formats[i], dest, stride);
+      reference = g_test_timer_elapsed () / n_runs;
+
+      g_test_timer_start ();
+      for (guint run = 0; run < n_runs; run++)
+        download (&image, dest, stride);
+      elapsed = g_test_timer_elapsed () / n_runs;
+
+      if (g_test_perf ())
+        g_test_minimized_result (elapsed, "%.4s: %.2f ms, per pixel code %.2f ms",
+                                 (char *) &formats[i].fourcc,
+                                 elapsed * 1000, reference * 1000);
+
+      yuv_image_clear (&image);
+    }
+
+  g_free (dest);
+}
+
+#endif
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+#ifdef HAVE_DMABUF
+  for (gsize i = 0; i < G_N_ELEMENTS (formats); i++)
+    {
+      char *test_name = g_strdup_printf ("/dmabuf/yuv/download/%.4s", (char *) &formats[i].fourcc);
+      g_test_add_data_func (test_name, &formats[i], test_yuv_download);
+      g_free (test_name);
+    }
+
+  g_test_add_func ("/dmabuf/yuv/benchmark", test_yuv_benchmark);
+#endif
+
+  return g_test_run ();
+}
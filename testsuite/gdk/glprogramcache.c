@@ -0,0 +1,281 @@
+#include <gtk/gtk.h>
+#include <epoxy/gl.h>
+#include <glib/gstdio.h>
+#include "gdk/gdkdisplayprivate.h"
+#include "gdk/gdkglcontextprivate.h"
+#include "gdk/gdkglprogramcacheprivate.h"
+
+static const char vertex_source[] =
+  "in vec2 pos;\n"
+  "void main() { gl_Position = vec4 (pos, 0.0, 1.0); }\n";
+
+static const char fragment_source[] =
+  "out vec4 color;\n"
+  "void main() { color = vec4 (1.0, 0.0, 0.0, 1.0); }\n";
+
+static GdkGLContext *
+create_context (void)
+{
+  GdkDisplay *display;
+  GdkGLContext *context;
+  GError *error = NULL;
+
+  display = gdk_display_get_default ();
+  if (!gdk_display_prepare_gl (display, &error))
+    {
+      g_test_message ("no GL support: %s", error->message);
+      g_test_skip ("no GL support");
+      g_clear_error (&error);
+      return NULL;
+    }
+
+  context = gdk_display_create_gl_context (display, &error);
+  g_assert_no_error (error);
+  gdk_gl_context_realize (context, &error);
+  g_assert_no_error (error);
+
+  gdk_gl_context_make_current (context);
+
+  if (!gdk_gl_context_has_feature (context, GDK_GL_FEATURE_PROGRAM_BINARY))
+    {
+      g_test_skip ("no program binary support");
+      gdk_gl_context_clear_current ();
+      g_object_unref (context);
+      return NULL;
+    }
+
+  return context;
+}
+
+static void
+attach_shader (GdkGLContext *context,
+               GLuint        program,
+               GLenum        type,
+               const char   *source)
+{
+  const char *sources[2];
+  GLuint shader;
+  GLint status;
+
+  if (gdk_gl_context_get_use_es (context))
+    sources[0] = "#version 300 es\nprecision mediump float;\n";
+  else
+    sources[0] = "#version 330\n";
+  sources[1] = source;
+
+  shader = glCreateShader (type);
+  glShaderSource (shader, 2, sources, NULL);
+  glCompileShader (shader);
+  glGetShaderiv (shader, GL_COMPILE_STATUS, &status);
+  g_assert_true (status == GL_TRUE);
+
+  glAttachShader (program, shader);
+  glDeleteShader (shader);
+}
+
+static void
+link_program (GdkGLContext *context,
+              GLuint        program)
+{
+  GLint status;
+
+  attach_shader (context, program, GL_VERTEX_SHADER, vertex_source);
+  attach_shader (context, program, GL_FRAGMENT_SHADER, fragment_source);
+  glLinkProgram (program);
+  glGetProgramiv (program, GL_LINK_STATUS, &status);
+  g_assert_true (status == GL_TRUE);
+}
+
+static char *
+get_cache_dir (void)
+{
+  return g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "gl-program-cache", NULL);
+}
+
+/* There is one file per driver, and we only have one driver */
+static char *
+get_cache_file (void)
+{
+  char *dirname, *path;
+  const char *name;
+  GDir *dir;
+  GError *error = NULL;
+
+  dirname = get_cache_dir ();
+  dir = g_dir_open (dirname, 0, &error);
+  g_assert_no_error (error);
+
+  name = g_dir_read_name (dir);
+  g_assert_nonnull (name);
+  path = g_build_filename (dirname, name, NULL);
+  g_assert_null (g_dir_read_name (dir));
+
+  g_dir_close (dir);
+  g_free (dirname);
+
+  return path;
+}
+
+/* Writes out pending changes, and makes the next lookup
+ * load the file again, like a new process would */
+static void
+reload_cache (GdkGLContext *context)
+{
+  GdkDisplay *display = gdk_gl_context_get_display (context);
+
+  g_clear_pointer (&display->gl_program_cache, gdk_gl_program_cache_free);
+}
+
+static void
+clear_cache (GdkGLContext *context)
+{
+  char *dirname, *path;
+  const char *name;
+  GDir *dir;
+
+  reload_cache (context);
+
+  dirname = get_cache_dir ();
+  dir = g_dir_open (dirname, 0, NULL);
+  if (dir)
+    {
+      while ((name = g_dir_read_name (dir)))
+        {
+          path = g_build_filename (dirname, name, NULL);
+          g_remove (path);
+          g_free (path);
+        }
+      g_dir_close (dir);
+    }
+  g_free (dirname);
+}
+
+static void
+store_program (GdkGLContext *context,
+               const char   *checksum)
+{
+  GLuint program;
+
+  program = glCreateProgram ();
+  g_assert_false (gdk_gl_context_load_program_binary (context, checksum, program));
+  link_program (context, program);
+  gdk_gl_context_store_program_binary (context, checksum, program);
+  glDeleteProgram (program);
+
+  reload_cache (context);
+}
+
+static void
+test_load (void)
+{
+  GdkGLContext *context;
+  GLuint program;
+  GLint status;
+
+  context = create_context ();
+  if (context == NULL)
+    return;
+
+  clear_cache (context);
+  store_program (context, "load");
+
+  program = glCreateProgram ();
+  g_assert_true (gdk_gl_context_load_program_binary (context, "load", program));
+  glGetProgramiv (program, GL_LINK_STATUS, &status);
+  g_assert_true (status == GL_TRUE);
+  glDeleteProgram (program);
+
+  clear_cache (context);
+  gdk_gl_context_clear_current ();
+  g_object_unref (context);
+}
+
+typedef enum {
+  CORRUPT_TRUNCATE,
+  CORRUPT_GARBAGE,
+} Corruption;
+
+/* A broken file must not be trusted, and must be replaced with
+ * a working one */
+static void
+test_corrupt (gconstpointer data)
+{
+  Corruption corruption = GPOINTER_TO_INT (data);
+  GdkGLContext *context;
+  GLuint program;
+  GLint status;
+  char *path, *contents;
+  gsize length, i;
+  GError *error = NULL;
+
+  context = create_context ();
+  if (context == NULL)
+    return;
+
+  clear_cache (context);
+  store_program (context, "corrupt");
+
+  path = get_cache_file ();
+  g_file_get_contents (path, &contents, &length, &error);
+  g_assert_no_error (error);
+
+  switch (corruption)
+    {
+    case CORRUPT_TRUNCATE:
+      length /= 2;
+      break;
+
+    case CORRUPT_GARBAGE:
+      /* Keep the magic and version, so the entries get parsed */
+      for (i = 12; i < length; i++)
+        contents[i] = 0xff;
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+
+  g_file_set_contents (path, contents, length, &error);
+  g_assert_no_error (error);
+  g_free (contents);
+  g_free (path);
+
+  reload_cache (context);
+
+  /* Falls back to compiling, and caches the result again */
+  store_program (context, "corrupt");
+
+  program = glCreateProgram ();
+  g_assert_true (gdk_gl_context_load_program_binary (context, "corrupt", program));
+  glGetProgramiv (program, GL_LINK_STATUS, &status);
+  g_assert_true (status == GL_TRUE);
+  glDeleteProgram (program);
+
+  clear_cache (context);
+  gdk_gl_context_clear_current ();
+  g_object_unref (context);
+}
+
+int
+main (int argc, char *argv[])
+{
+  char *cache_dir;
+  int result;
+
+  /* Don't touch the real cache */
+  cache_dir = g_dir_make_tmp ("gtk-glprogramcache-XXXXXX", NULL);
+  g_assert_nonnull (cache_dir);
+  g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
+
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/glprogramcache/load", test_load);
+  g_test_add_data_func ("/glprogramcache/corrupt/truncate", GINT_TO_POINTER (CORRUPT_TRUNCATE), test_corrupt);
+  g_test_add_data_func ("/glprogramcache/corrupt/garbage", GINT_TO_POINTER (CORRUPT_GARBAGE), test_corrupt);
+
+  result = g_test_run ();
+
+  g_free (cache_dir);
+
+  return result;
+}
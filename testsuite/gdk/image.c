@@ -2,6 +2,9 @@
 #include "gdk/loaders/gdkpngprivate.h"
 #include "gdk/loaders/gdktiffprivate.h"
 #include "gdk/loaders/gdkjpegprivate.h"
+#include "gdk/loaders/gdkrawprivate.h"
+#include "gdk/gdkmemoryformatprivate.h"
+#include "gdk/gdktextureprivate.h"
 
 static void
 assert_texture_equal (GdkTexture *t1,
@@ -117,6 +120,234 @@ test_save_image (gconstpointer test_data)
   g_free (path);
 }
 
+static void
+test_save_raw (void)
+{
+  char *path;
+  GdkTexture *texture;
+  GdkTexture *texture2;
+  GFile *file;
+  GError *error = NULL;
+  GBytes *bytes;
+  GIOStream *stream;
+
+  path = g_test_build_filename (G_TEST_DIST, "image-data", "image.png", NULL);
+  texture = gdk_texture_new_from_filename (path, &error);
+  g_assert_no_error (error);
+
+  bytes = gdk_save_raw (texture);
+  g_assert_true (gdk_is_raw (bytes));
+
+  file = g_file_new_tmp ("imageXXXXXX", (GFileIOStream **)&stream, NULL);
+  g_object_unref (stream);
+  g_file_replace_contents (file,
+                           g_bytes_get_data (bytes, NULL),
+                           g_bytes_get_size (bytes),
+                           NULL, FALSE, 0,
+                           NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  /* This maps the file */
+  texture2 = gdk_texture_new_from_file (file, &error);
+  g_assert_no_error (error);
+  g_assert_true (GDK_IS_MEMORY_TEXTURE (texture2));
+  g_assert_cmpint (gdk_texture_get_format (texture), ==, gdk_texture_get_format (texture2));
+
+  assert_texture_equal (texture, texture2);
+
+  g_object_unref (texture2);
+  g_file_delete (file, NULL, NULL);
+  g_bytes_unref (bytes);
+  g_object_unref (texture);
+  g_object_unref (file);
+  g_free (path);
+}
+
+static GdkTexture *
+create_random_texture (GdkMemoryFormat format,
+                       int             width,
+                       int             height)
+{
+  GdkTexture *texture;
+  GBytes *bytes;
+  guchar *data;
+  gsize stride, i;
+
+  stride = width * gdk_memory_format_bytes_per_pixel (format);
+  data = g_malloc (stride * height);
+  /* Half noise, half gradients, so it compresses a bit */
+  for (i = 0; i < stride * height; i++)
+    data[i] = i % 97 < 50 ? i * 7 / 3 : g_test_rand_int_range (0, 256);
+
+  bytes = g_bytes_new_take (data, stride * height);
+  texture = gdk_memory_texture_new (width, height, format, bytes, stride);
+  g_bytes_unref (bytes);
+
+  return texture;
+}
+
+static void
+assert_texture_equal_in_format (GdkTexture      *t1,
+                                GdkTexture      *t2,
+                                GdkMemoryFormat  format)
+{
+  GdkTextureDownloader *downloader;
+  GBytes *b1, *b2;
+  gsize stride1, stride2;
+
+  g_assert_cmpint (gdk_texture_get_width (t1), ==, gdk_texture_get_width (t2));
+  g_assert_cmpint (gdk_texture_get_height (t1), ==, gdk_texture_get_height (t2));
+
+  downloader = gdk_texture_downloader_new (t1);
+  gdk_texture_downloader_set_format (downloader, format);
+  b1 = gdk_texture_downloader_download_bytes (downloader, &stride1);
+  gdk_texture_downloader_set_texture (downloader, t2);
+  b2 = gdk_texture_downloader_download_bytes (downloader, &stride2);
+
+  g_assert_cmpuint (stride1, ==, stride2);
+  g_assert_cmpmem (g_bytes_get_data (b1, NULL), g_bytes_get_size (b1),
+                   g_bytes_get_data (b2, NULL), g_bytes_get_size (b2));
+
+  g_bytes_unref (b2);
+  g_bytes_unref (b1);
+  gdk_texture_downloader_free (downloader);
+}
+
+/* The fast mode writes its own IDAT chunk, make sure libpng can
+ * read it back. The large sizes are split into multiple stripes. */
+static void
+test_save_png_fast (void)
+{
+  const GdkMemoryFormat formats[] = {
+    GDK_MEMORY_R8G8B8A8,
+    GDK_MEMORY_R8G8B8,
+    GDK_MEMORY_R16G16B16A16,
+  };
+  const int sizes[][2] = { { 1, 1 }, { 7, 3 }, { 1031, 769 } };
+  gsize i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++)
+    {
+      for (j = 0; j < G_N_ELEMENTS (sizes); j++)
+        {
+          GdkTexture *texture, *texture2;
+          GError *error = NULL;
+          GBytes *bytes;
+
+          texture = create_random_texture (formats[i], sizes[j][0], sizes[j][1]);
+
+          bytes = gdk_save_png_with_compression (texture, GDK_PNG_COMPRESSION_FAST);
+          g_assert_nonnull (bytes);
+          g_assert_true (gdk_is_png (bytes));
+
+          texture2 = gdk_load_png (bytes, &error);
+          g_assert_no_error (error);
+          g_assert_cmpint (gdk_texture_get_format (texture2), ==, formats[i]);
+
+          assert_texture_equal_in_format (texture, texture2, formats[i]);
+
+          g_object_unref (texture2);
+          g_bytes_unref (bytes);
+          g_object_unref (texture);
+        }
+    }
+}
+
+static void
+save_done (GObject      *source,
+           GAsyncResult *result,
+           gpointer      data)
+{
+  GBytes **bytes = data;
+  GError *error = NULL;
+
+  *bytes = gdk_save_png_finish (GDK_TEXTURE (source), result, &error);
+  g_assert_no_error (error);
+}
+
+static void
+test_save_png_async (void)
+{
+  GdkTexture *texture, *texture2;
+  GBytes *bytes = NULL, *expected;
+  GError *error = NULL;
+
+  texture = create_random_texture (GDK_MEMORY_R8G8B8A8, 67, 33);
+  expected = gdk_save_png (texture);
+
+  gdk_save_png_async (texture, GDK_PNG_COMPRESSION_DEFAULT, NULL, save_done, &bytes);
+  while (bytes == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_true (g_bytes_equal (bytes, expected));
+
+  texture2 = gdk_load_png (bytes, &error);
+  g_assert_no_error (error);
+  assert_texture_equal (texture, texture2);
+
+  g_object_unref (texture2);
+  g_bytes_unref (expected);
+  g_bytes_unref (bytes);
+  g_object_unref (texture);
+}
+
+static void
+test_load_area (gconstpointer data)
+{
+  const char *filename = data;
+  GdkTexture *texture, *area_texture, *expected;
+  GdkLoaderOptions options = { { 8, 4, 16, 20 }, 0, 0 };
+  char *path;
+  GFile *file;
+  GBytes *bytes;
+  GError *error = NULL;
+
+  path = g_test_build_filename (G_TEST_DIST, "image-data", filename, NULL);
+  file = g_file_new_for_path (path);
+  bytes = g_file_load_bytes (file, NULL, NULL, &error);
+  g_assert_no_error (error);
+  texture = gdk_texture_new_from_bytes (bytes, &error);
+  g_assert_no_error (error);
+
+  /* Just the area */
+  area_texture = gdk_texture_new_from_bytes_with_options (bytes, &options, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (gdk_texture_get_width (area_texture), ==, 16);
+  g_assert_cmpint (gdk_texture_get_height (area_texture), ==, 20);
+
+  /* jpeg decodes blocks differently when cropping */
+  if (!g_str_has_suffix (filename, ".jpeg"))
+    {
+      expected = gdk_loader_crop_texture (g_object_ref (texture), &options.area);
+      assert_texture_equal (expected, area_texture);
+      g_object_unref (expected);
+    }
+  g_object_unref (area_texture);
+
+  /* At a smaller size, loaders may shrink by 2 */
+  options.width = 8;
+  options.height = 10;
+  area_texture = gdk_texture_new_from_bytes_with_options (bytes, &options, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (gdk_texture_get_width (area_texture), >=, 8);
+  g_assert_cmpint (gdk_texture_get_width (area_texture), <=, 16);
+  g_assert_cmpint (gdk_texture_get_height (area_texture), >=, 10);
+  g_assert_cmpint (gdk_texture_get_height (area_texture), <=, 20);
+  g_object_unref (area_texture);
+
+  /* Outside of the image */
+  options.area = (GdkRectangle) { 100, 100, 10, 10 };
+  area_texture = gdk_texture_new_from_bytes_with_options (bytes, &options, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT);
+  g_assert_null (area_texture);
+  g_clear_error (&error);
+
+  g_object_unref (texture);
+  g_bytes_unref (bytes);
+  g_object_unref (file);
+  g_free (path);
+}
+
 static void
 test_load_image_fail (gconstpointer data)
 {
@@ -155,6 +386,10 @@ main (int argc, char *argv[])
      char *test = g_strconcat ("/image/load/", name, NULL);
      g_test_add_data_func (test, name, test_load_image);
      g_free (test);
+
+     test = g_strconcat ("/image/load-area/", name, NULL);
+     g_test_add_data_func (test, name, test_load_area);
+     g_free (test);
    }
 
   path = g_test_build_filename (G_TEST_DIST, "bad-image-data", NULL);
@@ -172,6 +407,9 @@ main (int argc, char *argv[])
   g_test_add_data_func ("/image/save/image.png", "image.png", test_save_image);
   g_test_add_data_func ("/image/save/image.tiff", "image.tiff", test_save_image);
   g_test_add_data_func ("/image/save/image.jpeg", "image.jpeg", test_save_image);
+  g_test_add_func ("/image/save/raw", test_save_raw);
+  g_test_add_func ("/image/save/png-fast", test_save_png_fast);
+  g_test_add_func ("/image/save/png-async", test_save_png_async);
 
   return g_test_run ();
 }
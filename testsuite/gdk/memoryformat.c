@@ -0,0 +1,296 @@
+#include <gtk.h>
+
+#include "gdk/gdkmemoryformatprivate.h"
+#include "gdk/gdkmemorysimdprivate.h"
+
+static const gsize widths[] = { 1, 3, 4, 7, 8, 15, 16, 17, 33, 67 };
+
+#define HEIGHT 3
+
+static guchar *
+create_random_data (GdkMemoryFormat format,
+                    gsize           width,
+                    gsize          *out_stride)
+{
+  gsize bpp, stride, i;
+  guchar *data;
+
+  bpp = gdk_memory_format_bytes_per_pixel (format);
+  /* Add some padding to catch kernels reading or writing out of bounds */
+  stride = bpp * width + 4;
+  data = g_malloc (stride * HEIGHT);
+
+  switch (gdk_memory_format_get_depth (format))
+    {
+    case GDK_MEMORY_U8:
+    case GDK_MEMORY_U16:
+      for (i = 0; i < stride * HEIGHT; i++)
+        data[i] = g_test_rand_int_range (0, 256);
+      break;
+
+    case GDK_MEMORY_FLOAT16:
+    case GDK_MEMORY_FLOAT32:
+      {
+        GdkMemorySimd simd = gdk_memory_simd_get_enabled ();
+        float *f = g_new (float, width * HEIGHT * 4);
+
+        /* Stay away from NaN and infinity, the existing half float
+         * conversions don't agree on those. */
+        for (i = 0; i < width * HEIGHT * 4; i++)
+          f[i] = g_test_rand_double_range (-0.2, 1.2);
+
+        gdk_memory_simd_set_enabled (GDK_MEMORY_SIMD_NONE);
+        gdk_memory_convert (data, stride, format,
+                            (guchar *) f, width * 4 * sizeof (float), GDK_MEMORY_R32G32B32A32_FLOAT,
+                            width, HEIGHT);
+        gdk_memory_simd_set_enabled (simd);
+
+        g_free (f);
+      }
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+
+  *out_stride = stride;
+
+  return data;
+}
+
+static void
+test_convert_simd (gconstpointer data)
+{
+  GdkMemoryFormat dest_format = GPOINTER_TO_UINT (data);
+  GdkMemorySimd supported;
+
+  supported = gdk_memory_simd_get_supported ();
+  if (supported == GDK_MEMORY_SIMD_NONE)
+    {
+      g_test_skip ("No SIMD support available");
+      return;
+    }
+
+  for (GdkMemoryFormat src_format = 0; src_format < GDK_MEMORY_N_FORMATS; src_format++)
+    {
+      for (gsize w = 0; w < G_N_ELEMENTS (widths); w++)
+        {
+          gsize width = widths[w];
+          gsize src_stride, dest_stride;
+          guchar *src, *expected, *actual;
+
+          src = create_random_data (src_format, width, &src_stride);
+          dest_stride = gdk_memory_format_bytes_per_pixel (dest_format) * width + 4;
+          expected = g_malloc0 (dest_stride * HEIGHT);
+          actual = g_malloc0 (dest_stride * HEIGHT);
+
+          gdk_memory_simd_set_enabled (GDK_MEMORY_SIMD_NONE);
+          gdk_memory_convert (expected, dest_stride, dest_format,
+                              src, src_stride, src_format,
+                              width, HEIGHT);
+
+          /* Test each instruction set on its own */
+          for (GdkMemorySimd simd = 1; simd <= GDK_MEMORY_SIMD_ALL; simd <<= 1)
+            {
+              if ((supported & simd) == 0)
+                continue;
+
+              /* AVX2 falls back to SSE4.1 */
+              gdk_memory_simd_set_enabled (simd | (supported & GDK_MEMORY_SIMD_SSE4_1));
+              memset (actual, 0, dest_stride * HEIGHT);
+              gdk_memory_convert (actual, dest_stride, dest_format,
+                                  src, src_stride, src_format,
+                                  width, HEIGHT);
+
+              if (memcmp (expected, actual, dest_stride * HEIGHT) != 0)
+                {
+                  for (gsize i = 0; i < dest_stride * HEIGHT; i++)
+                    {
+                      if (expected[i] != actual[i])
+                        {
+                          g_test_message ("format %u => %u, width %" G_GSIZE_FORMAT ", SIMD 0x%x: byte %" G_GSIZE_FORMAT " is 0x%02x but should be 0x%02x",
+                                          src_format, dest_format, width, simd,
+                                          i, actual[i], expected[i]);
+                          break;
+                        }
+                    }
+                  g_test_fail ();
+                }
+            }
+
+          gdk_memory_simd_set_enabled (GDK_MEMORY_SIMD_ALL);
+
+          g_free (actual);
+          g_free (expected);
+          g_free (src);
+        }
+    }
+}
+
+/* Large images are converted in parallel, check that the
+ * result matches converting one row at a time */
+static void
+test_convert_parallel (void)
+{
+  const gsize width = 1031, height = 769;
+  GdkMemoryFormat src_format = GDK_MEMORY_R16G16B16A16;
+  GdkMemoryFormat dest_format = GDK_MEMORY_B8G8R8A8_PREMULTIPLIED;
+  gsize src_stride, dest_stride, i, y;
+  guchar *src, *expected, *actual;
+
+  src_stride = width * gdk_memory_format_bytes_per_pixel (src_format);
+  dest_stride = width * gdk_memory_format_bytes_per_pixel (dest_format);
+  src = g_malloc (src_stride * height);
+  for (i = 0; i < src_stride * height; i++)
+    src[i] = g_test_rand_int_range (0, 256);
+  expected = g_malloc (dest_stride * height);
+  actual = g_malloc (dest_stride * height);
+
+  for (y = 0; y < height; y++)
+    gdk_memory_convert (expected + y * dest_stride, dest_stride, dest_format,
+                        src + y * src_stride, src_stride, src_format,
+                        width, 1);
+
+  gdk_memory_convert (actual, dest_stride, dest_format,
+                      src, src_stride, src_format,
+                      width, height);
+
+  g_assert_cmpmem (expected, dest_stride * height, actual, dest_stride * height);
+
+  g_free (actual);
+  g_free (expected);
+  g_free (src);
+}
+
+/* The direct integer conversions must match the float round trip,
+ * which we emulate by converting through a float format first */
+static void
+test_convert_direct (gconstpointer data)
+{
+  GdkMemoryFormat dest_format = GPOINTER_TO_UINT (data);
+  GdkMemorySimd simd = gdk_memory_simd_get_enabled ();
+
+  /* Make sure the SIMD paths don't take over */
+  gdk_memory_simd_set_enabled (GDK_MEMORY_SIMD_NONE);
+
+  for (GdkMemoryFormat src_format = 0; src_format < GDK_MEMORY_N_FORMATS; src_format++)
+    {
+      GdkMemoryFormat float_format;
+      gsize width = widths[G_N_ELEMENTS (widths) - 1];
+      gsize src_stride, float_stride, dest_stride;
+      guchar *src, *tmp, *expected, *actual;
+
+      if (src_format == dest_format ||
+          !gdk_memory_convert_is_direct (dest_format, src_format))
+        continue;
+
+      if (gdk_memory_format_alpha (src_format) == GDK_MEMORY_ALPHA_PREMULTIPLIED)
+        float_format = GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED;
+      else
+        float_format = GDK_MEMORY_R32G32B32A32_FLOAT;
+
+      src = create_random_data (src_format, width, &src_stride);
+      float_stride = gdk_memory_format_bytes_per_pixel (float_format) * width;
+      tmp = g_malloc (float_stride * HEIGHT);
+      dest_stride = gdk_memory_format_bytes_per_pixel (dest_format) * width + 4;
+      expected = g_malloc0 (dest_stride * HEIGHT);
+      actual = g_malloc0 (dest_stride * HEIGHT);
+
+      gdk_memory_convert (tmp, float_stride, float_format,
+                          src, src_stride, src_format,
+                          width, HEIGHT);
+      gdk_memory_convert (expected, dest_stride, dest_format,
+                          tmp, float_stride, float_format,
+                          width, HEIGHT);
+
+      gdk_memory_convert (actual, dest_stride, dest_format,
+                          src, src_stride, src_format,
+                          width, HEIGHT);
+
+      if (memcmp (expected, actual, dest_stride * HEIGHT) != 0)
+        {
+          g_test_message ("format %u => %u does not match the float conversion",
+                          src_format, dest_format);
+          g_test_fail ();
+        }
+
+      g_free (actual);
+      g_free (expected);
+      g_free (tmp);
+      g_free (src);
+    }
+
+  gdk_memory_simd_set_enabled (simd);
+}
+
+/* Runs all conversions. Use -m perf to get useful timings,
+ * the results also say which pairs use the float round trip */
+static void
+test_convert_benchmark (void)
+{
+  gsize size = g_test_perf () ? 1024 : 16;
+  guint n_runs = g_test_perf () ? 10 : 1;
+  GEnumClass *enum_class;
+  guchar *src, *dest;
+
+  enum_class = g_type_class_ref (GDK_TYPE_MEMORY_FORMAT);
+  /* 16 bytes per pixel is the biggest format */
+  src = g_malloc0 (size * size * 16);
+  dest = g_malloc0 (size * size * 16);
+
+  for (GdkMemoryFormat src_format = 0; src_format < GDK_MEMORY_N_FORMATS; src_format++)
+    {
+      for (GdkMemoryFormat dest_format = 0; dest_format < GDK_MEMORY_N_FORMATS; dest_format++)
+        {
+          double elapsed;
+
+          g_test_timer_start ();
+          for (guint i = 0; i < n_runs; i++)
+            gdk_memory_convert (dest, size * gdk_memory_format_bytes_per_pixel (dest_format), dest_format,
+                                src, size * gdk_memory_format_bytes_per_pixel (src_format), src_format,
+                                size, size);
+          elapsed = g_test_timer_elapsed () / n_runs;
+
+          if (g_test_perf ())
+            g_test_minimized_result (elapsed, "%s => %s (%s): %.1f Mpixels/s",
+                                     g_enum_get_value (enum_class, src_format)->value_nick,
+                                     g_enum_get_value (enum_class, dest_format)->value_nick,
+                                     gdk_memory_convert_is_direct (dest_format, src_format) ? "direct" : "float",
+                                     size * size / elapsed / 1000000);
+        }
+    }
+
+  g_free (dest);
+  g_free (src);
+  g_type_class_unref (enum_class);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GEnumClass *enum_class;
+
+  gtk_test_init (&argc, &argv, NULL);
+
+  enum_class = g_type_class_ref (GDK_TYPE_MEMORY_FORMAT);
+
+  for (GdkMemoryFormat format = 0; format < GDK_MEMORY_N_FORMATS; format++)
+    {
+      char *test_name = g_strdup_printf ("/memoryformat/convert-simd/%s",
+                                         g_enum_get_value (enum_class, format)->value_nick);
+      g_test_add_data_func (test_name, GUINT_TO_POINTER (format), test_convert_simd);
+      g_free (test_name);
+
+      test_name = g_strdup_printf ("/memoryformat/convert-direct/%s",
+                                   g_enum_get_value (enum_class, format)->value_nick);
+      g_test_add_data_func (test_name, GUINT_TO_POINTER (format), test_convert_direct);
+      g_free (test_name);
+    }
+
+  g_type_class_unref (enum_class);
+
+  g_test_add_func ("/memoryformat/convert-parallel", test_convert_parallel);
+  g_test_add_func ("/memoryformat/convert-benchmark", test_convert_benchmark);
+
+  return g_test_run ();
+}
@@ -2,6 +2,7 @@
 
 #include "gdk/gdkmemorytextureprivate.h"
 #include "gdk/gdktextureprivate.h"
+#include "gdk/gdktexturedownloaderprivate.h"
 
 
 #define assert_texture_diff_equal(a, b, expected) G_STMT_START { \
@@ -441,6 +442,92 @@ test_texture_downloader (void)
   g_object_unref (texture);
 }
 
+static void
+test_texture_downloader_pool (void)
+{
+  GdkTexture *texture;
+  GdkTextureDownloader *downloader;
+  GdkDownloadPool *pool;
+  gsize stride, stride2;
+  GBytes *bytes, *bytes2;
+  gconstpointer data;
+
+  texture = gdk_texture_new_from_resource ("/org/gtk/libgtk/icons/16x16/places/user-trash.png");
+  downloader = gdk_texture_downloader_new (texture);
+  gdk_texture_downloader_set_format (downloader, GDK_MEMORY_R16G16B16A16);
+  pool = gdk_download_pool_new (1024 * 1024);
+
+  bytes = gdk_texture_downloader_download_bytes (downloader, &stride);
+
+  bytes2 = gdk_texture_downloader_download_bytes_pooled (downloader, pool, &stride2);
+  g_assert_cmpuint (stride, ==, stride2);
+  g_assert_true (g_bytes_equal (bytes, bytes2));
+  data = g_bytes_get_data (bytes2, NULL);
+  g_bytes_unref (bytes2);
+
+  /* The memory gets reused */
+  bytes2 = gdk_texture_downloader_download_bytes_pooled (downloader, pool, &stride2);
+  g_assert_cmpuint (stride, ==, stride2);
+  g_assert_true (g_bytes_equal (bytes, bytes2));
+  g_assert_true (g_bytes_get_data (bytes2, NULL) == data);
+
+  /* The pool may go away before the bytes do */
+  gdk_download_pool_unref (pool);
+  g_bytes_unref (bytes2);
+
+  g_bytes_unref (bytes);
+  gdk_texture_downloader_free (downloader);
+  g_object_unref (texture);
+}
+
+static void
+download_done (GObject      *source,
+               GAsyncResult *result,
+               gpointer      data)
+{
+  GBytes **bytes = data;
+  GError *error = NULL;
+  gsize stride;
+
+  *bytes = gdk_texture_downloader_download_bytes_finish (result, &stride, &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (stride, ==, 4 * 2 * 16);
+}
+
+static void
+test_texture_downloader_async (void)
+{
+  GdkTexture *texture;
+  GdkTextureDownloader *downloader;
+  GdkDownloadPool *pool;
+  GBytes *expected, *bytes = NULL, *pooled_bytes = NULL;
+  gsize stride;
+
+  texture = gdk_texture_new_from_resource ("/org/gtk/libgtk/icons/16x16/places/user-trash.png");
+  downloader = gdk_texture_downloader_new (texture);
+  gdk_texture_downloader_set_format (downloader, GDK_MEMORY_R16G16B16A16);
+  pool = gdk_download_pool_new (1024 * 1024);
+
+  expected = gdk_texture_downloader_download_bytes (downloader, &stride);
+
+  gdk_texture_downloader_download_bytes_async (downloader, NULL, NULL, download_done, &bytes);
+  gdk_texture_downloader_download_bytes_async (downloader, pool, NULL, download_done, &pooled_bytes);
+  /* The downloads made a copy of the downloader */
+  gdk_texture_downloader_free (downloader);
+
+  while (bytes == NULL || pooled_bytes == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_true (g_bytes_equal (expected, bytes));
+  g_assert_true (g_bytes_equal (expected, pooled_bytes));
+
+  g_bytes_unref (pooled_bytes);
+  g_bytes_unref (bytes);
+  g_bytes_unref (expected);
+  gdk_download_pool_unref (pool);
+  g_object_unref (texture);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -457,6 +544,8 @@ main (int argc, char *argv[])
   g_test_add_func ("/texture/icon/serialize", test_texture_icon_serialize);
   g_test_add_func ("/texture/diff", test_texture_diff);
   g_test_add_func ("/texture/downloader", test_texture_downloader);
+  g_test_add_func ("/texture/downloader/pool", test_texture_downloader_pool);
+  g_test_add_func ("/texture/downloader/async", test_texture_downloader_async);
 
   return g_test_run ();
 }
@@ -0,0 +1,401 @@
+/* Benchmarks for the texture loaders, memory format conversions
+ * and the texture downloader.
+ *
+ * See testsuite/benchmarkutils.c for the common options.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtk/gtk.h>
+
+#include "gdk/gdkmemoryformatprivate.h"
+#include "gdk/gdkmemorysimdprivate.h"
+#include "gdk/gdkparalleltaskprivate.h"
+#include "gdk/loaders/gdkpngprivate.h"
+#include "gdk/loaders/gdkjpegprivate.h"
+#include "gdk/loaders/gdktiffprivate.h"
+
+#include "testsuite/benchmarkutils.h"
+
+/* {{{ Options */
+
+static char **sizes = NULL;
+static gboolean no_simd = FALSE;
+
+static const GOptionEntry entries[] = {
+  { "size", 0, 0, G_OPTION_ARG_STRING_ARRAY, &sizes, "Add an image size to test", "WIDTHxHEIGHT" },
+  { "no-simd", 0, 0, G_OPTION_ARG_NONE, &no_simd, "Disable the SIMD conversion code", NULL },
+  { NULL, }
+};
+
+typedef struct {
+  int width;
+  int height;
+  char name[32];
+} Size;
+
+static GArray *size_list;
+
+/* }}} */
+/* {{{ Test images */
+
+/* Something that compresses like a photo or screenshot would,
+ * pure noise makes the encoders look unreasonably bad.
+ */
+static GdkTexture *
+create_texture (GdkMemoryFormat  format,
+                const Size      *size)
+{
+  GdkTexture *texture;
+  GBytes *bytes;
+  guint8 *data;
+  gsize stride;
+  GRand *rand;
+  int x, y;
+
+  rand = g_rand_new_with_seed (42);
+  stride = 4 * size->width;
+  data = g_malloc (stride * size->height);
+  for (y = 0; y < size->height; y++)
+    {
+      for (x = 0; x < size->width; x++)
+        {
+          guint8 *p = data + y * stride + 4 * x;
+          guint8 noise = g_rand_int_range (rand, 0, 16);
+
+          p[0] = (x * 255 / size->width) ^ noise;
+          p[1] = (y * 255 / size->height) ^ noise;
+          p[2] = ((x + y) & 0x40) ? 200 : 50;
+          p[3] = 128 + (x & 0x7f);
+        }
+    }
+  g_rand_free (rand);
+
+  bytes = g_bytes_new_take (data, stride * size->height);
+  texture = gdk_memory_texture_new (size->width, size->height,
+                                    GDK_MEMORY_R8G8B8A8,
+                                    bytes, stride);
+  g_bytes_unref (bytes);
+
+  if (format != GDK_MEMORY_R8G8B8A8)
+    {
+      GdkTextureDownloader *downloader;
+      GdkTexture *converted;
+
+      downloader = gdk_texture_downloader_new (texture);
+      gdk_texture_downloader_set_format (downloader, format);
+      bytes = gdk_texture_downloader_download_bytes (downloader, &stride);
+      converted = gdk_memory_texture_new (size->width, size->height,
+                                          format,
+                                          bytes, stride);
+      g_bytes_unref (bytes);
+      gdk_texture_downloader_free (downloader);
+      g_object_unref (texture);
+      texture = converted;
+    }
+
+  return texture;
+}
+
+static gsize
+texture_size (GdkTexture *texture)
+{
+  return (gsize) gdk_texture_get_width (texture) *
+                 gdk_texture_get_height (texture) *
+                 gdk_memory_format_bytes_per_pixel (gdk_texture_get_format (texture));
+}
+
+/* }}} */
+/* {{{ Encoding and decoding */
+
+typedef struct {
+  const char *name;
+  GdkMemoryFormat format;
+  GBytes * (* save) (GdkTexture *texture);
+  GdkTexture * (* load) (GBytes *bytes, GError **error);
+} Codec;
+
+static GBytes *
+save_png_fast (GdkTexture *texture)
+{
+  return gdk_save_png_with_compression (texture, GDK_PNG_COMPRESSION_FAST);
+}
+
+static const Codec codecs[] = {
+  { "png", GDK_MEMORY_R8G8B8A8, gdk_save_png, gdk_load_png },
+  { "png-fast", GDK_MEMORY_R8G8B8A8, save_png_fast, gdk_load_png },
+  { "png-16bit", GDK_MEMORY_R16G16B16A16, gdk_save_png, gdk_load_png },
+  { "jpeg", GDK_MEMORY_R8G8B8, gdk_save_jpeg, gdk_load_jpeg },
+  { "tiff", GDK_MEMORY_R8G8B8A8, gdk_save_tiff, gdk_load_tiff },
+  { "tiff-float", GDK_MEMORY_R32G32B32A32_FLOAT, gdk_save_tiff, gdk_load_tiff },
+};
+
+typedef struct {
+  const Codec *codec;
+  GdkTexture *texture;
+  GBytes *bytes;
+} CodecData;
+
+static void
+encode (gpointer data)
+{
+  CodecData *cd = data;
+
+  g_bytes_unref (cd->codec->save (cd->texture));
+}
+
+static void
+decode (gpointer data)
+{
+  CodecData *cd = data;
+  GError *error = NULL;
+  GdkTexture *texture;
+
+  texture = cd->codec->load (cd->bytes, &error);
+  if (texture == NULL)
+    g_error ("Failed to decode %s: %s", cd->codec->name, error->message);
+
+  g_object_unref (texture);
+}
+
+static void
+benchmark_codecs (const Size *size)
+{
+  for (gsize i = 0; i < G_N_ELEMENTS (codecs); i++)
+    {
+      CodecData cd;
+
+      if (!benchmark_should_run ("encode", codecs[i].name) &&
+          !benchmark_should_run ("decode", codecs[i].name))
+        continue;
+
+      cd.codec = &codecs[i];
+      cd.texture = create_texture (codecs[i].format, size);
+      cd.bytes = codecs[i].save (cd.texture);
+
+      benchmark_run ("encode", codecs[i].name, size->name,
+                     BENCHMARK_UNIT_BYTES, texture_size (cd.texture),
+                     encode, &cd);
+      benchmark_run ("decode", codecs[i].name, size->name,
+                     BENCHMARK_UNIT_BYTES, texture_size (cd.texture),
+                     decode, &cd);
+
+      g_bytes_unref (cd.bytes);
+      g_object_unref (cd.texture);
+    }
+}
+
+/* }}} */
+/* {{{ Conversions */
+
+typedef struct {
+  guchar *src;
+  gsize src_stride;
+  GdkMemoryFormat src_format;
+  guchar *dest;
+  gsize dest_stride;
+  GdkMemoryFormat dest_format;
+  const Size *size;
+} ConvertData;
+
+static void
+convert (gpointer data)
+{
+  ConvertData *cd = data;
+
+  gdk_memory_convert (cd->dest, cd->dest_stride, cd->dest_format,
+                      cd->src, cd->src_stride, cd->src_format,
+                      cd->size->width, cd->size->height);
+}
+
+static void
+benchmark_convert (const Size *size)
+{
+  GEnumClass *enum_class;
+  ConvertData cd;
+
+  enum_class = g_type_class_ref (GDK_TYPE_MEMORY_FORMAT);
+
+  /* 16 bytes per pixel is the biggest format */
+  cd.size = size;
+  cd.src = g_malloc0 ((gsize) size->width * size->height * 16);
+  cd.dest = g_malloc0 ((gsize) size->width * size->height * 16);
+
+  for (cd.src_format = 0; cd.src_format < GDK_MEMORY_N_FORMATS; cd.src_format++)
+    {
+      for (cd.dest_format = 0; cd.dest_format < GDK_MEMORY_N_FORMATS; cd.dest_format++)
+        {
+          char *name;
+
+          name = g_strdup_printf ("%s-%s",
+                                  g_enum_get_value (enum_class, cd.src_format)->value_nick,
+                                  g_enum_get_value (enum_class, cd.dest_format)->value_nick);
+
+          if (benchmark_should_run ("convert", name))
+            {
+              cd.src_stride = size->width * gdk_memory_format_bytes_per_pixel (cd.src_format);
+              cd.dest_stride = size->width * gdk_memory_format_bytes_per_pixel (cd.dest_format);
+
+              benchmark_run ("convert", name, size->name,
+                             BENCHMARK_UNIT_BYTES, cd.src_stride * size->height,
+                             convert, &cd);
+            }
+
+          g_free (name);
+        }
+    }
+
+  g_free (cd.dest);
+  g_free (cd.src);
+  g_type_class_unref (enum_class);
+}
+
+/* }}} */
+/* {{{ Downloads */
+
+typedef struct {
+  GdkTexture *texture;
+  GdkTextureDownloader *downloader;
+} DownloadData;
+
+/* Download to float and back, like an editor applying a filter would */
+static void
+download_round_trip (gpointer data)
+{
+  DownloadData *dd = data;
+  GdkTextureDownloader *downloader;
+  GdkTexture *texture;
+  GBytes *bytes;
+  gsize stride;
+
+  gdk_texture_downloader_set_texture (dd->downloader, dd->texture);
+  gdk_texture_downloader_set_format (dd->downloader, GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED);
+  bytes = gdk_texture_downloader_download_bytes (dd->downloader, &stride);
+
+  texture = gdk_memory_texture_new (gdk_texture_get_width (dd->texture),
+                                    gdk_texture_get_height (dd->texture),
+                                    GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED,
+                                    bytes, stride);
+  g_bytes_unref (bytes);
+
+  downloader = gdk_texture_downloader_new (texture);
+  gdk_texture_downloader_set_format (downloader, gdk_texture_get_format (dd->texture));
+  bytes = gdk_texture_downloader_download_bytes (downloader, &stride);
+  g_bytes_unref (bytes);
+  gdk_texture_downloader_free (downloader);
+
+  g_object_unref (texture);
+}
+
+static void
+benchmark_download (const Size *size)
+{
+  GEnumClass *enum_class;
+  DownloadData dd;
+
+  enum_class = g_type_class_ref (GDK_TYPE_MEMORY_FORMAT);
+
+  for (GdkMemoryFormat format = 0; format < GDK_MEMORY_N_FORMATS; format++)
+    {
+      const char *name = g_enum_get_value (enum_class, format)->value_nick;
+
+      if (!benchmark_should_run ("download", name))
+        continue;
+
+      dd.texture = create_texture (format, size);
+      dd.downloader = gdk_texture_downloader_new (dd.texture);
+
+      benchmark_run ("download", name, size->name,
+                     BENCHMARK_UNIT_BYTES, texture_size (dd.texture),
+                     download_round_trip, &dd);
+
+      gdk_texture_downloader_free (dd.downloader);
+      g_object_unref (dd.texture);
+    }
+
+  g_type_class_unref (enum_class);
+}
+
+/* }}} */
+
+static void
+parse_sizes (void)
+{
+  Size size;
+
+  size_list = g_array_new (FALSE, FALSE, sizeof (Size));
+
+  if (benchmark_is_quick ())
+    {
+      size.width = size.height = 17;
+      g_snprintf (size.name, sizeof (size.name), "%dx%d", size.width, size.height);
+      g_array_append_val (size_list, size);
+      return;
+    }
+
+  if (sizes == NULL)
+    {
+      const int defaults[] = { 256, 1024, 2048 };
+
+      for (gsize i = 0; i < G_N_ELEMENTS (defaults); i++)
+        {
+          size.width = size.height = defaults[i];
+          g_snprintf (size.name, sizeof (size.name), "%dx%d", size.width, size.height);
+          g_array_append_val (size_list, size);
+        }
+      return;
+    }
+
+  for (gsize i = 0; sizes[i]; i++)
+    {
+      if (sscanf (sizes[i], "%dx%d", &size.width, &size.height) != 2 ||
+          size.width <= 0 || size.height <= 0)
+        {
+          g_printerr ("Invalid size \"%s\", expected WIDTHxHEIGHT\n", sizes[i]);
+          exit (1);
+        }
+      g_snprintf (size.name, sizeof (size.name), "%dx%d", size.width, size.height);
+      g_array_append_val (size_list, size);
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  guint i;
+
+  benchmark_init (&argc, &argv, entries,
+                  "Benchmark texture decoding, encoding, conversion and downloads.\n"
+                  "Groups are encode, decode, convert and download.");
+
+  parse_sizes ();
+
+  if (no_simd)
+    gdk_memory_simd_set_enabled (GDK_MEMORY_SIMD_NONE);
+
+  benchmark_add_info ("threads", "%u", gdk_parallel_task_get_n_threads ());
+  benchmark_add_info ("simd", "%u", gdk_memory_simd_get_enabled ());
+  benchmark_begin ();
+
+  for (i = 0; i < size_list->len; i++)
+    {
+      const Size *size = &g_array_index (size_list, Size, i);
+
+      benchmark_codecs (size);
+      benchmark_convert (size);
+      benchmark_download (size);
+    }
+
+  benchmark_end ();
+
+  g_array_unref (size_list);
+  g_strfreev (sizes);
+
+  return 0;
+}
+
+/* vim:set foldmethod=marker: */
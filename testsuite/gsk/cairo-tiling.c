@@ -0,0 +1,124 @@
+#include <gtk/gtk.h>
+#include "gsk/gskcairorendererprivate.h"
+#include "gdk/gdkparalleltaskprivate.h"
+#include "gdk/gdktextureprivate.h"
+#include "../reftests/reftest-compare.h"
+
+#include <math.h>
+
+static GskRenderNode *
+load_node_file (const char *name)
+{
+  GskRenderNode *node;
+  char *path;
+  char *contents;
+  gsize length;
+  GBytes *bytes;
+  GError *error = NULL;
+
+  path = g_test_build_filename (G_TEST_DIST, name, NULL);
+  g_file_get_contents (path, &contents, &length, &error);
+  g_assert_no_error (error);
+  bytes = g_bytes_new_take (contents, length);
+
+  node = gsk_render_node_deserialize (bytes, NULL, NULL);
+  g_assert_nonnull (node);
+
+  g_bytes_unref (bytes);
+  g_free (path);
+
+  return node;
+}
+
+typedef struct {
+  const char *tile_size;
+  double scale;
+} TilingTest;
+
+/* The cairo renderer reads the tile size when it is created.
+ * The target has a device scale, like the surfaces of a window
+ * with fractional scaling. */
+static GdkTexture *
+render_node (GskRenderNode *node,
+             const char    *tile_size,
+             double         scale)
+{
+  GskRenderer *renderer;
+  GdkTexture *texture;
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  graphene_rect_t bounds;
+  GError *error = NULL;
+
+  if (tile_size)
+    g_setenv ("GSK_CAIRO_TILE_SIZE", tile_size, TRUE);
+  else
+    g_unsetenv ("GSK_CAIRO_TILE_SIZE");
+
+  renderer = gsk_cairo_renderer_new ();
+  gsk_renderer_realize_for_display (renderer, gdk_display_get_default (), &error);
+  g_assert_no_error (error);
+
+  gsk_render_node_get_bounds (node, &bounds);
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                        ceil (bounds.size.width * scale),
+                                        ceil (bounds.size.height * scale));
+  cairo_surface_set_device_scale (surface, scale, scale);
+  cr = cairo_create (surface);
+  cairo_translate (cr, - bounds.origin.x, - bounds.origin.y);
+  gsk_cairo_renderer_draw (GSK_CAIRO_RENDERER (renderer), cr, node);
+  cairo_destroy (cr);
+
+  texture = gdk_texture_new_for_surface (surface);
+  cairo_surface_destroy (surface);
+
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+  g_unsetenv ("GSK_CAIRO_TILE_SIZE");
+
+  return texture;
+}
+
+static void
+test_tiling (gconstpointer data)
+{
+  const TilingTest *test = data;
+  GskRenderNode *node;
+  GdkTexture *untiled, *tiled, *diff;
+
+  if (gdk_parallel_task_get_n_threads () <= 1)
+    {
+      g_test_skip ("Tiles are only used with more than one thread");
+      return;
+    }
+
+  node = load_node_file ("cairo-tiling.node");
+
+  untiled = render_node (node, NULL, test->scale);
+  tiled = render_node (node, test->tile_size, test->scale);
+
+  diff = reftest_compare_textures (untiled, tiled);
+  g_assert_null (diff);
+
+  g_object_unref (untiled);
+  g_object_unref (tiled);
+  gsk_render_node_unref (node);
+}
+
+/* Tile sizes that do and don't line up with the glyphs */
+static const TilingTest tiling_32 = { "32", 1 };
+static const TilingTest tiling_37 = { "37", 1 };
+/* Tiles that start at fractional positions in user space */
+static const TilingTest tiling_fractional = { "37", 1.5 };
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_data_func ("/cairo/tiling/32", &tiling_32, test_tiling);
+  g_test_add_data_func ("/cairo/tiling/37", &tiling_37, test_tiling);
+  g_test_add_data_func ("/cairo/tiling/fractional-scale", &tiling_fractional, test_tiling);
+
+  return g_test_run ();
+}
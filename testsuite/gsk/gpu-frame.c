@@ -0,0 +1,792 @@
+#include <gtk/gtk.h>
+#include "gsk/gpu/gsknglrendererprivate.h"
+#include "gsk/gpu/gskgpudeviceprivate.h"
+#include "gsk/gpu/gskgpuframeprivate.h"
+#include "gdk/gdkparalleltaskprivate.h"
+#include "../reftests/reftest-compare.h"
+
+#include <string.h>
+
+#define SIZE 200
+
+static const graphene_rect_t viewport = GRAPHENE_RECT_INIT (0, 0, SIZE, SIZE);
+
+static GskRenderer *
+create_renderer (GskRenderer * (* renderer_new) (void))
+{
+  GskRenderer *renderer;
+  GError *error = NULL;
+
+  renderer = renderer_new ();
+  if (!gsk_renderer_realize_for_display (renderer, gdk_display_get_default (), &error))
+    {
+      g_test_skip (error->message);
+      g_error_free (error);
+      g_object_unref (renderer);
+      return NULL;
+    }
+
+  return renderer;
+}
+
+/* Like gsk_gpu_renderer_create_frame(), but we want to hand
+ * our own target and damage to the frame */
+static GskGpuFrame *
+create_frame (GskRenderer         *renderer,
+              GskGpuOptimizations  optimizations)
+{
+  GskGpuRenderer *gpu_renderer = GSK_GPU_RENDERER (renderer);
+  GdkDrawContext *context;
+  GskGpuFrame *frame;
+
+  context = gsk_gpu_renderer_get_context (gpu_renderer);
+  if (GDK_IS_GL_CONTEXT (context))
+    gdk_gl_context_make_current (GDK_GL_CONTEXT (context));
+
+  frame = g_object_new (GSK_GPU_RENDERER_GET_CLASS (gpu_renderer)->frame_type, NULL);
+  gsk_gpu_frame_setup (frame,
+                       gpu_renderer,
+                       gsk_gpu_renderer_get_device (gpu_renderer),
+                       optimizations);
+
+  return frame;
+}
+
+static void
+assert_textures_equal (GdkTexture *expected,
+                       GdkTexture *rendered)
+{
+  GdkTexture *diff;
+
+  diff = reftest_compare_textures (expected, rendered);
+  if (diff)
+    {
+      char *path = g_test_build_filename (G_TEST_BUILT, "gpu-frame-diff.png", NULL);
+
+      gdk_texture_save_to_png (diff, path);
+      g_test_message ("Differences saved to %s", path);
+      g_free (path);
+      g_object_unref (diff);
+      g_test_fail ();
+    }
+}
+
+/* {{{ Damage */
+
+#define MAX_DAMAGE_RECTS 25
+
+typedef struct {
+  gsize n_rects;
+  cairo_rectangle_int_t rects[MAX_DAMAGE_RECTS];
+} DamageTest;
+
+/* The two versions of the scene only differ inside the damage */
+static GskRenderNode *
+create_damage_scene (const DamageTest *test,
+                     gboolean          changed)
+{
+  GskRenderNode *boxes[MAX_DAMAGE_RECTS];
+  GskRenderNode *children[2];
+  GskRenderNode *container, *node;
+  GskTransform *transform;
+  gsize i;
+
+  children[0] = gsk_linear_gradient_node_new (&viewport,
+                                              &GRAPHENE_POINT_INIT (0, 0),
+                                              &GRAPHENE_POINT_INIT (SIZE, SIZE),
+                                              (GskColorStop[2]) {
+                                                { 0, { 1, 0, 0, 1 } },
+                                                { 1, { 0, 0, 1, 1 } },
+                                              },
+                                              2);
+
+  /* Draw the boxes through a container, a translation and an
+   * offscreen, which all walk the damage rectangles */
+  for (i = 0; i < test->n_rects; i++)
+    {
+      const cairo_rectangle_int_t *r = &test->rects[i];
+
+      boxes[i] = gsk_color_node_new (changed ? &(GdkRGBA) { 0, 1, 0, 1 }
+                                             : &(GdkRGBA) { 1, 1, 0, 0.5 },
+                                     &GRAPHENE_RECT_INIT (r->x - 10, r->y - 10,
+                                                          r->width, r->height));
+    }
+  container = gsk_container_node_new (boxes, test->n_rects);
+  for (i = 0; i < test->n_rects; i++)
+    gsk_render_node_unref (boxes[i]);
+
+  transform = gsk_transform_translate (NULL, &GRAPHENE_POINT_INIT (10, 10));
+  node = gsk_transform_node_new (container, transform);
+  gsk_transform_unref (transform);
+  gsk_render_node_unref (container);
+
+  children[1] = gsk_opacity_node_new (node, 0.75);
+  gsk_render_node_unref (node);
+
+  node = gsk_container_node_new (children, 2);
+  gsk_render_node_unref (children[0]);
+  gsk_render_node_unref (children[1]);
+
+  return node;
+}
+
+/* Draws the changed scene over the old one only inside the damage,
+ * and checks that it looks as if the new scene was drawn from scratch */
+static void
+test_damage (gconstpointer data)
+{
+  const DamageTest *test = data;
+  GskRenderer *renderer;
+  GskGpuFrame *frame;
+  GskGpuImage *image;
+  GskRenderNode *before, *after;
+  cairo_region_t *damage;
+  GdkTexture *expected, *rendered;
+
+  renderer = create_renderer (gsk_ngl_renderer_new);
+  if (renderer == NULL)
+    return;
+
+  before = create_damage_scene (test, FALSE);
+  after = create_damage_scene (test, TRUE);
+  damage = cairo_region_create_rectangles (test->rects, test->n_rects);
+
+  expected = gsk_renderer_render_texture (renderer, after, &viewport);
+
+  frame = create_frame (renderer, gsk_gpu_renderer_get_optimizations (GSK_GPU_RENDERER (renderer)));
+  image = gsk_gpu_device_create_download_image (gsk_gpu_renderer_get_device (GSK_GPU_RENDERER (renderer)),
+                                                GDK_MEMORY_U8,
+                                                SIZE, SIZE);
+
+  gsk_gpu_frame_render (frame, g_get_monotonic_time (), image, NULL, before, &viewport, NULL);
+  rendered = NULL;
+  gsk_gpu_frame_render (frame, g_get_monotonic_time (), image, damage, after, &viewport, &rendered);
+  g_assert_nonnull (rendered);
+
+  assert_textures_equal (expected, rendered);
+
+  g_object_unref (rendered);
+  g_object_unref (expected);
+  g_object_unref (image);
+  g_object_unref (frame);
+  cairo_region_destroy (damage);
+  gsk_render_node_unref (after);
+  gsk_render_node_unref (before);
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+}
+
+/* Too far apart to be merged */
+static const DamageTest damage_few = {
+  3, {
+    { 10, 10, 30, 20 },
+    { 150, 20, 40, 40 },
+    { 30, 140, 20, 50 },
+  }
+};
+
+/* Small enough to be merged, and more than fit in one pass */
+static DamageTest damage_grid;
+
+/* }}} */
+/* {{{ Two frames */
+
+typedef GskRenderNode * (* CreateNodeFunc) (void);
+
+static GskRenderNode *
+create_boxes (void)
+{
+  GskRenderNode *boxes[3];
+  GskRenderNode *node;
+  gsize i;
+
+  boxes[0] = gsk_color_node_new (&(GdkRGBA) { 1, 0, 0, 1 }, &GRAPHENE_RECT_INIT (20, 20, 60, 40));
+  boxes[1] = gsk_color_node_new (&(GdkRGBA) { 0, 1, 0, 1 }, &GRAPHENE_RECT_INIT (60, 50, 50, 80));
+  boxes[2] = gsk_color_node_new (&(GdkRGBA) { 0, 0, 1, 0.5 }, &GRAPHENE_RECT_INIT (100, 110, 70, 60));
+  node = gsk_container_node_new (boxes, G_N_ELEMENTS (boxes));
+  for (i = 0; i < G_N_ELEMENTS (boxes); i++)
+    gsk_render_node_unref (boxes[i]);
+
+  return node;
+}
+
+static GskRenderNode *
+create_blur (void)
+{
+  GskRenderNode *child, *node;
+
+  child = create_boxes ();
+  node = gsk_blur_node_new (child, 6);
+  gsk_render_node_unref (child);
+
+  return node;
+}
+
+static GskRenderNode *
+create_shadow (void)
+{
+  GskRenderNode *child, *node;
+
+  child = create_boxes ();
+  node = gsk_shadow_node_new (child, &(GskShadow) { { 0, 0, 0, 0.5 }, 5, 7, 4 }, 1);
+  gsk_render_node_unref (child);
+
+  return node;
+}
+
+static GskRenderNode *
+create_scene_with_background (GskRenderNode *node,
+                              const GdkRGBA *background)
+{
+  GskRenderNode *children[2];
+  GskRenderNode *scene;
+
+  children[0] = gsk_color_node_new (background, &viewport);
+  children[1] = node;
+  scene = gsk_container_node_new (children, 2);
+  gsk_render_node_unref (children[0]);
+
+  return scene;
+}
+
+/* Draws two frames that share a subtree, like an application that
+ * only changed its background. The second frame can reuse what was
+ * done for the subtree in the first frame, and must look the same
+ * as a copy of the subtree that was never drawn before.
+ * All renderers share the device and its caches, so a new renderer
+ * would not do for the comparison. */
+static void
+test_two_frames (gconstpointer data)
+{
+  CreateNodeFunc create_node = (CreateNodeFunc) data;
+  GskRenderer *renderer;
+  GskRenderNode *node, *copy, *first, *second, *reference;
+  GdkTexture *texture, *expected, *rendered;
+
+  renderer = create_renderer (gsk_ngl_renderer_new);
+  if (renderer == NULL)
+    return;
+
+  node = create_node ();
+  copy = create_node ();
+  first = create_scene_with_background (node, &(GdkRGBA) { 1, 1, 1, 1 });
+  second = create_scene_with_background (node, &(GdkRGBA) { 1, 1, 0.5, 1 });
+  reference = create_scene_with_background (copy, &(GdkRGBA) { 1, 1, 0.5, 1 });
+
+  texture = gsk_renderer_render_texture (renderer, first, &viewport);
+  rendered = gsk_renderer_render_texture (renderer, second, &viewport);
+  expected = gsk_renderer_render_texture (renderer, reference, &viewport);
+
+  assert_textures_equal (expected, rendered);
+
+  g_object_unref (expected);
+  g_object_unref (rendered);
+  g_object_unref (texture);
+  gsk_render_node_unref (reference);
+  gsk_render_node_unref (second);
+  gsk_render_node_unref (first);
+  gsk_render_node_unref (copy);
+  gsk_render_node_unref (node);
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+}
+
+/* }}} */
+/* {{{ Retained */
+
+/* Big enough to be retained */
+static GskRenderNode *
+create_grid (float x,
+             float y,
+             float hue)
+{
+  GskRenderNode *cells[16];
+  GskRenderNode *node;
+  gsize i;
+
+  for (i = 0; i < G_N_ELEMENTS (cells); i++)
+    cells[i] = gsk_color_node_new (&(GdkRGBA) { hue, i / 16.f, 1 - hue, 0.8 },
+                                   &GRAPHENE_RECT_INIT (x + 20 * (i % 4), y + 20 * (i / 4), 15, 15));
+  node = gsk_container_node_new (cells, G_N_ELEMENTS (cells));
+  for (i = 0; i < G_N_ELEMENTS (cells); i++)
+    gsk_render_node_unref (cells[i]);
+
+  return node;
+}
+
+/* Retained containers inside a retained container, so the outer
+ * recording references the inner ones */
+static GskRenderNode *
+create_nested_grids (void)
+{
+  GskRenderNode *children[9];
+  GskRenderNode *child, *node;
+  gsize i;
+
+  for (i = 0; i < 8; i++)
+    children[i] = create_grid (5 + 100 * (i % 2), 5 + 50 * (i / 2), i / 8.f);
+
+  child = create_grid (0, 0, 1);
+  children[8] = gsk_transform_node_new (child,
+                                        gsk_transform_rotate (gsk_transform_translate (NULL, &GRAPHENE_POINT_INIT (100, 60)), 30));
+  gsk_render_node_unref (child);
+
+  node = gsk_container_node_new (children, G_N_ELEMENTS (children));
+  for (i = 0; i < G_N_ELEMENTS (children); i++)
+    gsk_render_node_unref (children[i]);
+
+  return node;
+}
+
+/* Subtrees are recorded in the second frame they are drawn in, and
+ * replayed in the third. Both must look the same as a copy of the
+ * subtree, which the renderer has never seen before. */
+static void
+test_retained (void)
+{
+  GskRenderer *renderer;
+  GskRenderNode *node, *copy, *scene, *reference;
+  GdkTexture *expected, *rendered;
+  GdkRGBA background;
+  gsize i;
+
+  renderer = create_renderer (gsk_ngl_renderer_new);
+  if (renderer == NULL)
+    return;
+
+  node = create_nested_grids ();
+
+  for (i = 0; i < 3; i++)
+    {
+      background = (GdkRGBA) { 1, 1, i / 3.f, 1 };
+      scene = create_scene_with_background (node, &background);
+      copy = create_nested_grids ();
+      reference = create_scene_with_background (copy, &background);
+
+      rendered = gsk_renderer_render_texture (renderer, scene, &viewport);
+      expected = gsk_renderer_render_texture (renderer, reference, &viewport);
+      assert_textures_equal (expected, rendered);
+
+      g_object_unref (expected);
+      g_object_unref (rendered);
+      gsk_render_node_unref (reference);
+      gsk_render_node_unref (copy);
+      gsk_render_node_unref (scene);
+    }
+
+  gsk_render_node_unref (node);
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+}
+
+/* }}} */
+/* {{{ Parallel */
+
+static GskRenderNode *
+create_text (int x,
+             int y)
+{
+  GskRenderNode *node;
+  GBytes *bytes;
+  char *s;
+
+  s = g_strdup_printf ("text { font: \"Sans 10\"; glyphs: \"Gtk\"; offset: %d %d; }", x, y);
+  bytes = g_bytes_new_take (s, strlen (s));
+  node = gsk_render_node_deserialize (bytes, NULL, NULL);
+  g_assert_nonnull (node);
+  g_bytes_unref (bytes);
+
+  return node;
+}
+
+static GdkTexture *
+create_checkerboard (void)
+{
+  GdkTexture *texture;
+  GBytes *bytes;
+  guint32 *pixels;
+  gsize x, y;
+
+  pixels = g_new (guint32, 64 * 64);
+  for (y = 0; y < 64; y++)
+    for (x = 0; x < 64; x++)
+      pixels[y * 64 + x] = ((x / 4 + y / 4) % 2) ? 0xFFFF00FF : 0xFF00FFFF;
+
+  bytes = g_bytes_new_take (pixels, 64 * 64 * sizeof (guint32));
+  texture = gdk_memory_texture_new (64, 64, GDK_MEMORY_DEFAULT, bytes, 64 * sizeof (guint32));
+  g_bytes_unref (bytes);
+
+  return texture;
+}
+
+#define CELL_SIZE 25
+
+/* Enough children of enough kinds to be recorded by several threads
+ * that all need uploads, mipmaps, glyphs and offscreens */
+static GskRenderNode *
+create_parallel_scene (void)
+{
+  GskRenderNode *children[(SIZE / CELL_SIZE) * (SIZE / CELL_SIZE)];
+  GskRenderNode *node, *child;
+  GdkTexture *texture;
+  graphene_rect_t bounds;
+  gsize i, n;
+
+  texture = create_checkerboard ();
+
+  n = 0;
+  for (i = 0; i < G_N_ELEMENTS (children); i++)
+    {
+      int x = (i % (SIZE / CELL_SIZE)) * CELL_SIZE;
+      int y = (i / (SIZE / CELL_SIZE)) * CELL_SIZE;
+
+      bounds = GRAPHENE_RECT_INIT (x, y, CELL_SIZE, CELL_SIZE);
+
+      switch (i % 5)
+        {
+        case 0:
+          children[n++] = gsk_color_node_new (&(GdkRGBA) { i / 64.f, 0.5, 0, 1 }, &bounds);
+          break;
+
+        case 1:
+          children[n++] = gsk_linear_gradient_node_new (&bounds,
+                                                        &GRAPHENE_POINT_INIT (x, y),
+                                                        &GRAPHENE_POINT_INIT (x + CELL_SIZE, y + CELL_SIZE),
+                                                        (GskColorStop[2]) {
+                                                          { 0, { 1, 1, 0, 1 } },
+                                                          { 1, { 0, 1, 1, 1 } },
+                                                        },
+                                                        2);
+          break;
+
+        case 2:
+          /* The same texture everywhere, scaled down so it needs mipmaps */
+          children[n++] = gsk_texture_scale_node_new (texture, &bounds, GSK_SCALING_FILTER_TRILINEAR);
+          break;
+
+        case 3:
+          child = gsk_color_node_new (&(GdkRGBA) { 0, 0, 1, 1 },
+                                      &GRAPHENE_RECT_INIT (x + 5, y + 5, CELL_SIZE - 10, CELL_SIZE - 10));
+          children[n++] = gsk_blur_node_new (child, 3);
+          gsk_render_node_unref (child);
+          break;
+
+        case 4:
+          children[n++] = create_text (x, y + 18);
+          break;
+
+        default:
+          g_assert_not_reached ();
+        }
+    }
+
+  node = gsk_container_node_new (children, n);
+  for (i = 0; i < n; i++)
+    gsk_render_node_unref (children[i]);
+  g_object_unref (texture);
+
+  return node;
+}
+
+static GdkTexture *
+render_frame (GskRenderer         *renderer,
+              GskRenderNode       *node,
+              GskGpuOptimizations  optimizations)
+{
+  GskGpuFrame *frame;
+  GskGpuImage *image;
+  GdkTexture *texture = NULL;
+
+  frame = create_frame (renderer, optimizations);
+  image = gsk_gpu_device_create_download_image (gsk_gpu_renderer_get_device (GSK_GPU_RENDERER (renderer)),
+                                                GDK_MEMORY_U8,
+                                                SIZE, SIZE);
+
+  gsk_gpu_frame_render (frame, g_get_monotonic_time (), image, NULL, node, &viewport, &texture);
+  g_assert_nonnull (texture);
+
+  g_object_unref (image);
+  g_object_unref (frame);
+
+  return texture;
+}
+
+/* Recording in parallel must give the same result as recording
+ * on one thread, also in the next frame when things are cached */
+static void
+test_parallel (void)
+{
+  GskRenderer *serial_renderer, *parallel_renderer;
+  GskGpuOptimizations optimizations;
+  GskRenderNode *node;
+  GdkTexture *serial, *parallel;
+  int i;
+
+  if (gdk_parallel_task_get_n_threads () <= 1)
+    {
+      g_test_skip ("Recording is only parallel with more than one thread");
+      return;
+    }
+
+  /* The ngl renderer never records in parallel */
+  parallel_renderer = create_renderer (gsk_vulkan_renderer_new);
+  if (parallel_renderer == NULL)
+    return;
+  optimizations = gsk_gpu_renderer_get_optimizations (GSK_GPU_RENDERER (parallel_renderer));
+  if (!(optimizations & GSK_GPU_OPTIMIZE_PARALLEL))
+    {
+      g_test_skip ("Parallel recording is disabled");
+      gsk_renderer_unrealize (parallel_renderer);
+      g_object_unref (parallel_renderer);
+      return;
+    }
+  serial_renderer = create_renderer (gsk_vulkan_renderer_new);
+  g_assert_nonnull (serial_renderer);
+
+  node = create_parallel_scene ();
+  serial = render_frame (serial_renderer, node, optimizations & ~GSK_GPU_OPTIMIZE_PARALLEL);
+
+  for (i = 0; i < 2; i++)
+    {
+      parallel = render_frame (parallel_renderer, node, optimizations);
+      assert_textures_equal (serial, parallel);
+      g_object_unref (parallel);
+    }
+
+  g_object_unref (serial);
+  gsk_render_node_unref (node);
+  gsk_renderer_unrealize (serial_renderer);
+  g_object_unref (serial_renderer);
+  gsk_renderer_unrealize (parallel_renderer);
+  g_object_unref (parallel_renderer);
+}
+
+/* }}} */
+/* {{{ Atlas compaction */
+
+/* Glyphs drawn on top of each other, so they all fit in the viewport */
+static GskRenderNode *
+create_glyphs (int   size,
+               guint n_glyphs)
+{
+  PangoFontMap *fontmap;
+  PangoContext *context;
+  PangoFontDescription *desc;
+  PangoFont *font;
+  PangoGlyphString *glyphs;
+  GskRenderNode *node;
+  guint i;
+
+  fontmap = pango_cairo_font_map_get_default ();
+  context = pango_font_map_create_context (fontmap);
+  desc = pango_font_description_from_string ("Sans");
+  pango_font_description_set_absolute_size (desc, size * PANGO_SCALE);
+  font = pango_font_map_load_font (fontmap, context, desc);
+  g_assert_nonnull (font);
+
+  glyphs = pango_glyph_string_new ();
+  pango_glyph_string_set_size (glyphs, n_glyphs);
+  for (i = 0; i < n_glyphs; i++)
+    glyphs->glyphs[i] = (PangoGlyphInfo) { 36 + i, { 0, 0, 0 }, { 1 } };
+
+  node = gsk_text_node_new (font, glyphs, &(GdkRGBA) { 0, 0, 0, 1 }, &GRAPHENE_POINT_INIT (10, SIZE - 20));
+  g_assert_nonnull (node);
+
+  pango_glyph_string_free (glyphs);
+  g_object_unref (font);
+  pango_font_description_free (desc);
+  g_object_unref (context);
+
+  return node;
+}
+
+/* Fills more atlases than the budget allows, so the atlas holding
+ * the glyphs of the first frame gets compacted. The glyphs must
+ * still draw the same from their new place. */
+static void
+test_atlas_compaction (void)
+{
+  GskRenderer *renderer;
+  GskRenderNode *text, *node;
+  GdkTexture *expected, *rendered, *texture;
+  int i;
+
+  renderer = create_renderer (gsk_ngl_renderer_new);
+  if (renderer == NULL)
+    return;
+
+  text = create_text (20, 50);
+  expected = gsk_renderer_render_texture (renderer, text, &viewport);
+
+  /* 40 big glyphs per frame, in a new size each time */
+  for (i = 0; i < 12; i++)
+    {
+      node = create_glyphs (150 + i, 40);
+      texture = gsk_renderer_render_texture (renderer, node, &viewport);
+      g_object_unref (texture);
+      gsk_render_node_unref (node);
+    }
+
+  rendered = gsk_renderer_render_texture (renderer, text, &viewport);
+  assert_textures_equal (expected, rendered);
+
+  g_object_unref (rendered);
+  g_object_unref (expected);
+  gsk_render_node_unref (text);
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+}
+
+/* }}} */
+/* {{{ Paths */
+
+static const char round_join_node[] =
+  "stroke {\n"
+  "  child: color { bounds: 0 0 200 200; color: rgb(0,0,255); }\n"
+  "  path: \"M 20 160 L 60 40 L 100 160 L 140 40 L 180 160\";\n"
+  "  line-width: 12;\n"
+  "  line-cap: round;\n"
+  "  line-join: round;\n"
+  "}";
+
+static const char even_odd_node[] =
+  "fill {\n"
+  "  child: color { bounds: 0 0 200 200; color: rgb(255,0,0); }\n"
+  "  path: \"M 100 10 L 153 175 L 14 73 L 186 73 L 47 175 Z\";\n"
+  "  fill-rule: even-odd;\n"
+  "}";
+
+static const char rotated_node[] =
+  "transform {\n"
+  "  transform: translate(100, 100) rotate(30);\n"
+  "  child: stroke {\n"
+  "    child: color { bounds: -100 -100 200 200; color: rgb(0,128,0); }\n"
+  "    path: \"M -70 0 C -70 -60 70 -60 70 0 C 70 60 -30 40 -30 0\";\n"
+  "    line-width: 9;\n"
+  "    line-cap: round;\n"
+  "    line-join: round;\n"
+  "  }\n"
+  "}";
+
+static const char scaled_node[] =
+  "transform {\n"
+  "  transform: scale(2.5);\n"
+  "  child: stroke {\n"
+  "    child: color { bounds: 0 0 80 80; color: rgb(128,0,128); }\n"
+  "    path: \"M 10 40 C 10 10 40 10 40 40 S 70 70 70 40\";\n"
+  "    line-width: 3;\n"
+  "    line-cap: round;\n"
+  "    line-join: round;\n"
+  "  }\n"
+  "}";
+
+/* The shader computes the coverage of the edges differently than
+ * Cairo, so only a bit of difference in the antialiasing is fine */
+#define PATH_TOLERANCE 24
+
+static void
+assert_textures_close (GdkTexture *expected,
+                       GdkTexture *rendered,
+                       guint       tolerance)
+{
+  guchar *data1, *data2;
+  gsize i, n_bytes;
+  guint max_diff;
+
+  n_bytes = 4 * SIZE * SIZE;
+  data1 = g_malloc (n_bytes);
+  data2 = g_malloc (n_bytes);
+  gdk_texture_download (expected, data1, 4 * SIZE);
+  gdk_texture_download (rendered, data2, 4 * SIZE);
+
+  max_diff = 0;
+  for (i = 0; i < n_bytes; i++)
+    max_diff = MAX (max_diff, (guint) ABS (data1[i] - data2[i]));
+
+  if (max_diff > tolerance)
+    {
+      g_test_message ("Pixels differ by up to %u", max_diff);
+      assert_textures_equal (expected, rendered);
+    }
+
+  g_free (data1);
+  g_free (data2);
+}
+
+/* Paths drawn with the path shader must look like the ones that
+ * Cairo rasterizes */
+static void
+test_path (gconstpointer data)
+{
+  const char *text = data;
+  GskRenderer *renderer;
+  GskGpuOptimizations optimizations;
+  GskRenderNode *node;
+  GdkTexture *cairo, *shader;
+  GBytes *bytes;
+
+  renderer = create_renderer (gsk_ngl_renderer_new);
+  if (renderer == NULL)
+    return;
+  optimizations = gsk_gpu_renderer_get_optimizations (GSK_GPU_RENDERER (renderer));
+  if (!(optimizations & GSK_GPU_OPTIMIZE_PATHS))
+    {
+      g_test_skip ("Drawing paths with shaders is disabled");
+      gsk_renderer_unrealize (renderer);
+      g_object_unref (renderer);
+      return;
+    }
+
+  bytes = g_bytes_new_static (text, strlen (text));
+  node = gsk_render_node_deserialize (bytes, NULL, NULL);
+  g_assert_nonnull (node);
+  g_bytes_unref (bytes);
+
+  cairo = render_frame (renderer, node, optimizations & ~GSK_GPU_OPTIMIZE_PATHS);
+  shader = render_frame (renderer, node, optimizations);
+  assert_textures_close (cairo, shader, PATH_TOLERANCE);
+
+  g_object_unref (shader);
+  g_object_unref (cairo);
+  gsk_render_node_unref (node);
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+}
+
+/* }}} */
+
+int
+main (int argc, char *argv[])
+{
+  gsize x, y;
+
+  /* Make sure there are threads to record with */
+  g_setenv ("GDK_MAX_THREADS", "4", FALSE);
+
+  gtk_test_init (&argc, &argv, NULL);
+
+  for (y = 0; y < 5; y++)
+    for (x = 0; x < 5; x++)
+      damage_grid.rects[damage_grid.n_rects++] = (cairo_rectangle_int_t) { 5 + 40 * x, 5 + 40 * y, 9, 9 };
+
+  g_test_add_data_func ("/gpu/damage/few", &damage_few, test_damage);
+  g_test_add_data_func ("/gpu/damage/grid", &damage_grid, test_damage);
+
+  /* Offscreens of these are kept in the node cache */
+  g_test_add_data_func ("/gpu/two-frames/blur", create_blur, test_two_frames);
+  g_test_add_data_func ("/gpu/two-frames/shadow", create_shadow, test_two_frames);
+
+  g_test_add_func ("/gpu/retained", test_retained);
+  g_test_add_func ("/gpu/parallel", test_parallel);
+
+  g_test_add_func ("/gpu/atlas-compaction", test_atlas_compaction);
+
+  g_test_add_data_func ("/gpu/path/round-join", round_join_node, test_path);
+  g_test_add_data_func ("/gpu/path/even-odd", even_odd_node, test_path);
+  g_test_add_data_func ("/gpu/path/rotated", rotated_node, test_path);
+  g_test_add_data_func ("/gpu/path/scaled", scaled_node, test_path);
+
+  return g_test_run ();
+}
+
+/* vim:set foldmethod=marker: */
@@ -21,6 +21,7 @@
 #include "config.h"
 
 #include <gtk/gtk.h>
+#include "gsk/gskrendernodebinaryprivate.h"
 
 static char *
 test_get_reference_file (const char *node_file)
@@ -156,6 +157,52 @@ deserialize_error_func (const GskParseLocation *start,
   g_string_append_c (errors, '\n');
 }
 
+/* The binary format must reproduce the node exactly, so
+ * printing the reloaded node must give the same text.
+ */
+static gboolean
+check_binary_roundtrip (GskRenderNode *node,
+                        GBytes        *text)
+{
+  GskRenderNode *reloaded;
+  GString *errors;
+  GBytes *binary, *bytes;
+  gboolean result = TRUE;
+
+  binary = gsk_render_node_serialize_binary (node);
+  g_assert_true (gsk_render_node_is_binary (binary));
+
+  errors = g_string_new ("");
+  reloaded = gsk_render_node_deserialize (binary, deserialize_error_func, errors);
+  g_bytes_unref (binary);
+
+  if (errors->str[0])
+    {
+      g_print ("Unexpected errors loading binary node:\n%s\n", errors->str);
+      result = FALSE;
+    }
+  g_string_free (errors, TRUE);
+
+  if (reloaded == NULL)
+    {
+      g_print ("Failed to load binary node\n");
+      return FALSE;
+    }
+
+  bytes = gsk_render_node_serialize (reloaded);
+  gsk_render_node_unref (reloaded);
+
+  if (!g_bytes_equal (bytes, text))
+    {
+      g_print ("Binary roundtrip doesn't match:\n%s\n",
+               (const char *) g_bytes_get_data (bytes, NULL));
+      result = FALSE;
+    }
+  g_bytes_unref (bytes);
+
+  return result;
+}
+
 static gboolean
 parse_node_file (GFile *file, gboolean generate)
 {
@@ -180,16 +227,19 @@ parse_node_file (GFile *file, gboolean generate)
   node = gsk_render_node_deserialize (bytes, deserialize_error_func, errors);
   g_bytes_unref (bytes);
   bytes = gsk_render_node_serialize (node);
-  gsk_render_node_unref (node);
 
   if (generate)
     {
       g_print ("%s", (char *) g_bytes_get_data (bytes, NULL));
+      gsk_render_node_unref (node);
       g_bytes_unref (bytes);
       g_string_free (errors, TRUE);
       return TRUE;
     }
 
+  result &= check_binary_roundtrip (node, bytes);
+  gsk_render_node_unref (node);
+
   node_file = g_file_get_path (file);
   reference_file = test_get_reference_file (node_file);
 
@@ -0,0 +1,351 @@
+/* Benchmarks for saving and loading render nodes in the text
+ * and the binary format.
+ *
+ * Pass --file to add recordings from the inspector to the
+ * synthetic scene.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtk/gtk.h>
+
+#include "gsk/gskrendernodebinaryprivate.h"
+
+#include "testsuite/benchmarkutils.h"
+
+/* {{{ Options */
+
+static int grid = 100;
+static char **files = NULL;
+
+static const GOptionEntry entries[] = {
+  { "grid", 0, 0, G_OPTION_ARG_INT, &grid, "Number of rows and columns in the synthetic scene", "SIZE" },
+  { "file", 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &files, "Add a node file to test", "FILE" },
+  { NULL, }
+};
+
+typedef struct {
+  char *name;
+  GskRenderNode *node;
+  GBytes *text;
+  GBytes *binary;
+} Scene;
+
+/* }}} */
+/* {{{ Scenes */
+
+static GdkTexture *
+create_texture (int size)
+{
+  GdkTexture *texture;
+  GBytes *bytes;
+  guint8 *data;
+  int x, y;
+
+  data = g_malloc (4 * size * size);
+  for (y = 0; y < size; y++)
+    {
+      for (x = 0; x < size; x++)
+        {
+          guint8 *p = data + 4 * (y * size + x);
+
+          p[0] = x * 255 / size;
+          p[1] = y * 255 / size;
+          p[2] = ((x + y) & 0x8) ? 200 : 50;
+          p[3] = 255;
+        }
+    }
+
+  bytes = g_bytes_new_take (data, 4 * size * size);
+  texture = gdk_memory_texture_new (size, size,
+                                    GDK_MEMORY_R8G8B8A8,
+                                    bytes, 4 * size);
+  g_bytes_unref (bytes);
+
+  return texture;
+}
+
+static GskRenderNode *
+create_text_node (PangoContext  *context,
+                  const char    *text,
+                  const GdkRGBA *color,
+                  float          x,
+                  float          y)
+{
+  PangoLayout *layout;
+  PangoLayoutIter *iter;
+  PangoLayoutRun *run;
+  GskRenderNode *node = NULL;
+
+  layout = pango_layout_new (context);
+  pango_layout_set_text (layout, text, -1);
+
+  iter = pango_layout_get_iter (layout);
+  run = pango_layout_iter_get_run_readonly (iter);
+  if (run)
+    node = gsk_text_node_new (run->item->analysis.font,
+                              run->glyphs,
+                              color,
+                              &GRAPHENE_POINT_INIT (x, y + 12));
+
+  pango_layout_iter_free (iter);
+  g_object_unref (layout);
+
+  return node;
+}
+
+/* Something that looks like a typical widget tree: lots of
+ * backgrounds, borders, clips and labels, with a few icons,
+ * gradients and paths thrown in.
+ */
+static GskRenderNode *
+create_synthetic_scene (int size)
+{
+  PangoContext *context;
+  GdkTexture *texture;
+  GskPath *path;
+  GskStroke *stroke;
+  GPtrArray *cells;
+  GskRenderNode *node;
+  int x, y;
+
+  context = pango_font_map_create_context (pango_cairo_font_map_get_default ());
+  texture = create_texture (32);
+  path = gsk_path_parse ("M 2 12 C 2 4 22 4 22 12 C 22 20 2 20 2 12 Z M 8 8 L 16 16");
+  stroke = gsk_stroke_new (1.5);
+
+  cells = g_ptr_array_new_with_free_func ((GDestroyNotify) gsk_render_node_unref);
+  for (y = 0; y < size; y++)
+    {
+      for (x = 0; x < size; x++)
+        {
+          GskRenderNode *children[6];
+          GskRenderNode *child;
+          GskRoundedRect outline;
+          GskTransform *transform;
+          GdkRGBA color = { (x % 16) / 15.f, (y % 16) / 15.f, 0.5, 1 };
+          GskColorStop stops[] = {
+            { 0, { 1, 1, 1, 1 } },
+            { 1, color },
+          };
+          char *label;
+          guint n = 0;
+
+          gsk_rounded_rect_init_from_rect (&outline, &GRAPHENE_RECT_INIT (0, 0, 120, 40), 6);
+
+          children[n++] = gsk_color_node_new (&color, &outline.bounds);
+          children[n++] = gsk_linear_gradient_node_new (&GRAPHENE_RECT_INIT (0, 0, 120, 20),
+                                                        &GRAPHENE_POINT_INIT (0, 0),
+                                                        &GRAPHENE_POINT_INIT (0, 20),
+                                                        stops, G_N_ELEMENTS (stops));
+          children[n++] = gsk_border_node_new (&outline,
+                                               (float[4]) { 1, 1, 1, 1 },
+                                               (GdkRGBA[4]) {
+                                                 { 0, 0, 0, 0.3 }, { 0, 0, 0, 0.3 },
+                                                 { 0, 0, 0, 0.5 }, { 0, 0, 0, 0.3 },
+                                               });
+
+          transform = gsk_transform_translate (NULL, &GRAPHENE_POINT_INIT (4, 8));
+          child = gsk_texture_node_new (texture, &GRAPHENE_RECT_INIT (0, 0, 24, 24));
+          children[n++] = gsk_transform_node_new (child, transform);
+          gsk_render_node_unref (child);
+          gsk_transform_unref (transform);
+
+          label = g_strdup_printf ("Item %d, %d", x, y);
+          child = create_text_node (context, label, &(GdkRGBA) { 0, 0, 0, 1 }, 32, 8);
+          g_free (label);
+          if (child)
+            children[n++] = child;
+
+          if ((x + y) % 4 == 0)
+            {
+              child = gsk_color_node_new (&(GdkRGBA) { 0.2, 0.4, 0.8, 1 },
+                                          &GRAPHENE_RECT_INIT (96, 8, 24, 24));
+              if (x % 2)
+                children[n++] = gsk_stroke_node_new (child, path, stroke);
+              else
+                children[n++] = gsk_fill_node_new (child, path, GSK_FILL_RULE_WINDING);
+              gsk_render_node_unref (child);
+            }
+
+          node = gsk_container_node_new (children, n);
+          for (guint i = 0; i < n; i++)
+            gsk_render_node_unref (children[i]);
+
+          child = gsk_rounded_clip_node_new (node, &outline);
+          gsk_render_node_unref (node);
+
+          transform = gsk_transform_translate (NULL, &GRAPHENE_POINT_INIT (x * 130, y * 50));
+          node = gsk_transform_node_new (child, transform);
+          gsk_render_node_unref (child);
+          gsk_transform_unref (transform);
+
+          g_ptr_array_add (cells, node);
+        }
+    }
+
+  node = gsk_container_node_new ((GskRenderNode **) cells->pdata, cells->len);
+
+  g_ptr_array_unref (cells);
+  gsk_stroke_free (stroke);
+  gsk_path_unref (path);
+  g_object_unref (texture);
+  g_object_unref (context);
+
+  return node;
+}
+
+static Scene *
+scene_new (const char    *name,
+           GskRenderNode *node)
+{
+  Scene *scene;
+  GskRenderNode *reloaded;
+  GBytes *bytes;
+
+  scene = g_new0 (Scene, 1);
+  scene->name = g_strdup (name);
+  scene->node = node;
+  scene->text = gsk_render_node_serialize (node);
+  scene->binary = gsk_render_node_serialize_binary (node);
+
+  /* Make sure we're comparing the same thing */
+  reloaded = gsk_render_node_deserialize (scene->binary, NULL, NULL);
+  g_assert_nonnull (reloaded);
+  bytes = gsk_render_node_serialize (reloaded);
+  g_assert_true (g_bytes_equal (bytes, scene->text));
+  g_bytes_unref (bytes);
+  gsk_render_node_unref (reloaded);
+
+  return scene;
+}
+
+static void
+scene_free (Scene *scene)
+{
+  g_free (scene->name);
+  gsk_render_node_unref (scene->node);
+  g_bytes_unref (scene->text);
+  g_bytes_unref (scene->binary);
+  g_free (scene);
+}
+
+/* }}} */
+/* {{{ Benchmarks */
+
+static void
+save_text (gpointer data)
+{
+  Scene *scene = data;
+
+  g_bytes_unref (gsk_render_node_serialize (scene->node));
+}
+
+static void
+save_binary (gpointer data)
+{
+  Scene *scene = data;
+
+  g_bytes_unref (gsk_render_node_serialize_binary (scene->node));
+}
+
+static void
+load_text (gpointer data)
+{
+  Scene *scene = data;
+
+  gsk_render_node_unref (gsk_render_node_deserialize (scene->text, NULL, NULL));
+}
+
+static void
+load_binary (gpointer data)
+{
+  Scene *scene = data;
+
+  gsk_render_node_unref (gsk_render_node_deserialize (scene->binary, NULL, NULL));
+}
+
+static void
+benchmark_scene (Scene *scene)
+{
+  gsize text_size = g_bytes_get_size (scene->text);
+  gsize binary_size = g_bytes_get_size (scene->binary);
+
+  benchmark_run ("save", "text", scene->name, BENCHMARK_UNIT_BYTES, text_size, save_text, scene);
+  benchmark_run ("save", "binary", scene->name, BENCHMARK_UNIT_BYTES, binary_size, save_binary, scene);
+  benchmark_run ("load", "text", scene->name, BENCHMARK_UNIT_BYTES, text_size, load_text, scene);
+  benchmark_run ("load", "binary", scene->name, BENCHMARK_UNIT_BYTES, binary_size, load_binary, scene);
+}
+
+/* }}} */
+
+int
+main (int argc, char *argv[])
+{
+  GError *error = NULL;
+  GPtrArray *scenes;
+  guint i;
+
+  benchmark_init (&argc, &argv, entries,
+                  "Benchmark saving and loading render nodes.\n"
+                  "Groups are save and load, names are text and binary.");
+
+  if (benchmark_is_quick ())
+    grid = 4;
+
+  if (grid < 1)
+    {
+      g_printerr ("Need at least one cell\n");
+      exit (1);
+    }
+
+  scenes = g_ptr_array_new_with_free_func ((GDestroyNotify) scene_free);
+  g_ptr_array_add (scenes, scene_new ("synthetic", create_synthetic_scene (grid)));
+
+  for (i = 0; files && files[i]; i++)
+    {
+      GskRenderNode *node;
+      GFile *file;
+      GBytes *bytes;
+      char *name;
+
+      file = g_file_new_for_commandline_arg (files[i]);
+      bytes = g_file_load_bytes (file, NULL, NULL, &error);
+      g_object_unref (file);
+      if (bytes == NULL)
+        {
+          g_printerr ("%s\n", error->message);
+          exit (1);
+        }
+
+      node = gsk_render_node_deserialize (bytes, NULL, NULL);
+      g_bytes_unref (bytes);
+      if (node == NULL)
+        {
+          g_printerr ("Failed to load %s\n", files[i]);
+          exit (1);
+        }
+
+      name = g_path_get_basename (files[i]);
+      g_ptr_array_add (scenes, scene_new (name, node));
+      g_free (name);
+    }
+
+  benchmark_begin ();
+
+  for (i = 0; i < scenes->len; i++)
+    benchmark_scene (g_ptr_array_index (scenes, i));
+
+  benchmark_end ();
+
+  g_ptr_array_unref (scenes);
+  g_strfreev (files);
+
+  return 0;
+}
+
+/* vim:set foldmethod=marker: */
@@ -17,9 +17,13 @@
  * Authors: Matthias Clasen <mclasen@redhat.com>
  */
 
+#include <stdlib.h>
+
 #include <gtk/gtk.h>
 #include "gsk/gskpathprivate.h"
 #include "gsk/gskcontourprivate.h"
+#include "gsk/gskpathindexprivate.h"
+#include "gsk/gskpathmeasureprivate.h"
 
 static gboolean
 add_segment (GskPathOperation        op,
@@ -263,6 +267,200 @@ test_rect_winding (void)
   gsk_path_unref (path1);
 }
 
+/* Big contours get split into curves by the index, small
+ * ones and shapes are kept whole, so we want both.
+ */
+static GskPath *
+create_index_test_path (void)
+{
+  GskPathBuilder *builder;
+  GskRoundedRect rect;
+
+  builder = gsk_path_builder_new ();
+
+  for (int i = 0; i < 10; i++)
+    {
+      int n = g_test_rand_bit () ? g_test_rand_int_range (2, 8) : g_test_rand_int_range (20, 200);
+
+      gsk_path_builder_move_to (builder,
+                                g_test_rand_double_range (0, 1000),
+                                g_test_rand_double_range (0, 1000));
+      for (int j = 0; j < n; j++)
+        {
+          float x = g_test_rand_double_range (0, 1000);
+          float y = g_test_rand_double_range (0, 1000);
+
+          switch (g_test_rand_int_range (0, 4))
+            {
+            case 0:
+              gsk_path_builder_line_to (builder, x, y);
+              break;
+            case 1:
+              gsk_path_builder_quad_to (builder, y, x, x, y);
+              break;
+            case 2:
+              gsk_path_builder_cubic_to (builder, x, x, y, y, x, y);
+              break;
+            case 3:
+              gsk_path_builder_conic_to (builder, y, x, x, y, g_test_rand_double_range (0.2, 20));
+              break;
+            default:
+              g_assert_not_reached ();
+            }
+        }
+      if (g_test_rand_bit ())
+        gsk_path_builder_close (builder);
+    }
+
+  gsk_path_builder_add_circle (builder, &GRAPHENE_POINT_INIT (300, 300), 100);
+  gsk_path_builder_add_rect (builder, &GRAPHENE_RECT_INIT (500, 100, 200, 300));
+  gsk_rounded_rect_init_from_rect (&rect, &GRAPHENE_RECT_INIT (100, 600, 300, 200), 20);
+  gsk_path_builder_add_rounded_rect (builder, &rect);
+  gsk_path_builder_move_to (builder, 800, 800);
+
+  return gsk_path_builder_free_to_path (builder);
+}
+
+static void
+test_index_winding (void)
+{
+  for (int i = 0; i < 10; i++)
+    {
+      GskPath *path = create_index_test_path ();
+      GskPathIndex *index = gsk_path_index_new (path);
+
+      for (int j = 0; j < 1000; j++)
+        {
+          graphene_point_t point = GRAPHENE_POINT_INIT (g_test_rand_double_range (-100, 1100),
+                                                        g_test_rand_double_range (-100, 1100));
+          int winding = 0;
+
+          for (gsize k = 0; k < gsk_path_get_n_contours (path); k++)
+            winding += gsk_contour_get_winding (gsk_path_get_contour (path, k), &point);
+
+          g_assert_cmpint (gsk_path_index_get_winding (index, &point), ==, winding);
+        }
+
+      gsk_path_index_free (index);
+      gsk_path_unref (path);
+    }
+}
+
+static void
+test_index_closest_point (void)
+{
+  for (int i = 0; i < 10; i++)
+    {
+      GskPath *path = create_index_test_path ();
+      GskPathIndex *index = gsk_path_index_new (path);
+
+      for (int j = 0; j < 200; j++)
+        {
+          graphene_point_t point = GRAPHENE_POINT_INIT (g_test_rand_double_range (-100, 1100),
+                                                        g_test_rand_double_range (-100, 1100));
+          float threshold = g_test_rand_bit () ? INFINITY : g_test_rand_double_range (0, 50);
+          GskPathPoint result1, result2;
+          graphene_point_t pos1, pos2;
+          float dist1, dist2;
+          gboolean found1, found2;
+
+          found1 = FALSE;
+          dist1 = threshold;
+          for (gsize k = 0; k < gsk_path_get_n_contours (path); k++)
+            {
+              float dist;
+
+              if (gsk_contour_get_closest_point (gsk_path_get_contour (path, k), &point, dist1, &result1, &dist))
+                {
+                  found1 = TRUE;
+                  result1.contour = k;
+                  dist1 = dist;
+                  gsk_path_point_get_position (&result1, path, &pos1);
+                }
+            }
+
+          found2 = gsk_path_index_get_closest_point (index, &point, threshold, &result2, &dist2);
+
+          g_assert_cmpint (found1, ==, found2);
+          if (!found1)
+            continue;
+
+          gsk_path_point_get_position (&result2, path, &pos2);
+          g_assert_cmpfloat_with_epsilon (dist1, dist2, 0.001);
+          g_assert_cmpfloat_with_epsilon (pos1.x, pos2.x, 0.01);
+          g_assert_cmpfloat_with_epsilon (pos1.y, pos2.y, 0.01);
+        }
+
+      gsk_path_index_free (index);
+      gsk_path_unref (path);
+    }
+}
+
+static int
+compare_float (gconstpointer a,
+               gconstpointer b)
+{
+  float fa = *(const float *) a;
+  float fb = *(const float *) b;
+
+  return fa < fb ? -1 : fa > fb;
+}
+
+static void
+test_measure_sample (void)
+{
+  for (int i = 0; i < 10; i++)
+    {
+      GskPath *path = create_index_test_path ();
+      GskPathMeasure *measure = gsk_path_measure_new_with_tolerance (path, g_test_rand_double_range (0.1, 1));
+      float length = gsk_path_measure_get_length (measure);
+      gsize n_distances = 500;
+      float *distances = g_new (float, n_distances);
+      GskPathPoint *points = g_new (GskPathPoint, n_distances);
+      graphene_point_t *positions = g_new (graphene_point_t, n_distances);
+      graphene_vec2_t *tangents = g_new (graphene_vec2_t, n_distances);
+      GskPathDirection direction = g_test_rand_int_range (GSK_PATH_FROM_START, GSK_PATH_FROM_END + 1);
+
+      for (gsize j = 0; j < n_distances; j++)
+        distances[j] = g_test_rand_double_range (-10, length + 10);
+
+      /* Test sorted distances most of the time, since that is the
+       * common case, but make sure that unsorted ones work too
+       */
+      if (i % 3 != 0)
+        qsort (distances, n_distances, sizeof (float), compare_float);
+
+      if (g_test_rand_bit ())
+        gsk_path_measure_prepare (measure);
+
+      g_assert_true (gsk_path_measure_sample (measure, distances, n_distances, direction, points, positions, tangents));
+
+      for (gsize j = 0; j < n_distances; j++)
+        {
+          GskPathPoint point;
+          graphene_point_t pos;
+          graphene_vec2_t tangent;
+
+          g_assert_true (gsk_path_measure_get_point (measure, distances[j], &point));
+          gsk_path_point_get_position (&point, path, &pos);
+          gsk_path_point_get_tangent (&point, path, direction, &tangent);
+
+          g_assert_cmpint (points[j].contour, ==, point.contour);
+          g_assert_cmpfloat_with_epsilon (positions[j].x, pos.x, 0.01);
+          g_assert_cmpfloat_with_epsilon (positions[j].y, pos.y, 0.01);
+          g_assert_cmpfloat_with_epsilon (graphene_vec2_get_x (&tangents[j]), graphene_vec2_get_x (&tangent), 0.01);
+          g_assert_cmpfloat_with_epsilon (graphene_vec2_get_y (&tangents[j]), graphene_vec2_get_y (&tangent), 0.01);
+        }
+
+      g_free (distances);
+      g_free (points);
+      g_free (positions);
+      g_free (tangents);
+      gsk_path_measure_unref (measure);
+      gsk_path_unref (path);
+    }
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -274,6 +472,9 @@ main (int argc, char *argv[])
   g_test_add_func ("/path/rounded-rect/winding", test_rounded_rect_winding);
   g_test_add_func ("/path/rect/roundtrip", test_rect_roundtrip);
   g_test_add_func ("/path/rect/winding", test_rect_winding);
+  g_test_add_func ("/path/index/winding", test_index_winding);
+  g_test_add_func ("/path/index/closest-point", test_index_closest_point);
+  g_test_add_func ("/path/measure/sample", test_measure_sample);
 
   return g_test_run ();
 }
@@ -0,0 +1,353 @@
+/* Benchmarks for hit testing paths, comparing the spatial index
+ * with iterating over all contours, and for sampling points along
+ * paths, comparing batched lookups with looking up every point.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtk/gtk.h>
+
+#include "gsk/gskcontourprivate.h"
+#include "gsk/gskpathindexprivate.h"
+#include "gsk/gskpathmeasureprivate.h"
+#include "gsk/gskpathprivate.h"
+
+#include "testsuite/benchmarkutils.h"
+
+/* {{{ Options */
+
+static int size = 20000;
+static int n_queries = 1000;
+static double threshold = 10;
+
+static const GOptionEntry entries[] = {
+  { "size", 0, 0, G_OPTION_ARG_INT, &size, "Number of curves in each path", "CURVES" },
+  { "queries", 0, 0, G_OPTION_ARG_INT, &n_queries, "Number of points to test or sample in each run", "POINTS" },
+  { "threshold", 0, 0, G_OPTION_ARG_DOUBLE, &threshold, "Threshold for closest point queries", "DISTANCE" },
+  { NULL, }
+};
+
+typedef struct {
+  const char *name;
+  GskPath *path;
+  GskPathIndex *index;
+  GskPathMeasure *measure;
+  graphene_point_t *points;
+  int n_points;
+  float *distances;
+  int result;
+} Scene;
+
+/* }}} */
+/* {{{ Scenes */
+
+/* A long closed outline, like a coastline on a map */
+static GskPath *
+create_outline (GRand *rand,
+                int    n_curves)
+{
+  GskPathBuilder *builder;
+  int i;
+
+  builder = gsk_path_builder_new ();
+  gsk_path_builder_move_to (builder, 500, 0);
+  for (i = 1; i < n_curves; i++)
+    {
+      float angle = 2 * G_PI * i / n_curves;
+      float radius = g_rand_double_range (rand, 400, 500);
+
+      gsk_path_builder_line_to (builder, 500 + radius * sinf (angle), 500 - radius * cosf (angle));
+    }
+  gsk_path_builder_close (builder);
+
+  return gsk_path_builder_free_to_path (builder);
+}
+
+/* Lots of curvy contours, like roads or the edges of a diagram */
+static GskPath *
+create_curves (GRand *rand,
+               int    n_curves)
+{
+  GskPathBuilder *builder;
+  int i;
+
+  builder = gsk_path_builder_new ();
+  for (i = 0; i < n_curves; i++)
+    {
+      float x, y;
+
+      if (i % 32 == 0)
+        gsk_path_builder_move_to (builder,
+                                  g_rand_double_range (rand, 0, 1000),
+                                  g_rand_double_range (rand, 0, 1000));
+
+      x = g_rand_double_range (rand, -20, 20);
+      y = g_rand_double_range (rand, -20, 20);
+      gsk_path_builder_rel_cubic_to (builder, x, 0, x, y, 2 * x, 2 * y);
+    }
+
+  return gsk_path_builder_free_to_path (builder);
+}
+
+/* Many small shapes, like the nodes of a diagram */
+static GskPath *
+create_shapes (GRand *rand,
+               int    n_curves)
+{
+  GskPathBuilder *builder;
+  int i;
+
+  builder = gsk_path_builder_new ();
+  for (i = 0; i < n_curves / 4; i++)
+    {
+      float x = g_rand_double_range (rand, 0, 1000);
+      float y = g_rand_double_range (rand, 0, 1000);
+
+      switch (i % 3)
+        {
+        case 0:
+          gsk_path_builder_add_rect (builder, &GRAPHENE_RECT_INIT (x, y, 10, 6));
+          break;
+        case 1:
+          gsk_path_builder_add_circle (builder, &GRAPHENE_POINT_INIT (x, y), 5);
+          break;
+        case 2:
+          gsk_path_builder_move_to (builder, x, y);
+          gsk_path_builder_rel_line_to (builder, 10, 0);
+          gsk_path_builder_rel_line_to (builder, -5, 8);
+          gsk_path_builder_close (builder);
+          break;
+        default:
+          g_assert_not_reached ();
+        }
+    }
+
+  return gsk_path_builder_free_to_path (builder);
+}
+
+static Scene *
+scene_new (const char *name,
+           GskPath    *path,
+           GRand      *rand)
+{
+  Scene *scene;
+  int i;
+
+  scene = g_new0 (Scene, 1);
+  scene->name = name;
+  scene->path = path;
+  scene->index = gsk_path_index_new (path);
+  scene->n_points = n_queries;
+  scene->points = g_new (graphene_point_t, n_queries);
+  for (i = 0; i < n_queries; i++)
+    scene->points[i] = GRAPHENE_POINT_INIT (g_rand_double_range (rand, 0, 1000),
+                                            g_rand_double_range (rand, 0, 1000));
+
+  /* Evenly spaced, like dashes or glyphs along the path */
+  scene->measure = gsk_path_measure_new (path);
+  scene->distances = g_new (float, n_queries);
+  for (i = 0; i < n_queries; i++)
+    scene->distances[i] = gsk_path_measure_get_length (scene->measure) * i / n_queries;
+
+  return scene;
+}
+
+static void
+scene_free (Scene *scene)
+{
+  gsk_path_index_free (scene->index);
+  gsk_path_measure_unref (scene->measure);
+  gsk_path_unref (scene->path);
+  g_free (scene->points);
+  g_free (scene->distances);
+  g_free (scene);
+}
+
+/* }}} */
+/* {{{ Benchmarks */
+
+static void
+build_index (gpointer data)
+{
+  Scene *scene = data;
+
+  gsk_path_index_free (gsk_path_index_new (scene->path));
+}
+
+/* This is what gsk_path_in_fill() does without an index */
+static void
+winding_linear (gpointer data)
+{
+  Scene *scene = data;
+  gsize n_contours = gsk_path_get_n_contours (scene->path);
+
+  for (int i = 0; i < scene->n_points; i++)
+    {
+      int winding = 0;
+
+      for (gsize j = 0; j < n_contours; j++)
+        winding += gsk_contour_get_winding (gsk_path_get_contour (scene->path, j), &scene->points[i]);
+
+      scene->result += winding;
+    }
+}
+
+static void
+winding_index (gpointer data)
+{
+  Scene *scene = data;
+
+  for (int i = 0; i < scene->n_points; i++)
+    scene->result += gsk_path_index_get_winding (scene->index, &scene->points[i]);
+}
+
+/* This is what gsk_path_get_closest_point() does without an index */
+static void
+closest_linear (gpointer data)
+{
+  Scene *scene = data;
+  gsize n_contours = gsk_path_get_n_contours (scene->path);
+
+  for (int i = 0; i < scene->n_points; i++)
+    {
+      GskPathPoint result;
+      float dist = threshold;
+
+      for (gsize j = 0; j < n_contours; j++)
+        {
+          if (gsk_contour_get_closest_point (gsk_path_get_contour (scene->path, j),
+                                             &scene->points[i], dist, &result, &dist))
+            scene->result++;
+        }
+    }
+}
+
+static void
+closest_index (gpointer data)
+{
+  Scene *scene = data;
+
+  for (int i = 0; i < scene->n_points; i++)
+    {
+      GskPathPoint result;
+      float dist;
+
+      if (gsk_path_index_get_closest_point (scene->index, &scene->points[i], threshold, &result, &dist))
+        scene->result++;
+    }
+}
+
+static void
+build_measure (gpointer data)
+{
+  Scene *scene = data;
+  GskPathMeasure *measure;
+
+  measure = gsk_path_measure_new (scene->path);
+  gsk_path_measure_prepare (measure);
+  gsk_path_measure_unref (measure);
+}
+
+static void
+sample_single (gpointer data)
+{
+  Scene *scene = data;
+
+  for (int i = 0; i < scene->n_points; i++)
+    {
+      GskPathPoint point;
+      graphene_point_t pos;
+      graphene_vec2_t tangent;
+
+      gsk_path_measure_get_point (scene->measure, scene->distances[i], &point);
+      gsk_path_point_get_position (&point, scene->path, &pos);
+      gsk_path_point_get_tangent (&point, scene->path, GSK_PATH_TO_END, &tangent);
+
+      scene->result += pos.x > 500;
+    }
+}
+
+static void
+sample_batch (gpointer data)
+{
+  Scene *scene = data;
+  graphene_point_t *pos = g_new (graphene_point_t, scene->n_points);
+  graphene_vec2_t *tangents = g_new (graphene_vec2_t, scene->n_points);
+
+  gsk_path_measure_sample (scene->measure,
+                           scene->distances, scene->n_points,
+                           GSK_PATH_TO_END,
+                           NULL, pos, tangents);
+
+  for (int i = 0; i < scene->n_points; i++)
+    scene->result += pos[i].x > 500;
+
+  g_free (pos);
+  g_free (tangents);
+}
+
+static void
+benchmark_scene (Scene *scene)
+{
+  benchmark_run ("build", "index", scene->name, BENCHMARK_UNIT_OPS, 1, build_index, scene);
+  benchmark_run ("build", "measure", scene->name, BENCHMARK_UNIT_OPS, 1, build_measure, scene);
+  benchmark_run ("in-fill", "linear", scene->name, BENCHMARK_UNIT_OPS, scene->n_points, winding_linear, scene);
+  benchmark_run ("in-fill", "index", scene->name, BENCHMARK_UNIT_OPS, scene->n_points, winding_index, scene);
+  benchmark_run ("closest", "linear", scene->name, BENCHMARK_UNIT_OPS, scene->n_points, closest_linear, scene);
+  benchmark_run ("closest", "index", scene->name, BENCHMARK_UNIT_OPS, scene->n_points, closest_index, scene);
+  benchmark_run ("sample", "single", scene->name, BENCHMARK_UNIT_OPS, scene->n_points, sample_single, scene);
+  benchmark_run ("sample", "batch", scene->name, BENCHMARK_UNIT_OPS, scene->n_points, sample_batch, scene);
+}
+
+/* }}} */
+
+int
+main (int argc, char *argv[])
+{
+  GPtrArray *scenes;
+  GRand *rand;
+  guint i;
+
+  benchmark_init (&argc, &argv, entries,
+                  "Benchmark hit testing and measuring of paths.\n"
+                  "Groups are build, in-fill, closest and sample.");
+
+  if (benchmark_is_quick ())
+    {
+      size = 200;
+      n_queries = 10;
+    }
+
+  if (size < 4 || n_queries < 1 || threshold < 0)
+    {
+      g_printerr ("Need at least four curves, one query and a positive threshold\n");
+      exit (1);
+    }
+
+  rand = g_rand_new_with_seed (42);
+  scenes = g_ptr_array_new_with_free_func ((GDestroyNotify) scene_free);
+  g_ptr_array_add (scenes, scene_new ("outline", create_outline (rand, size), rand));
+  g_ptr_array_add (scenes, scene_new ("curves", create_curves (rand, size), rand));
+  g_ptr_array_add (scenes, scene_new ("shapes", create_shapes (rand, size), rand));
+
+  benchmark_add_info ("size", "%d", size);
+  benchmark_add_info ("threshold", "%g", threshold);
+  benchmark_begin ();
+
+  for (i = 0; i < scenes->len; i++)
+    benchmark_scene (g_ptr_array_index (scenes, i));
+
+  benchmark_end ();
+
+  g_ptr_array_unref (scenes);
+  g_rand_free (rand);
+
+  return 0;
+}
+
+/* vim:set foldmethod=marker: */
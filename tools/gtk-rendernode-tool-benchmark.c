@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <math.h>
 
 #include <glib/gi18n-lib.h>
 #include <glib/gprintf.h>
@@ -29,32 +30,749 @@
 #include <gtk/gtk.h>
 #include "gtk-rendernode-tool.h"
 
+/* Changes smaller than this are printed, but not marked as faster or
+ * slower and don't count as regressions */
+#define DEFAULT_THRESHOLD 5.0 /* percent */
+
+/* Percentiles and the Mann-Whitney U test need this many samples
+ * to be meaningful */
+#define MIN_RUNS 20
+
+#define SIGNIFICANCE 0.05
+
+typedef struct _Result Result;
+
+struct _Result
+{
+  char *filename;
+  const char *renderer;
+  /* double, milliseconds. Both are wall clock times. Rendering a
+   * texture waits for the GPU, so render includes GPU time. */
+  GArray *render;
+  GArray *total;  /* including the download, empty if not downloading */
+};
+
 static void
-benchmark_node (GskRenderNode *node,
-                const char    *renderer_name,
-                guint          runs,
-                gboolean       download)
+result_free (gpointer data)
 {
-  GError *error = NULL;
-  GskRenderer *renderer;
+  Result *result = data;
+
+  g_free (result->filename);
+  g_array_unref (result->render);
+  g_array_unref (result->total);
+  g_free (result);
+}
+
+static Result *
+result_new (const char *filename,
+            const char *renderer)
+{
+  Result *result = g_new0 (Result, 1);
+
+  result->filename = g_strdup (filename);
+  result->renderer = g_intern_string (renderer);
+  result->render = g_array_new (FALSE, FALSE, sizeof (double));
+  result->total = g_array_new (FALSE, FALSE, sizeof (double));
+
+  return result;
+}
+
+static int
+compare_doubles (gconstpointer a,
+                 gconstpointer b)
+{
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/* The samples must be sorted */
+static double
+percentile (GArray *samples,
+            double  p)
+{
+  gsize rank;
+
+  if (samples->len == 0)
+    return NAN;
+
+  /* nearest rank */
+  rank = (gsize) ceil (p / 100.0 * samples->len);
+  rank = CLAMP (rank, 1, samples->len);
+
+  return g_array_index (samples, double, rank - 1);
+}
+
+static double
+median (GArray *samples)
+{
+  GArray *sorted;
+  double result;
+
+  sorted = g_array_copy (samples);
+  g_array_sort (sorted, compare_doubles);
+  if (sorted->len == 0)
+    result = NAN;
+  else if (sorted->len % 2)
+    result = g_array_index (sorted, double, sorted->len / 2);
+  else
+    result = (g_array_index (sorted, double, sorted->len / 2 - 1) +
+              g_array_index (sorted, double, sorted->len / 2)) / 2;
+  g_array_unref (sorted);
+
+  return result;
+}
+
+static void
+print_stats (const char *label,
+             GArray     *samples)
+{
+  GArray *sorted;
+
+  if (samples->len == 0)
+    return;
+
+  sorted = g_array_copy (samples);
+  g_array_sort (sorted, compare_doubles);
+
+  g_print ("  %s\tmin %8.3fms\tmedian %8.3fms\tp95 %8.3fms\tp99 %8.3fms\n",
+           label,
+           g_array_index (sorted, double, 0),
+           median (sorted),
+           percentile (sorted, 95),
+           percentile (sorted, 99));
+
+  g_array_unref (sorted);
+}
+
+static void
+print_result (const Result *result)
+{
+  g_print ("%s\t%s\n", result->filename, result->renderer);
+  print_stats ("render", result->render);
+  print_stats ("total", result->total);
+}
+
+static void
+append_json_string (GString    *string,
+                    const char *s)
+{
+  g_string_append_c (string, '"');
+  for (; *s; s++)
+    {
+      if (*s == '"' || *s == '\\')
+        g_string_append_printf (string, "\\%c", *s);
+      else if ((guchar) *s < 0x20)
+        g_string_append_printf (string, "\\u%04x", (guchar) *s);
+      else
+        g_string_append_c (string, *s);
+    }
+  g_string_append_c (string, '"');
+}
+
+static void
+append_json_samples (GString    *string,
+                     const char *name,
+                     GArray     *samples)
+{
+  char buf[G_ASCII_DTOSTR_BUF_SIZE];
+  GArray *sorted;
   guint i;
 
-  renderer = create_renderer (renderer_name, &error);
-  if (renderer == NULL)
+  sorted = g_array_copy (samples);
+  g_array_sort (sorted, compare_doubles);
+
+  g_string_append_printf (string, "      \"%s\": {\n", name);
+  if (sorted->len > 0)
     {
-      g_printerr ("Could not benchmark renderer \"%s\": %s\n", renderer_name, error->message);
-      g_clear_error (&error);
-      return;
+      g_string_append_printf (string, "        \"min\": %s,\n",
+                              g_ascii_formatd (buf, sizeof (buf), "%.4f", g_array_index (sorted, double, 0)));
+      g_string_append_printf (string, "        \"median\": %s,\n",
+                              g_ascii_formatd (buf, sizeof (buf), "%.4f", median (sorted)));
+      g_string_append_printf (string, "        \"p95\": %s,\n",
+                              g_ascii_formatd (buf, sizeof (buf), "%.4f", percentile (sorted, 95)));
+      g_string_append_printf (string, "        \"p99\": %s,\n",
+                              g_ascii_formatd (buf, sizeof (buf), "%.4f", percentile (sorted, 99)));
+    }
+  g_string_append (string, "        \"samples\": [");
+  for (i = 0; i < samples->len; i++)
+    {
+      if (i > 0)
+        g_string_append (string, ", ");
+      g_string_append (string, g_ascii_formatd (buf, sizeof (buf), "%.4f", g_array_index (samples, double, i)));
+    }
+  g_string_append (string, "]\n      }");
+
+  g_array_unref (sorted);
+}
+
+static void
+print_json (GPtrArray *results,
+            guint      warmup)
+{
+  GString *string;
+  guint i;
+
+  string = g_string_new ("{\n");
+  g_string_append (string, "  \"version\": 1,\n");
+  g_string_append_printf (string, "  \"warmup\": %u,\n", warmup);
+  g_string_append (string, "  \"results\": [");
+
+  for (i = 0; i < results->len; i++)
+    {
+      const Result *result = g_ptr_array_index (results, i);
+
+      g_string_append (string, i > 0 ? ",\n    {\n" : "\n    {\n");
+      g_string_append (string, "      \"file\": ");
+      append_json_string (string, result->filename);
+      g_string_append (string, ",\n      \"renderer\": ");
+      append_json_string (string, result->renderer);
+      g_string_append (string, ",\n");
+      append_json_samples (string, "render", result->render);
+      g_string_append (string, ",\n");
+      append_json_samples (string, "total", result->total);
+      g_string_append (string, "\n    }");
+    }
+
+  g_string_append (string, "\n  ]\n}\n");
+
+  g_print ("%s", string->str);
+  g_string_free (string, TRUE);
+}
+
+/* {{{ Reading results */
+
+/* A small JSON reader that turns objects into a{sv}, arrays into av,
+ * numbers into d, strings into s, booleans into b and null into mv.
+ * That is enough for reading back our own results.
+ */
+static GVariant *parse_json_value (const char **p,
+                                   GError     **error);
+
+static void
+skip_whitespace (const char **p)
+{
+  while (g_ascii_isspace (**p))
+    (*p)++;
+}
+
+static gboolean
+parse_json_string (const char **p,
+                   char       **out_string,
+                   GError     **error)
+{
+  GString *string;
+
+  if (**p != '"')
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Expected a string"));
+      return FALSE;
+    }
+  (*p)++;
+
+  string = g_string_new (NULL);
+  while (**p != '"')
+    {
+      if (**p == '\0')
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Unterminated string"));
+          g_string_free (string, TRUE);
+          return FALSE;
+        }
+      else if (**p == '\\')
+        {
+          (*p)++;
+          switch (**p)
+            {
+            case 'b': g_string_append_c (string, '\b'); break;
+            case 'f': g_string_append_c (string, '\f'); break;
+            case 'n': g_string_append_c (string, '\n'); break;
+            case 'r': g_string_append_c (string, '\r'); break;
+            case 't': g_string_append_c (string, '\t'); break;
+            case 'u':
+              {
+                char hex[5] = { 0, };
+                char *end;
+                gunichar c;
+
+                if (strlen (*p + 1) < 4)
+                  {
+                    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Invalid escape"));
+                    g_string_free (string, TRUE);
+                    return FALSE;
+                  }
+                memcpy (hex, *p + 1, 4);
+                c = g_ascii_strtoull (hex, &end, 16);
+                if (*end != '\0')
+                  {
+                    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Invalid escape"));
+                    g_string_free (string, TRUE);
+                    return FALSE;
+                  }
+                g_string_append_unichar (string, c);
+                *p += 4;
+              }
+              break;
+            case '\0':
+              continue;
+            default:
+              g_string_append_c (string, **p);
+              break;
+            }
+          (*p)++;
+        }
+      else
+        {
+          g_string_append_c (string, **p);
+          (*p)++;
+        }
+    }
+  (*p)++;
+
+  *out_string = g_string_free (string, FALSE);
+  return TRUE;
+}
+
+static GVariant *
+parse_json_object (const char **p,
+                   GError     **error)
+{
+  GVariantBuilder builder;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  (*p)++;
+  skip_whitespace (p);
+
+  if (**p == '}')
+    {
+      (*p)++;
+      return g_variant_builder_end (&builder);
+    }
+
+  while (TRUE)
+    {
+      GVariant *value;
+      char *key;
+
+      skip_whitespace (p);
+      if (!parse_json_string (p, &key, error))
+        goto fail;
+
+      skip_whitespace (p);
+      if (**p != ':')
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Expected “:”"));
+          g_free (key);
+          goto fail;
+        }
+      (*p)++;
+
+      value = parse_json_value (p, error);
+      if (value == NULL)
+        {
+          g_free (key);
+          goto fail;
+        }
+      g_variant_builder_add (&builder, "{sv}", key, value);
+      g_free (key);
+
+      skip_whitespace (p);
+      if (**p == '}')
+        break;
+      if (**p != ',')
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Expected “,” or “}”"));
+          goto fail;
+        }
+      (*p)++;
+    }
+  (*p)++;
+
+  return g_variant_builder_end (&builder);
+
+fail:
+  g_variant_builder_clear (&builder);
+  return NULL;
+}
+
+static GVariant *
+parse_json_array (const char **p,
+                  GError     **error)
+{
+  GVariantBuilder builder;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("av"));
+  (*p)++;
+  skip_whitespace (p);
+
+  if (**p == ']')
+    {
+      (*p)++;
+      return g_variant_builder_end (&builder);
+    }
+
+  while (TRUE)
+    {
+      GVariant *value;
+
+      value = parse_json_value (p, error);
+      if (value == NULL)
+        {
+          g_variant_builder_clear (&builder);
+          return NULL;
+        }
+      g_variant_builder_add (&builder, "v", value);
+
+      skip_whitespace (p);
+      if (**p == ']')
+        break;
+      if (**p != ',')
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Expected “,” or “]”"));
+          g_variant_builder_clear (&builder);
+          return NULL;
+        }
+      (*p)++;
+    }
+  (*p)++;
+
+  return g_variant_builder_end (&builder);
+}
+
+static GVariant *
+parse_json_value (const char **p,
+                  GError     **error)
+{
+  skip_whitespace (p);
+
+  switch (**p)
+    {
+    case '{':
+      return parse_json_object (p, error);
+
+    case '[':
+      return parse_json_array (p, error);
+
+    case '"':
+      {
+        char *string;
+
+        if (!parse_json_string (p, &string, error))
+          return NULL;
+
+        return g_variant_new_take_string (string);
+      }
+
+    default:
+      if (g_str_has_prefix (*p, "true"))
+        {
+          *p += strlen ("true");
+          return g_variant_new_boolean (TRUE);
+        }
+      else if (g_str_has_prefix (*p, "false"))
+        {
+          *p += strlen ("false");
+          return g_variant_new_boolean (FALSE);
+        }
+      else if (g_str_has_prefix (*p, "null"))
+        {
+          *p += strlen ("null");
+          return g_variant_new_maybe (G_VARIANT_TYPE_VARIANT, NULL);
+        }
+      else
+        {
+          char *end;
+          double d;
+
+          d = g_ascii_strtod (*p, &end);
+          if (end == *p)
+            {
+              g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Unexpected character “%c”"), **p);
+              return NULL;
+            }
+          *p = end;
+
+          return g_variant_new_double (d);
+        }
+    }
+}
+
+static GArray *
+read_samples (GVariant   *result,
+              const char *name)
+{
+  GVariant *stats, *samples;
+  GArray *array;
+  gsize i;
+
+  array = g_array_new (FALSE, FALSE, sizeof (double));
+
+  stats = g_variant_lookup_value (result, name, G_VARIANT_TYPE_VARDICT);
+  if (stats == NULL)
+    return array;
+
+  samples = g_variant_lookup_value (stats, "samples", G_VARIANT_TYPE ("av"));
+  if (samples)
+    {
+      for (i = 0; i < g_variant_n_children (samples); i++)
+        {
+          GVariant *child = g_variant_get_child_value (samples, i);
+          GVariant *value = g_variant_get_variant (child);
+
+          if (g_variant_is_of_type (value, G_VARIANT_TYPE_DOUBLE))
+            {
+              double d = g_variant_get_double (value);
+              g_array_append_val (array, d);
+            }
+
+          g_variant_unref (value);
+          g_variant_unref (child);
+        }
+      g_variant_unref (samples);
+    }
+  g_variant_unref (stats);
+
+  return array;
+}
+
+static GPtrArray *
+load_results (const char *filename)
+{
+  GPtrArray *results;
+  GError *error = NULL;
+  GVariant *json, *list;
+  const char *p;
+  char *contents;
+  gsize i;
+
+  if (!g_file_get_contents (filename, &contents, NULL, &error))
+    {
+      g_printerr (_("Failed to load results: %s\n"), error->message);
+      exit (1);
+    }
+
+  p = contents;
+  json = parse_json_value (&p, &error);
+  if (json == NULL)
+    {
+      g_printerr (_("Failed to parse %s at offset %ld: %s\n"), filename, (long) (p - contents), error->message);
+      exit (1);
+    }
+  g_variant_ref_sink (json);
+  g_free (contents);
+
+  list = NULL;
+  if (g_variant_is_of_type (json, G_VARIANT_TYPE_VARDICT))
+    list = g_variant_lookup_value (json, "results", G_VARIANT_TYPE ("av"));
+  if (list == NULL)
+    {
+      g_printerr (_("%s does not contain benchmark results\n"), filename);
+      exit (1);
+    }
+
+  results = g_ptr_array_new_with_free_func (result_free);
+
+  for (i = 0; i < g_variant_n_children (list); i++)
+    {
+      GVariant *child = g_variant_get_child_value (list, i);
+      GVariant *entry = g_variant_get_variant (child);
+      const char *file, *renderer;
+
+      if (g_variant_is_of_type (entry, G_VARIANT_TYPE_VARDICT) &&
+          g_variant_lookup (entry, "file", "&s", &file) &&
+          g_variant_lookup (entry, "renderer", "&s", &renderer))
+        {
+          Result *result = result_new (file, renderer);
+
+          g_array_unref (result->render);
+          g_array_unref (result->total);
+          result->render = read_samples (entry, "render");
+          result->total = read_samples (entry, "total");
+
+          g_ptr_array_add (results, result);
+        }
+
+      g_variant_unref (entry);
+      g_variant_unref (child);
+    }
+
+  g_variant_unref (list);
+  g_variant_unref (json);
+
+  return results;
+}
+
+/* }}} */
+/* {{{ Comparing results */
+
+/* Two-sided Mann-Whitney U test with the normal approximation.
+ * It does not assume a distribution, which is good for timings
+ * that tend to have long tails.
+ */
+typedef struct
+{
+  double value;
+  guint group;
+} Sample;
+
+static int
+compare_sample (gconstpointer a,
+                gconstpointer b)
+{
+  double va = ((const Sample *) a)->value;
+  double vb = ((const Sample *) b)->value;
+
+  return va < vb ? -1 : va > vb;
+}
+
+static double
+mann_whitney_p_value (GArray *a,
+                      GArray *b)
+{
+  Sample *all;
+  double rank_sum_a, ties, u, mu, sigma, z;
+  guint n_a = a->len, n_b = b->len, n = n_a + n_b;
+  guint i, j, k;
+
+  if (n_a == 0 || n_b == 0)
+    return 1.0;
+
+  all = g_new (Sample, n);
+  for (i = 0; i < n_a; i++)
+    all[i] = (Sample) { g_array_index (a, double, i), 0 };
+  for (i = 0; i < n_b; i++)
+    all[n_a + i] = (Sample) { g_array_index (b, double, i), 1 };
+
+  qsort (all, n, sizeof (Sample), compare_sample);
+
+  rank_sum_a = 0;
+  ties = 0;
+  for (i = 0; i < n; i = j)
+    {
+      double rank, t;
+
+      /* ties get the average of their ranks */
+      for (j = i + 1; j < n && all[j].value == all[i].value; j++)
+        ;
+      rank = (i + 1 + j) / 2.0;
+      t = j - i;
+      ties += t * t * t - t;
+      for (k = i; k < j; k++)
+        {
+          if (all[k].group == 0)
+            rank_sum_a += rank;
+        }
+    }
+
+  g_free (all);
+
+  u = rank_sum_a - n_a * (n_a + 1) / 2.0;
+  mu = n_a * n_b / 2.0;
+  /* ties reduce the variance of u */
+  sigma = sqrt ((double) n_a * n_b / 12.0 * ((n + 1) - ties / ((double) n * (n - 1))));
+  if (!(sigma > 0))
+    return 1.0;
+
+  z = (u - mu) / sigma;
+
+  return erfc (fabs (z) / G_SQRT2);
+}
+
+static gboolean
+compare_samples (const char *filename,
+                 const char *renderer,
+                 const char *label,
+                 GArray     *old_samples,
+                 GArray     *new_samples,
+                 double      threshold)
+{
+  double old_median, new_median, change, p;
+  const char *verdict;
+
+  if (old_samples->len == 0 || new_samples->len == 0)
+    return FALSE;
+
+  old_median = median (old_samples);
+  new_median = median (new_samples);
+  change = old_median > 0 ? (new_median - old_median) * 100 / old_median : 0;
+  p = mann_whitney_p_value (old_samples, new_samples);
+
+  if (p >= SIGNIFICANCE || fabs (change) < threshold)
+    verdict = "";
+  else if (change > 0)
+    verdict = _("slower");
+  else
+    verdict = _("faster");
+
+  g_print ("%s\t%s\t%s\t%8.3fms\t%8.3fms\t%+6.1f%%\tp=%.3f\t%s\n",
+           filename, renderer, label,
+           old_median, new_median, change, p, verdict);
+
+  return p < SIGNIFICANCE && change >= threshold;
+}
+
+static int
+compare_results (const char *old_file,
+                 const char *new_file,
+                 double      threshold)
+{
+  GPtrArray *old_results, *new_results;
+  gboolean regressed = FALSE;
+  guint i, j;
+
+  old_results = load_results (old_file);
+  new_results = load_results (new_file);
+
+  for (i = 0; i < new_results->len; i++)
+    {
+      Result *new_result = g_ptr_array_index (new_results, i);
+
+      for (j = 0; j < old_results->len; j++)
+        {
+          Result *old_result = g_ptr_array_index (old_results, j);
+
+          if (!g_str_equal (old_result->filename, new_result->filename) ||
+              old_result->renderer != new_result->renderer)
+            continue;
+
+          regressed |= compare_samples (new_result->filename, new_result->renderer, "render",
+                                        old_result->render, new_result->render, threshold);
+          regressed |= compare_samples (new_result->filename, new_result->renderer, "total",
+                                        old_result->total, new_result->total, threshold);
+          break;
+        }
     }
 
-  for (i = 0; i < runs; i++)
+  g_ptr_array_unref (old_results);
+  g_ptr_array_unref (new_results);
+
+  return regressed ? 1 : 0;
+}
+
+/* }}} */
+
+static void
+benchmark_node (GskRenderer   *renderer,
+                GskRenderNode *node,
+                Result        *result,
+                guint          warmup,
+                guint          runs,
+                gboolean       download)
+{
+  guint i;
+
+  for (i = 0; i < warmup + runs; i++)
     {
       GdkTexture *texture;
-      gint64 start_time, end_time, duration;
+      gint64 start_time, render_time, end_time;
 
       start_time = g_get_monotonic_time ();
 
       texture = gsk_renderer_render_texture (renderer, node, NULL);
+
+      render_time = g_get_monotonic_time ();
+
       if (download)
         {
           GdkTextureDownloader *downloader;
@@ -69,16 +787,66 @@ benchmark_node (GskRenderNode *node,
 
       end_time = g_get_monotonic_time ();
 
-      duration = end_time - start_time;
-      g_print ("%s\t%lld.%03ds\n",
-               renderer_name,
-               (long long) duration / G_USEC_PER_SEC,
-               (int) ((duration * 1000 / G_USEC_PER_SEC) % 1000)); 
       g_object_unref (texture);
+
+      if (i >= warmup)
+        {
+          double render = (render_time - start_time) / 1000.0;
+          double total = (end_time - start_time) / 1000.0;
+
+          g_array_append_val (result->render, render);
+          if (download)
+            g_array_append_val (result->total, total);
+        }
     }
+}
+
+static void
+add_node_files (GPtrArray  *files,
+                const char *filename)
+{
+  GFile *file;
+  GFileEnumerator *enumerator;
+  GFileInfo *info;
+  GPtrArray *children;
+  GError *error = NULL;
 
-  gsk_renderer_unrealize (renderer);
-  g_object_unref (renderer);
+  if (!g_file_test (filename, G_FILE_TEST_IS_DIR))
+    {
+      g_ptr_array_add (files, g_strdup (filename));
+      return;
+    }
+
+  file = g_file_new_for_commandline_arg (filename);
+  enumerator = g_file_enumerate_children (file,
+                                          G_FILE_ATTRIBUTE_STANDARD_NAME,
+                                          G_FILE_QUERY_INFO_NONE,
+                                          NULL,
+                                          &error);
+  if (enumerator == NULL)
+    {
+      g_printerr (_("Could not read directory %s: %s\n"), filename, error->message);
+      exit (1);
+    }
+
+  children = g_ptr_array_new ();
+  while ((info = g_file_enumerator_next_file (enumerator, NULL, NULL)))
+    {
+      const char *name = g_file_info_get_name (info);
+
+      if (g_str_has_suffix (name, ".node") ||
+          g_str_has_suffix (name, ".bnode"))
+        g_ptr_array_add (children, g_build_filename (filename, name, NULL));
+
+      g_object_unref (info);
+    }
+
+  /* Keep the order stable, so results are easy to compare */
+  g_ptr_array_sort_values (children, (GCompareFunc) strcmp);
+  g_ptr_array_extend_and_steal (files, children);
+
+  g_object_unref (enumerator);
+  g_object_unref (file);
 }
 
 void
@@ -89,29 +857,31 @@ do_benchmark (int          *argc,
   char **filenames = NULL;
   char **renderers = NULL;
   gboolean nodownload = FALSE;
-  int runs = 3;
+  gboolean json = FALSE;
+  gboolean compare = FALSE;
+  double threshold = DEFAULT_THRESHOLD;
+  int runs = MIN_RUNS;
+  int warmup = 1;
   const GOptionEntry entries[] = {
     { "renderer", 0, 0, G_OPTION_ARG_STRING_ARRAY, &renderers, N_("Add renderer to benchmark"), N_("RENDERER") },
     { "runs", 0, 0, G_OPTION_ARG_INT, &runs, N_("Number of runs with each renderer"), N_("RUNS") },
+    { "warmup", 0, 0, G_OPTION_ARG_INT, &warmup, N_("Number of runs to discard before measuring"), N_("RUNS") },
     { "no-download", 0, 0, G_OPTION_ARG_NONE, &nodownload, N_("Don’t download result/wait for GPU to finish"), NULL },
+    { "json", 0, 0, G_OPTION_ARG_NONE, &json, N_("Print results as JSON"), NULL },
+    { "compare", 0, 0, G_OPTION_ARG_NONE, &compare, N_("Compare two JSON result files"), NULL },
+    { "threshold", 0, 0, G_OPTION_ARG_DOUBLE, &threshold, N_("Smallest change to mark as faster or slower when comparing"), N_("PERCENT") },
     { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &filenames, NULL, N_("FILE…") },
     { NULL, }
   };
-  GskRenderNode *node;
+  GPtrArray *files, *results;
   GError *error = NULL;
-  gsize i;
-
-  if (gdk_display_get_default () == NULL)
-    {
-      g_printerr (_("Could not initialize windowing system\n"));
-      exit (1);
-    }
+  gsize i, j;
 
   g_set_prgname ("gtk4-rendernode-tool benchmark");
   context = g_option_context_new (NULL);
   g_option_context_set_translation_domain (context, GETTEXT_PACKAGE);
   g_option_context_add_main_entries (context, entries, NULL);
-  g_option_context_set_summary (context, _("Benchmark rendering of a .node file."));
+  g_option_context_set_summary (context, _("Benchmark rendering of .node files."));
 
   if (!g_option_context_parse (context, argc, (char ***)argv, &error))
     {
@@ -122,30 +892,92 @@ do_benchmark (int          *argc,
 
   g_option_context_free (context);
 
+  if (compare)
+    {
+      int status;
+
+      if (filenames == NULL || g_strv_length (filenames) != 2)
+        {
+          g_printerr (_("Must specify two result files to compare\n"));
+          exit (1);
+        }
+
+      status = compare_results (filenames[0], filenames[1], threshold);
+      g_strfreev (filenames);
+      g_strfreev (renderers);
+      exit (status);
+    }
+
+  if (gdk_display_get_default () == NULL)
+    {
+      g_printerr (_("Could not initialize windowing system\n"));
+      exit (1);
+    }
+
   if (filenames == NULL)
     {
       g_printerr (_("No .node file specified\n"));
       exit (1);
     }
 
-  if (g_strv_length (filenames) > 1)
+  if (runs < 1 || warmup < 0)
     {
-      g_printerr (_("Can only benchmark a single .node file\n"));
+      g_printerr (_("Invalid number of runs\n"));
       exit (1);
     }
 
+  if (runs < MIN_RUNS)
+    g_printerr (_("Warning: Percentiles and comparisons are not meaningful with fewer than %d runs\n"), MIN_RUNS);
+
   if (renderers == NULL || renderers[0] == NULL)
     renderers = g_strdupv ((char **) (const char *[]) { "gl", "ngl", "vulkan", "cairo", NULL });
-  
-  node = load_node_file (filenames[0]);
+
+  files = g_ptr_array_new_with_free_func (g_free);
+  for (i = 0; filenames[i] != NULL; i++)
+    add_node_files (files, filenames[i]);
+
+  results = g_ptr_array_new_with_free_func (result_free);
 
   for (i = 0; renderers[i] != NULL; i++)
     {
-      benchmark_node (node, renderers[i], runs, !nodownload);
+      GskRenderer *renderer;
+
+      renderer = create_renderer (renderers[i], &error);
+      if (renderer == NULL)
+        {
+          g_printerr ("Could not benchmark renderer \"%s\": %s\n", renderers[i], error->message);
+          g_clear_error (&error);
+          continue;
+        }
+
+      for (j = 0; j < files->len; j++)
+        {
+          const char *filename = g_ptr_array_index (files, j);
+          GskRenderNode *node;
+          Result *result;
+
+          node = load_node_file (filename);
+          if (node == NULL)
+            continue;
+
+          result = result_new (filename, renderers[i]);
+          benchmark_node (renderer, node, result, warmup, runs, !nodownload);
+          if (!json)
+            print_result (result);
+          g_ptr_array_add (results, result);
+
+          gsk_render_node_unref (node);
+        }
+
+      gsk_renderer_unrealize (renderer);
+      g_object_unref (renderer);
     }
 
-  gsk_render_node_unref (node);
+  if (json)
+    print_json (results, warmup);
 
+  g_ptr_array_unref (results);
+  g_ptr_array_unref (files);
   g_strfreev (filenames);
   g_strfreev (renderers);
 }
@@ -38,7 +38,8 @@ texture_from_file (const char   *filename,
 {
   GdkTexture *texture;
 
-  if (g_str_has_suffix (filename, ".node"))
+  if (g_str_has_suffix (filename, ".node") ||
+      g_str_has_suffix (filename, ".bnode"))
     {
       GskRenderNode *node = load_node_file (filename);
       texture = gsk_renderer_render_texture (renderer, node, NULL);
@@ -45,6 +45,12 @@ get_save_filename (const char *filename)
       result = g_strconcat (basename, extension, NULL);
       g_free (basename);
     }
+  else if (g_str_has_suffix (filename, ".bnode"))
+    {
+      char *basename = g_strndup (filename, length - strlen (".bnode"));
+      result = g_strconcat (basename, extension, NULL);
+      g_free (basename);
+    }
   else
     result = g_strconcat (filename, extension, NULL);
 
@@ -61,10 +61,30 @@ load_node_file (const char *filename)
 {
   GFile *file;
   GBytes *bytes;
+  GskRenderNode *node;
   GError *error = NULL;
 
   file = g_file_new_for_commandline_arg (filename);
-  bytes = g_file_load_bytes (file, NULL, NULL, &error);
+  if (g_file_is_native (file))
+    {
+      char *path = g_file_get_path (file);
+      GMappedFile *mapped;
+
+      /* Map local files, so binary node files can reference
+       * their texture data without copying it
+       */
+      mapped = g_mapped_file_new (path, FALSE, &error);
+      if (mapped)
+        {
+          bytes = g_mapped_file_get_bytes (mapped);
+          g_mapped_file_unref (mapped);
+        }
+      else
+        bytes = NULL;
+      g_free (path);
+    }
+  else
+    bytes = g_file_load_bytes (file, NULL, NULL, &error);
   g_object_unref (file);
 
   if (bytes == NULL)
@@ -74,7 +94,10 @@ load_node_file (const char *filename)
       exit (1);
     }
 
-  return gsk_render_node_deserialize (bytes, deserialize_error_func, NULL);
+  node = gsk_render_node_deserialize (bytes, deserialize_error_func, NULL);
+  g_bytes_unref (bytes);
+
+  return node;
 }
 
 /* keep in sync with gsk/gskrenderer.c */